@@ -301,10 +301,15 @@ typedef struct {
 typedef struct {
 	List acct_list;		/* list of char * */
 	List associd_list;	/* list of char */
+	uint32_t chunk_size;    /* most jobs returned per call, 0 for all,
+				 * see slurmdb_jobs_get_chunked() */
 	List cluster_list;	/* list of char * */
 	List constraint_list; 	/* list of char * */
 	uint32_t cpus_max;      /* number of cpus high range */
 	uint32_t cpus_min;      /* number of cpus low range */
+	char *cursor_cluster;   /* with chunk_size, resume after this cluster's
+				 * job cursor_jobid */
+	uint32_t cursor_jobid;  /* last job id of the previous chunk */
 	uint32_t db_flags;      /* flags sent from the slurmctld on the job */
 	int32_t exitcode;       /* exit code of job */
 	uint32_t flags;         /* Reporting flags*/
@@ -590,6 +595,12 @@ struct slurmdb_assoc_usage {
 				  * (DON'T PACK for state file) */
 	uint64_t *grp_used_tres_run_secs; /* array of running tres secs
 					   * (DON'T PACK for state file) */
+	uint64_t *grp_tres_avail; /* tightest grp tres headroom of this
+				   * assoc and its parents, see
+				   * assoc_mgr_get_grp_tres_avail()
+				   * (DON'T PACK) */
+	uint32_t grp_tres_avail_gen; /* generation grp_tres_avail was
+				      * computed in (DON'T PACK) */
 
 	double grp_used_wall;   /* group count of time used in running jobs */
 	double fs_factor;	/* Fairshare factor. Not used by all algorithms
@@ -1338,6 +1349,10 @@ typedef struct {
 
 typedef struct {
 	slurmdb_rollup_stats_t *dbd_rollup_stats;
+	uint32_t mult_msg_cnt;          /* DBD_SEND_MULT_MSG batches processed */
+	uint64_t mult_msg_recs;         /* records in those batches */
+	uint64_t mult_msg_time_max;     /* longest batch in usecs */
+	uint64_t mult_msg_time_total;   /* usecs spent on all batches */
 	List rollup_stats;              /* List of Clusters rollup stats */
 	List rpc_list;                  /* list of RPCs sent to the dbd. */
 	time_t time_start;              /* When we started collecting data */
@@ -1649,6 +1664,21 @@ extern List slurmdb_job_modify(void *db_conn,
  */
 extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond);
 
+/*
+ * get info from the storage a chunk at a time instead of all at once
+ * IN:  slurmdb_job_cond_t *job_cond, chunk_size is the number of jobs to
+ *      get per chunk, 1000 if not set
+ * IN:  callback - called with a List of slurmdb_job_rec_t * for each chunk,
+ *      the List is freed once it returns. Chunks come by cluster in job id
+ *      order, return anything but SLURM_SUCCESS to stop.
+ * IN:  arg - passed to callback
+ * RET: SLURM_SUCCESS on success, else the callback's return or SLURM_ERROR
+ */
+extern int slurmdb_jobs_get_chunked(void *db_conn,
+				    slurmdb_job_cond_t *job_cond,
+				    int (*callback) (List job_list, void *arg),
+				    void *arg);
+
 /*
  * Fix runaway jobs
  * IN: jobs, a list of all the runaway jobs
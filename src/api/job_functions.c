@@ -40,6 +40,7 @@
 
 #include "src/common/slurm_accounting_storage.h"
 #include "src/common/slurm_jobcomp.h"
+#include "src/common/xstring.h"
 
 /*
  * modify existing job in the accounting system
@@ -70,6 +71,66 @@ extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond)
 	return jobacct_storage_g_get_jobs_cond(db_conn, db_api_uid, job_cond);
 }
 
+/*
+ * get info from the storage a chunk at a time, each chunk is handed to
+ * callback and freed afterwards so only one is ever held in memory
+ */
+extern int slurmdb_jobs_get_chunked(void *db_conn,
+				    slurmdb_job_cond_t *job_cond,
+				    int (*callback) (List job_list, void *arg),
+				    void *arg)
+{
+	List job_list;
+	ListIterator itr;
+	slurmdb_job_rec_t *job;
+	uint32_t chunk_size = job_cond->chunk_size;
+	int rc = SLURM_SUCCESS;
+
+	xassert(callback);
+
+	if (db_api_uid == -1)
+		db_api_uid = getuid();
+
+	if (!job_cond->chunk_size)
+		job_cond->chunk_size = 1000;
+
+	while (true) {
+		if (!(job_list = jobacct_storage_g_get_jobs_cond(
+			      db_conn, db_api_uid, job_cond))) {
+			rc = SLURM_ERROR;
+			break;
+		}
+		if (!list_count(job_list)) {
+			FREE_NULL_LIST(job_list);
+			break;
+		}
+
+		/* A chunk only holds jobs from one cluster */
+		itr = list_iterator_create(job_list);
+		while ((job = list_next(itr))) {
+			if (xstrcmp(job_cond->cursor_cluster, job->cluster)) {
+				xfree(job_cond->cursor_cluster);
+				job_cond->cursor_cluster = xstrdup(job->cluster);
+				job_cond->cursor_jobid = 0;
+			}
+			if (job->jobid > job_cond->cursor_jobid)
+				job_cond->cursor_jobid = job->jobid;
+		}
+		list_iterator_destroy(itr);
+
+		rc = (*callback)(job_list, arg);
+		FREE_NULL_LIST(job_list);
+		if (rc != SLURM_SUCCESS)
+			break;
+	}
+
+	job_cond->chunk_size = chunk_size;
+	xfree(job_cond->cursor_cluster);
+	job_cond->cursor_jobid = 0;
+
+	return rc;
+}
+
 /*
  * Fix runaway jobs
  * IN: jobs, a list of all the runaway jobs
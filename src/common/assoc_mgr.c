@@ -47,11 +47,22 @@
 #include "src/common/uid.h"
 #include "src/common/xstring.h"
 #include "src/common/slurm_priority.h"
+#include "src/common/slurmdb_pack.h"
 #include "src/common/slurmdbd_pack.h"
 #include "src/slurmdbd/read_config.h"
 
 #define ASSOC_HASH_SIZE 1000
-#define ASSOC_HASH_ID_INX(_assoc_id)	(_assoc_id % ASSOC_HASH_SIZE)
+#define ASSOC_HASH_ID_INX(_assoc_id)	(_assoc_id % assoc_hash_size)
+
+/* Number of update lists the slurmdbd remembers for the slurmctlds */
+#define JOURNAL_SIZE 1024
+/* A change id is the journal epoch followed by a sequence number */
+#define CHANGE_ID(_epoch, _seq)	(((uint64_t) (_epoch) << 32) | (_seq))
+
+typedef struct {
+	buf_t *buffer;		/* update objects, SLURM_PROTOCOL_VERSION */
+	uint32_t count;		/* number of update objects in buffer */
+} journal_entry_t;
 
 slurmdb_assoc_rec_t *assoc_mgr_root_assoc = NULL;
 uint32_t g_qos_max_priority = 0;
@@ -76,8 +87,73 @@ static pthread_mutex_t assoc_lock_init = PTHREAD_MUTEX_INITIALIZER;
 static assoc_init_args_t init_setup;
 static slurmdb_assoc_rec_t **assoc_hash_id = NULL;
 static slurmdb_assoc_rec_t **assoc_hash = NULL;
+static uint32_t assoc_hash_size = ASSOC_HASH_SIZE;
+static uint32_t assoc_hash_cnt = 0;
 static int *assoc_mgr_tres_old_pos = NULL;
 
+/*
+ * Open addressing index of a list of records by id and by name.  It is
+ * rebuilt on first use after the list was write locked.  While the write
+ * lock is held the list may not match the index, so lookups walk the list.
+ */
+typedef struct {
+	void **by_id;
+	void **by_name;
+	uint32_t mask;
+	bool valid;
+	bool writing;
+} rec_index_t;
+
+static rec_index_t qos_index;
+static rec_index_t user_index;
+static pthread_mutex_t rec_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Published snapshot of the shares of every association, see
+ * _shares_snap_get().  A snapshot is never changed once published and is
+ * freed when its last reference is released.
+ */
+typedef struct {
+	uint32_t gen;		/* grp_tres_avail_gen when it was taken */
+	int refcnt;		/* protected by shares_snap_lock */
+	List shares;		/* assoc_shares_object_t's */
+	time_t time;		/* when it was taken */
+	uint32_t tres_cnt;	/* size of the TRES arrays of shares */
+} shares_snap_t;
+
+static shares_snap_t *shares_snap = NULL;
+static pthread_mutex_t shares_snap_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t shares_build_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void _shares_snap_release(shares_snap_t *snap);
+
+/*
+ * The slurmdbd keeps the journal, a slurmctld the change its lists are at.
+ * Both are protected by journal_lock.
+ */
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static journal_entry_t journal[JOURNAL_SIZE];
+static uint32_t journal_epoch = 0;
+static uint32_t journal_seq = 0;
+static uint64_t assoc_mgr_change_id = 0;
+
+/*
+ * Bumped when a write lock on the assocs or TRES is released, every
+ * grp_tres_avail computed under another generation is stale.  Changed
+ * atomically so the shares snapshot can check it without the assoc and TRES
+ * locks, grp_tres_avail_lock only serializes the readers filling in the
+ * cache.
+ */
+static uint32_t grp_tres_avail_gen = 1;
+static pthread_mutex_t grp_tres_avail_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void _grp_tres_avail_gen_bump(void)
+{
+	/* 0 is never a generation */
+	if (!__atomic_add_fetch(&grp_tres_avail_gen, 1, __ATOMIC_SEQ_CST))
+		__atomic_add_fetch(&grp_tres_avail_gen, 1, __ATOMIC_SEQ_CST);
+}
+
 static bool _running_cache(void)
 {
 	if (init_setup.running_cache &&
@@ -122,24 +198,25 @@ static int _assoc_hash_index(slurmdb_assoc_rec_t *assoc)
 	if (assoc->partition)
 		index += _get_str_inx(assoc->partition);
 
-	index %= ASSOC_HASH_SIZE;
+	index %= (int) assoc_hash_size;
 	if (index < 0)
-		index += ASSOC_HASH_SIZE;
+		index += assoc_hash_size;
 
 	return index;
 
 }
 
-static void _add_assoc_hash(slurmdb_assoc_rec_t *assoc)
+static void _free_assoc_hash(void)
 {
-	int inx = ASSOC_HASH_ID_INX(assoc->id);
+	xfree(assoc_hash_id);
+	xfree(assoc_hash);
+	assoc_hash_size = ASSOC_HASH_SIZE;
+	assoc_hash_cnt = 0;
+}
 
-	if (!assoc_hash_id)
-		assoc_hash_id = xcalloc(ASSOC_HASH_SIZE,
-					sizeof(slurmdb_assoc_rec_t *));
-	if (!assoc_hash)
-		assoc_hash = xcalloc(ASSOC_HASH_SIZE,
-				     sizeof(slurmdb_assoc_rec_t *));
+static void _link_assoc_hash(slurmdb_assoc_rec_t *assoc)
+{
+	int inx = ASSOC_HASH_ID_INX(assoc->id);
 
 	assoc->assoc_next_id = assoc_hash_id[inx];
 	assoc_hash_id[inx] = assoc;
@@ -149,6 +226,55 @@ static void _add_assoc_hash(slurmdb_assoc_rec_t *assoc)
 	assoc_hash[inx] = assoc;
 }
 
+/*
+ * Double the size of the hash tables.  Chains are relinked from their tail so
+ * records keeping a chain together keep their order.
+ */
+static void _grow_assoc_hash(void)
+{
+	slurmdb_assoc_rec_t **old_hash = assoc_hash, **chain = NULL;
+	slurmdb_assoc_rec_t *assoc;
+	uint32_t old_size = assoc_hash_size;
+	int i, cnt, chain_size = 0;
+
+	assoc_hash_size *= 2;
+	xfree(assoc_hash_id);
+	assoc_hash_id = xcalloc(assoc_hash_size, sizeof(slurmdb_assoc_rec_t *));
+	assoc_hash = xcalloc(assoc_hash_size, sizeof(slurmdb_assoc_rec_t *));
+
+	for (i = 0; i < old_size; i++) {
+		cnt = 0;
+		for (assoc = old_hash[i]; assoc; assoc = assoc->assoc_next) {
+			if (cnt >= chain_size) {
+				chain_size = MAX(cnt + 1, chain_size * 2);
+				xrecalloc(chain, chain_size, sizeof(*chain));
+			}
+			chain[cnt++] = assoc;
+		}
+		while (cnt--)
+			_link_assoc_hash(chain[cnt]);
+	}
+
+	xfree(chain);
+	xfree(old_hash);
+}
+
+static void _add_assoc_hash(slurmdb_assoc_rec_t *assoc)
+{
+	if (!assoc_hash_id)
+		assoc_hash_id = xcalloc(assoc_hash_size,
+					sizeof(slurmdb_assoc_rec_t *));
+	if (!assoc_hash)
+		assoc_hash = xcalloc(assoc_hash_size,
+				     sizeof(slurmdb_assoc_rec_t *));
+
+	/* Keep the chains short however many associations there are */
+	if (++assoc_hash_cnt > assoc_hash_size)
+		_grow_assoc_hash();
+
+	_link_assoc_hash(assoc);
+}
+
 static bool _remove_from_assoc_list(slurmdb_assoc_rec_t *assoc)
 {
 	slurmdb_assoc_rec_t *assoc_ptr;
@@ -314,6 +440,8 @@ static void _delete_assoc_hash(slurmdb_assoc_rec_t *assoc)
 		return;	/* Fix CLANG false positive error */
 	} else
 		*assoc_pptr = assoc_ptr->assoc_next;
+
+	assoc_hash_cnt--;
 }
 
 
@@ -667,6 +795,153 @@ static int _local_update_assoc_qos_list(slurmdb_assoc_rec_t *assoc,
 	return SLURM_SUCCESS;
 }
 
+static uint32_t _qos_rec_id(void *x)
+{
+	return ((slurmdb_qos_rec_t *) x)->id;
+}
+
+static char *_qos_rec_name(void *x)
+{
+	return ((slurmdb_qos_rec_t *) x)->name;
+}
+
+static uint32_t _user_rec_uid(void *x)
+{
+	return ((slurmdb_user_rec_t *) x)->uid;
+}
+
+static char *_user_rec_name(void *x)
+{
+	return ((slurmdb_user_rec_t *) x)->name;
+}
+
+static uint32_t _rec_index_hash_id(uint32_t id)
+{
+	return id * 2654435761U;
+}
+
+static uint32_t _rec_index_hash_name(char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	/* Names are compared without case */
+	for (; *name; name++)
+		hash = (hash ^ (uint8_t) tolower((int) *name)) * 16777619U;
+
+	return hash;
+}
+
+static void _free_rec_index(rec_index_t *index)
+{
+	xfree(index->by_id);
+	xfree(index->by_name);
+	index->mask = 0;
+	index->valid = false;
+}
+
+static void _build_rec_index(rec_index_t *index, List list,
+			     uint32_t (*get_id)(void *x),
+			     char *(*get_name)(void *x))
+{
+	ListIterator itr;
+	void *rec;
+	uint32_t size = 16, id, i;
+	char *name;
+
+	while (size < (list_count(list) * 2))
+		size *= 2;
+
+	_free_rec_index(index);
+	index->by_id = xcalloc(size, sizeof(void *));
+	index->by_name = xcalloc(size, sizeof(void *));
+	index->mask = size - 1;
+
+	/* Records are added in list order so the first match is found first */
+	itr = list_iterator_create(list);
+	while ((rec = list_next(itr))) {
+		if ((id = get_id(rec)) != NO_VAL) {
+			for (i = _rec_index_hash_id(id) & index->mask;
+			     index->by_id[i]; i = (i + 1) & index->mask)
+				;
+			index->by_id[i] = rec;
+		}
+		if ((name = get_name(rec))) {
+			for (i = _rec_index_hash_name(name) & index->mask;
+			     index->by_name[i]; i = (i + 1) & index->mask)
+				;
+			index->by_name[i] = rec;
+		}
+	}
+	list_iterator_destroy(itr);
+
+	index->valid = true;
+}
+
+/*
+ * Find the record of list with the given id, or if none (or id is NO_VAL)
+ * with the given name.
+ * NOTE: The list's read lock needs to be locked before calling this function.
+ */
+static void *_find_rec_index(rec_index_t *index, List list,
+			     uint32_t id, char *name,
+			     uint32_t (*get_id)(void *x),
+			     char *(*get_name)(void *x))
+{
+	ListIterator itr;
+	void *rec = NULL;
+	uint32_t i;
+
+	if (!list)
+		return NULL;
+
+	if (index->writing) {
+		itr = list_iterator_create(list);
+		while ((rec = list_next(itr))) {
+			if (((id != NO_VAL) && (get_id(rec) == id)) ||
+			    (name && !xstrcasecmp(name, get_name(rec))))
+				break;
+		}
+		list_iterator_destroy(itr);
+		return rec;
+	}
+
+	slurm_mutex_lock(&rec_index_lock);
+	if (!index->valid)
+		_build_rec_index(index, list, get_id, get_name);
+
+	if (id != NO_VAL) {
+		for (i = _rec_index_hash_id(id) & index->mask;
+		     (rec = index->by_id[i]); i = (i + 1) & index->mask) {
+			if (get_id(rec) == id)
+				break;
+		}
+	}
+	if (!rec && name) {
+		for (i = _rec_index_hash_name(name) & index->mask;
+		     (rec = index->by_name[i]); i = (i + 1) & index->mask) {
+			if (!xstrcasecmp(name, get_name(rec)))
+				break;
+		}
+	}
+	slurm_mutex_unlock(&rec_index_lock);
+
+	return rec;
+}
+
+static slurmdb_qos_rec_t *_find_qos_rec(uint32_t id, char *name)
+{
+	return _find_rec_index(&qos_index, assoc_mgr_qos_list, id, name,
+			       _qos_rec_id, _qos_rec_name);
+}
+
+/* Find a user by uid, or by name only if the uid is NO_VAL */
+static slurmdb_user_rec_t *_find_user_rec(uint32_t uid, char *name)
+{
+	return _find_rec_index(&user_index, assoc_mgr_user_list, uid,
+			       (uid == NO_VAL) ? name : NULL,
+			       _user_rec_uid, _user_rec_name);
+}
+
 static int _list_find_uid(void *x, void *key)
 {
 	slurmdb_user_rec_t *user = (slurmdb_user_rec_t *) x;
@@ -1015,8 +1290,7 @@ static int _post_assoc_list(void)
 	if (!assoc_mgr_assoc_list)
 		return SLURM_ERROR;
 
-	xfree(assoc_hash_id);
-	xfree(assoc_hash);
+	_free_assoc_hash();
 
 	itr = list_iterator_create(assoc_mgr_assoc_list);
 
@@ -1975,6 +2249,120 @@ static int _refresh_assoc_wckey_list(void *db_conn, int enforce)
 	return SLURM_SUCCESS;
 }
 
+static int _load_assoc_mgr_state(bool only_tres, bool ignore_errors);
+
+/* Remember the change the slurmdbd is at before reading all the lists */
+static void _get_current_change_id(void *db_conn)
+{
+	uint64_t change_id = 0;
+	List update_list;
+
+	if (slurmdbd_conf)
+		return;
+
+	if (!(update_list = acct_storage_g_get_updates(db_conn, &change_id)))
+		change_id = 0;
+	FREE_NULL_LIST(update_list);
+
+	slurm_mutex_lock(&journal_lock);
+	assoc_mgr_change_id = change_id;
+	slurm_mutex_unlock(&journal_lock);
+}
+
+/*
+ * Apply the changes the slurmdbd made after the one our lists are at.
+ * RET SLURM_SUCCESS, else the lists have to be read again
+ */
+static int _sync_changes(void *db_conn)
+{
+	uint64_t change_id;
+	List update_list;
+	int cnt, rc;
+
+	if (slurmdbd_conf)
+		return SLURM_ERROR;
+
+	slurm_mutex_lock(&journal_lock);
+	change_id = assoc_mgr_change_id;
+	slurm_mutex_unlock(&journal_lock);
+
+	if (!change_id)
+		return SLURM_ERROR;
+
+	if (!(update_list = acct_storage_g_get_updates(db_conn, &change_id))) {
+		debug("%s: slurmdbd no longer has the changes after %"PRIu64,
+		      __func__, change_id);
+		return SLURM_ERROR;
+	}
+
+	cnt = list_count(update_list);
+	rc = assoc_mgr_update(update_list, 0);
+	FREE_NULL_LIST(update_list);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	slurm_mutex_lock(&journal_lock);
+	if (change_id > assoc_mgr_change_id)
+		assoc_mgr_change_id = change_id;
+	slurm_mutex_unlock(&journal_lock);
+
+	debug("%s: applied %d updates up to change %"PRIu64,
+	      __func__, cnt, change_id);
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Start from the lists in the state file and only get what changed since
+ * they were saved.
+ * RET SLURM_SUCCESS, else the lists are freed and have to be read again
+ */
+static int _load_state_and_sync(void *db_conn)
+{
+	uint16_t running_cache = RUNNING_CACHE_STATE_NOTRUNNING;
+	uint16_t cache_level = init_setup.cache_level;
+	int rc = SLURM_ERROR;
+
+	if (slurmdbd_conf || !init_setup.state_save_location ||
+	    !*init_setup.state_save_location ||
+	    assoc_mgr_assoc_list || assoc_mgr_qos_list || assoc_mgr_user_list)
+		return SLURM_ERROR;
+
+	/* TRES aren't in the journal, they are few so read them */
+	if ((cache_level & ASSOC_MGR_CACHE_TRES) && !assoc_mgr_tres_list &&
+	    (_get_assoc_mgr_tres_list(db_conn, init_setup.enforce) !=
+	     SLURM_SUCCESS))
+		return SLURM_ERROR;
+	if (!g_tres_count)
+		return SLURM_ERROR;
+
+	if (init_setup.running_cache)
+		running_cache = *init_setup.running_cache;
+	if (_load_assoc_mgr_state(false, true) != SLURM_SUCCESS)
+		goto end_it;
+	if (init_setup.running_cache)
+		*init_setup.running_cache = running_cache;
+
+	if (((cache_level & ASSOC_MGR_CACHE_ASSOC) && !assoc_mgr_assoc_list) ||
+	    ((cache_level & ASSOC_MGR_CACHE_QOS) && !assoc_mgr_qos_list) ||
+	    ((cache_level & ASSOC_MGR_CACHE_USER) && !assoc_mgr_user_list) ||
+	    ((cache_level & ASSOC_MGR_CACHE_WCKEY) && !assoc_mgr_wckey_list) ||
+	    ((cache_level & ASSOC_MGR_CACHE_RES) && !assoc_mgr_res_list))
+		goto end_it;
+
+	rc = _sync_changes(db_conn);
+
+end_it:
+	if (init_setup.running_cache)
+		*init_setup.running_cache = running_cache;
+	if (rc != SLURM_SUCCESS)
+		assoc_mgr_fini(false);
+	else
+		info("%s: association lists recovered from state", __func__);
+
+	return rc;
+}
+
 extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 			  int db_conn_errno)
 {
@@ -2004,6 +2392,13 @@ extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 	if (db_conn_errno != SLURM_SUCCESS)
 		return SLURM_ERROR;
 
+	if (_load_state_and_sync(db_conn) == SLURM_SUCCESS)
+		return SLURM_SUCCESS;
+
+	if (!assoc_mgr_assoc_list && !assoc_mgr_qos_list &&
+	    !assoc_mgr_user_list)
+		_get_current_change_id(db_conn);
+
 	/* get tres before association and qos since it is used there */
 	if ((!assoc_mgr_tres_list)
 	    && (init_setup.cache_level & ASSOC_MGR_CACHE_TRES)) {
@@ -2062,6 +2457,7 @@ extern int assoc_mgr_fini(bool save_state)
 	assoc_mgr_lock_t locks = { .assoc = WRITE_LOCK, .qos = WRITE_LOCK,
 				   .res = WRITE_LOCK, .tres = WRITE_LOCK,
 				   .user = WRITE_LOCK, .wckey = WRITE_LOCK };
+	shares_snap_t *snap;
 
 	if (save_state)
 		dump_assoc_mgr_state();
@@ -2093,11 +2489,18 @@ extern int assoc_mgr_fini(bool save_state)
 	if (_running_cache())
 		*init_setup.running_cache = RUNNING_CACHE_STATE_NOTRUNNING;
 
-	xfree(assoc_hash_id);
-	xfree(assoc_hash);
+	_free_assoc_hash();
+	_free_rec_index(&qos_index);
+	_free_rec_index(&user_index);
 
 	assoc_mgr_unlock(&locks);
 
+	slurm_mutex_lock(&shares_snap_lock);
+	snap = shares_snap;
+	shares_snap = NULL;
+	slurm_mutex_unlock(&shares_snap_lock);
+	_shares_snap_release(snap);
+
 	return SLURM_SUCCESS;
 }
 
@@ -2201,12 +2604,29 @@ extern void assoc_mgr_lock(assoc_mgr_lock_t *locks)
 		slurm_rwlock_rdlock(&assoc_mgr_locks[WCKEY_LOCK]);
 	else if (locks->wckey == WRITE_LOCK)
 		slurm_rwlock_wrlock(&assoc_mgr_locks[WCKEY_LOCK]);
+
+	if (locks->qos == WRITE_LOCK)
+		qos_index.writing = true;
+	if (locks->user == WRITE_LOCK)
+		user_index.writing = true;
 }
 
 extern void assoc_mgr_unlock(assoc_mgr_lock_t *locks)
 {
 	xassert(_clear_locks(locks));
 
+	if ((locks->assoc == WRITE_LOCK) || (locks->tres == WRITE_LOCK))
+		_grp_tres_avail_gen_bump();
+
+	if (locks->qos == WRITE_LOCK) {
+		qos_index.writing = false;
+		qos_index.valid = false;
+	}
+	if (locks->user == WRITE_LOCK) {
+		user_index.writing = false;
+		user_index.valid = false;
+	}
+
 	if (locks->wckey)
 		slurm_rwlock_unlock(&assoc_mgr_locks[WCKEY_LOCK]);
 
@@ -2599,7 +3019,6 @@ extern int assoc_mgr_fill_in_user(void *db_conn, slurmdb_user_rec_t *user,
 				  slurmdb_user_rec_t **user_pptr,
 				  bool locked)
 {
-	ListIterator itr = NULL;
 	slurmdb_user_rec_t * found_user = NULL;
 	assoc_mgr_lock_t locks = { .user = READ_LOCK };
 
@@ -2621,16 +3040,7 @@ extern int assoc_mgr_fill_in_user(void *db_conn, slurmdb_user_rec_t *user,
 		return SLURM_SUCCESS;
 	}
 
-	itr = list_iterator_create(assoc_mgr_user_list);
-	while ((found_user = list_next(itr))) {
-		if (user->uid != NO_VAL) {
-			if (user->uid == found_user->uid)
-				break;
-		} else if (user->name
-			   && !xstrcasecmp(user->name, found_user->name))
-			break;
-	}
-	list_iterator_destroy(itr);
+	found_user = _find_user_rec(user->uid, user->name);
 
 	if (!found_user) {
 		if (!locked)
@@ -2676,7 +3086,6 @@ extern int assoc_mgr_fill_in_qos(void *db_conn, slurmdb_qos_rec_t *qos,
 				 int enforce,
 				 slurmdb_qos_rec_t **qos_pptr, bool locked)
 {
-	ListIterator itr = NULL;
 	slurmdb_qos_rec_t * found_qos = NULL;
 	assoc_mgr_lock_t locks = { .qos = READ_LOCK };
 
@@ -2711,14 +3120,7 @@ extern int assoc_mgr_fill_in_qos(void *db_conn, slurmdb_qos_rec_t *qos,
 		return SLURM_SUCCESS;
 	}
 
-	itr = list_iterator_create(assoc_mgr_qos_list);
-	while ((found_qos = list_next(itr))) {
-		if (qos->id == found_qos->id)
-			break;
-		else if (qos->name && !xstrcasecmp(qos->name, found_qos->name))
-			break;
-	}
-	list_iterator_destroy(itr);
+	found_qos = _find_qos_rec(qos->id, qos->name);
 
 	if (!found_qos) {
 		if (!locked)
@@ -3007,7 +3409,7 @@ extern slurmdb_admin_level_t assoc_mgr_get_admin_level(void *db_conn,
 		return SLURMDB_ADMIN_NOTSET;
 	}
 
-	found_user = list_find_first(assoc_mgr_user_list, _list_find_uid, &uid);
+	found_user = _find_user_rec(uid, NULL);
 
 	if (found_user)
 		level = found_user->admin_level;
@@ -3039,8 +3441,7 @@ extern bool assoc_mgr_is_user_acct_coord(void *db_conn,
 		return false;
 	}
 
-	found_user = list_find_first(assoc_mgr_user_list, _list_find_uid,
-				     &uid);
+	found_user = _find_user_rec(uid, NULL);
 
 	if (!found_user || !found_user->coord_accts) {
 		assoc_mgr_unlock(&locks);
@@ -3062,6 +3463,261 @@ extern bool assoc_mgr_is_user_acct_coord(void *db_conn,
 	return false;
 }
 
+/*
+ * Return true if the share of an association of user (NULL for an account)
+ * under acct is to be sent to the requester.
+ */
+static bool _share_wanted(char *user_name, char *acct, ListIterator user_itr,
+			  ListIterator acct_itr, bool is_admin,
+			  slurmdb_user_rec_t *user)
+{
+	ListIterator itr = NULL;
+	slurmdb_coord_rec_t *coord = NULL;
+	char *tmp_char = NULL;
+
+	if (user_itr && user_name) {
+		while ((tmp_char = list_next(user_itr))) {
+			if (!xstrcasecmp(tmp_char, user_name))
+				break;
+		}
+		list_iterator_reset(user_itr);
+		/* not correct user */
+		if (!tmp_char)
+			return false;
+	}
+
+	if (acct_itr) {
+		while ((tmp_char = list_next(acct_itr))) {
+			if (!xstrcasecmp(tmp_char, acct))
+				break;
+		}
+		list_iterator_reset(acct_itr);
+		/* not correct account */
+		if (!tmp_char)
+			return false;
+	}
+
+	if (!(slurm_conf.private_data & PRIVATE_DATA_USAGE) || is_admin)
+		return true;
+
+	if (user_name && !xstrcmp(user_name, user->name))
+		return true;
+
+	if (!user->coord_accts) {
+		debug4("This user isn't a coord.");
+		return false;
+	}
+
+	if (!acct) {
+		debug("No account name given in association.");
+		return false;
+	}
+
+	itr = list_iterator_create(user->coord_accts);
+	while ((coord = list_next(itr))) {
+		if (!xstrcasecmp(coord->name, acct))
+			break;
+	}
+	list_iterator_destroy(itr);
+
+	return coord ? true : false;
+}
+
+/* NOTE: The assoc_mgr assoc and tres read locks need to be locked. */
+static assoc_shares_object_t *_make_share(slurmdb_assoc_rec_t *assoc)
+{
+	assoc_shares_object_t *share = xmalloc(sizeof(*share));
+
+	share->assoc_id = assoc->id;
+	share->cluster = xstrdup(assoc->cluster);
+
+	if (assoc == assoc_mgr_root_assoc)
+		share->shares_raw = NO_VAL;
+	else
+		share->shares_raw = assoc->shares_raw;
+
+	share->shares_norm = assoc->usage->shares_norm;
+	share->usage_raw = (uint64_t)assoc->usage->usage_raw;
+
+	share->usage_tres_raw = xcalloc(g_tres_count, sizeof(long double));
+	memcpy(share->usage_tres_raw,
+	       assoc->usage->usage_tres_raw,
+	       sizeof(long double) * g_tres_count);
+
+	share->tres_grp_mins = xcalloc(g_tres_count, sizeof(uint64_t));
+	memcpy(share->tres_grp_mins, assoc->grp_tres_mins_ctld,
+	       sizeof(uint64_t) * g_tres_count);
+	share->tres_run_secs = xcalloc(g_tres_count, sizeof(uint64_t));
+	memcpy(share->tres_run_secs,
+	       assoc->usage->grp_used_tres_run_secs,
+	       sizeof(uint64_t) * g_tres_count);
+	share->fs_factor = assoc->usage->fs_factor;
+	share->level_fs = assoc->usage->level_fs;
+
+	if (assoc->partition) {
+		share->partition =  xstrdup(assoc->partition);
+	} else {
+		share->partition = NULL;
+	}
+
+	if (assoc->user) {
+		/* We only calculate user effective usage when
+		 * we need it
+		 */
+		if (fuzzy_equal(assoc->usage->usage_efctv, NO_VAL))
+			priority_g_set_assoc_usage(assoc);
+
+		share->name = xstrdup(assoc->user);
+		share->parent = xstrdup(assoc->acct);
+		share->user = 1;
+	} else {
+		share->name = xstrdup(assoc->acct);
+		if (!assoc->parent_acct
+		    && assoc->usage->parent_assoc_ptr)
+			share->parent = xstrdup(
+				assoc->usage->parent_assoc_ptr->acct);
+		else
+			share->parent = xstrdup(assoc->parent_acct);
+	}
+	share->usage_norm = (double)assoc->usage->usage_norm;
+	share->usage_efctv = (double)assoc->usage->usage_efctv;
+
+	return share;
+}
+
+static assoc_shares_object_t *_copy_share(assoc_shares_object_t *share,
+					  uint32_t tres_cnt)
+{
+	assoc_shares_object_t *copy = xmalloc(sizeof(*copy));
+
+	memcpy(copy, share, sizeof(*copy));
+	copy->cluster = xstrdup(share->cluster);
+	copy->name = xstrdup(share->name);
+	copy->parent = xstrdup(share->parent);
+	copy->partition = xstrdup(share->partition);
+	copy->usage_tres_raw = xcalloc(tres_cnt, sizeof(long double));
+	memcpy(copy->usage_tres_raw, share->usage_tres_raw,
+	       sizeof(long double) * tres_cnt);
+	copy->tres_grp_mins = xcalloc(tres_cnt, sizeof(uint64_t));
+	memcpy(copy->tres_grp_mins, share->tres_grp_mins,
+	       sizeof(uint64_t) * tres_cnt);
+	copy->tres_run_secs = xcalloc(tres_cnt, sizeof(uint64_t));
+	memcpy(copy->tres_run_secs, share->tres_run_secs,
+	       sizeof(uint64_t) * tres_cnt);
+
+	return copy;
+}
+
+/* RET seconds a snapshot of the shares may be used, -1 if not configured */
+static int _shares_snap_age(void)
+{
+	char *tmp_ptr;
+
+	if (!(tmp_ptr = xstrcasestr(slurm_conf.slurmctld_params,
+				    "assoc_snapshot_age=")))
+		return -1;
+
+	return atoi(tmp_ptr + strlen("assoc_snapshot_age="));
+}
+
+static void _shares_snap_release(shares_snap_t *snap)
+{
+	bool last;
+
+	if (!snap)
+		return;
+
+	slurm_mutex_lock(&shares_snap_lock);
+	last = !--snap->refcnt;
+	slurm_mutex_unlock(&shares_snap_lock);
+
+	if (last) {
+		FREE_NULL_LIST(snap->shares);
+		xfree(snap);
+	}
+}
+
+/*
+ * NOTE: Called with shares_snap_lock locked, but without the assoc and TRES
+ * locks.  A change made while this runs may not be seen yet, the snapshot is
+ * then used as it would have been by a request coming in just before.
+ */
+static bool _shares_snap_fresh(shares_snap_t *snap, int max_age)
+{
+	if (!snap || (snap->tres_cnt != g_tres_count))
+		return false;
+
+	/* Unchanged since it was taken, or not too old */
+	if ((snap->gen == __atomic_load_n(&grp_tres_avail_gen,
+					  __ATOMIC_SEQ_CST)) ||
+	    (difftime(time(NULL), snap->time) < max_age))
+		return true;
+
+	return false;
+}
+
+/*
+ * Get a reference on the published snapshot of the shares of every
+ * association, building a new one if it is too old.  Readers of the shares
+ * only hold the assoc_mgr locks while a snapshot is built, once per max_age
+ * however many of them there are.
+ */
+static shares_snap_t *_shares_snap_get(int max_age)
+{
+	assoc_mgr_lock_t locks = { .assoc = READ_LOCK, .tres = READ_LOCK };
+	shares_snap_t *snap, *old_snap;
+	slurmdb_assoc_rec_t *assoc;
+	ListIterator itr;
+
+	slurm_mutex_lock(&shares_snap_lock);
+	if (_shares_snap_fresh(shares_snap, max_age)) {
+		snap = shares_snap;
+		snap->refcnt++;
+		slurm_mutex_unlock(&shares_snap_lock);
+		return snap;
+	}
+	slurm_mutex_unlock(&shares_snap_lock);
+
+	/* Only one reader builds, the others wait for its snapshot */
+	slurm_mutex_lock(&shares_build_lock);
+	slurm_mutex_lock(&shares_snap_lock);
+	if (_shares_snap_fresh(shares_snap, max_age)) {
+		snap = shares_snap;
+		snap->refcnt++;
+		slurm_mutex_unlock(&shares_snap_lock);
+		slurm_mutex_unlock(&shares_build_lock);
+		return snap;
+	}
+	slurm_mutex_unlock(&shares_snap_lock);
+
+	snap = xmalloc(sizeof(*snap));
+	snap->shares = list_create(slurm_destroy_assoc_shares_object);
+	snap->time = time(NULL);
+	/* One reference for being published, one for the caller */
+	snap->refcnt = 2;
+
+	assoc_mgr_lock(&locks);
+	snap->gen = grp_tres_avail_gen;
+	snap->tres_cnt = g_tres_count;
+	if (assoc_mgr_assoc_list) {
+		itr = list_iterator_create(assoc_mgr_assoc_list);
+		while ((assoc = list_next(itr)))
+			list_append(snap->shares, _make_share(assoc));
+		list_iterator_destroy(itr);
+	}
+	assoc_mgr_unlock(&locks);
+
+	slurm_mutex_lock(&shares_snap_lock);
+	old_snap = shares_snap;
+	shares_snap = snap;
+	slurm_mutex_unlock(&shares_snap_lock);
+	slurm_mutex_unlock(&shares_build_lock);
+
+	_shares_snap_release(old_snap);
+
+	return snap;
+}
+
 extern void assoc_mgr_get_shares(void *db_conn,
 				 uid_t uid, shares_request_msg_t *req_msg,
 				 shares_response_msg_t *resp_msg)
@@ -3071,10 +3727,11 @@ extern void assoc_mgr_get_shares(void *db_conn,
 	ListIterator acct_itr = NULL;
 	slurmdb_assoc_rec_t *assoc = NULL;
 	assoc_shares_object_t *share = NULL;
+	shares_snap_t *snap = NULL;
 	List ret_list = NULL;
-	char *tmp_char = NULL;
 	slurmdb_user_rec_t user;
 	int is_admin=1;
+	int max_age;
 	assoc_mgr_lock_t locks = { .assoc = READ_LOCK, .tres = READ_LOCK };
 
 	xassert(resp_msg);
@@ -3115,133 +3772,41 @@ extern void assoc_mgr_get_shares(void *db_conn,
 	resp_msg->assoc_shares_list = ret_list =
 		list_create(slurm_destroy_assoc_shares_object);
 
-	assoc_mgr_lock(&locks);
-
-	resp_msg->tres_cnt = g_tres_count;
-
 	/* DON'T FREE, since this shouldn't change while the slurmctld
 	 * is running we should be ok.
 	*/
 	resp_msg->tres_names = assoc_mgr_tres_name_array;
 
-	itr = list_iterator_create(assoc_mgr_assoc_list);
-	while ((assoc = list_next(itr))) {
-		if (user_itr && assoc->user) {
-			while ((tmp_char = list_next(user_itr))) {
-				if (!xstrcasecmp(tmp_char, assoc->user))
-					break;
-			}
-			list_iterator_reset(user_itr);
-			/* not correct user */
-			if (!tmp_char)
-				continue;
-		}
+	if ((max_age = _shares_snap_age()) >= 0) {
+		snap = _shares_snap_get(max_age);
+		resp_msg->tres_cnt = snap->tres_cnt;
 
-		if (acct_itr) {
-			while ((tmp_char = list_next(acct_itr))) {
-				if (!xstrcasecmp(tmp_char, assoc->acct))
-					break;
-			}
-			list_iterator_reset(acct_itr);
-			/* not correct account */
-			if (!tmp_char)
+		itr = list_iterator_create(snap->shares);
+		while ((share = list_next(itr))) {
+			if (!_share_wanted(share->user ? share->name : NULL,
+					   share->user ?
+					   share->parent : share->name,
+					   user_itr, acct_itr, is_admin, &user))
 				continue;
+			list_append(ret_list,
+				    _copy_share(share, snap->tres_cnt));
 		}
+		list_iterator_destroy(itr);
 
-		if (slurm_conf.private_data & PRIVATE_DATA_USAGE) {
-			if (!is_admin) {
-				ListIterator itr = NULL;
-				slurmdb_coord_rec_t *coord = NULL;
-
-				if (assoc->user &&
-				    !xstrcmp(assoc->user, user.name))
-					goto is_user;
-
-				if (!user.coord_accts) {
-					debug4("This user isn't a coord.");
-					goto bad_user;
-				}
-
-				if (!assoc->acct) {
-					debug("No account name given "
-					      "in association.");
-					goto bad_user;
-				}
-
-				itr = list_iterator_create(user.coord_accts);
-				while ((coord = list_next(itr))) {
-					if (!xstrcasecmp(coord->name,
-							 assoc->acct))
-						break;
-				}
-				list_iterator_destroy(itr);
-
-				if (coord)
-					goto is_user;
-
-			bad_user:
-				continue;
-			}
-		}
-	is_user:
-
-		share = xmalloc(sizeof(assoc_shares_object_t));
-		list_append(ret_list, share);
-
-		share->assoc_id = assoc->id;
-		share->cluster = xstrdup(assoc->cluster);
+		_shares_snap_release(snap);
+		goto end_it;
+	}
 
-		if (assoc == assoc_mgr_root_assoc)
-			share->shares_raw = NO_VAL;
-		else
-			share->shares_raw = assoc->shares_raw;
-
-		share->shares_norm = assoc->usage->shares_norm;
-		share->usage_raw = (uint64_t)assoc->usage->usage_raw;
-
-		share->usage_tres_raw = xcalloc(g_tres_count,
-						sizeof(long double));
-		memcpy(share->usage_tres_raw,
-		       assoc->usage->usage_tres_raw,
-		       sizeof(long double) * g_tres_count);
-
-		share->tres_grp_mins = xcalloc(g_tres_count, sizeof(uint64_t));
-		memcpy(share->tres_grp_mins, assoc->grp_tres_mins_ctld,
-		       sizeof(uint64_t) * g_tres_count);
-		share->tres_run_secs = xcalloc(g_tres_count, sizeof(uint64_t));
-		memcpy(share->tres_run_secs,
-		       assoc->usage->grp_used_tres_run_secs,
-		       sizeof(uint64_t) * g_tres_count);
-		share->fs_factor = assoc->usage->fs_factor;
-		share->level_fs = assoc->usage->level_fs;
-
-		if (assoc->partition) {
-			share->partition =  xstrdup(assoc->partition);
-		} else {
-			share->partition = NULL;
-		}
+	assoc_mgr_lock(&locks);
 
-		if (assoc->user) {
-			/* We only calculate user effective usage when
-			 * we need it
-			 */
-			if (fuzzy_equal(assoc->usage->usage_efctv, NO_VAL))
-				priority_g_set_assoc_usage(assoc);
+	resp_msg->tres_cnt = g_tres_count;
 
-			share->name = xstrdup(assoc->user);
-			share->parent = xstrdup(assoc->acct);
-			share->user = 1;
-		} else {
-			share->name = xstrdup(assoc->acct);
-			if (!assoc->parent_acct
-			    && assoc->usage->parent_assoc_ptr)
-				share->parent = xstrdup(
-					assoc->usage->parent_assoc_ptr->acct);
-			else
-				share->parent = xstrdup(assoc->parent_acct);
-		}
-		share->usage_norm = (double)assoc->usage->usage_norm;
-		share->usage_efctv = (double)assoc->usage->usage_efctv;
+	itr = list_iterator_create(assoc_mgr_assoc_list);
+	while ((assoc = list_next(itr))) {
+		if (!_share_wanted(assoc->user, assoc->acct, user_itr, acct_itr,
+				   is_admin, &user))
+			continue;
+		list_append(ret_list, _make_share(assoc));
 	}
 	list_iterator_destroy(itr);
 	assoc_mgr_unlock(&locks);
@@ -4461,6 +5026,14 @@ extern int assoc_mgr_update_qos(slurmdb_update_object_t *update, bool locked)
 					rec->flags = object->flags;
 			}
 
+			if (object->description) {
+				xfree(rec->description);
+				if (object->description[0]) {
+					rec->description = object->description;
+					object->description = NULL;
+				}
+			}
+
 			if (object->grace_time != NO_VAL)
 				rec->grace_time = object->grace_time;
 
@@ -5399,6 +5972,14 @@ extern int dump_assoc_mgr_state(void)
 				       DBD_ADD_ASSOCS, buffer);
 	}
 
+	/* the slurmdbd change these lists are at */
+	slurm_mutex_lock(&journal_lock);
+	if (assoc_mgr_change_id) {
+		pack16(DBD_GOT_UPDATES, buffer);
+		pack64(assoc_mgr_change_id, buffer);
+	}
+	slurm_mutex_unlock(&journal_lock);
+
 	/* write the buffer to file */
 	reg_file = xstrdup_printf("%s/assoc_mgr_state",
 				  *init_setup.state_save_location);
@@ -5860,7 +6441,7 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
-extern int load_assoc_mgr_state(bool only_tres)
+static int _load_assoc_mgr_state(bool only_tres, bool ignore_errors)
 {
 	int error_code = SLURM_SUCCESS;
 	uint16_t type = 0;
@@ -5869,6 +6450,7 @@ extern int load_assoc_mgr_state(bool only_tres)
 	buf_t *buffer = NULL;
 	time_t buf_time;
 	dbd_list_msg_t *msg = NULL;
+	uint64_t change_id = 0;
 	assoc_mgr_lock_t locks = { .assoc = WRITE_LOCK, .file = READ_LOCK,
 				   .qos = WRITE_LOCK, .res = WRITE_LOCK,
 				   .tres = WRITE_LOCK, .user = WRITE_LOCK,
@@ -5894,7 +6476,7 @@ extern int load_assoc_mgr_state(bool only_tres)
 	safe_unpack16(&ver, buffer);
 	debug3("Version in assoc_mgr_state header is %u", ver);
 	if (ver > SLURM_PROTOCOL_VERSION || ver < SLURM_MIN_PROTOCOL_VERSION) {
-		if (!ignore_state_errors)
+		if (!ignore_errors)
 			fatal("Can not recover assoc_mgr state, incompatible version, "
 			      "got %u need >= %u <= %u, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.",
 			      ver, SLURM_MIN_PROTOCOL_VERSION, SLURM_PROTOCOL_VERSION);
@@ -5991,6 +6573,9 @@ extern int load_assoc_mgr_state(bool only_tres)
 			msg->my_list = NULL;
 			slurmdbd_free_list_msg(msg);
 			break;
+		case DBD_GOT_UPDATES:
+			safe_unpack64(&change_id, buffer);
+			break;
 		case DBD_ADD_WCKEYS:
 			error_code = slurmdbd_unpack_list_msg(
 				&msg, ver, DBD_ADD_WCKEYS, buffer);
@@ -6020,12 +6605,18 @@ extern int load_assoc_mgr_state(bool only_tres)
 	if (!only_tres && init_setup.running_cache)
 		*init_setup.running_cache = RUNNING_CACHE_STATE_RUNNING;
 
+	if (!only_tres) {
+		slurm_mutex_lock(&journal_lock);
+		assoc_mgr_change_id = change_id;
+		slurm_mutex_unlock(&journal_lock);
+	}
+
 	free_buf(buffer);
 	assoc_mgr_unlock(&locks);
 	return SLURM_SUCCESS;
 
 unpack_error:
-	if (!ignore_state_errors)
+	if (!ignore_errors)
 		fatal("Incomplete assoc mgr state file, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.");
 	error("Incomplete assoc mgr state file");
 
@@ -6035,6 +6626,11 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+extern int load_assoc_mgr_state(bool only_tres)
+{
+	return _load_assoc_mgr_state(only_tres, ignore_state_errors);
+}
+
 extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 {
 	bool partial_list = 1;
@@ -6051,6 +6647,13 @@ extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 			return SLURM_ERROR;
 	}
 
+	/* Only get what changed if the slurmdbd still knows */
+	if (!partial_list) {
+		if (_sync_changes(db_conn) == SLURM_SUCCESS)
+			goto end_it;
+		_get_current_change_id(db_conn);
+	}
+
 	/* get qos before association since it is used there */
 	if (cache_level & ASSOC_MGR_CACHE_QOS)
 		if (_refresh_assoc_mgr_qos_list(
@@ -6077,12 +6680,111 @@ extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level)
 			    db_conn, init_setup.enforce) == SLURM_ERROR)
 			return SLURM_ERROR;
 
+end_it:
 	if (!partial_list && _running_cache())
 		*init_setup.running_cache = RUNNING_CACHE_STATE_LISTS_REFRESHED;
 
 	return SLURM_SUCCESS;
 }
 
+extern uint64_t assoc_mgr_journal_add(List update_list)
+{
+	journal_entry_t *entry;
+	slurmdb_update_object_t *object;
+	ListIterator itr;
+	uint64_t change_id;
+
+	slurm_mutex_lock(&journal_lock);
+	if (!journal_epoch)
+		journal_epoch = time(NULL);
+	if (journal_seq == UINT32_MAX) {
+		/* Start over, the slurmctlds will read everything again */
+		journal_epoch++;
+		journal_seq = 0;
+	}
+	journal_seq++;
+	change_id = CHANGE_ID(journal_epoch, journal_seq);
+
+	entry = &journal[journal_seq % JOURNAL_SIZE];
+	FREE_NULL_BUFFER(entry->buffer);
+	entry->buffer = init_buf(BUF_SIZE);
+	entry->count = list_count(update_list);
+	itr = list_iterator_create(update_list);
+	while ((object = list_next(itr)))
+		slurmdb_pack_update_object(object, SLURM_PROTOCOL_VERSION,
+					   entry->buffer);
+	list_iterator_destroy(itr);
+	slurm_mutex_unlock(&journal_lock);
+
+	return change_id;
+}
+
+extern List assoc_mgr_journal_get(uint64_t *change_id)
+{
+	uint32_t epoch = *change_id >> 32;
+	uint32_t seq = *change_id & 0xffffffff;
+	uint32_t offset, i, j;
+	journal_entry_t *entry;
+	slurmdb_update_object_t *object;
+	List update_list = NULL;
+
+	slurm_mutex_lock(&journal_lock);
+	if (!journal_epoch)
+		journal_epoch = time(NULL);
+
+	if (!*change_id) {
+		/* Only want to know where we are */
+		update_list = list_create(slurmdb_destroy_update_object);
+		goto end_it;
+	}
+
+	if ((epoch != journal_epoch) || (seq > journal_seq) ||
+	    ((journal_seq - seq) > JOURNAL_SIZE))
+		goto end_it;
+
+	update_list = list_create(slurmdb_destroy_update_object);
+	for (i = seq + 1; i <= journal_seq; i++) {
+		entry = &journal[i % JOURNAL_SIZE];
+		offset = get_buf_offset(entry->buffer);
+		set_buf_offset(entry->buffer, 0);
+		for (j = 0; j < entry->count; j++) {
+			if (slurmdb_unpack_update_object(
+				    &object, SLURM_PROTOCOL_VERSION,
+				    entry->buffer) != SLURM_SUCCESS)
+				break;
+			list_append(update_list, object);
+		}
+		set_buf_offset(entry->buffer, offset);
+		if (j < entry->count) {
+			error("%s: unable to unpack change %u", __func__, i);
+			FREE_NULL_LIST(update_list);
+			goto end_it;
+		}
+	}
+
+end_it:
+	if (update_list)
+		*change_id = CHANGE_ID(journal_epoch, journal_seq);
+	slurm_mutex_unlock(&journal_lock);
+
+	return update_list;
+}
+
+extern void assoc_mgr_update_change_id(uint64_t change_id)
+{
+	/* Not an update made in the database */
+	if (!change_id)
+		return;
+
+	slurm_mutex_lock(&journal_lock);
+	if (change_id == (assoc_mgr_change_id + 1))
+		assoc_mgr_change_id = change_id;
+	else if (change_id > assoc_mgr_change_id)
+		debug("%s: missed changes between %"PRIu64" and %"PRIu64", they will be read on the next sync",
+		      __func__, assoc_mgr_change_id, change_id);
+	slurm_mutex_unlock(&journal_lock);
+}
+
 extern int assoc_mgr_set_missing_uids()
 {
 	uid_t pw_uid;
@@ -6337,6 +7039,63 @@ extern int assoc_mgr_set_tres_cnt_array(uint64_t **tres_cnt, char *tres_str,
 	return diff_cnt;
 }
 
+static uint64_t *_get_grp_tres_avail(slurmdb_assoc_rec_t *assoc)
+{
+	slurmdb_assoc_usage_t *usage = assoc->usage;
+	uint64_t *parent_avail = NULL, limit, used, avail;
+	int i;
+
+	if (usage->grp_tres_avail_gen == grp_tres_avail_gen)
+		return usage->grp_tres_avail;
+
+	if (usage->parent_assoc_ptr)
+		parent_avail = _get_grp_tres_avail(usage->parent_assoc_ptr);
+
+	xrealloc(usage->grp_tres_avail, sizeof(uint64_t) * g_tres_count);
+	for (i = 0; i < g_tres_count; i++) {
+		limit = assoc->grp_tres_ctld ?
+			assoc->grp_tres_ctld[i] : INFINITE64;
+		used = (i < usage->tres_cnt) ? usage->grp_used_tres[i] : 0;
+
+		/* One more than what is left, 0 when already over */
+		if (limit == INFINITE64)
+			avail = INFINITE64;
+		else if (used > limit)
+			avail = 0;
+		else
+			avail = limit - used + 1;
+
+		if (parent_avail && (parent_avail[i] < avail))
+			avail = parent_avail[i];
+		usage->grp_tres_avail[i] = avail;
+	}
+	usage->grp_tres_avail_gen = grp_tres_avail_gen;
+
+	return usage->grp_tres_avail;
+}
+
+extern void assoc_mgr_reset_grp_tres_avail(void)
+{
+	slurm_mutex_lock(&grp_tres_avail_lock);
+	_grp_tres_avail_gen_bump();
+	slurm_mutex_unlock(&grp_tres_avail_lock);
+}
+
+extern uint64_t *assoc_mgr_get_grp_tres_avail(slurmdb_assoc_rec_t *assoc)
+{
+	uint64_t *avail;
+
+	xassert(verify_assoc_lock(ASSOC_LOCK, READ_LOCK));
+	xassert(verify_assoc_lock(TRES_LOCK, READ_LOCK));
+	xassert(assoc && assoc->usage);
+
+	slurm_mutex_lock(&grp_tres_avail_lock);
+	avail = _get_grp_tres_avail(assoc);
+	slurm_mutex_unlock(&grp_tres_avail_lock);
+
+	return avail;
+}
+
 /* tres read lock needs to be locked before this is called. */
 extern void assoc_mgr_set_assoc_tres_cnt(slurmdb_assoc_rec_t *assoc)
 {
@@ -445,6 +445,28 @@ extern int assoc_mgr_refresh_lists(void *db_conn, uint16_t cache_level);
  */
 extern int assoc_mgr_set_missing_uids();
 
+/*
+ * Add update_list to the journal of the slurmdbd, before it is sent to the
+ * slurmctlds and applied to our own lists.
+ * RET change id of update_list
+ */
+extern uint64_t assoc_mgr_journal_add(List update_list);
+
+/*
+ * Get the updates the slurmdbd made after a change out of its journal.
+ * IN/OUT change_id - last change known, 0 to only get the current one,
+ *                    set to the current change
+ * RET List of slurmdb_update_object_t *'s, NULL if the journal doesn't go
+ *     back that far
+ */
+extern List assoc_mgr_journal_get(uint64_t *change_id);
+
+/*
+ * Note the slurmdbd change id of an update applied to the lists.  It only
+ * moves forward if no change was missed in between.
+ */
+extern void assoc_mgr_update_change_id(uint64_t change_id);
+
 /* Normalize shares for an association. External so a priority plugin
  * can call it if needed.
  */
@@ -492,6 +514,24 @@ extern slurmdb_tres_rec_t *assoc_mgr_find_tres_rec2(
 extern int assoc_mgr_set_tres_cnt_array(uint64_t **tres_cnt, char *tres_str,
 					uint64_t init_val, bool locked);
 
+/*
+ * Get the Grp TRES still available to a job of assoc, the tightest of assoc
+ * and all its parents.  Each count is one more than what can still be used,
+ * so a job fits every GrpTRES limit up the tree if each of its TRES counts
+ * is lower, and INFINITE64 means no limit.  The array is kept by the
+ * assoc_mgr and recomputed lazily after the assocs or TRES change.
+ * NOTE: The assoc_mgr assoc and tres read locks need to be locked before
+ * calling this function and while using the returned array.
+ */
+extern uint64_t *assoc_mgr_get_grp_tres_avail(slurmdb_assoc_rec_t *assoc);
+
+/*
+ * Forget every array returned by assoc_mgr_get_grp_tres_avail().  Only needed
+ * when grp_used_tres is changed without an assoc write lock, releasing one
+ * does it already.
+ */
+extern void assoc_mgr_reset_grp_tres_avail(void);
+
 /* Creates all the tres arrays for an association.
  * NOTE: The assoc_mgr tres read lock needs to be locked before this
  * is called. */
@@ -48,14 +48,25 @@
 #define POLLRDHUP POLLHUP
 #endif
 
+/*
+ * The epoll backend is built on Linux unless EIO_NO_EPOLL is defined, and is
+ * used at run time when CommunicationParameters includes "EioEpoll".
+ */
+#if defined(__linux__) && !defined(EIO_NO_EPOLL)
+#define HAVE_EIO_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
 #include "src/common/fd.h"
 #include "src/common/eio.h"
 #include "src/common/log.h"
 #include "src/common/list.h"
 #include "src/common/net.h"
+#include "src/common/read_config.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/xassert.h"
 #include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
 
 /*
  * Define slurm-specific aliases for use by plugins, see slurm_xlator.h
@@ -80,6 +91,22 @@ strong_alias(eio_signal_wakeup,		slurm_eio_signal_wakeup);
  * it wakes up.
  */
 #define EIO_MAGIC 0xe1e10
+
+/*
+ * State of one file descriptor for the epoll backend, indexed by fd.
+ * An fd stays registered with epoll across loop iterations and its events
+ * are only changed when the readable()/writable() answers of its object
+ * change.
+ */
+typedef struct {
+	eio_obj_t *obj;		/* object owning the fd this iteration */
+	eio_obj_t *reg_obj;	/* object the fd was registered for */
+	uint32_t events;	/* events registered with epoll */
+	uint32_t gen;		/* last loop iteration the fd was wanted */
+	bool registered;	/* fd has been added to the epoll set */
+	bool no_epoll;		/* fd rejected by epoll, use poll() for it */
+} eio_fd_state_t;
+
 struct eio_handle_components {
 	int  magic;
 	int  fds[2];
@@ -88,6 +115,15 @@ struct eio_handle_components {
 	uint16_t shutdown_wait;
 	List obj_list;
 	List new_objs;
+
+	/* epoll backend, epfd is -1 when the poll() backend is used */
+	int epfd;
+	uint32_t gen;
+	eio_fd_state_t *fd_state;	/* indexed by fd */
+	int fd_state_size;
+	int *reg_fds;			/* fds currently in the epoll set */
+	int reg_cnt;
+	int reg_size;
 };
 
 /* Function prototypes */
@@ -99,12 +135,16 @@ static void         _poll_dispatch(struct pollfd *, unsigned int, eio_obj_t **,
 		                   List objList);
 static void         _poll_handle_event(short revents, eio_obj_t *obj,
 		                       List objList);
+#ifdef HAVE_EIO_EPOLL
+static int          _epoll_mainloop(eio_handle_t *eio);
+#endif
 
 eio_handle_t *eio_handle_create(uint16_t shutdown_wait)
 {
 	eio_handle_t *eio = xmalloc(sizeof(*eio));
 
 	eio->magic = EIO_MAGIC;
+	eio->epfd = -1;
 
 	if (pipe(eio->fds) < 0) {
 		error("%s: pipe: %m", __func__);
@@ -124,6 +164,12 @@ eio_handle_t *eio_handle_create(uint16_t shutdown_wait)
 	if (shutdown_wait > 0)
 		eio->shutdown_wait = shutdown_wait;
 
+#ifdef HAVE_EIO_EPOLL
+	if (xstrcasestr(slurm_conf.comm_params, "EioEpoll") &&
+	    ((eio->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0))
+		error("%s: epoll_create1: %m, using poll()", __func__);
+#endif
+
 	return eio;
 }
 
@@ -133,6 +179,10 @@ void eio_handle_destroy(eio_handle_t *eio)
 	xassert(eio->magic == EIO_MAGIC);
 	close(eio->fds[0]);
 	close(eio->fds[1]);
+	if (eio->epfd >= 0)
+		close(eio->epfd);
+	xfree(eio->fd_state);
+	xfree(eio->reg_fds);
 	FREE_NULL_LIST(eio->obj_list);
 	FREE_NULL_LIST(eio->new_objs);
 	slurm_mutex_destroy(&eio->shutdown_mutex);
@@ -279,6 +329,11 @@ int eio_handle_mainloop(eio_handle_t *eio)
 	xassert (eio != NULL);
 	xassert (eio->magic == EIO_MAGIC);
 
+#ifdef HAVE_EIO_EPOLL
+	if (eio->epfd >= 0)
+		return _epoll_mainloop(eio);
+#endif
+
 	while (1) {
 		/* Alloc memory for pfds and map if needed */
 		n = list_count(eio->obj_list);
@@ -486,6 +541,273 @@ static void _poll_handle_event(short revents, eio_obj_t *obj, List objList)
 	}
 }
 
+#ifdef HAVE_EIO_EPOLL
+static eio_fd_state_t *_epoll_fd_state(eio_handle_t *eio, int fd)
+{
+	if (fd >= eio->fd_state_size) {
+		int old_size = eio->fd_state_size;
+
+		eio->fd_state_size = MAX(fd + 1, old_size * 2);
+		xrealloc(eio->fd_state,
+			 eio->fd_state_size * sizeof(eio_fd_state_t));
+		/* xrealloc() zeroes the new part of the array */
+	}
+	return &eio->fd_state[fd];
+}
+
+/*
+ * Add fd to the epoll set or change its events. An fd closed since it was
+ * registered has been dropped by the kernel (ENOENT), and an fd registered
+ * for a previous owner may still be in the set (EEXIST), so either case
+ * falls back to the other operation.
+ * RET 0 on success, -1 on error with errno set
+ */
+static int _epoll_set(int epfd, int fd, struct epoll_event *ev, bool add)
+{
+	if (!epoll_ctl(epfd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, ev))
+		return 0;
+	if ((add && (errno != EEXIST)) || (!add && (errno != ENOENT)))
+		return -1;
+
+	return epoll_ctl(epfd, add ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, ev);
+}
+
+/*
+ * Bring the epoll registration of obj's fd in line with the events wanted.
+ * RET false if the fd must be handled with poll() in this iteration instead
+ */
+static bool _epoll_update(eio_handle_t *eio, eio_obj_t *obj,
+			  uint32_t events)
+{
+	eio_fd_state_t *fds = _epoll_fd_state(eio, obj->fd);
+	struct epoll_event ev = { .events = events, .data.fd = obj->fd };
+	bool new_owner;
+
+	if (fds->gen == eio->gen) {
+		/* Two objects sharing an fd */
+		return false;
+	}
+	fds->gen = eio->gen;
+	fds->obj = obj;
+
+	/*
+	 * The fd may have been closed and its number reused by another object
+	 * since it was registered, in which case the kernel already dropped
+	 * it from the epoll set and it must be added again. The same object
+	 * reopening the fd is caught by the mainloop clearing the events of
+	 * every fd it dispatched.
+	 */
+	new_owner = (fds->reg_obj != obj);
+	if (new_owner)
+		fds->no_epoll = false;
+	else if (fds->no_epoll)		/* e.g. a regular file */
+		return false;
+	else if (fds->registered && (fds->events == events))
+		return true;
+
+	if (!fds->registered) {
+		if (eio->reg_cnt >= eio->reg_size) {
+			eio->reg_size = MAX(64, eio->reg_size * 2);
+			xrealloc(eio->reg_fds, eio->reg_size * sizeof(int));
+		}
+		eio->reg_fds[eio->reg_cnt++] = obj->fd;
+		fds->registered = true;
+		new_owner = true;
+	}
+	fds->reg_obj = obj;
+
+	if (_epoll_set(eio->epfd, obj->fd, &ev, new_owner)) {
+		if (errno != EPERM)
+			error("%s: epoll_ctl(%d): %m", __func__, obj->fd);
+		fds->no_epoll = true;
+		fds->events = 0;
+		return false;
+	}
+	fds->events = events;
+	return true;
+}
+
+/* Drop fds from the epoll set which no object wanted in this iteration */
+static void _epoll_sweep(eio_handle_t *eio)
+{
+	eio_fd_state_t *fds;
+	int i = 0, fd;
+
+	while (i < eio->reg_cnt) {
+		fd = eio->reg_fds[i];
+		fds = &eio->fd_state[fd];
+		if (fds->gen == eio->gen) {
+			i++;
+			continue;
+		}
+		/* May already be gone if the fd was closed */
+		if (!fds->no_epoll)
+			(void) epoll_ctl(eio->epfd, EPOLL_CTL_DEL, fd, NULL);
+		memset(fds, 0, sizeof(*fds));
+		eio->reg_fds[i] = eio->reg_fds[--eio->reg_cnt];
+	}
+}
+
+static short _epoll_to_poll_events(uint32_t events)
+{
+	short revents = 0;
+
+	if (events & EPOLLIN)
+		revents |= POLLIN;
+	if (events & EPOLLOUT)
+		revents |= POLLOUT;
+	if (events & EPOLLERR)
+		revents |= POLLERR;
+	if (events & EPOLLHUP)
+		revents |= POLLHUP;
+	if (events & EPOLLRDHUP)
+		revents |= POLLRDHUP;
+
+	return revents;
+}
+
+/*
+ * Same contract as the poll() based eio_handle_mainloop(), but objects' fds
+ * stay registered with epoll between iterations and only the fds which are
+ * ready are dispatched. The readable()/writable() callbacks are still asked
+ * on every iteration since their answers depend on state shared between
+ * objects, but only changes in the answers result in system calls.
+ *
+ * fds which epoll can not handle (e.g. regular files) and fds shared by
+ * several objects are handled with poll() alongside the epoll fd.
+ */
+static int _epoll_mainloop(eio_handle_t *eio)
+{
+	int retval = 0;
+	struct pollfd *pollfds = NULL;
+	struct epoll_event *events = NULL;
+	eio_obj_t **map = NULL;
+	unsigned int maxnfds = 0, nfds, nobjs;
+	int i, n, max_events = 0;
+	uint32_t want;
+	time_t shutdown_time;
+	ListIterator itr;
+	eio_obj_t *obj;
+	eio_fd_state_t *fds;
+
+	while (1) {
+		n = list_count(eio->obj_list);
+		if (maxnfds < n) {
+			maxnfds = n;
+			xrealloc(pollfds, (maxnfds + 2) * sizeof(struct pollfd));
+			xrealloc(map, maxnfds * sizeof(eio_obj_t *));
+		}
+		if (!pollfds)  /* Fix for CLANG false positive */
+			goto done;
+
+		debug4("eio: handling events for %d objects", n);
+		eio->gen++;
+		nfds = 0;
+		nobjs = 0;
+		itr = list_iterator_create(eio->obj_list);
+		while ((obj = list_next(itr))) {
+			bool writable = _is_writable(obj);
+			bool readable = _is_readable(obj);
+
+			if (!readable && !writable)
+				continue;
+			nobjs++;
+			if (obj->fd < 0)
+				continue;
+
+			want = 0;
+			if (readable)
+				want |= EPOLLIN | EPOLLRDHUP;
+			if (writable)
+				want |= EPOLLOUT;
+			if (_epoll_update(eio, obj, want))
+				continue;
+
+			pollfds[nfds].fd = obj->fd;
+			pollfds[nfds].events = 0;
+			if (readable)
+				pollfds[nfds].events |= POLLIN | POLLRDHUP;
+			if (writable)
+				pollfds[nfds].events |= POLLOUT | POLLHUP;
+			map[nfds] = obj;
+			nfds++;
+		}
+		list_iterator_destroy(itr);
+		_epoll_sweep(eio);
+
+		if (nobjs == 0)
+			goto done;
+
+		/* Setup epoll and eio handle signaling fds */
+		pollfds[nfds].fd = eio->epfd;
+		pollfds[nfds].events = POLLIN;
+		pollfds[nfds + 1].fd = eio->fds[0];
+		pollfds[nfds + 1].events = POLLIN;
+
+		slurm_mutex_lock(&eio->shutdown_mutex);
+		shutdown_time = eio->shutdown_time;
+		slurm_mutex_unlock(&eio->shutdown_mutex);
+		if (_poll_internal(pollfds, nfds + 2, shutdown_time) < 0)
+			goto error;
+
+		/* See if we've been told to shut down by eio_signal_shutdown */
+		if (pollfds[nfds + 1].revents & POLLIN)
+			_eio_wakeup_handler(eio);
+
+		if (pollfds[nfds].revents & POLLIN) {
+			if (max_events < eio->reg_cnt) {
+				max_events = eio->reg_cnt;
+				xrealloc(events, max_events *
+					 sizeof(struct epoll_event));
+			}
+			while ((n = epoll_wait(eio->epfd, events, max_events,
+					       0)) < 0) {
+				if (errno != EINTR) {
+					error("epoll_wait: %m");
+					goto error;
+				}
+			}
+			for (i = 0; i < n; i++) {
+				fds = &eio->fd_state[events[i].data.fd];
+				if ((fds->gen != eio->gen) || !fds->obj)
+					continue;
+				_poll_handle_event(
+					_epoll_to_poll_events(events[i].events),
+					fds->obj, eio->obj_list);
+				/*
+				 * The handler may have closed the fd and got
+				 * the same number back, which the kernel
+				 * dropped from the epoll set. Make the next
+				 * iteration check the registration so it is
+				 * added again (ENOENT) if that happened.
+				 */
+				fds->events = 0;
+			}
+		}
+
+		_poll_dispatch(pollfds, nfds, map, eio->obj_list);
+
+		slurm_mutex_lock(&eio->shutdown_mutex);
+		shutdown_time = eio->shutdown_time;
+		slurm_mutex_unlock(&eio->shutdown_mutex);
+		if (shutdown_time &&
+		    (difftime(time(NULL), shutdown_time)>=eio->shutdown_wait)) {
+			error("%s: Abandoning IO %d secs after job shutdown initiated",
+			      __func__, eio->shutdown_wait);
+			break;
+		}
+	}
+
+error:
+	retval = -1;
+done:
+	xfree(pollfds);
+	xfree(events);
+	xfree(map);
+	return retval;
+}
+#endif
+
 static struct io_operations *_ops_copy(struct io_operations *ops)
 {
 	struct io_operations *ret = xmalloc(sizeof(*ops));
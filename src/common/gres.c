@@ -186,8 +186,25 @@ static uint32_t select_plugin_type = NO_VAL;
 static buf_t *gres_context_buf = NULL;
 static buf_t *gres_conf_buf = NULL;
 
+/*
+ * Index of the nodes by free count of each GRES, see gres_node_avail_filter().
+ * Bit i of bitmap[b] is set if node i has at least (1 << b) of the GRES not
+ * allocated to jobs.
+ */
+#define GRES_AVAIL_BUCKETS 16
+typedef struct {
+	uint32_t plugin_id;
+	bitstr_t *bitmap[GRES_AVAIL_BUCKETS];
+} gres_avail_index_t;
+
+static gres_avail_index_t *gres_avail_index = NULL;
+static int gres_avail_index_cnt = 0;
+static bool gres_avail_index_valid = false;
+static pthread_mutex_t gres_avail_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Local functions */
 static void _add_gres_context(char *gres_name);
+static void _free_avail_index(void);
 static gres_node_state_t *_build_gres_node_state(void);
 static void	_build_node_gres_str(List *gres_list, char **gres_str,
 				     int cores_per_sock, int sock_per_node);
@@ -671,6 +688,11 @@ extern int gres_fini(void)
 	FREE_NULL_BUFFER(gres_conf_buf);
 	gres_context_cnt = -1;
 
+	slurm_mutex_lock(&gres_avail_lock);
+	_free_avail_index();
+	gres_avail_index_valid = false;
+	slurm_mutex_unlock(&gres_avail_lock);
+
 fini:	slurm_mutex_unlock(&gres_context_lock);
 	return rc;
 }
@@ -2237,6 +2259,17 @@ static void _gres_node_state_delete_topo(gres_node_state_t *gres_node_ptr)
 {
 	int i;
 
+	xfree(gres_node_ptr->topo_gres_cnt_alloc);
+	if (gres_node_ptr->topo_shared) {
+		gres_node_ptr->topo_core_bitmap = NULL;
+		gres_node_ptr->topo_gres_bitmap = NULL;
+		gres_node_ptr->topo_gres_cnt_avail = NULL;
+		gres_node_ptr->topo_type_id = NULL;
+		gres_node_ptr->topo_type_name = NULL;
+		gres_node_ptr->topo_shared = false;
+		return;
+	}
+
 	for (i = 0; i < gres_node_ptr->topo_cnt; i++) {
 		if (gres_node_ptr->topo_gres_bitmap)
 			FREE_NULL_BITMAP(gres_node_ptr->topo_gres_bitmap[i]);
@@ -2246,7 +2279,6 @@ static void _gres_node_state_delete_topo(gres_node_state_t *gres_node_ptr)
 	}
 	xfree(gres_node_ptr->topo_gres_bitmap);
 	xfree(gres_node_ptr->topo_core_bitmap);
-	xfree(gres_node_ptr->topo_gres_cnt_alloc);
 	xfree(gres_node_ptr->topo_gres_cnt_avail);
 	xfree(gres_node_ptr->topo_type_id);
 	xfree(gres_node_ptr->topo_type_name);
@@ -2258,7 +2290,7 @@ static void _gres_node_state_delete(gres_node_state_t *gres_node_ptr)
 
 	FREE_NULL_BITMAP(gres_node_ptr->gres_bit_alloc);
 	xfree(gres_node_ptr->gres_used);
-	if (gres_node_ptr->links_cnt) {
+	if (gres_node_ptr->links_cnt && !gres_node_ptr->topo_shared) {
 		for (i = 0; i < gres_node_ptr->link_len; i++)
 			xfree(gres_node_ptr->links_cnt[i]);
 		xfree(gres_node_ptr->links_cnt);
@@ -2266,13 +2298,15 @@ static void _gres_node_state_delete(gres_node_state_t *gres_node_ptr)
 
 	_gres_node_state_delete_topo(gres_node_ptr);
 
-	for (i = 0; i < gres_node_ptr->type_cnt; i++) {
-		xfree(gres_node_ptr->type_name[i]);
-	}
 	xfree(gres_node_ptr->type_cnt_alloc);
-	xfree(gres_node_ptr->type_cnt_avail);
-	xfree(gres_node_ptr->type_id);
-	xfree(gres_node_ptr->type_name);
+	if (!gres_node_ptr->type_shared) {
+		for (i = 0; i < gres_node_ptr->type_cnt; i++) {
+			xfree(gres_node_ptr->type_name[i]);
+		}
+		xfree(gres_node_ptr->type_cnt_avail);
+		xfree(gres_node_ptr->type_id);
+		xfree(gres_node_ptr->type_name);
+	}
 	xfree(gres_node_ptr);
 }
 
@@ -3140,6 +3174,7 @@ extern int gres_node_config_validate(char *node_name,
 	_sync_node_mps_to_gpu(gres_mps_ptr, gres_gpu_ptr);
 	_build_node_gres_str(gres_list, new_config, cores_per_sock, sock_cnt);
 	slurm_mutex_unlock(&gres_context_lock);
+	gres_node_avail_invalidate();
 
 	return rc;
 }
@@ -3712,6 +3747,7 @@ extern int gres_node_reconfig(char *node_name,
 	/* Build new per-node gres_str */
 	_build_node_gres_str(gres_list, gres_str, cores_per_sock,sock_per_node);
 	slurm_mutex_unlock(&gres_context_lock);
+	gres_node_avail_invalidate();
 	xfree(gres_ptr_array);
 
 	return rc;
@@ -3843,6 +3879,7 @@ extern int gres_node_state_unpack(List *gres_list, buf_t *buffer,
 		list_append(*gres_list, gres_ptr);
 	}
 	slurm_mutex_unlock(&gres_context_lock);
+	gres_node_avail_invalidate();
 	return rc;
 
 unpack_error:
@@ -3851,6 +3888,58 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* Deep copy the topology of a node gres state which shares it */
+static void _node_state_unshare_topo(gres_node_state_t *gres_ptr)
+{
+	bitstr_t **topo_core_bitmap = gres_ptr->topo_core_bitmap;
+	bitstr_t **topo_gres_bitmap = gres_ptr->topo_gres_bitmap;
+	uint64_t *topo_gres_cnt_avail = gres_ptr->topo_gres_cnt_avail;
+	uint32_t *topo_type_id = gres_ptr->topo_type_id;
+	char **topo_type_name = gres_ptr->topo_type_name;
+	int **links_cnt = gres_ptr->links_cnt;
+	int i, j;
+
+	if (!gres_ptr->topo_shared)
+		return;
+	gres_ptr->topo_shared = false;
+
+	if (links_cnt && gres_ptr->link_len) {
+		gres_ptr->links_cnt = xcalloc(gres_ptr->link_len,
+					      sizeof(int *));
+		j = sizeof(int) * gres_ptr->link_len;
+		for (i = 0; i < gres_ptr->link_len; i++) {
+			gres_ptr->links_cnt[i] = xmalloc(j);
+			memcpy(gres_ptr->links_cnt[i], links_cnt[i], j);
+		}
+	}
+
+	gres_ptr->topo_core_bitmap = xcalloc(gres_ptr->topo_cnt,
+					     sizeof(bitstr_t *));
+	gres_ptr->topo_gres_bitmap = xcalloc(gres_ptr->topo_cnt,
+					     sizeof(bitstr_t *));
+	gres_ptr->topo_gres_cnt_avail = xcalloc(gres_ptr->topo_cnt,
+						sizeof(uint64_t));
+	gres_ptr->topo_type_id = xcalloc(gres_ptr->topo_cnt, sizeof(uint32_t));
+	gres_ptr->topo_type_name = xcalloc(gres_ptr->topo_cnt, sizeof(char *));
+	for (i = 0; i < gres_ptr->topo_cnt; i++) {
+		if (topo_core_bitmap[i])
+			gres_ptr->topo_core_bitmap[i] =
+				bit_copy(topo_core_bitmap[i]);
+		if (topo_gres_bitmap[i])
+			gres_ptr->topo_gres_bitmap[i] =
+				bit_copy(topo_gres_bitmap[i]);
+		gres_ptr->topo_gres_cnt_avail[i] = topo_gres_cnt_avail[i];
+		gres_ptr->topo_type_id[i] = topo_type_id[i];
+		gres_ptr->topo_type_name[i] = xstrdup(topo_type_name[i]);
+	}
+}
+
+/*
+ * Copy a node gres state for will-run and preemption tests. Only the fields
+ * changed by allocating and deallocating GRES to jobs are copied, the
+ * topology and type configuration are shared with the original, which must
+ * not be freed or reconfigured while the copy exists.
+ */
 static void *_node_state_dup(void *gres_data)
 {
 	int i, j;
@@ -3869,7 +3958,22 @@ static void *_node_state_dup(void *gres_data)
 	if (gres_ptr->gres_bit_alloc)
 		new_gres->gres_bit_alloc = bit_copy(gres_ptr->gres_bit_alloc);
 
-	if (gres_ptr->links_cnt && gres_ptr->link_len) {
+	if (gres_ptr->topo_cnt) {
+		new_gres->topo_shared      = true;
+		new_gres->topo_cnt         = gres_ptr->topo_cnt;
+		new_gres->links_cnt        = gres_ptr->links_cnt;
+		new_gres->link_len         = gres_ptr->link_len;
+		new_gres->topo_core_bitmap = gres_ptr->topo_core_bitmap;
+		new_gres->topo_gres_bitmap = gres_ptr->topo_gres_bitmap;
+		new_gres->topo_gres_cnt_avail = gres_ptr->topo_gres_cnt_avail;
+		new_gres->topo_type_id     = gres_ptr->topo_type_id;
+		new_gres->topo_type_name   = gres_ptr->topo_type_name;
+		new_gres->topo_gres_cnt_alloc = xcalloc(gres_ptr->topo_cnt,
+							sizeof(uint64_t));
+		memcpy(new_gres->topo_gres_cnt_alloc,
+		       gres_ptr->topo_gres_cnt_alloc,
+		       sizeof(uint64_t) * gres_ptr->topo_cnt);
+	} else if (gres_ptr->links_cnt && gres_ptr->link_len) {
 		new_gres->links_cnt = xcalloc(gres_ptr->link_len,
 					      sizeof(int *));
 		j = sizeof(int) * gres_ptr->link_len;
@@ -3880,56 +3984,16 @@ static void *_node_state_dup(void *gres_data)
 		new_gres->link_len = gres_ptr->link_len;
 	}
 
-	if (gres_ptr->topo_cnt) {
-		new_gres->topo_cnt         = gres_ptr->topo_cnt;
-		new_gres->topo_core_bitmap = xcalloc(gres_ptr->topo_cnt,
-						     sizeof(bitstr_t *));
-		new_gres->topo_gres_bitmap = xcalloc(gres_ptr->topo_cnt,
-						     sizeof(bitstr_t *));
-		new_gres->topo_gres_cnt_alloc = xcalloc(gres_ptr->topo_cnt,
-							sizeof(uint64_t));
-		new_gres->topo_gres_cnt_avail = xcalloc(gres_ptr->topo_cnt,
-							sizeof(uint64_t));
-		new_gres->topo_type_id = xcalloc(gres_ptr->topo_cnt,
-						 sizeof(uint32_t));
-		new_gres->topo_type_name = xcalloc(gres_ptr->topo_cnt,
-						   sizeof(char *));
-		for (i = 0; i < gres_ptr->topo_cnt; i++) {
-			if (gres_ptr->topo_core_bitmap[i]) {
-				new_gres->topo_core_bitmap[i] =
-					bit_copy(gres_ptr->topo_core_bitmap[i]);
-			}
-			new_gres->topo_gres_bitmap[i] =
-				bit_copy(gres_ptr->topo_gres_bitmap[i]);
-			new_gres->topo_gres_cnt_alloc[i] =
-				gres_ptr->topo_gres_cnt_alloc[i];
-			new_gres->topo_gres_cnt_avail[i] =
-				gres_ptr->topo_gres_cnt_avail[i];
-			new_gres->topo_type_id[i] = gres_ptr->topo_type_id[i];
-			new_gres->topo_type_name[i] =
-				xstrdup(gres_ptr->topo_type_name[i]);
-		}
-	}
-
 	if (gres_ptr->type_cnt) {
+		new_gres->type_shared    = true;
 		new_gres->type_cnt       = gres_ptr->type_cnt;
+		new_gres->type_cnt_avail = gres_ptr->type_cnt_avail;
+		new_gres->type_id        = gres_ptr->type_id;
+		new_gres->type_name      = gres_ptr->type_name;
 		new_gres->type_cnt_alloc = xcalloc(gres_ptr->type_cnt,
 						   sizeof(uint64_t));
-		new_gres->type_cnt_avail = xcalloc(gres_ptr->type_cnt,
-						   sizeof(uint64_t));
-		new_gres->type_id = xcalloc(gres_ptr->type_cnt,
-					    sizeof(uint32_t));
-		new_gres->type_name = xcalloc(gres_ptr->type_cnt,
-					      sizeof(char *));
-		for (i = 0; i < gres_ptr->type_cnt; i++) {
-			new_gres->type_cnt_alloc[i] =
-				gres_ptr->type_cnt_alloc[i];
-			new_gres->type_cnt_avail[i] =
-				gres_ptr->type_cnt_avail[i];
-			new_gres->type_id[i] = gres_ptr->type_id[i];
-			new_gres->type_name[i] =
-				xstrdup(gres_ptr->type_name[i]);
-		}
+		memcpy(new_gres->type_cnt_alloc, gres_ptr->type_cnt_alloc,
+		       sizeof(uint64_t) * gres_ptr->type_cnt);
 	}
 
 	return new_gres;
@@ -3969,7 +4033,7 @@ extern List gres_node_state_dup(List gres_list)
 				new_gres->gres_data = gres_data;
 				new_gres->gres_name =
 					xstrdup(gres_ptr->gres_name);
-				gres_ptr->state_type = GRES_STATE_TYPE_NODE;
+				new_gres->state_type = GRES_STATE_TYPE_NODE;
 				list_append(new_list, new_gres);
 			}
 			break;
@@ -4050,6 +4114,172 @@ extern void gres_node_state_dealloc_all(List gres_list)
 	}
 	list_iterator_destroy(gres_iter);
 	slurm_mutex_unlock(&gres_context_lock);
+
+	gres_node_avail_invalidate();
+}
+
+static void _free_avail_index(void)
+{
+	int i, b;
+
+	for (i = 0; i < gres_avail_index_cnt; i++) {
+		for (b = 0; b < GRES_AVAIL_BUCKETS; b++)
+			FREE_NULL_BITMAP(gres_avail_index[i].bitmap[b]);
+	}
+	xfree(gres_avail_index);
+	gres_avail_index_cnt = 0;
+}
+
+/* NOTE: Called with gres_avail_lock locked */
+static gres_avail_index_t *_get_avail_index(uint32_t plugin_id, bool create)
+{
+	gres_avail_index_t *index;
+	int i, b;
+
+	for (i = 0; i < gres_avail_index_cnt; i++) {
+		if (gres_avail_index[i].plugin_id == plugin_id)
+			return &gres_avail_index[i];
+	}
+	if (!create)
+		return NULL;
+
+	xrecalloc(gres_avail_index, gres_avail_index_cnt + 1,
+		  sizeof(gres_avail_index_t));
+	index = &gres_avail_index[gres_avail_index_cnt++];
+	index->plugin_id = plugin_id;
+	for (b = 0; b < GRES_AVAIL_BUCKETS; b++)
+		index->bitmap[b] = bit_alloc(node_record_count);
+
+	return index;
+}
+
+/* NOTE: Called with gres_avail_lock locked */
+static void _set_avail_index(int node_inx, List node_gres_list)
+{
+	ListIterator gres_iter;
+	gres_state_t *gres_ptr;
+	gres_node_state_t *node_state;
+	gres_avail_index_t *index;
+	uint64_t avail;
+	int i, b;
+
+	for (i = 0; i < gres_avail_index_cnt; i++) {
+		for (b = 0; b < GRES_AVAIL_BUCKETS; b++)
+			bit_clear(gres_avail_index[i].bitmap[b], node_inx);
+	}
+	if (!node_gres_list)
+		return;
+
+	gres_iter = list_iterator_create(node_gres_list);
+	while ((gres_ptr = list_next(gres_iter))) {
+		node_state = gres_ptr->gres_data;
+		avail = node_state->gres_cnt_avail;
+		if (!node_state->no_consume) {
+			if (node_state->gres_cnt_alloc >= avail)
+				avail = 0;
+			else
+				avail -= node_state->gres_cnt_alloc;
+		}
+		index = _get_avail_index(gres_ptr->plugin_id, true);
+		for (b = 0; (b < GRES_AVAIL_BUCKETS) &&
+			     (avail >= (((uint64_t) 1) << b)); b++)
+			bit_set(index->bitmap[b], node_inx);
+	}
+	list_iterator_destroy(gres_iter);
+}
+
+/* NOTE: Called with gres_avail_lock locked */
+static void _build_avail_index(void)
+{
+	int i;
+
+	_free_avail_index();
+	for (i = 0; i < node_record_count; i++)
+		_set_avail_index(i, node_record_table_ptr[i].gres_list);
+	gres_avail_index_valid = true;
+}
+
+/*
+ * Rebuild the index of free GRES by node before its next use. Called when
+ * the GRES configuration of nodes change or their allocations are reset.
+ */
+extern void gres_node_avail_invalidate(void)
+{
+	slurm_mutex_lock(&gres_avail_lock);
+	gres_avail_index_valid = false;
+	slurm_mutex_unlock(&gres_avail_lock);
+}
+
+/*
+ * Update the index of free GRES for a node after allocating or deallocating
+ * GRES from it. Copies of the node gres state (e.g. for will-run tests) are
+ * not indexed and ignored.
+ * IN node_gres_list - node gres state information
+ * IN node_inx - index of the node in node_record_table_ptr
+ */
+extern void gres_node_avail_update(List node_gres_list, int node_inx)
+{
+	if ((node_inx < 0) || (node_inx >= node_record_count) ||
+	    !node_gres_list ||
+	    (node_record_table_ptr[node_inx].gres_list != node_gres_list))
+		return;
+
+	slurm_mutex_lock(&gres_avail_lock);
+	if (gres_avail_index_valid && gres_avail_index_cnt &&
+	    (bit_size(gres_avail_index[0].bitmap[0]) == node_record_count))
+		_set_avail_index(node_inx, node_gres_list);
+	else
+		gres_avail_index_valid = false;
+	slurm_mutex_unlock(&gres_avail_lock);
+}
+
+/*
+ * Clear from node_bitmap the nodes which do not have enough free GRES to
+ * satisfy the job's per node GRES counts. Nodes left may still be unable to
+ * satisfy the request (GRES type, binding to cores, etc.), so this only
+ * spares the detailed tests of gres_job_test2() on nodes which will fail
+ * them. Only valid for the live node gres state.
+ * IN job_gres_list - job's gres_list built by gres_job_state_validate()
+ * IN/OUT node_bitmap - nodes to be considered for the job
+ */
+extern void gres_node_avail_filter(List job_gres_list, bitstr_t *node_bitmap)
+{
+	ListIterator job_gres_iter;
+	gres_state_t *job_gres_ptr;
+	gres_job_state_t *job_state;
+	gres_avail_index_t *index;
+	int b;
+
+	if (!job_gres_list || !node_bitmap ||
+	    (bit_size(node_bitmap) != node_record_count))
+		return;
+
+	slurm_mutex_lock(&gres_avail_lock);
+	if (!gres_avail_index_valid ||
+	    (gres_avail_index_cnt &&
+	     (bit_size(gres_avail_index[0].bitmap[0]) != node_record_count)))
+		_build_avail_index();
+
+	job_gres_iter = list_iterator_create(job_gres_list);
+	while ((job_gres_ptr = list_next(job_gres_iter))) {
+		job_state = job_gres_ptr->gres_data;
+		if (!job_state->gres_per_node)
+			continue;
+		if (!(index = _get_avail_index(job_gres_ptr->plugin_id,
+					       false))) {
+			/* No node has this GRES */
+			bit_clear_all(node_bitmap);
+			break;
+		}
+		/* Largest bucket not over the count, a superset of the fit */
+		for (b = 1; (b < GRES_AVAIL_BUCKETS) &&
+			     ((((uint64_t) 1) << b) <= job_state->gres_per_node);
+		     b++)
+			;
+		bit_and(node_bitmap, index->bitmap[b - 1]);
+	}
+	list_iterator_destroy(job_gres_iter);
+	slurm_mutex_unlock(&gres_avail_lock);
 }
 
 static char *_node_gres_used(void *gres_data, char *gres_name)
@@ -6396,6 +6626,7 @@ extern void gres_validate_node_cores(gres_node_state_t *node_gres_ptr,
 			      node_name, cores_slurmd, cores_ctld);
 			log_mismatch = false;
 		}
+		_node_state_unshare_topo(node_gres_ptr);
 		new_core_bitmap = _core_bitmap_rebuild(
 			node_gres_ptr->topo_core_bitmap[i],
 			cores_ctld);
@@ -165,6 +165,12 @@ typedef struct gres_node_state {
 	 * GPUs on the node while the count is a site-configurable value.
 	 */
 	uint16_t topo_cnt;		/* Size of topo_ arrays */
+	/*
+	 * Set in copies made by gres_node_state_dup(): links_cnt and the topo_
+	 * arrays other than topo_gres_cnt_alloc belong to the original node
+	 * gres state and are not to be modified or freed.
+	 */
+	bool topo_shared;
 	int link_len;			/* Size of link_cnt */
 	int **links_cnt;		/* Count of links between GRES */
 	bitstr_t **topo_core_bitmap;
@@ -182,6 +188,11 @@ typedef struct gres_node_state {
 	 * will be incremented.
 	 */
 	uint16_t type_cnt;		/* Size of type_ arrays */
+	/*
+	 * Set in copies made by gres_node_state_dup(): the type_ arrays other
+	 * than type_cnt_alloc belong to the original node gres state.
+	 */
+	bool type_shared;
 	uint64_t *type_cnt_alloc;
 	uint64_t *type_cnt_avail;
 	uint32_t *type_id;		/* GRES type (e.g. model ID) */
@@ -551,6 +562,32 @@ extern List gres_node_state_dup(List gres_list);
  */
 extern void gres_node_state_dealloc_all(List gres_list);
 
+/*
+ * Rebuild the index of free GRES by node before its next use. Called when
+ * the GRES configuration of nodes change or their allocations are reset.
+ */
+extern void gres_node_avail_invalidate(void);
+
+/*
+ * Update the index of free GRES for a node after allocating or deallocating
+ * GRES from it. Copies of the node gres state (e.g. for will-run tests) are
+ * not indexed and ignored.
+ * IN node_gres_list - node gres state information
+ * IN node_inx - index of the node in node_record_table_ptr
+ */
+extern void gres_node_avail_update(List node_gres_list, int node_inx);
+
+/*
+ * Clear from node_bitmap the nodes which do not have enough free GRES to
+ * satisfy the job's per node GRES counts. Nodes left may still be unable to
+ * satisfy the request (GRES type, binding to cores, etc.), so this only
+ * spares the detailed tests of gres_job_test2() on nodes which will fail
+ * them. Only valid for the live node gres state.
+ * IN job_gres_list - job's gres_list built by gres_job_state_validate()
+ * IN/OUT node_bitmap - nodes to be considered for the job
+ */
+extern void gres_node_avail_filter(List job_gres_list, bitstr_t *node_bitmap);
+
 /*
  * Log a node's current gres state
  * IN gres_list - generated by gres_node_config_validate()
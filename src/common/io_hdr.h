@@ -49,6 +49,16 @@
 #define MAX_MSG_LEN 1024
 #define SLURM_IO_KEY_SIZE 8
 
+/*
+ * With --io-aggregate the slurmstepd holds task output for up to the given
+ * window (msec) and writes all pending frames to srun in a single write of
+ * at most IO_AGGREGATE_MAX_LEN bytes. Each frame keeps its own io_hdr_t, so
+ * the stream is unchanged from the client's point of view.
+ */
+#define IO_AGGREGATE_DEFAULT_WINDOW 10
+#define IO_AGGREGATE_MAX_WINDOW 1000
+#define IO_AGGREGATE_MAX_LEN (64 * 1024)
+
 #define SLURM_IO_STDIN 0
 #define SLURM_IO_STDOUT 1
 #define SLURM_IO_STDERR 2
@@ -58,6 +58,7 @@
 #include <errno.h>
 #include <poll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -159,9 +160,16 @@ extern char * program_invocation_name;
 /*
  * pthread_atfork handlers:
  */
-static void _atfork_prep()   { slurm_mutex_lock(&log_lock);   }
-static void _atfork_parent() { slurm_mutex_unlock(&log_lock); }
-static void _atfork_child()  { slurm_mutex_unlock(&log_lock); }
+static void _async_drain(void);
+static void _async_fast_start(void);
+static void _async_reset(void);
+static void _atfork_prep()   { slurm_mutex_lock(&log_lock); _async_drain(); }
+static void _atfork_parent()
+{
+	_async_fast_start();
+	slurm_mutex_unlock(&log_lock);
+}
+static void _atfork_child()  { _async_reset(); slurm_mutex_unlock(&log_lock); }
 static bool at_forked = false;
 #define atfork_install_handlers()					\
 	while (!at_forked) {						\
@@ -170,6 +178,7 @@ static bool at_forked = false;
 	}
 
 static void _log_flush(log_t *log);
+static void xlogfmtcat(char **dst, const char *fmt, ...);
 
 static log_level_t _highest_level(log_level_t a, log_level_t b, log_level_t c)
 {
@@ -276,6 +285,330 @@ static int _fd_writeable(int fd)
 	return 1;
 }
 
+/*
+ * Asynchronous logfile writes (log_options_t.async)
+ *
+ * Lines for a logfile are formatted by the caller and handed over to a writer
+ * thread through a bounded lock-free multi-producer/single-consumer ring, so
+ * the caller never waits on the file. Each slot carries a sequence number
+ * telling whether it is free for producer "pos" (seq == pos) or holds the
+ * line of producer "pos" (seq == pos + 1).
+ *
+ * Lines going to the logfile only are formatted and queued without log_lock
+ * (the "fast path"), so threads logging at the same time do not serialize.
+ * Anything changing the log setup stops the fast path and waits for the
+ * producers still in it while holding log_lock.
+ *
+ * When the ring is full, errors and fatals wait for the writer to make room,
+ * anything else is dropped. The number of dropped lines is written to the
+ * logfile by the writer as soon as it catches up.
+ */
+#define ASYNC_RING_SIZE	8192	/* must be a power of 2 */
+
+typedef struct {
+	uint64_t seq;
+	log_t *log;
+	char *line;
+} async_slot_t;
+
+static async_slot_t async_ring[ASYNC_RING_SIZE];
+static uint64_t async_head = 0;		/* next slot claimed by producers */
+static uint64_t async_tail = 0;		/* next slot read by the writer */
+static uint64_t async_dropped = 0;
+static uint64_t async_dropped_tot = 0;
+static uint64_t async_waits = 0;
+
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t async_idle_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t async_thread;
+static bool async_ring_init = false;
+static bool async_running = false;
+static bool async_busy = false;
+static bool async_sleeping = false;
+static bool async_shutdown = false;
+
+static bool async_fast = false;		/* fast path open */
+static uint32_t async_fast_users = 0;	/* producers in the fast path */
+static log_level_t async_fast_min;	/* fast path for min < level <= max */
+static log_level_t async_fast_max;
+
+static void _async_reset(void)
+{
+	for (int i = 0; i < ASYNC_RING_SIZE; i++) {
+		async_ring[i].seq = i;
+		async_ring[i].log = NULL;
+		async_ring[i].line = NULL;
+	}
+	async_head = async_tail = 0;
+	async_dropped = 0;
+	async_running = async_busy = async_sleeping = async_shutdown = false;
+	async_fast = false;
+	async_fast_users = 0;
+	async_ring_init = true;
+}
+
+static bool _async_empty(void)
+{
+	async_slot_t *slot = &async_ring[async_tail & (ASYNC_RING_SIZE - 1)];
+
+	return (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) !=
+		(async_tail + 1));
+}
+
+/* Only called by the writer thread */
+static async_slot_t *_async_dequeue(void)
+{
+	if (_async_empty())
+		return NULL;
+
+	return &async_ring[async_tail & (ASYNC_RING_SIZE - 1)];
+}
+
+/* Give the slot returned by _async_dequeue() back to the producers */
+static void _async_release(async_slot_t *slot)
+{
+	slot->log = NULL;
+	slot->line = NULL;
+	__atomic_store_n(&slot->seq, async_tail + ASYNC_RING_SIZE,
+			 __ATOMIC_RELEASE);
+	async_tail++;
+}
+
+static bool _async_full(void)
+{
+	uint64_t pos = __atomic_load_n(&async_head, __ATOMIC_RELAXED);
+	async_slot_t *slot = &async_ring[pos & (ASYNC_RING_SIZE - 1)];
+
+	return ((int64_t) __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) -
+		(int64_t) pos) < 0;
+}
+
+/* Wait for the writer to empty a full ring */
+static void _async_wait_room(void)
+{
+	slurm_mutex_lock(&async_lock);
+	while (_async_full() && !async_shutdown) {
+		slurm_cond_signal(&async_cond);
+		slurm_cond_wait(&async_idle_cond, &async_lock);
+	}
+	slurm_mutex_unlock(&async_lock);
+}
+
+/* RET false if the ring is full */
+static bool _async_enqueue(log_t *log, char *line)
+{
+	uint64_t pos = __atomic_load_n(&async_head, __ATOMIC_RELAXED);
+	async_slot_t *slot;
+	int64_t diff;
+
+	while (true) {
+		slot = &async_ring[pos & (ASYNC_RING_SIZE - 1)];
+		diff = (int64_t) __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) -
+		       (int64_t) pos;
+		if (diff < 0)
+			return false;
+		if ((diff == 0) &&
+		    __atomic_compare_exchange_n(&async_head, &pos, pos + 1,
+						true, __ATOMIC_RELAXED,
+						__ATOMIC_RELAXED))
+			break;
+		if (diff > 0)
+			pos = __atomic_load_n(&async_head, __ATOMIC_RELAXED);
+	}
+
+	slot->log = log;
+	slot->line = line;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&async_sleeping, __ATOMIC_SEQ_CST)) {
+		slurm_mutex_lock(&async_lock);
+		slurm_cond_signal(&async_cond);
+		slurm_mutex_unlock(&async_lock);
+	}
+
+	return true;
+}
+
+static void _async_write_dropped(log_t *log, uint64_t dropped)
+{
+	char *msg = NULL;
+
+	if (!log->logfp)
+		return;
+	xlogfmtcat(&msg, "[%M] error: %"PRIu64" log messages dropped, log writer fell behind\n",
+		   dropped);
+	fputs(msg, log->logfp);
+	xfree(msg);
+}
+
+static void *_async_writer(void *arg)
+{
+	async_slot_t *slot;
+	uint64_t dropped;
+	FILE *last_fp;
+
+#if HAVE_SYS_PRCTL_H
+	(void) prctl(PR_SET_NAME, "log_writer", NULL, NULL, NULL);
+#endif
+
+	slurm_mutex_lock(&async_lock);
+	while (true) {
+		async_busy = false;
+		slurm_cond_broadcast(&async_idle_cond);
+
+		__atomic_store_n(&async_sleeping, true, __ATOMIC_SEQ_CST);
+		while (_async_empty() && !async_shutdown)
+			slurm_cond_wait(&async_cond, &async_lock);
+		__atomic_store_n(&async_sleeping, false, __ATOMIC_SEQ_CST);
+
+		if (_async_empty() && async_shutdown)
+			break;
+		async_busy = true;
+		slurm_mutex_unlock(&async_lock);
+
+		last_fp = NULL;
+		while ((slot = _async_dequeue())) {
+			if ((dropped = __atomic_exchange_n(&async_dropped, 0,
+							   __ATOMIC_RELAXED)))
+				_async_write_dropped(slot->log, dropped);
+			if (slot->log->logfp) {
+				if (last_fp && (last_fp != slot->log->logfp))
+					fflush(last_fp);
+				fputs(slot->line, slot->log->logfp);
+				last_fp = slot->log->logfp;
+			}
+			xfree(slot->line);
+			_async_release(slot);
+		}
+		if (last_fp)
+			fflush(last_fp);
+
+		slurm_mutex_lock(&async_lock);
+	}
+	slurm_mutex_unlock(&async_lock);
+
+	return NULL;
+}
+
+static void _async_start(void)
+{
+	if (async_running)
+		return;
+
+	if (!async_ring_init)
+		_async_reset();
+
+	/* Can't use slurm_thread_create() as it logs on failure */
+	if (pthread_create(&async_thread, NULL, _async_writer, NULL)) {
+		fprintf(stderr, "%s: unable to start log writer thread, logging synchronously: %s\n",
+			__func__, slurm_strerror(errno));
+		return;
+	}
+	async_running = true;
+}
+
+/*
+ * Close the fast path and wait for the producers still in it.
+ * Call with log_lock held, _async_fast_start() opens it again.
+ */
+static void _async_fast_stop(void)
+{
+	__atomic_store_n(&async_fast, false, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&async_fast_users, __ATOMIC_SEQ_CST))
+		sched_yield();
+}
+
+/* Open the fast path if the log setup allows it, call with log_lock held */
+static void _async_fast_start(void)
+{
+	if (!async_running || !LOG_INITIALIZED || !log->opt.async ||
+	    !log->logfp)
+		return;
+
+	async_fast_min = MAX(log->opt.stderr_level, log->opt.syslog_level);
+	async_fast_max = log->opt.logfile_level;
+	if (async_fast_min < async_fast_max)
+		__atomic_store_n(&async_fast, true, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Wait for the writer to have written everything queued so far.
+ * Call with log_lock held, this closes the fast path so nothing new gets
+ * queued. _async_fast_start() opens it again.
+ */
+static void _async_drain(void)
+{
+	_async_fast_stop();
+
+	if (!async_running)
+		return;
+
+	slurm_mutex_lock(&async_lock);
+	while (async_busy || !_async_empty()) {
+		slurm_cond_signal(&async_cond);
+		slurm_cond_wait(&async_idle_cond, &async_lock);
+	}
+	slurm_mutex_unlock(&async_lock);
+}
+
+/* Flush and stop the writer, call with log_lock held */
+static void _async_stop(void)
+{
+	_async_fast_stop();
+
+	if (!async_running)
+		return;
+
+	slurm_mutex_lock(&async_lock);
+	async_shutdown = true;
+	slurm_cond_signal(&async_cond);
+	slurm_mutex_unlock(&async_lock);
+	pthread_join(async_thread, NULL);
+
+	if ((async_dropped_tot || async_waits) && log && log->logfp) {
+		char *msg = NULL;
+
+		xlogfmtcat(&msg, "[%M] log writer dropped %"PRIu64" messages, %"PRIu64" errors waited for room\n",
+			   async_dropped_tot, async_waits);
+		fputs(msg, log->logfp);
+		xfree(msg);
+	}
+	async_running = false;
+	async_shutdown = false;
+}
+
+/*
+ * Hand a complete logfile line over to the writer thread.
+ * RET true if the line was taken care of, *line is then consumed,
+ *     false if the caller has to write it out itself.
+ */
+static bool _async_write(log_t *log, log_level_t level, char **line)
+{
+	if (!log->opt.async || !async_running)
+		return false;
+
+	while (!_async_enqueue(log, *line)) {
+		if (level > LOG_LEVEL_ERROR) {
+			__atomic_fetch_add(&async_dropped, 1,
+					   __ATOMIC_RELAXED);
+			__atomic_fetch_add(&async_dropped_tot, 1,
+					   __ATOMIC_RELAXED);
+			xfree(*line);
+			return true;
+		}
+		/*
+		 * Never lose errors, nor write them ahead of the lines still
+		 * queued, make the caller wait instead
+		 */
+		__atomic_fetch_add(&async_waits, 1, __ATOMIC_RELAXED);
+		_async_wait_room();
+	}
+
+	*line = NULL;
+	return true;
+}
+
 /*
  * Initialize log with
  * prog = program name to tag error messages with
@@ -289,6 +622,9 @@ _log_init(char *prog, log_options_t opt, log_facility_t fac, char *logfile )
 {
 	int rc = 0;
 
+	/* Nothing may still be queued for a logfile about to change */
+	_async_drain();
+
 	if (!log)  {
 		log = xmalloc(sizeof(log_t));
 		log->logfp = NULL;
@@ -371,8 +707,12 @@ _log_init(char *prog, log_options_t opt, log_facility_t fac, char *logfile )
 					   log->opt.logfile_level,
 					   log->opt.stderr_level);
 
+	if (log->opt.async)
+		_async_start();
+
 	log->initialized = 1;
  out:
+	_async_fast_start();
 	return rc;
 }
 
@@ -389,6 +729,8 @@ _sched_log_init(char *prog, log_options_t opt, log_facility_t fac,
 {
 	int rc = 0;
 
+	_async_drain();
+
 	if (!sched_log) {
 		sched_log = xmalloc(sizeof(log_t));
 		atfork_install_handlers();
@@ -471,8 +813,12 @@ _sched_log_init(char *prog, log_options_t opt, log_facility_t fac,
 	if (highest_sched_log_level > LOG_LEVEL_QUIET)
 		highest_sched_log_level = LOG_LEVEL_END;
 
+	if (sched_log->opt.async)
+		_async_start();
+
 	sched_log->initialized = 1;
  out:
+	_async_fast_start();
 	return rc;
 }
 
@@ -508,6 +854,7 @@ void log_fini(void)
 		return;
 
 	slurm_mutex_lock(&log_lock);
+	_async_stop();
 	_log_flush(log);
 	xfree(log->argv0);
 	xfree(log->fpfx);
@@ -528,6 +875,7 @@ void sched_log_fini(void)
 		return;
 
 	slurm_mutex_lock(&log_lock);
+	_async_drain();
 	_log_flush(sched_log);
 	xfree(sched_log->argv0);
 	xfree(sched_log->fpfx);
@@ -538,6 +886,7 @@ void sched_log_fini(void)
 	if (sched_log->logfp)
 		fclose(sched_log->logfp);
 	xfree(sched_log);
+	_async_fast_start();
 	slurm_mutex_unlock(&log_lock);
 }
 
@@ -549,6 +898,7 @@ void log_reinit(void)
 void log_set_fpfx(char **prefix)
 {
 	slurm_mutex_lock(&log_lock);
+	_async_fast_stop();
 	xfree(log->fpfx);
 	if (!prefix || !*prefix)
 		log->fpfx = xstrdup("");
@@ -556,6 +906,7 @@ void log_set_fpfx(char **prefix)
 		log->fpfx = *prefix;
 		*prefix = NULL;
 	}
+	_async_fast_start();
 	slurm_mutex_unlock(&log_lock);
 }
 
@@ -591,6 +942,7 @@ int log_alter_with_fp(log_options_t opt, log_facility_t fac, FILE *fp_in)
 	int rc = 0;
 	slurm_mutex_lock(&log_lock);
 	rc = _log_init(NULL, opt, fac, NULL);
+	_async_drain();
 	if (log->logfp)
 		fclose(log->logfp); /* Ignore errors */
 	log->logfp = fp_in;
@@ -601,6 +953,7 @@ int log_alter_with_fp(log_options_t opt, log_facility_t fac, FILE *fp_in)
 		/* don't close fd on out since this fd was made
 		 * outside of the logger */
 	}
+	_async_fast_start();
 	slurm_mutex_unlock(&log_lock);
 	return rc;
 }
@@ -652,7 +1005,9 @@ void log_set_timefmt(unsigned fmtflag)
 {
 	if (log) {
 		slurm_mutex_lock(&log_lock);
+		_async_fast_stop();
 		log->fmt = fmtflag;
+		_async_fast_start();
 		slurm_mutex_unlock(&log_lock);
 	} else {
 		fprintf(stderr, "%s:%d: %s Slurm log not initialized\n",
@@ -1169,6 +1524,98 @@ static void _log_printf(log_t *log, cbuf_t *cb, FILE *stream,
  * log a message at the specified level to facilities that have been
  * configured to receive messages at that level
  */
+/*
+ * Return the prefix of a line logged at level and set the matching syslog
+ * priority
+ */
+static char *_log_level_pfx(log_level_t level, bool sched, bool spank,
+			    int *priority)
+{
+	char *pfx = "";
+
+	switch (level) {
+	case LOG_LEVEL_FATAL:
+		*priority = LOG_CRIT;
+		pfx = "fatal: ";
+		break;
+
+	case LOG_LEVEL_ERROR:
+		*priority = LOG_ERR;
+		pfx = sched? "error: sched: " : "error: ";
+		pfx = spank ? "" : pfx;
+		break;
+
+	case LOG_LEVEL_INFO:
+	case LOG_LEVEL_VERBOSE:
+		*priority = LOG_INFO;
+		pfx = sched ? "sched: " : "";
+		break;
+
+	case LOG_LEVEL_DEBUG:
+		*priority = LOG_DEBUG;
+		pfx = sched ? "debug:  sched: " : "debug:  ";
+		break;
+
+	case LOG_LEVEL_DEBUG2:
+		*priority = LOG_DEBUG;
+		pfx = sched ? "debug2: sched: " : "debug2: ";
+		break;
+
+	case LOG_LEVEL_DEBUG3:
+		*priority = LOG_DEBUG;
+		pfx = sched ? "debug3: sched: " : "debug3: ";
+		break;
+
+	case LOG_LEVEL_DEBUG4:
+		*priority = LOG_DEBUG;
+		pfx = "debug4: ";
+		break;
+
+	case LOG_LEVEL_DEBUG5:
+		*priority = LOG_DEBUG;
+		pfx = "debug5: ";
+		break;
+
+	default:
+		*priority = LOG_ERR;
+		pfx = "internal error: ";
+		break;
+	}
+
+	return pfx;
+}
+
+/*
+ * Format and queue a line going to an asynchronous logfile only, without
+ * taking log_lock.
+ * RET false if the line has to go through _log_msg(), args is then untouched
+ */
+static bool _log_msg_fast(log_level_t level, bool spank, const char *fmt,
+			  va_list args)
+{
+	char *pfx = "", *buf, *line = NULL;
+	int priority;
+	bool done = false;
+
+	if (!__atomic_load_n(&async_fast, __ATOMIC_RELAXED))
+		return false;
+
+	__atomic_fetch_add(&async_fast_users, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&async_fast, __ATOMIC_SEQ_CST) &&
+	    (level > async_fast_min) && (level <= async_fast_max)) {
+		if (log->opt.prefix_level)
+			pfx = _log_level_pfx(level, false, spank, &priority);
+		buf = vxstrfmt(fmt, args);
+		xlogfmtcat(&line, "[%M] %s%s%s\n", log->fpfx, pfx, buf);
+		xfree(buf);
+		(void) _async_write(log, level, &line);
+		done = true;
+	}
+	__atomic_fetch_sub(&async_fast_users, 1, __ATOMIC_SEQ_CST);
+
+	return done;
+}
+
 static void _log_msg(log_level_t level, bool sched, bool spank, const char *fmt, va_list args)
 {
 	char *pfx = "";
@@ -1176,6 +1623,9 @@ static void _log_msg(log_level_t level, bool sched, bool spank, const char *fmt,
 	char *msgbuf = NULL;
 	int priority = LOG_INFO;
 
+	if (!sched && _log_msg_fast(level, spank, fmt, args))
+		return;
+
 	slurm_mutex_lock(&log_lock);
 
 	if (!LOG_INITIALIZED) {
@@ -1186,10 +1636,13 @@ static void _log_msg(log_level_t level, bool sched, bool spank, const char *fmt,
 	if (SCHED_LOG_INITIALIZED && sched &&
 	    (highest_sched_log_level > LOG_LEVEL_QUIET)) {
 		buf = vxstrfmt(fmt, args);
-		xlogfmtcat(&msgbuf, "[%M] %s%s%s", sched_log->fpfx, pfx, buf);
-		_log_printf(sched_log, sched_log->fbuf, sched_log->logfp,
-			    "sched: %s\n", msgbuf);
-		fflush(sched_log->logfp);
+		xlogfmtcat(&msgbuf, "sched: [%M] %s%s%s\n",
+			   sched_log->fpfx, pfx, buf);
+		if (!_async_write(sched_log, level, &msgbuf)) {
+			_log_printf(sched_log, sched_log->fbuf,
+				    sched_log->logfp, "%s", msgbuf);
+			fflush(sched_log->logfp);
+		}
 		xfree(msgbuf);
 	}
 
@@ -1199,57 +1652,8 @@ static void _log_msg(log_level_t level, bool sched, bool spank, const char *fmt,
 		return;
 	}
 
-	if (log->opt.prefix_level || (log->opt.syslog_level > level)) {
-		switch (level) {
-		case LOG_LEVEL_FATAL:
-			priority = LOG_CRIT;
-			pfx = "fatal: ";
-			break;
-
-		case LOG_LEVEL_ERROR:
-			priority = LOG_ERR;
-			pfx = sched? "error: sched: " : "error: ";
-			pfx = spank ? "" : pfx;
-			break;
-
-		case LOG_LEVEL_INFO:
-		case LOG_LEVEL_VERBOSE:
-			priority = LOG_INFO;
-			pfx = sched ? "sched: " : "";
-			break;
-
-		case LOG_LEVEL_DEBUG:
-			priority = LOG_DEBUG;
-			pfx = sched ? "debug:  sched: " : "debug:  ";
-			break;
-
-		case LOG_LEVEL_DEBUG2:
-			priority = LOG_DEBUG;
-			pfx = sched ? "debug2: sched: " : "debug2: ";
-			break;
-
-		case LOG_LEVEL_DEBUG3:
-			priority = LOG_DEBUG;
-			pfx = sched ? "debug3: sched: " : "debug3: ";
-			break;
-
-		case LOG_LEVEL_DEBUG4:
-			priority = LOG_DEBUG;
-			pfx = "debug4: ";
-			break;
-
-		case LOG_LEVEL_DEBUG5:
-			priority = LOG_DEBUG;
-			pfx = "debug5: ";
-			break;
-
-		default:
-			priority = LOG_ERR;
-			pfx = "internal error: ";
-			break;
-		}
-
-	}
+	if (log->opt.prefix_level || (log->opt.syslog_level > level))
+		pfx = _log_level_pfx(level, sched, spank, &priority);
 
 	if (!buf) {
 		/* format the basic message,
@@ -1276,9 +1680,11 @@ static void _log_msg(log_level_t level, bool sched, bool spank, const char *fmt,
 
 	if ((level <= log->opt.logfile_level) && (log->logfp != NULL)) {
 
-		xlogfmtcat(&msgbuf, "[%M] %s%s%s", log->fpfx, pfx, buf);
-		_log_printf(log, log->fbuf, log->logfp, "%s\n", msgbuf);
-		fflush(log->logfp);
+		xlogfmtcat(&msgbuf, "[%M] %s%s%s\n", log->fpfx, pfx, buf);
+		if (!_async_write(log, level, &msgbuf)) {
+			_log_printf(log, log->fbuf, log->logfp, "%s", msgbuf);
+			fflush(log->logfp);
+		}
 
 		xfree(msgbuf);
 	}
@@ -1328,7 +1734,9 @@ void
 log_flush()
 {
 	slurm_mutex_lock(&log_lock);
+	_async_drain();
 	_log_flush(log);
+	_async_fast_start();
 	slurm_mutex_unlock(&log_lock);
 }
 
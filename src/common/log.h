@@ -100,6 +100,7 @@ typedef struct {
 	log_level_t logfile_level;  /* max level to log to logfile           */
 	bool prefix_level;          /* prefix level (e.g. "debug: ") if true */
 	bool buffered;              /* use internal buffer to never block    */
+	bool async;                 /* write logfile from a separate thread  */
 } 	log_options_t;
 
 extern char *slurm_prog_name;
@@ -218,7 +219,8 @@ bool log_has_data(void);
 
 /*
  * log_flush() attempts to flush all data in the internal
- * log buffer to the appropriate output stream.
+ * log buffer to the appropriate output stream, and waits for
+ * the asynchronous log writer to write out everything queued.
  */
 void log_flush(void);
 
@@ -208,6 +208,7 @@ typedef struct slurm_acct_storage_ops {
 	int (*get_data)            (void *db_conn, acct_storage_info_t dinfo,
 				    void *data);
 	int (*shutdown)            (void *db_conn);
+	List (*get_updates)        (void *db_conn, uint64_t *change_id);
 } slurm_acct_storage_ops_t;
 /*
  * Must be synchronized with slurm_acct_storage_ops_t above.
@@ -286,6 +287,7 @@ static const char *syms[] = {
 	"acct_storage_p_clear_stats",
 	"acct_storage_p_get_data",
 	"acct_storage_p_shutdown",
+	"acct_storage_p_get_updates",
 };
 
 static slurm_acct_storage_ops_t ops;
@@ -1065,6 +1067,13 @@ extern int acct_storage_g_clear_stats(void *db_conn)
 	return (*(ops.clear_stats))(db_conn);
 }
 
+extern List acct_storage_g_get_updates(void *db_conn, uint64_t *change_id)
+{
+	if (slurm_acct_storage_init() < 0)
+		return NULL;
+	return (*(ops.get_updates))(db_conn, change_id);
+}
+
 /*
  * Get generic data.
  * RET: SLURM_SUCCESS on success SLURM_ERROR else
@@ -572,6 +572,15 @@ extern int acct_storage_g_get_data(void *db_conn,  acct_storage_info_t dinfo,
  */
 extern int acct_storage_g_clear_stats(void *db_conn);
 
+/*
+ * Get the association updates made after a change.
+ * IN/OUT change_id - last change known, 0 to only get the current one,
+ *                    set to the last change returned
+ * RET: List of slurmdb_update_object_t *'s, NULL if the changes are no
+ *      longer known and the lists have to be read again
+ */
+extern List acct_storage_g_get_updates(void *db_conn, uint64_t *change_id);
+
 /*
  * Shutdown database server.
  * RET: SLURM_SUCCESS on success SLURM_ERROR else
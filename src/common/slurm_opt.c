@@ -40,6 +40,7 @@
 #include <sys/param.h>
 
 #include "src/common/cpu_frequency.h"
+#include "src/common/io_hdr.h"
 #include "src/common/log.h"
 #include "src/common/optz.h"
 #include "src/common/parse_time.h"
@@ -2207,6 +2208,59 @@ static slurm_cli_opt_t slurm_opt_interactive = {
 	.reset_func = arg_reset_interactive,
 };
 
+static int arg_set_io_aggregate(slurm_opt_t *opt, const char *arg)
+{
+	int window = IO_AGGREGATE_DEFAULT_WINDOW;
+
+	if (!opt->sbatch_opt && !opt->srun_opt)
+		return SLURM_ERROR;
+
+	if (arg) {
+		window = parse_int("--io-aggregate", arg, false);
+		if (window < 0) {
+			error("Invalid --io-aggregate specification");
+			exit(-1);
+		}
+		if (window > IO_AGGREGATE_MAX_WINDOW) {
+			info("--io-aggregate window reduced to %d msec",
+			     IO_AGGREGATE_MAX_WINDOW);
+			window = IO_AGGREGATE_MAX_WINDOW;
+		}
+	}
+
+	if (opt->sbatch_opt)
+		opt->sbatch_opt->io_aggregate = window;
+	if (opt->srun_opt)
+		opt->srun_opt->io_aggregate = window;
+
+	return SLURM_SUCCESS;
+}
+static char *arg_get_io_aggregate(slurm_opt_t *opt)
+{
+	if (opt->sbatch_opt)
+		return xstrdup_printf("%d", opt->sbatch_opt->io_aggregate);
+	if (opt->srun_opt)
+		return xstrdup_printf("%d", opt->srun_opt->io_aggregate);
+
+	return xstrdup("invalid-context");
+}
+static void arg_reset_io_aggregate(slurm_opt_t *opt)
+{
+	if (opt->sbatch_opt)
+		opt->sbatch_opt->io_aggregate = 0;
+	if (opt->srun_opt)
+		opt->srun_opt->io_aggregate = 0;
+}
+static slurm_cli_opt_t slurm_opt_io_aggregate = {
+	.name = "io-aggregate",
+	.has_arg = optional_argument,
+	.val = LONG_OPT_IO_AGGREGATE,
+	.set_func_sbatch = arg_set_io_aggregate,
+	.set_func_srun = arg_set_io_aggregate,
+	.get_func = arg_get_io_aggregate,
+	.reset_func = arg_reset_io_aggregate,
+};
+
 static int arg_set_jobid(slurm_opt_t *opt, const char *arg)
 {
 	if (!opt->srun_opt)
@@ -4957,6 +5011,7 @@ static const slurm_cli_opt_t *common_options[] = {
 	&slurm_opt_immediate,
 	&slurm_opt_input,
 	&slurm_opt_interactive,
+	&slurm_opt_io_aggregate,
 	&slurm_opt_jobid,
 	&slurm_opt_job_name,
 	&slurm_opt_kill_command,
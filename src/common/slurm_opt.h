@@ -111,6 +111,7 @@ enum {
 	LONG_OPT_HINT,
 	LONG_OPT_IGNORE_PBS,
 	LONG_OPT_INTERACTIVE,
+	LONG_OPT_IO_AGGREGATE,
 	LONG_OPT_JOBID,
 	LONG_OPT_KILL_INV_DEP,
 	LONG_OPT_LAUNCH_CMD,
@@ -206,6 +207,7 @@ typedef struct {
 	char *batch_features;		/* --batch			*/
 	char *export_file;		/* --export-file=file		*/
 	bool ignore_pbs;		/* --ignore-pbs			*/
+	int io_aggregate;		/* --io-aggregate[=msec]	*/
 	int minsockets;			/* --minsockets=n		*/
 	int mincores;			/* --mincores=n			*/
 	int minthreads;			/* --minthreads=n		*/
@@ -246,6 +248,7 @@ typedef struct {
 	bool exact;			/* --exact			*/
 	bool exclusive;			/* --exclusive			*/
 	bool interactive;		/* --interactive		*/
+	int io_aggregate;		/* --io-aggregate[=msec]	*/
 	uint32_t jobid;			/* --jobid			*/
 	int32_t kill_bad_exit;		/* --kill-on-bad-exit		*/
 	bool labelio;			/* --label-output		*/
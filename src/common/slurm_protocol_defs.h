@@ -1348,6 +1348,7 @@ typedef struct {
 \*****************************************************************************/
 
 typedef struct {
+	uint64_t change_id; /* slurmdbd change of update_list, 0 if none */
 	List update_list; /* of type slurmdb_update_object_t *'s */
 	uint16_t rpc_version;
 } accounting_update_msg_t;
@@ -10366,7 +10366,22 @@ static void _pack_accounting_update_msg(accounting_update_msg_t *msg,
 	ListIterator itr = NULL;
 	slurmdb_update_object_t *rec = NULL;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		if (msg->update_list)
+			count = list_count(msg->update_list);
+
+		pack32(count, buffer);
+
+		if (count) {
+			itr = list_iterator_create(msg->update_list);
+			while ((rec = list_next(itr))) {
+				slurmdb_pack_update_object(
+					rec, protocol_version, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+		pack64(msg->change_id, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		if (msg->update_list)
 			count = list_count(msg->update_list);
 
@@ -10395,7 +10410,21 @@ static int _unpack_accounting_update_msg(accounting_update_msg_t **msg,
 
 	*msg = msg_ptr;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		msg_ptr->update_list = list_create(
+			slurmdb_destroy_update_object);
+		for (i = 0; i < count; i++) {
+			if ((slurmdb_unpack_update_object(
+				     &rec, protocol_version, buffer))
+			    == SLURM_ERROR)
+				goto unpack_error;
+			list_append(msg_ptr->update_list, rec);
+		}
+		safe_unpack64(&msg_ptr->change_id, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		safe_unpack32(&count, buffer);
 		if (count > NO_VAL)
 			goto unpack_error;
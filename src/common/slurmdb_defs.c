@@ -715,6 +715,7 @@ extern void slurmdb_destroy_assoc_usage(void *object)
 		FREE_NULL_LIST(usage->children_list);
 		FREE_NULL_BITMAP(usage->grp_node_bitmap);
 		xfree(usage->grp_node_job_cnt);
+		xfree(usage->grp_tres_avail);
 		xfree(usage->grp_used_tres_run_secs);
 		xfree(usage->grp_used_tres);
 		xfree(usage->usage_tres_raw);
@@ -1219,6 +1220,7 @@ extern void slurmdb_destroy_job_cond(void *object)
 		FREE_NULL_LIST(job_cond->associd_list);
 		FREE_NULL_LIST(job_cond->cluster_list);
 		FREE_NULL_LIST(job_cond->constraint_list);
+		xfree(job_cond->cursor_cluster);
 		FREE_NULL_LIST(job_cond->groupid_list);
 		FREE_NULL_LIST(job_cond->jobname_list);
 		FREE_NULL_LIST(job_cond->partition_list);
@@ -3003,13 +3005,15 @@ end_it:
 /*
  * send_accounting_update - send update to controller of cluster
  * IN update_list: updates to send
+ * IN change_id: slurmdbd change id of update_list, 0 if none
  * IN cluster: name of cluster
  * IN host: control host of cluster
  * IN port: control port of cluster
  * IN rpc_version: rpc version of cluster
  * RET:  error code
  */
-extern int slurmdb_send_accounting_update(List update_list, char *cluster,
+extern int slurmdb_send_accounting_update(List update_list,
+					  uint64_t change_id, char *cluster,
 					  char *host, uint16_t port,
 					  uint16_t rpc_version)
 {
@@ -3025,6 +3029,7 @@ extern int slurmdb_send_accounting_update(List update_list, char *cluster,
 	memset(&msg, 0, sizeof(accounting_update_msg_t));
 	msg.rpc_version = rpc_version;
 	msg.update_list = update_list;
+	msg.change_id = change_id;
 
 	debug("sending updates to %s at %s(%hu) ver %hu",
 	      cluster, host, port, rpc_version);
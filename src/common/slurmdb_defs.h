@@ -175,7 +175,8 @@ extern char *slurmdb_purge_string(uint32_t purge, char *string, int len,
 				  bool with_archive);
 extern int slurmdb_addto_qos_char_list(List char_list, List qos_list,
 				       char *names, int option);
-extern int slurmdb_send_accounting_update(List update_list, char *cluster,
+extern int slurmdb_send_accounting_update(List update_list,
+					  uint64_t change_id, char *cluster,
 					  char *host, uint16_t port,
 					  uint16_t rpc_version);
 extern slurmdb_report_cluster_rec_t *slurmdb_cluster_rec_2_report(
@@ -3680,7 +3680,84 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 {
 	slurmdb_job_cond_t *object = (slurmdb_job_cond_t *)in;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		if (!object) {
+			pack32(NO_VAL, buffer);	/* count(acct_list) */
+			pack32(NO_VAL, buffer);	/* count(associd_list) */
+			pack32(0, buffer);	/* chunk_size */
+			pack32(NO_VAL, buffer);	/* count(cluster_list) */
+			pack32(NO_VAL, buffer);	/* count(constraint_list) */
+			pack32(0, buffer);	/* cpus_max */
+			pack32(0, buffer);	/* cpus_min */
+			packnull(buffer);	/* cursor_cluster */
+			pack32(0, buffer);	/* cursor_jobid */
+			pack32(SLURMDB_JOB_FLAG_NOTSET, buffer); /* db_flags */
+			pack32(0, buffer);	/* exitcode */
+			pack32(0, buffer);	/* job cond flags */
+			pack32(NO_VAL, buffer);	/* count(format_list) */
+			pack32(NO_VAL, buffer);	/* count(groupid_list) */
+			pack32(NO_VAL, buffer);	/* count(jobname_list) */
+			pack32(0, buffer);	/* nodes_max */
+			pack32(0, buffer);	/* nodes_min */
+			pack32(NO_VAL, buffer);	/* count(partition_list) */
+			pack32(NO_VAL, buffer);	/* count(qos_list) */
+			pack32(NO_VAL, buffer);	/* count(reason_list) */
+			pack32(NO_VAL, buffer);	/* count(resv_list) */
+			pack32(NO_VAL, buffer);	/* count(resvid_list) */
+			pack32(NO_VAL, buffer);	/* count(step_list) */
+			pack32(NO_VAL, buffer);	/* count(state_list) */
+			pack32(0, buffer);	/* timelimit_max */
+			pack32(0, buffer);	/* timelimit_min */
+			pack_time(0, buffer);	/* usage_end */
+			pack_time(0, buffer);	/* usage_start */
+			packnull(buffer);	/* used_nodes */
+			pack32(NO_VAL, buffer);	/* count(userid_list) */
+			pack32(NO_VAL, buffer);	/* count(wckey_list) */
+			return;
+		}
+
+		_pack_list_of_str(object->acct_list, buffer);
+		_pack_list_of_str(object->associd_list, buffer);
+		pack32(object->chunk_size, buffer);
+		_pack_list_of_str(object->cluster_list, buffer);
+		_pack_list_of_str(object->constraint_list, buffer);
+
+		pack32(object->cpus_max, buffer);
+		pack32(object->cpus_min, buffer);
+		packstr(object->cursor_cluster, buffer);
+		pack32(object->cursor_jobid, buffer);
+		pack32(object->db_flags, buffer);
+		pack32((uint32_t)object->exitcode, buffer);
+		pack32(object->flags, buffer);
+
+		_pack_list_of_str(object->format_list, buffer);
+		_pack_list_of_str(object->groupid_list, buffer);
+		_pack_list_of_str(object->jobname_list, buffer);
+
+		pack32(object->nodes_max, buffer);
+		pack32(object->nodes_min, buffer);
+
+		_pack_list_of_str(object->partition_list, buffer);
+		_pack_list_of_str(object->qos_list, buffer);
+		_pack_list_of_str(object->reason_list, buffer);
+		_pack_list_of_str(object->resv_list, buffer);
+		_pack_list_of_str(object->resvid_list, buffer);
+
+		slurm_pack_list(object->step_list, slurm_pack_selected_step,
+				buffer, protocol_version);
+
+		_pack_list_of_str(object->state_list, buffer);
+
+		pack32(object->timelimit_max, buffer);
+		pack32(object->timelimit_min, buffer);
+		pack_time(object->usage_end, buffer);
+		pack_time(object->usage_start, buffer);
+
+		packstr(object->used_nodes, buffer);
+
+		_pack_list_of_str(object->userid_list, buffer);
+		_pack_list_of_str(object->wckey_list, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		if (!object) {
 			pack32(NO_VAL, buffer);	/* count(acct_list) */
 			pack32(NO_VAL, buffer);	/* count(associd_list) */
@@ -3766,7 +3843,237 @@ extern int slurmdb_unpack_job_cond(void **object, uint16_t protocol_version,
 
 	*object = object_ptr;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->acct_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->acct_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->associd_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->associd_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&object_ptr->chunk_size, buffer);
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->cluster_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->cluster_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count && (count != NO_VAL)) {
+			object_ptr->constraint_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->constraint_list,
+					    tmp_info);
+			}
+		}
+
+		safe_unpack32(&object_ptr->cpus_max, buffer);
+		safe_unpack32(&object_ptr->cpus_min, buffer);
+		safe_unpackstr_xmalloc(&object_ptr->cursor_cluster,
+				       &uint32_tmp, buffer);
+		safe_unpack32(&object_ptr->cursor_jobid, buffer);
+		safe_unpack32(&object_ptr->db_flags, buffer);
+		safe_unpack32(&uint32_tmp, buffer);
+		object_ptr->exitcode = (int32_t)uint32_tmp;
+		safe_unpack32(&object_ptr->flags, buffer);
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count && (count != NO_VAL)) {
+			object_ptr->format_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->format_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->groupid_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->groupid_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->jobname_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->jobname_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&object_ptr->nodes_max, buffer);
+		safe_unpack32(&object_ptr->nodes_min, buffer);
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->partition_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->partition_list,
+					    tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->qos_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->qos_list,
+					    tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count != NO_VAL) {
+			object_ptr->reason_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->reason_list,
+					    tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count != NO_VAL) {
+			object_ptr->resv_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->resv_list,
+					    tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->resvid_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->resvid_list,
+					    tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->step_list =
+				list_create(slurm_destroy_selected_step);
+			for (i = 0; i < count; i++) {
+				if (slurm_unpack_selected_step(
+					    &job, protocol_version, buffer)
+				    != SLURM_SUCCESS) {
+					error("unpacking selected step");
+					goto unpack_error;
+				}
+				/* There is no such thing as jobid 0,
+				 * if we process it the database will
+				 * return all jobs. */
+				if (!job->step_id.job_id)
+					slurm_destroy_selected_step(job);
+				else
+					list_append(object_ptr->step_list, job);
+			}
+			if (!list_count(object_ptr->step_list))
+				FREE_NULL_LIST(object_ptr->step_list);
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->state_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->state_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&object_ptr->timelimit_max, buffer);
+		safe_unpack32(&object_ptr->timelimit_min, buffer);
+		safe_unpack_time(&object_ptr->usage_end, buffer);
+		safe_unpack_time(&object_ptr->usage_start, buffer);
+
+		safe_unpackstr_xmalloc(&object_ptr->used_nodes,
+				       &uint32_tmp, buffer);
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->userid_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->userid_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->wckey_list = list_create(xfree_ptr);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->wckey_list, tmp_info);
+			}
+		}
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		safe_unpack32(&count, buffer);
 		if (count > NO_VAL)
 			goto unpack_error;
@@ -5505,7 +5812,28 @@ extern void slurmdb_pack_stats_msg(void *object, uint16_t protocol_version,
 {
 	slurmdb_stats_rec_t *stats_ptr = (slurmdb_stats_rec_t *) object;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		slurmdb_pack_rollup_stats(stats_ptr->dbd_rollup_stats,
+					  protocol_version, buffer);
+		slurm_pack_list(stats_ptr->rollup_stats,
+				slurmdb_pack_rollup_stats,
+				buffer, protocol_version);
+
+		slurm_pack_list(stats_ptr->rpc_list,
+				slurmdb_pack_rpc_obj,
+				buffer, protocol_version);
+
+		pack_time(stats_ptr->time_start, buffer);
+
+		slurm_pack_list(stats_ptr->user_list,
+				slurmdb_pack_rpc_obj,
+				buffer, protocol_version);
+
+		pack32(stats_ptr->mult_msg_cnt, buffer);
+		pack64(stats_ptr->mult_msg_recs, buffer);
+		pack64(stats_ptr->mult_msg_time_max, buffer);
+		pack64(stats_ptr->mult_msg_time_total, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		slurmdb_pack_rollup_stats(stats_ptr->dbd_rollup_stats,
 					  protocol_version, buffer);
 		slurm_pack_list(stats_ptr->rollup_stats,
@@ -5534,7 +5862,41 @@ extern int slurmdb_unpack_stats_msg(void **object, uint16_t protocol_version,
 		xmalloc(sizeof(slurmdb_stats_rec_t));
 
 	*object = stats_ptr;
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		/* Rollup statistics */
+		if (slurmdb_unpack_rollup_stats(
+			    (void **)&stats_ptr->dbd_rollup_stats,
+			    protocol_version, buffer)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
+		if (slurm_unpack_list(&stats_ptr->rollup_stats,
+				      slurmdb_unpack_rollup_stats,
+				      slurmdb_destroy_rollup_stats,
+				      buffer, protocol_version)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
+
+		if (slurm_unpack_list(&stats_ptr->rpc_list,
+				      slurmdb_unpack_rpc_obj,
+				      slurmdb_destroy_rpc_obj,
+				      buffer, protocol_version)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
+
+		safe_unpack_time(&stats_ptr->time_start, buffer);
+
+		if (slurm_unpack_list(&stats_ptr->user_list,
+				      slurmdb_unpack_rpc_obj,
+				      slurmdb_destroy_rpc_obj,
+				      buffer, protocol_version)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
+
+		safe_unpack32(&stats_ptr->mult_msg_cnt, buffer);
+		safe_unpack64(&stats_ptr->mult_msg_recs, buffer);
+		safe_unpack64(&stats_ptr->mult_msg_time_max, buffer);
+		safe_unpack64(&stats_ptr->mult_msg_time_total, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		/* Rollup statistics */
 		if (slurmdb_unpack_rollup_stats(
 			    (void **)&stats_ptr->dbd_rollup_stats,
@@ -780,6 +780,18 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Shutdown daemon";
 		break;
+	case DBD_GET_UPDATES:
+		if (get_enum) {
+			return "DBD_GET_UPDATES";
+		} else
+			return "Get Updates";
+		break;
+	case DBD_GOT_UPDATES:
+		if (get_enum) {
+			return "DBD_GOT_UPDATES";
+		} else
+			return "Got Updates";
+		break;
 	case SLURM_PERSIST_INIT:
 		if (get_enum) {
 			return "SLURM_PERSIST_INIT";
@@ -943,6 +955,10 @@ extern void slurmdbd_free_msg(persist_msg_t *msg)
 	case DBD_MODIFY_RESV:
 		slurmdbd_free_rec_msg(msg->data, msg->msg_type);
 		break;
+	case DBD_GET_UPDATES:
+	case DBD_GOT_UPDATES:
+		slurmdbd_free_updates_msg(msg->data);
+		break;
 	case DBD_GET_CONFIG:
 	case DBD_RECONFIG:
 	case DBD_GET_STATS:
@@ -1107,6 +1123,14 @@ extern void slurmdbd_free_list_msg(dbd_list_msg_t *msg)
 	}
 }
 
+extern void slurmdbd_free_updates_msg(dbd_updates_msg_t *msg)
+{
+	if (msg) {
+		FREE_NULL_LIST(msg->update_list);
+		xfree(msg);
+	}
+}
+
 extern void slurmdbd_free_modify_msg(dbd_modify_msg_t *msg,
 				     slurmdbd_msg_type_t type)
 {
@@ -152,6 +152,8 @@ typedef enum {
 	DBD_GOT_FEDERATIONS,	/* Response to DBD_GET_FEDERATIONS 	*/
 	DBD_MODIFY_FEDERATIONS, /* Modify existing federation 		*/
 	DBD_REMOVE_FEDERATIONS, /* Removing existing federation 	*/
+	DBD_GET_UPDATES,	/* Get association updates since a change */
+	DBD_GOT_UPDATES,	/* Response to DBD_GET_UPDATES		*/
 
 	SLURM_PERSIST_INIT = 6500, /* So we don't use the
 				    * REQUEST_PERSIST_INIT also used here.
@@ -311,8 +313,17 @@ typedef struct {
 	uint32_t return_code;   /* If there was an error and a list of
 				 * them this is the type of error it
 				 * was */
+	uint32_t seq;		/* DBD_SEND/GOT_MULT_MSG sequence number,
+				 * 0 if not used */
 } dbd_list_msg_t;
 
+typedef struct {
+	uint64_t change_id;	/* DBD_GET_UPDATES: last change known, 0 for
+				 * the current one without updates
+				 * DBD_GOT_UPDATES: last change in update_list */
+	List update_list;	/* list of slurmdb_update_object_t *'s */
+} dbd_updates_msg_t;
+
 typedef struct {
 	void *cond;
 	void *rec;
@@ -411,6 +422,7 @@ extern void slurmdbd_free_register_ctld_msg(dbd_register_ctld_msg_t *msg);
 extern void slurmdbd_free_roll_usage_msg(dbd_roll_usage_msg_t *msg);
 extern void slurmdbd_free_step_complete_msg(dbd_step_comp_msg_t *msg);
 extern void slurmdbd_free_step_start_msg(dbd_step_start_msg_t *msg);
+extern void slurmdbd_free_updates_msg(dbd_updates_msg_t *msg);
 extern void slurmdbd_free_usage_msg(dbd_usage_msg_t *msg,
 				    slurmdbd_msg_type_t type);
 
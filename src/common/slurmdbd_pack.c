@@ -1311,6 +1311,10 @@ extern void slurmdbd_pack_list_msg(dbd_list_msg_t *msg, uint16_t rpc_version,
 		msg->return_code = rc;
 
 	pack32(msg->return_code, buffer);
+
+	if ((rpc_version >= SLURM_21_08_PROTOCOL_VERSION) &&
+	    ((type == DBD_SEND_MULT_MSG) || (type == DBD_GOT_MULT_MSG)))
+		pack32(msg->seq, buffer);
 }
 
 extern int slurmdbd_unpack_list_msg(dbd_list_msg_t **msg, uint16_t rpc_version,
@@ -1419,6 +1423,10 @@ extern int slurmdbd_unpack_list_msg(dbd_list_msg_t **msg, uint16_t rpc_version,
 
 	safe_unpack32(&msg_ptr->return_code, buffer);
 
+	if ((rpc_version >= SLURM_21_08_PROTOCOL_VERSION) &&
+	    ((type == DBD_SEND_MULT_MSG) || (type == DBD_GOT_MULT_MSG)))
+		safe_unpack32(&msg_ptr->seq, buffer);
+
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -1427,6 +1435,66 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+extern void slurmdbd_pack_updates_msg(dbd_updates_msg_t *msg,
+				      uint16_t rpc_version, buf_t *buffer)
+{
+	uint32_t count = 0;
+	ListIterator itr;
+	slurmdb_update_object_t *object;
+
+	if (rpc_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		pack64(msg->change_id, buffer);
+		if (msg->update_list)
+			count = list_count(msg->update_list);
+		pack32(count, buffer);
+		if (count) {
+			itr = list_iterator_create(msg->update_list);
+			while ((object = list_next(itr)))
+				slurmdb_pack_update_object(
+					object, rpc_version, buffer);
+			list_iterator_destroy(itr);
+		}
+	}
+}
+
+extern int slurmdbd_unpack_updates_msg(dbd_updates_msg_t **msg,
+				       uint16_t rpc_version, buf_t *buffer)
+{
+	uint32_t count = 0;
+	int i;
+	dbd_updates_msg_t *msg_ptr = xmalloc(sizeof(dbd_updates_msg_t));
+	slurmdb_update_object_t *object = NULL;
+
+	*msg = msg_ptr;
+
+	if (rpc_version >= SLURM_21_08_PROTOCOL_VERSION) {
+		safe_unpack64(&msg_ptr->change_id, buffer);
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL)
+			goto unpack_error;
+		msg_ptr->update_list =
+			list_create(slurmdb_destroy_update_object);
+		for (i = 0; i < count; i++) {
+			if (slurmdb_unpack_update_object(
+				    &object, rpc_version, buffer) !=
+			    SLURM_SUCCESS)
+				goto unpack_error;
+			list_append(msg_ptr->update_list, object);
+		}
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, rpc_version);
+		goto unpack_error;
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurmdbd_free_updates_msg(msg_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 extern buf_t *pack_slurmdbd_msg(persist_msg_t *req, uint16_t rpc_version)
 {
 	buf_t *buffer;
@@ -1600,6 +1668,11 @@ extern buf_t *pack_slurmdbd_msg(persist_msg_t *req, uint16_t rpc_version)
 	case DBD_GET_CONFIG:
 		packstr((char *)req->data, buffer);
 		break;
+	case DBD_GET_UPDATES:
+	case DBD_GOT_UPDATES:
+		slurmdbd_pack_updates_msg(
+			(dbd_updates_msg_t *)req->data, rpc_version, buffer);
+		break;
 	case DBD_RECONFIG:
 	case DBD_GET_STATS:
 	case DBD_CLEAR_STATS:
@@ -1807,6 +1880,11 @@ extern int unpack_slurmdbd_msg(persist_msg_t *resp, uint16_t rpc_version,
 		rc = _unpack_config_name(
 			(char **)&resp->data, rpc_version, buffer);
 		break;
+	case DBD_GET_UPDATES:
+	case DBD_GOT_UPDATES:
+		rc = slurmdbd_unpack_updates_msg(
+			(dbd_updates_msg_t **)&resp->data, rpc_version, buffer);
+		break;
 	case DBD_RECONFIG:
 	case DBD_GET_STATS:
 	case DBD_CLEAR_STATS:
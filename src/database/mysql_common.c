@@ -202,6 +202,84 @@ end_it:
 	return rc;
 }
 
+/* NOTE: Ensure that mysql_conn->lock is set on function entry */
+static void _batch_clear(mysql_conn_t *mysql_conn)
+{
+	xfree(mysql_conn->batch_insert);
+	xfree(mysql_conn->batch_update);
+	if (mysql_conn->batch_rows)
+		list_flush(mysql_conn->batch_rows);
+}
+
+/* NOTE: Ensure that mysql_conn->lock is set on function entry */
+static char *_batch_query(mysql_conn_t *mysql_conn, char *row)
+{
+	char *query = xstrdup(mysql_conn->batch_insert);
+	char *sep = " ";
+	ListIterator itr;
+
+	if (row) {
+		xstrfmtcat(query, " %s", row);
+	} else {
+		itr = list_iterator_create(mysql_conn->batch_rows);
+		while ((row = list_next(itr))) {
+			xstrfmtcat(query, "%s%s", sep, row);
+			sep = ", ";
+		}
+		list_iterator_destroy(itr);
+	}
+	if (mysql_conn->batch_update)
+		xstrfmtcat(query, " %s", mysql_conn->batch_update);
+
+	return query;
+}
+
+/*
+ * A failure is also kept in batch_rc to fail the next mysql_db_commit(), so
+ * callers that can't return it may ignore it.
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static int _batch_flush(mysql_conn_t *mysql_conn)
+{
+	char *query, *row;
+	ListIterator itr;
+	int rc, cnt;
+
+	if (!mysql_conn->batch_rows ||
+	    !(cnt = list_count(mysql_conn->batch_rows)))
+		return SLURM_SUCCESS;
+
+	query = _batch_query(mysql_conn, NULL);
+	debug3("%s: sending %d rows in one statement", __func__, cnt);
+	rc = _mysql_query_internal(mysql_conn->db_conn, query);
+	xfree(query);
+
+	if (rc && (cnt > 1)) {
+		error("%s: insert of %d rows failed, sending them one by one",
+		      __func__, cnt);
+		rc = SLURM_SUCCESS;
+		itr = list_iterator_create(mysql_conn->batch_rows);
+		while ((row = list_next(itr))) {
+			query = _batch_query(mysql_conn, row);
+			if (_mysql_query_internal(mysql_conn->db_conn, query))
+				rc = SLURM_ERROR;
+			xfree(query);
+		}
+		list_iterator_destroy(itr);
+	}
+
+	_batch_clear(mysql_conn);
+
+	/*
+	 * The rows were queued as already stored, the transaction holding
+	 * them must not be committed without them.
+	 */
+	if (rc && !mysql_conn->batch_rc)
+		mysql_conn->batch_rc = rc;
+
+	return rc;
+}
+
 /* NOTE: Ensure that mysql_conn->lock is NOT set on function entry */
 static int _mysql_make_table_current(mysql_conn_t *mysql_conn, char *table_name,
 				     storage_field_t *fields, char *ending)
@@ -707,6 +785,9 @@ extern int destroy_mysql_conn(mysql_conn_t *mysql_conn)
 {
 	if (mysql_conn) {
 		mysql_db_close_db_connection(mysql_conn);
+		xfree(mysql_conn->batch_insert);
+		FREE_NULL_LIST(mysql_conn->batch_rows);
+		xfree(mysql_conn->batch_update);
 		xfree(mysql_conn->pre_commit_query);
 		xfree(mysql_conn->cluster_name);
 		slurm_mutex_destroy(&mysql_conn->lock);
@@ -848,6 +929,8 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 extern int mysql_db_close_db_connection(mysql_conn_t *mysql_conn)
 {
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_clear(mysql_conn);
+	mysql_conn->batch_rc = SLURM_SUCCESS;
 	if (mysql_conn && mysql_conn->db_conn) {
 		if (mysql_thread_safe())
 			mysql_thread_end();
@@ -880,7 +963,9 @@ extern int mysql_db_query(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
-	rc = _mysql_query_internal(mysql_conn->db_conn, query);
+	rc = _batch_flush(mysql_conn);
+	if (_mysql_query_internal(mysql_conn->db_conn, query))
+		rc = SLURM_ERROR;
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
 }
@@ -898,6 +983,7 @@ extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
+	(void) _batch_flush(mysql_conn);
 	if (!(rc = _mysql_query_internal(mysql_conn->db_conn, query)))
 		rc = mysql_affected_rows(mysql_conn->db_conn);
 	slurm_mutex_unlock(&mysql_conn->lock);
@@ -933,9 +1019,20 @@ extern int mysql_db_commit(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	(void) _batch_flush(mysql_conn);
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
-	if (mysql_commit(mysql_conn->db_conn)) {
+	if (mysql_conn->batch_rc) {
+		/* Have the sender of the queued rows send them again */
+		error("%s: queued rows could not be inserted, rolling back",
+		      __func__);
+		if (mysql_rollback(mysql_conn->db_conn))
+			error("mysql_rollback failed: %d %s",
+			      mysql_errno(mysql_conn->db_conn),
+			      mysql_error(mysql_conn->db_conn));
+		rc = mysql_conn->batch_rc;
+		mysql_conn->batch_rc = SLURM_SUCCESS;
+	} else if (mysql_commit(mysql_conn->db_conn)) {
 		error("mysql_commit failed: %d %s",
 		      mysql_errno(mysql_conn->db_conn),
 		      mysql_error(mysql_conn->db_conn));
@@ -954,6 +1051,8 @@ extern int mysql_db_rollback(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	_batch_clear(mysql_conn);
+	mysql_conn->batch_rc = SLURM_SUCCESS;
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_rollback(mysql_conn->db_conn)) {
@@ -980,6 +1079,7 @@ extern MYSQL_RES *mysql_db_query_ret(mysql_conn_t *mysql_conn,
 	MYSQL_RES *result = NULL;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	(void) _batch_flush(mysql_conn);
 	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
 		if (mysql_errno(mysql_conn->db_conn) == ER_NO_SUCH_TABLE)
 			goto fini;
@@ -1009,6 +1109,7 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query)
 	int rc = SLURM_SUCCESS;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	(void) _batch_flush(mysql_conn);
 	if ((rc = _mysql_query_internal(
 		     mysql_conn->db_conn, query)) != SLURM_ERROR)
 		rc = _clear_results(mysql_conn->db_conn);
@@ -1021,6 +1122,7 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 	uint64_t new_id = 0;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	(void) _batch_flush(mysql_conn);
 	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
 		new_id = mysql_insert_id(mysql_conn->db_conn);
 		if (!new_id) {
@@ -1034,6 +1136,36 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 
 }
 
+extern int mysql_db_batch_insert(mysql_conn_t *mysql_conn, char *insert,
+				 char *row, char *update)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!mysql_conn || !mysql_conn->db_conn) {
+		fatal("You haven't inited this storage yet.");
+		return 0;	/* For CLANG false positive */
+	}
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	if (xstrcmp(mysql_conn->batch_insert, insert) ||
+	    xstrcmp(mysql_conn->batch_update, update))
+		(void) _batch_flush(mysql_conn);
+
+	if (!mysql_conn->batch_insert) {
+		mysql_conn->batch_insert = xstrdup(insert);
+		mysql_conn->batch_update = xstrdup(update);
+	}
+	if (!mysql_conn->batch_rows)
+		mysql_conn->batch_rows = list_create(xfree_ptr);
+	list_append(mysql_conn->batch_rows, xstrdup(row));
+
+	if (list_count(mysql_conn->batch_rows) >= MYSQL_BATCH_MAX_ROWS)
+		rc = _batch_flush(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+
+	return rc;
+}
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending)
 {
@@ -58,7 +58,14 @@ typedef enum {
 	SLURM_MYSQL_PLUGIN_JC, /* jobcomp */
 } slurm_mysql_plugin_type_t;
 
+/* Most rows sent in one multi-row insert by mysql_db_batch_insert() */
+#define MYSQL_BATCH_MAX_ROWS 256
+
 typedef struct {
+	char *batch_insert;	/* statement the queued rows belong to */
+	List batch_rows;	/* rows queued by mysql_db_batch_insert() */
+	char *batch_update;	/* "on duplicate key update" of the rows */
+	int batch_rc;		/* failed flush, fails the next commit */
 	bool cluster_deleted;
 	char *cluster_name;
 	MYSQL *db_conn;
@@ -105,6 +112,22 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query);
 
 extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query);
 
+/*
+ * Queue a row for a multi-row insert instead of sending it right away.
+ *
+ * IN insert - statement up to and including "values"
+ * IN row - values of the row, with the parentheses
+ * IN update - "on duplicate key update" clause, referring to the row through
+ *	       VALUES() so it applies to every row of the statement, or NULL
+ *
+ * Rows queued with the same insert and update are sent as one statement
+ * before anything else is done on the connection, before a commit, or once
+ * MYSQL_BATCH_MAX_ROWS are queued. A rollback discards them. If the statement
+ * fails the rows are retried one by one so only the bad ones are lost.
+ */
+extern int mysql_db_batch_insert(mysql_conn_t *mysql_conn, char *insert,
+				 char *row, char *update);
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending);
 
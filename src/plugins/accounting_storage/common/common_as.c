@@ -36,12 +36,20 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include "config.h"
+
+#include <arpa/inet.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#if HAVE_LIBZ
+#  include <zlib.h>
+#endif
+
 #include "src/common/env.h"
 #include "src/common/slurmdbd_defs.h"
 #include "src/common/slurm_auth.h"
@@ -932,3 +940,404 @@ extern int archive_write_file(buf_t *buffer, char *cluster_name,
 
 	return rc;
 }
+
+/*
+ * Columnar archive files
+ *
+ * [magic][version]
+ * for each column: [encoding][raw size][packmem of the column data]
+ * footer: [type][usage_info][cluster][rec_cnt][column names]
+ *         [offset of each column]
+ * [offset of the footer][magic]
+ *
+ * Columns holding only integers are stored as zigzag varint deltas from the
+ * value before, everything else as varint length + 1 (0 for NULL) followed
+ * by the string.  Each column is compressed with zlib when available.
+ */
+#define ARCHIVE_COLUMNAR_MAGIC	0x53434131	/* "SCA1" */
+#define ARCHIVE_COL_INT		0x01
+#define ARCHIVE_COL_STR		0x02
+#define ARCHIVE_COL_ZLIB	0x80
+#define ARCHIVE_ZLIB_MAX_RATIO	1032	/* best compression deflate gets */
+
+typedef struct {
+	uint8_t *data;
+	uint32_t alloc;
+	uint32_t size;
+} col_data_t;
+
+static void _col_put(col_data_t *col, const void *data, uint32_t len)
+{
+	if ((col->size + len) > col->alloc) {
+		col->alloc = MAX(col->alloc * 2, col->size + len + 1024);
+		xrealloc_nz(col->data, col->alloc);
+	}
+	memcpy(col->data + col->size, data, len);
+	col->size += len;
+}
+
+static void _col_put_varint(col_data_t *col, uint64_t val)
+{
+	uint8_t byte;
+
+	do {
+		byte = val & 0x7f;
+		val >>= 7;
+		if (val)
+			byte |= 0x80;
+		_col_put(col, &byte, 1);
+	} while (val);
+}
+
+static int _col_get_varint(uint8_t *data, uint32_t size, uint32_t *pos,
+			   uint64_t *val)
+{
+	int shift = 0;
+
+	*val = 0;
+	while (*pos < size) {
+		uint8_t byte = data[(*pos)++];
+		*val |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return SLURM_SUCCESS;
+		if ((shift += 7) > 63)
+			break;
+	}
+	return SLURM_ERROR;
+}
+
+/* Only use the integer encoding if it gives back the exact same string */
+static bool _col_is_int(char *str, int64_t *val)
+{
+	char tmp[32], *end = NULL;
+
+	if (!str || !str[0])
+		return false;
+	errno = 0;
+	*val = strtoll(str, &end, 10);
+	if (errno || *end)
+		return false;
+	snprintf(tmp, sizeof(tmp), "%"PRId64, *val);
+	return !xstrcmp(tmp, str);
+}
+
+static void _pack_column(char ***rows, uint32_t rec_cnt, uint32_t col,
+			 buf_t *buffer)
+{
+	col_data_t col_data = { 0 };
+	uint8_t encoding = ARCHIVE_COL_INT;
+	int64_t val, last = 0;
+	uint32_t i;
+
+	for (i = 0; i < rec_cnt; i++) {
+		if (!_col_is_int(rows[i][col], &val)) {
+			encoding = ARCHIVE_COL_STR;
+			break;
+		}
+	}
+
+	for (i = 0; i < rec_cnt; i++) {
+		char *str = rows[i][col];
+
+		if (encoding == ARCHIVE_COL_INT) {
+			int64_t delta;
+
+			(void) _col_is_int(str, &val);
+			delta = val - last;
+			last = val;
+			_col_put_varint(&col_data,
+					((uint64_t) delta << 1) ^
+					(uint64_t) (delta >> 63));
+		} else if (!str) {
+			_col_put_varint(&col_data, 0);
+		} else {
+			uint32_t len = strlen(str);
+			_col_put_varint(&col_data, (uint64_t) len + 1);
+			_col_put(&col_data, str, len);
+		}
+	}
+
+#if HAVE_LIBZ
+	if (col_data.size) {
+		uLongf zlen = compressBound(col_data.size);
+		char *zdata = xmalloc_nz(zlen);
+
+		if ((compress2((Bytef *) zdata, &zlen, col_data.data,
+			       col_data.size, Z_DEFAULT_COMPRESSION) == Z_OK) &&
+		    (zlen < col_data.size)) {
+			pack8(encoding | ARCHIVE_COL_ZLIB, buffer);
+			pack32(col_data.size, buffer);
+			packmem(zdata, zlen, buffer);
+			xfree(zdata);
+			xfree(col_data.data);
+			return;
+		}
+		xfree(zdata);
+	}
+#endif
+	pack8(encoding, buffer);
+	pack32(col_data.size, buffer);
+	packmem((char *) col_data.data, col_data.size, buffer);
+	xfree(col_data.data);
+}
+
+/*
+ * Unpack the data of the column at the buffer's offset, uncompressed.
+ * RET SLURM_SUCCESS or SLURM_ERROR if the column is damaged
+ */
+static int _unpack_column_data(buf_t *buffer, uint8_t *encoding,
+			       char **data_out, uint32_t *size_out)
+{
+	uint32_t raw_size, size;
+	char *data = NULL;
+
+	safe_unpack8(encoding, buffer);
+	safe_unpack32(&raw_size, buffer);
+	safe_unpackmem_xmalloc(&data, &size, buffer);
+
+	if (*encoding & ARCHIVE_COL_ZLIB) {
+#if HAVE_LIBZ
+		uLongf zlen = raw_size;
+		char *zdata;
+
+		/* Don't trust raw_size with the allocation */
+		if (((uint64_t) raw_size >
+		     ((uint64_t) size * ARCHIVE_ZLIB_MAX_RATIO)) ||
+		    (raw_size > MAX_BUF_SIZE))
+			goto unpack_error;
+		zdata = xmalloc_nz(raw_size + 1);
+		if ((uncompress((Bytef *) zdata, &zlen, (Bytef *) data, size)
+		     != Z_OK) || (zlen != raw_size)) {
+			xfree(zdata);
+			goto unpack_error;
+		}
+		xfree(data);
+		data = zdata;
+		size = raw_size;
+		*encoding &= ~ARCHIVE_COL_ZLIB;
+#else
+		error("%s: archive column is compressed with zlib which is not supported by this build",
+		      __func__);
+		goto unpack_error;
+#endif
+	}
+	if (size != raw_size)
+		goto unpack_error;
+
+	*data_out = data;
+	*size_out = size;
+	return SLURM_SUCCESS;
+
+unpack_error:
+	xfree(data);
+	return SLURM_ERROR;
+}
+
+/* Decode the unpacked data of column col into rec_cnt rows */
+static int _decode_column(uint8_t encoding, char *data, uint32_t size,
+			  char ***rows, uint32_t rec_cnt, uint32_t col)
+{
+	uint8_t *raw = (uint8_t *) data;
+	uint32_t pos = 0, i;
+	int64_t last = 0;
+	uint64_t val;
+
+	for (i = 0; i < rec_cnt; i++) {
+		if (_col_get_varint(raw, size, &pos, &val))
+			return SLURM_ERROR;
+		if (encoding == ARCHIVE_COL_INT) {
+			last += (int64_t) ((val >> 1) ^ -(val & 1));
+			rows[i][col] = xstrdup_printf("%"PRId64, last);
+		} else if (encoding == ARCHIVE_COL_STR) {
+			if (!val)
+				continue;
+			if ((val - 1) > (size - pos))
+				return SLURM_ERROR;
+			rows[i][col] = xstrndup((char *) raw + pos, val - 1);
+			pos += val - 1;
+		} else
+			return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern void archive_free_footer(archive_footer_t *footer)
+{
+	uint32_t i;
+
+	if (!footer)
+		return;
+
+	xfree(footer->cluster_name);
+	for (i = 0; i < footer->col_cnt; i++)
+		xfree(footer->col_names[i]);
+	xfree(footer->col_names);
+	footer->col_cnt = 0;
+}
+
+extern bool archive_is_columnar(char *data, uint32_t size)
+{
+	uint32_t magic;
+
+	if (!data || (size < (2 * sizeof(uint32_t))))
+		return false;
+
+	memcpy(&magic, data, sizeof(magic));
+	return (ntohl(magic) == ARCHIVE_COLUMNAR_MAGIC);
+}
+
+extern buf_t *archive_pack_columnar(char ***rows, archive_footer_t *footer)
+{
+	buf_t *buffer = init_buf(BUF_SIZE);
+	uint32_t col_cnt = footer->col_cnt, rec_cnt = footer->rec_cnt;
+	uint32_t *offsets = xcalloc(col_cnt, sizeof(uint32_t));
+	uint32_t col, footer_offset;
+
+	pack32(ARCHIVE_COLUMNAR_MAGIC, buffer);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+
+	for (col = 0; col < col_cnt; col++) {
+		offsets[col] = get_buf_offset(buffer);
+		_pack_column(rows, rec_cnt, col, buffer);
+	}
+
+	footer_offset = get_buf_offset(buffer);
+	pack16(footer->type, buffer);
+	pack32(footer->usage_info, buffer);
+	packstr(footer->cluster_name, buffer);
+	pack32(rec_cnt, buffer);
+	packstr_array(footer->col_names, col_cnt, buffer);
+	pack32_array(offsets, col_cnt, buffer);
+
+	pack32(footer_offset, buffer);
+	pack32(ARCHIVE_COLUMNAR_MAGIC, buffer);
+	xfree(offsets);
+
+	return buffer;
+}
+
+/*
+ * Unpack the footer and column offsets, leaves the buffer at the end of the
+ * footer.
+ */
+static int _unpack_columnar_footer(buf_t *buffer, archive_footer_t *footer,
+				   uint32_t **offsets)
+{
+	uint32_t footer_offset, magic, tmp32;
+	uint32_t size = size_buf(buffer);
+
+	memset(footer, 0, sizeof(archive_footer_t));
+
+	if (size < (2 * sizeof(uint32_t)))
+		return SLURM_ERROR;
+	set_buf_offset(buffer, size - (2 * sizeof(uint32_t)));
+	safe_unpack32(&footer_offset, buffer);
+	safe_unpack32(&magic, buffer);
+	if ((magic != ARCHIVE_COLUMNAR_MAGIC) || (footer_offset >= size))
+		goto unpack_error;
+
+	set_buf_offset(buffer, footer_offset);
+	safe_unpack16(&footer->type, buffer);
+	safe_unpack32(&footer->usage_info, buffer);
+	safe_unpackstr_xmalloc(&footer->cluster_name, &tmp32, buffer);
+	safe_unpack32(&footer->rec_cnt, buffer);
+	safe_unpackstr_array(&footer->col_names, &footer->col_cnt, buffer);
+	safe_unpack32_array(offsets, &tmp32, buffer);
+	if (tmp32 != footer->col_cnt)
+		goto unpack_error;
+	for (tmp32 = 0; tmp32 < footer->col_cnt; tmp32++)
+		if ((*offsets)[tmp32] >= footer_offset)
+			goto unpack_error;
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	archive_free_footer(footer);
+	return SLURM_ERROR;
+}
+
+extern int archive_unpack_columnar(buf_t *buffer, archive_footer_t *footer,
+				   char ****rows_out)
+{
+	uint32_t *offsets = NULL, *sizes = NULL, col, i;
+	uint16_t version;
+	uint8_t *encodings = NULL;
+	char ***rows, **data = NULL;
+
+	*rows_out = NULL;
+	if (_unpack_columnar_footer(buffer, footer, &offsets))
+		return SLURM_ERROR;
+
+	set_buf_offset(buffer, sizeof(uint32_t));
+	safe_unpack16(&version, buffer);
+	if (version > SLURM_PROTOCOL_VERSION) {
+		error("%s: can not read archive of version %u, need <= %u",
+		      __func__, version, SLURM_PROTOCOL_VERSION);
+		goto unpack_error;
+	}
+
+	/*
+	 * Every record takes at least one byte in each column, so the
+	 * columns must be there before rec_cnt is used to allocate anything.
+	 */
+	if (!footer->col_cnt && footer->rec_cnt)
+		goto unpack_error;
+	data = xcalloc(footer->col_cnt, sizeof(char *));
+	sizes = xcalloc(footer->col_cnt, sizeof(uint32_t));
+	encodings = xcalloc(footer->col_cnt, sizeof(uint8_t));
+	for (col = 0; col < footer->col_cnt; col++) {
+		set_buf_offset(buffer, offsets[col]);
+		if (_unpack_column_data(buffer, &encodings[col], &data[col],
+					&sizes[col]) ||
+		    (footer->rec_cnt > sizes[col]))
+			goto unpack_error;
+	}
+
+	rows = xcalloc(footer->rec_cnt + 1, sizeof(char **));
+	for (i = 0; i < footer->rec_cnt; i++)
+		rows[i] = xcalloc(footer->col_cnt, sizeof(char *));
+	*rows_out = rows;
+
+	for (col = 0; col < footer->col_cnt; col++) {
+		if (_decode_column(encodings[col], data[col], sizes[col], rows,
+				   footer->rec_cnt, col))
+			goto unpack_error;
+		xfree(data[col]);
+	}
+	xfree(data);
+	xfree(sizes);
+	xfree(encodings);
+	xfree(offsets);
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	error("%s: corrupt columnar archive", __func__);
+	archive_free_columnar_rows(*rows_out, footer);
+	*rows_out = NULL;
+	for (col = 0; data && (col < footer->col_cnt); col++)
+		xfree(data[col]);
+	xfree(data);
+	xfree(sizes);
+	xfree(encodings);
+	archive_free_footer(footer);
+	xfree(offsets);
+	return SLURM_ERROR;
+}
+
+extern void archive_free_columnar_rows(char ***rows,
+				       archive_footer_t *footer)
+{
+	uint32_t i, col;
+
+	if (!rows)
+		return;
+
+	for (i = 0; i < footer->rec_cnt; i++) {
+		for (col = 0; col < footer->col_cnt; col++)
+			xfree(rows[i][col]);
+		xfree(rows[i]);
+	}
+	xfree(rows);
+}
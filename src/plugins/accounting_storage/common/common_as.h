@@ -85,4 +85,37 @@ extern int archive_write_file(buf_t *buffer, char *cluster_name,
 			      char *arch_dir, char *arch_type,
 			      uint32_t archive_period);
 
+/* Describes the records of a columnar archive, kept at the end of the file */
+typedef struct {
+	char *cluster_name;
+	uint32_t col_cnt;
+	char **col_names;
+	uint32_t rec_cnt;
+	uint16_t type;		/* what kind of records these are */
+	uint32_t usage_info;
+} archive_footer_t;
+
+extern void archive_free_footer(archive_footer_t *footer);
+
+/* Return true if data holds a columnar archive */
+extern bool archive_is_columnar(char *data, uint32_t size);
+
+/*
+ * Pack footer->rec_cnt rows of footer->col_cnt strings (NULL allowed) column
+ * by column.
+ */
+extern buf_t *archive_pack_columnar(char ***rows, archive_footer_t *footer);
+
+/*
+ * Unpack a columnar archive into footer->rec_cnt rows of footer->col_cnt
+ * strings.  footer->rec_cnt is checked against the column data in the file,
+ * so it is safe to size allocations with.  Free the rows with
+ * archive_free_columnar_rows() before freeing the footer with
+ * archive_free_footer().
+ */
+extern int archive_unpack_columnar(buf_t *buffer, archive_footer_t *footer,
+				   char ****rows_out);
+extern void archive_free_columnar_rows(char ***rows,
+				       archive_footer_t *footer);
+
 #endif
@@ -127,6 +127,7 @@ char *job_table = "job_table";
 char *last_ran_table = "last_ran_table";
 char *qos_table = "qos_table";
 char *resv_table = "resv_table";
+char *rollup_job_table = "rollup_job_table";
 char *res_table = "res_table";
 char *step_table = "step_table";
 char *txn_table = "txn_table";
@@ -1309,6 +1310,7 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 		{ "hourly_rollup", "bigint unsigned default 0 not null" },
 		{ "daily_rollup", "bigint unsigned default 0 not null" },
 		{ "monthly_rollup", "bigint unsigned default 0 not null" },
+		{ "rollup_job_time", "bigint unsigned default 0 not null" },
 		{ NULL, NULL}
 	};
 
@@ -1327,6 +1329,11 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 		{ NULL, NULL}
 	};
 
+	storage_field_t rollup_job_table_fields[] = {
+		{ "job_db_inx", "bigint unsigned not null" },
+		{ NULL, NULL}
+	};
+
 	storage_field_t step_table_fields[] = {
 		{ "job_db_inx", "bigint unsigned not null" },
 		{ "deleted", "tinyint default 0 not null" },
@@ -1507,6 +1514,14 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 	    == SLURM_ERROR)
 		return SLURM_ERROR;
 
+	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
+		 cluster_name, rollup_job_table);
+	if (mysql_db_create_table(mysql_conn, table_name,
+				  rollup_job_table_fields,
+				  ", primary key (job_db_inx))")
+	    == SLURM_ERROR)
+		return SLURM_ERROR;
+
 	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
 		 cluster_name, step_table);
 	if (mysql_db_create_table(mysql_conn, table_name,
@@ -1595,7 +1610,7 @@ extern int remove_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", \"%s_%s\", "
 		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", \"%s_%s\", "
 		   "\"%s_%s\", \"%s_%s\", \"%s_%s\", \"%s_%s\", "
-		   "\"%s_%s\", \"%s_%s\";",
+		   "\"%s_%s\", \"%s_%s\", \"%s_%s\";",
 		   cluster_name, assoc_table,
 		   cluster_name, assoc_day_table,
 		   cluster_name, assoc_hour_table,
@@ -1607,6 +1622,7 @@ extern int remove_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 		   cluster_name, job_table,
 		   cluster_name, last_ran_table,
 		   cluster_name, resv_table,
+		   cluster_name, rollup_job_table,
 		   cluster_name, step_table,
 		   cluster_name, suspend_table,
 		   cluster_name, wckey_table,
@@ -2769,6 +2785,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	 * understand that. CID 44841.
 	 */
 	xassert(mysql_conn);
+	rc = SLURM_SUCCESS;
 
 	update_list = list_create(slurmdb_destroy_update_object);
 	list_transfer(update_list, mysql_conn->update_list);
@@ -2779,7 +2796,6 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 			if (mysql_db_rollback(mysql_conn))
 				error("rollback failed");
 		} else {
-			int rc = SLURM_SUCCESS;
 			/*
 			 * Handle anything here we were unable to do
 			 * because of rollback issues.
@@ -2796,19 +2812,21 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 			if (rc != SLURM_SUCCESS) {
 				if (mysql_db_rollback(mysql_conn))
 					error("rollback failed");
-			} else {
-				if (mysql_db_commit(mysql_conn))
-					error("commit failed");
+			} else if ((rc = mysql_db_commit(mysql_conn))) {
+				error("commit failed");
 			}
 		}
 	}
 
-	if (commit && list_count(update_list)) {
+	/* Nothing to tell anyone about what was rolled back */
+	if (commit && (rc == SLURM_SUCCESS) && list_count(update_list)) {
 		char *query = NULL;
 		MYSQL_RES *result = NULL;
 		MYSQL_ROW row;
 		ListIterator itr = NULL;
 		slurmdb_update_object_t *object = NULL;
+		/* Before assoc_mgr_update() takes parts of the objects */
+		uint64_t change_id = assoc_mgr_journal_add(update_list);
 
 		xstrfmtcat(query, "select control_host, control_port, "
 			   "name, rpc_version, flags "
@@ -2824,7 +2842,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 			if (slurm_atoul(row[4]) & CLUSTER_FLAG_EXT)
 				continue;
 			(void) slurmdb_send_accounting_update(
-				update_list,
+				update_list, change_id,
 				row[2], row[0],
 				slurm_atoul(row[1]),
 				slurm_atoul(row[3]));
@@ -2863,7 +2881,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	xfree(mysql_conn->pre_commit_query);
 	FREE_NULL_LIST(update_list);
 
-	return SLURM_SUCCESS;
+	return rc;
 }
 
 extern int acct_storage_p_add_users(mysql_conn_t *mysql_conn, uint32_t uid,
@@ -3458,3 +3476,8 @@ extern int acct_storage_p_shutdown(void *db_conn, bool dbd)
 {
 	return SLURM_SUCCESS;
 }
+
+extern List acct_storage_p_get_updates(void *db_conn, uint64_t *change_id)
+{
+	return assoc_mgr_journal_get(change_id);
+}
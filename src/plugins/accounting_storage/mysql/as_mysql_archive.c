@@ -806,6 +806,23 @@ static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
 
 static uint32_t high_buffer_size = (1024 * 1024);
 
+/* Rows to archive, either straight from the database or from a file */
+typedef struct {
+	uint32_t cnt;
+	uint32_t pos;
+	MYSQL_RES *result;
+	MYSQL_ROW *rows;
+} archive_rows_t;
+
+static MYSQL_ROW _next_archive_row(archive_rows_t *rows)
+{
+	if (rows->result)
+		return mysql_fetch_row(rows->result);
+	if (rows->pos < rows->cnt)
+		return rows->rows[rows->pos++];
+	return NULL;
+}
+
 static void _pack_local_event(local_event_t *object, uint16_t rpc_version,
 			      buf_t *buffer)
 {
@@ -2754,51 +2771,59 @@ static int _process_old_sql(char **data)
 	return rc;
 }
 
-static char *_get_archive_columns(purge_type_t type)
+static void _get_archive_col_names(purge_type_t type, char ***cols,
+				   int *col_count)
 {
-	char **cols = NULL;
-	char *tmp = NULL;
-	int col_count = 0, i = 0;
-
-	xfree(cols);
-
 	switch (type) {
 	case PURGE_EVENT:
-		cols      = event_req_inx;
-		col_count = EVENT_REQ_COUNT;
+		*cols      = event_req_inx;
+		*col_count = EVENT_REQ_COUNT;
 		break;
 	case PURGE_SUSPEND:
-		cols      = suspend_req_inx;
-		col_count = SUSPEND_REQ_COUNT;
+		*cols      = suspend_req_inx;
+		*col_count = SUSPEND_REQ_COUNT;
 		break;
 	case PURGE_RESV:
-		cols      = resv_req_inx;
-		col_count = RESV_REQ_COUNT;
+		*cols      = resv_req_inx;
+		*col_count = RESV_REQ_COUNT;
 		break;
 	case PURGE_JOB:
-		cols      = job_req_inx;
-		col_count = JOB_REQ_COUNT;
+		*cols      = job_req_inx;
+		*col_count = JOB_REQ_COUNT;
 		break;
 	case PURGE_STEP:
-		cols      = step_req_inx;
-		col_count = STEP_REQ_COUNT;
+		*cols      = step_req_inx;
+		*col_count = STEP_REQ_COUNT;
 		break;
 	case PURGE_TXN:
-		cols      = txn_req_inx;
-		col_count = TXN_REQ_COUNT;
+		*cols      = txn_req_inx;
+		*col_count = TXN_REQ_COUNT;
 		break;
 	case PURGE_USAGE:
-		cols      = usage_req_inx;
-		col_count = USAGE_COUNT;
+		*cols      = usage_req_inx;
+		*col_count = USAGE_COUNT;
 		break;
 	case PURGE_CLUSTER_USAGE:
-		cols      = cluster_req_inx;
-		col_count = CLUSTER_COUNT;
+		*cols      = cluster_req_inx;
+		*col_count = CLUSTER_COUNT;
 		break;
 	default:
 		xassert(0);
-		return NULL;
+		*cols      = NULL;
+		*col_count = 0;
+		break;
 	}
+}
+
+static char *_get_archive_columns(purge_type_t type)
+{
+	char **cols = NULL;
+	char *tmp = NULL;
+	int col_count = 0, i = 0;
+
+	_get_archive_col_names(type, &cols, &col_count);
+	if (!cols)
+		return NULL;
 
 	xstrfmtcat(tmp, "%s", cols[0]);
 	for (i=1; i<col_count; i++) {
@@ -2809,7 +2834,7 @@ static char *_get_archive_columns(purge_type_t type)
 }
 
 
-static buf_t *_pack_archive_events(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_events(archive_rows_t *rows, char *cluster_name,
 				   uint32_t cnt, uint32_t usage_info,
 				   time_t *period_start)
 {
@@ -2824,7 +2849,7 @@ static buf_t *_pack_archive_events(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[EVENT_REQ_START]);
 
@@ -2896,7 +2921,7 @@ static char *_load_events(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-static buf_t *_pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_jobs(archive_rows_t *rows, char *cluster_name,
 				 uint32_t cnt, uint32_t usage_info,
 				 time_t *period_start)
 {
@@ -2911,7 +2936,7 @@ static buf_t *_pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[JOB_REQ_SUBMIT]);
 
@@ -3180,7 +3205,7 @@ static char *_load_jobs(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-static buf_t *_pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_resvs(archive_rows_t *rows, char *cluster_name,
 				  uint32_t cnt, uint32_t usage_info,
 				  time_t *period_start)
 {
@@ -3195,7 +3220,7 @@ static buf_t *_pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[RESV_REQ_START]);
 
@@ -3271,7 +3296,7 @@ static char *_load_resvs(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-static buf_t *_pack_archive_steps(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_steps(archive_rows_t *rows, char *cluster_name,
 				  uint32_t cnt, uint32_t usage_info,
 				  time_t *period_start)
 {
@@ -3286,7 +3311,7 @@ static buf_t *_pack_archive_steps(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[STEP_REQ_START]);
 
@@ -3435,7 +3460,7 @@ static char *_load_steps(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-static buf_t *_pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_suspends(archive_rows_t *rows, char *cluster_name,
 				     uint32_t cnt, uint32_t usage_info,
 				     time_t *period_start)
 {
@@ -3450,7 +3475,7 @@ static buf_t *_pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[SUSPEND_REQ_START]);
 
@@ -3513,7 +3538,7 @@ static char *_load_suspend(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-static buf_t *_pack_archive_txns(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_txns(archive_rows_t *rows, char *cluster_name,
 				 uint32_t cnt, uint32_t usage_info,
 				 time_t *period_start)
 {
@@ -3528,7 +3553,7 @@ static buf_t *_pack_archive_txns(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[TXN_REQ_TS]);
 
@@ -3597,7 +3622,7 @@ static char *_load_txn(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-static buf_t *_pack_archive_usage(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_usage(archive_rows_t *rows, char *cluster_name,
 				  uint32_t cnt, uint32_t usage_info,
 				  time_t *period_start)
 {
@@ -3615,7 +3640,7 @@ static buf_t *_pack_archive_usage(MYSQL_RES *result, char *cluster_name,
 	pack32(cnt, buffer);
 	pack16(period, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[USAGE_START]);
 
@@ -3725,7 +3750,7 @@ static char *_load_usage(uint16_t rpc_version, buf_t *buffer,
 	return insert;
 }
 
-static buf_t *_pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
+static buf_t *_pack_archive_cluster_usage(archive_rows_t *rows, char *cluster_name,
 					  uint32_t cnt, uint32_t usage_info,
 					  time_t *period_start)
 {
@@ -3742,7 +3767,7 @@ static buf_t *_pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
 	pack32(cnt, buffer);
 	pack16(period, buffer);
 
-	while ((row = mysql_fetch_row(result))) {
+	while ((row = _next_archive_row(rows))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[CLUSTER_START]);
 
@@ -3839,53 +3864,187 @@ static char *_load_cluster_usage(uint16_t rpc_version, buf_t *buffer,
 }
 
 /* returns count of events archived or SLURM_ERROR on error */
-static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
-			       char *cluster_name, time_t period_end,
-			       char *arch_dir, uint32_t archive_period,
-			       char *sql_table, uint32_t usage_info)
-{
-	MYSQL_RES *result = NULL;
-	char *cols = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
-	buf_t *buffer;
-	int error_code = 0;
-	buf_t *(*pack_func)(MYSQL_RES *result, char *cluster_name,
-			    uint32_t cnt, uint32_t usage_info,
-			    time_t *period_start);
+typedef buf_t *(*archive_pack_func_t)(archive_rows_t *rows,
+				      char *cluster_name, uint32_t cnt,
+				      uint32_t usage_info,
+				      time_t *period_start);
 
-	cols = _get_archive_columns(type);
+static archive_pack_func_t _get_archive_pack_func(purge_type_t type)
+{
+	switch (type) {
+	case PURGE_EVENT:
+		return &_pack_archive_events;
+	case PURGE_SUSPEND:
+		return &_pack_archive_suspends;
+	case PURGE_RESV:
+		return &_pack_archive_resvs;
+	case PURGE_JOB:
+		return &_pack_archive_jobs;
+	case PURGE_STEP:
+		return &_pack_archive_steps;
+	case PURGE_TXN:
+		return &_pack_archive_txns;
+	case PURGE_USAGE:
+		return &_pack_archive_usage;
+	case PURGE_CLUSTER_USAGE:
+		return &_pack_archive_cluster_usage;
+	default:
+		return NULL;
+	}
+}
 
+/* Column the period of an archive file starts with */
+static int _get_archive_start_col(purge_type_t type)
+{
 	switch (type) {
 	case PURGE_EVENT:
-		pack_func = &_pack_archive_events;
-		break;
+		return EVENT_REQ_START;
 	case PURGE_SUSPEND:
-		pack_func = &_pack_archive_suspends;
-		break;
+		return SUSPEND_REQ_START;
 	case PURGE_RESV:
-		pack_func = &_pack_archive_resvs;
-		break;
+		return RESV_REQ_START;
 	case PURGE_JOB:
-		pack_func = &_pack_archive_jobs;
-		break;
+		return JOB_REQ_SUBMIT;
 	case PURGE_STEP:
-		pack_func = &_pack_archive_steps;
-		break;
+		return STEP_REQ_START;
 	case PURGE_TXN:
-		pack_func = &_pack_archive_txns;
-		break;
+		return TXN_REQ_TS;
 	case PURGE_USAGE:
-		pack_func = &_pack_archive_usage;
-		break;
+		return USAGE_START;
 	case PURGE_CLUSTER_USAGE:
-		pack_func = &_pack_archive_cluster_usage;
-		break;
+		return CLUSTER_START;
 	default:
+		xassert(0);
+		return 0;
+	}
+}
+
+/*
+ * Pack the rows as they came from the database column by column, see
+ * archive_pack_columnar().  Used instead of the pack_func of the type with
+ * Parameters=ArchiveColumnar.
+ */
+static buf_t *_pack_archive_columnar(purge_type_t type, MYSQL_RES *result,
+				     char *cluster_name, uint32_t cnt,
+				     uint32_t usage_info, time_t *period_start)
+{
+	archive_footer_t footer;
+	MYSQL_ROW *rows = xcalloc(cnt, sizeof(MYSQL_ROW));
+	MYSQL_ROW row;
+	buf_t *buffer;
+	int col_cnt = 0;
+	uint32_t i = 0;
+
+	while ((i < cnt) && (row = mysql_fetch_row(result)))
+		rows[i++] = row;
+	if (i)
+		*period_start = slurm_atoul(
+			rows[0][_get_archive_start_col(type)]);
+
+	memset(&footer, 0, sizeof(archive_footer_t));
+	_get_archive_col_names(type, &footer.col_names, &col_cnt);
+	footer.cluster_name = cluster_name;
+	footer.col_cnt = col_cnt;
+	footer.rec_cnt = i;
+	footer.type = type;
+	footer.usage_info = usage_info;
+
+	buffer = archive_pack_columnar(rows, &footer);
+	xfree(rows);
+
+	return buffer;
+}
+
+/*
+ * Turn a columnar archive file into the buffer _archive_table() would have
+ * packed for the same records, so it can be loaded like any other archive.
+ * Columns are matched by name, one not in the file is left NULL.
+ */
+static buf_t *_unpack_archive_columnar(mysql_conn_t *mysql_conn, char *data,
+				       uint32_t data_size)
+{
+	buf_t *buffer = create_buf(data, data_size);
+	archive_footer_t footer;
+	archive_rows_t rows;
+	archive_pack_func_t pack_func;
+	char ***file_rows = NULL, **cols = NULL;
+	int col_cnt = 0, i, j;
+	uint32_t k, len;
+
+	if (archive_unpack_columnar(buffer, &footer, &file_rows)) {
+		FREE_NULL_BUFFER(buffer);
+		return NULL;
+	}
+	FREE_NULL_BUFFER(buffer);
+
+	DB_DEBUG(DB_ARCHIVE, mysql_conn->conn,
+		 "columnar archive of cluster %s type %u with %u records",
+		 footer.cluster_name, footer.type, footer.rec_cnt);
+
+	if (!(pack_func = _get_archive_pack_func(footer.type))) {
+		error("Unknown type '%u' in columnar archive", footer.type);
+		goto end_it;
+	}
+	_get_archive_col_names(footer.type, &cols, &col_cnt);
+
+	/* rec_cnt was checked against the columns by archive_unpack_columnar() */
+	memset(&rows, 0, sizeof(archive_rows_t));
+	rows.cnt = footer.rec_cnt;
+	rows.rows = xcalloc(rows.cnt + 1, sizeof(MYSQL_ROW));
+	for (k = 0; k < rows.cnt; k++)
+		rows.rows[k] = xcalloc(col_cnt, sizeof(char *));
+
+	for (i = 0; i < col_cnt; i++) {
+		for (j = 0; j < footer.col_cnt; j++)
+			if (!xstrcmp(cols[i], footer.col_names[j]))
+				break;
+		if (j == footer.col_cnt) {
+			debug("%s: column %s not in archive",
+			      __func__, cols[i]);
+			continue;
+		}
+		for (k = 0; k < rows.cnt; k++)
+			rows.rows[k][i] = file_rows[k][j];
+	}
+
+	buffer = (*pack_func)(&rows, footer.cluster_name, rows.cnt,
+			      footer.usage_info, NULL);
+	len = get_buf_offset(buffer);
+	data = xfer_buf_data(buffer);
+	buffer = create_buf(data, len);
+
+	for (k = 0; k < rows.cnt; k++)
+		xfree(rows.rows[k]);
+	xfree(rows.rows);
+
+end_it:
+	archive_free_columnar_rows(file_rows, &footer);
+	archive_free_footer(&footer);
+
+	return buffer;
+}
+
+static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
+			       char *cluster_name, time_t period_end,
+			       char *arch_dir, uint32_t archive_period,
+			       char *sql_table, uint32_t usage_info)
+{
+	MYSQL_RES *result = NULL;
+	char *cols = NULL, *query = NULL;
+	time_t period_start = 0;
+	uint32_t cnt = 0;
+	buf_t *buffer;
+	int error_code = 0;
+	archive_pack_func_t pack_func;
+	archive_rows_t rows;
+
+	if (!(pack_func = _get_archive_pack_func(type))) {
 		fatal("Unknown purge type: %d", type);
 		return SLURM_ERROR;
 	}
 
+	cols = _get_archive_columns(type);
+
 	switch (type) {
 	case PURGE_TXN:
 		query = xstrdup_printf("select %s from \"%s\" where "
@@ -3933,8 +4092,15 @@ static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
 		return 0;
 	}
 
-	buffer = (*pack_func)(result, cluster_name, cnt, usage_info,
-			      &period_start);
+	if (slurmdbd_conf && slurmdbd_conf->archive_columnar) {
+		buffer = _pack_archive_columnar(type, result, cluster_name, cnt,
+						usage_info, &period_start);
+	} else {
+		memset(&rows, 0, sizeof(archive_rows_t));
+		rows.result = result;
+		buffer = (*pack_func)(&rows, cluster_name, cnt, usage_info,
+				      &period_start);
+	}
 	mysql_free_result(result);
 
 	error_code = archive_write_file(buffer, cluster_name,
@@ -4464,8 +4630,17 @@ extern int as_mysql_jobacct_process_archive_load(
 		goto got_sql;
 	}
 
-	buffer = create_buf(data, data_size);
-	data = NULL;	/* Moved to "buffer" */
+	if (archive_is_columnar(data, data_size)) {
+		buffer = _unpack_archive_columnar(mysql_conn, data, data_size);
+		data = NULL;	/* Moved to "buffer" */
+		if (!buffer) {
+			error("Couldn't read columnar archive");
+			return SLURM_ERROR;
+		}
+	} else {
+		buffer = create_buf(data, data_size);
+		data = NULL;	/* Moved to "buffer" */
+	}
 
 	safe_unpack16(&ver, buffer);
 	DB_DEBUG(DB_ARCHIVE, mysql_conn->conn,
@@ -56,6 +56,17 @@ typedef struct {
 	uint32_t old;
 } id_switch_t;
 
+/* Refers to the new row through VALUES() so step starts can be batched */
+static char *step_start_update =
+	"on duplicate key update "
+	"nodes_alloc=VALUES(nodes_alloc), task_cnt=VALUES(task_cnt), "
+	"time_end=0, state=VALUES(state), nodelist=VALUES(nodelist), "
+	"node_inx=VALUES(node_inx), task_dist=VALUES(task_dist), "
+	"req_cpufreq=VALUES(req_cpufreq), "
+	"req_cpufreq_min=VALUES(req_cpufreq_min), "
+	"req_cpufreq_gov=VALUES(req_cpufreq_gov), "
+	"tres_alloc=VALUES(tres_alloc)";
+
 static int _find_id_switch(void *x, void *key)
 {
 	id_switch_t *id_switch = (id_switch_t *)x;
@@ -635,6 +646,21 @@ no_rollup_change:
 			} else
 				rc = SLURM_ERROR;
 		}
+
+		/*
+		 * Let the hourly rollup know about this job, see
+		 * as_mysql_hourly_rollup().
+		 */
+		if (job_ptr->db_index) {
+			xfree(query);
+			query = xstrdup_printf(
+				"insert ignore into \"%s_%s\" (job_db_inx) "
+				"values (%"PRIu64");",
+				mysql_conn->cluster_name, rollup_job_table,
+				job_ptr->db_index);
+			DB_DEBUG(DB_JOB, mysql_conn->conn, "query\n%s", query);
+			rc = mysql_db_query(mysql_conn, query);
+		}
 	} else {
 		query = xstrdup_printf("update \"%s_%s\" set nodelist='%s', ",
 				       mysql_conn->cluster_name,
@@ -699,6 +725,12 @@ no_rollup_change:
 			   job_ptr->db_flags, job_ptr->state_reason_prev_db,
 			   begin_time, job_ptr->db_index);
 
+		/* Put it back in case it was dropped there after ending */
+		xstrfmtcat(query, ";insert ignore into \"%s_%s\" (job_db_inx) "
+			   "values (%"PRIu64");",
+			   mysql_conn->cluster_name, rollup_job_table,
+			   job_ptr->db_index);
+
 		DB_DEBUG(DB_JOB, mysql_conn->conn, "query\n%s", query);
 		rc = mysql_db_query(mysql_conn, query);
 	}
@@ -1114,7 +1146,7 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 	char *node_list = NULL;
 	char *node_inx = NULL;
 	time_t start_time, submit_time;
-	char *query = NULL;
+	char *query = NULL, *row = NULL;
 
 	if (!step_ptr->job_ptr->db_index
 	    && ((!step_ptr->job_ptr->details
@@ -1213,22 +1245,25 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 		}
 	}
 
-	/* we want to print a -1 for the requid so leave it a
-	   %d */
-	/* The stepid could be negative so use %d not %u */
+	/*
+	 * Steps of many jobs tend to start at once, so queue the row and let
+	 * it go out with the others in one multi-row insert.  It is sent
+	 * before anything else is done on this connection, and a failure
+	 * fails the commit done before the slurmctld gets the reply.
+	 * With CommitDelay the reply goes out before the commit, so insert
+	 * the row right away to report a failure to the right message.
+	 */
 	query = xstrdup_printf(
 		"insert into \"%s_%s\" (job_db_inx, id_step, step_het_comp, "
 		"time_start, step_name, state, tres_alloc, "
 		"nodes_alloc, task_cnt, nodelist, node_inx, "
 		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov) "
-		"values (%"PRIu64", %d, %u, %d, '%s', %d, '%s', %d, %d, "
-		"'%s', '%s', %d, %u, %u, %u) "
-		"on duplicate key update "
-		"nodes_alloc=%d, task_cnt=%d, time_end=0, state=%d, "
-		"nodelist='%s', node_inx='%s', task_dist=%d, "
-		"req_cpufreq=%u, req_cpufreq_min=%u, req_cpufreq_gov=%u,"
-		"tres_alloc='%s';",
-		mysql_conn->cluster_name, step_table,
+		"values",
+		mysql_conn->cluster_name, step_table);
+	/* The stepid could be negative so use %d not %u */
+	row = xstrdup_printf(
+		"(%"PRIu64", %d, %u, %d, '%s', %d, '%s', %d, %d, "
+		"'%s', '%s', %d, %u, %u, %u)",
 		step_ptr->job_ptr->db_index,
 		step_ptr->step_id.step_id,
 		step_ptr->step_id.step_het_comp,
@@ -1236,13 +1271,17 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 		JOB_RUNNING, step_ptr->tres_alloc_str,
 		nodes, tasks, node_list, node_inx, task_dist,
 		step_ptr->cpu_freq_max, step_ptr->cpu_freq_min,
-		step_ptr->cpu_freq_gov, nodes, tasks, JOB_RUNNING,
-		node_list, node_inx, task_dist, step_ptr->cpu_freq_max,
-		step_ptr->cpu_freq_min, step_ptr->cpu_freq_gov,
-		step_ptr->tres_alloc_str);
-	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+		step_ptr->cpu_freq_gov);
+	DB_DEBUG(DB_STEP, mysql_conn->conn, "query\n%s %s %s",
+		 query, row, step_start_update);
+	if (slurmdbd_conf && slurmdbd_conf->commit_delay) {
+		xstrfmtcat(query, " %s %s", row, step_start_update);
+		rc = mysql_db_query(mysql_conn, query);
+	} else
+		rc = mysql_db_batch_insert(mysql_conn, query, row,
+					   step_start_update);
 	xfree(query);
+	xfree(row);
 
 	return rc;
 }
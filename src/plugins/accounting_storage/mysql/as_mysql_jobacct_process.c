@@ -1120,6 +1120,65 @@ end_it:
 	return rc;
 }
 
+/*
+ * Get the jobs of a cluster with a job id above "after" one range of at most
+ * job_cond->chunk_size database rows at a time, until chunk_size jobs are
+ * found or the cluster has no more. A range always ends on a whole job id so
+ * duplicates and resized records of a job stay together.
+ */
+static int _cluster_get_jobs_chunk(mysql_conn_t *mysql_conn,
+				   slurmdb_user_rec_t *user,
+				   slurmdb_job_cond_t *job_cond,
+				   char *cluster_name,
+				   char *job_fields, char *step_fields,
+				   char *sent_extra, bool is_admin,
+				   int only_pending, uint32_t after,
+				   List sent_list)
+{
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	char *query = NULL, *extra = NULL;
+	uint32_t last;
+	int start_cnt = list_count(sent_list);
+	int rc = SLURM_SUCCESS;
+
+	while ((list_count(sent_list) - start_cnt) < job_cond->chunk_size) {
+		/* find the job id ending the next range */
+		query = xstrdup_printf("select t1.id_job from \"%s_%s\" as t1%s "
+				       "%s t1.id_job>%u order by t1.id_job "
+				       "limit 1 offset %u",
+				       cluster_name, job_table,
+				       sent_extra ? sent_extra : "",
+				       sent_extra ? "&&" : "where", after,
+				       job_cond->chunk_size - 1);
+		DB_DEBUG(DB_JOB, mysql_conn->conn, "query\n%s", query);
+		if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+			xfree(query);
+			return SLURM_ERROR;
+		}
+		xfree(query);
+		if ((row = mysql_fetch_row(result)))
+			last = slurm_atoul(row[0]);
+		else
+			last = INFINITE;
+		mysql_free_result(result);
+
+		extra = xstrdup_printf("%s %s (t1.id_job>%u && t1.id_job<=%u)",
+				       sent_extra ? sent_extra : "",
+				       sent_extra ? "&&" : "where",
+				       after, last);
+		rc = _cluster_get_jobs(mysql_conn, user, job_cond, cluster_name,
+				       job_fields, step_fields, extra,
+				       is_admin, only_pending, sent_list);
+		xfree(extra);
+		if ((rc != SLURM_SUCCESS) || (last == INFINITE))
+			break;
+		after = last;
+	}
+
+	return rc;
+}
+
 extern List setup_cluster_list_with_inx(mysql_conn_t *mysql_conn,
 					slurmdb_job_cond_t *job_cond,
 					void **curr_cluster)
@@ -1684,6 +1743,7 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 	int is_admin=1;
 	int i;
 	List job_list = NULL;
+	char *cursor_cluster = NULL;
 	slurmdb_user_rec_t user;
 	int only_pending = 0;
 	List use_cluster_list = as_mysql_cluster_list;
@@ -1737,17 +1797,44 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	assoc_mgr_lock(&locks);
 
+	/*
+	 * A chunk holds the jobs of only one cluster, the first one with jobs
+	 * after the cursor.
+	 */
+	if (job_cond && job_cond->chunk_size)
+		cursor_cluster = job_cond->cursor_cluster;
+
 	job_list = list_create(slurmdb_destroy_job_rec);
 	itr = list_iterator_create(use_cluster_list);
 	while ((cluster_name = list_next(itr))) {
 		int rc;
+		uint32_t after = 0;
+
 		_setup_job_cond_selected_steps(job_cond, cluster_name, &extra);
-		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
-					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
-		    != SLURM_SUCCESS)
+		if (cursor_cluster) {
+			if (xstrcmp(cluster_name, cursor_cluster))
+				continue;
+			cursor_cluster = NULL;
+			after = job_cond->cursor_jobid;
+		}
+
+		if (job_cond && job_cond->chunk_size)
+			rc = _cluster_get_jobs_chunk(mysql_conn, &user,
+						     job_cond, cluster_name,
+						     tmp, tmp2, extra,
+						     is_admin, only_pending,
+						     after, job_list);
+		else
+			rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
+					       cluster_name, tmp, tmp2, extra,
+					       is_admin, only_pending,
+					       job_list);
+		if (rc != SLURM_SUCCESS)
 			error("Problem getting jobs for cluster %s",
 			      cluster_name);
+
+		if (job_cond && job_cond->chunk_size && list_count(job_list))
+			break;
 	}
 	list_iterator_destroy(itr);
 
@@ -893,6 +893,7 @@ extern List as_mysql_modify_qos(mysql_conn_t *mysql_conn, uint32_t uid,
 		qos_rec = xmalloc(sizeof(slurmdb_qos_rec_t));
 		qos_rec->name = xstrdup(object);
 		qos_rec->id = id;
+		qos_rec->description = xstrdup(qos->description);
 		qos_rec->flags = qos->flags;
 
 		qos_rec->grace_time = qos->grace_time;
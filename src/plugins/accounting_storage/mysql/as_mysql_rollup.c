@@ -90,8 +90,48 @@ typedef struct {
 	time_t orig_start;
 	time_t start;
 	double unused_wall;
+	double used_wall; /* wall time used by jobs this hour */
 } local_resv_usage_t;
 
+/* Number of hours whose rows are gotten from the database at once */
+#define ROLLUP_RANGE_HOURS 24
+
+typedef struct {
+	int cnt;
+	MYSQL_RES *result;
+	MYSQL_ROW *rows;
+} rollup_rows_t;
+
+typedef struct {
+	time_t end;
+	List resv_usage_list; /* list of local_resv_usage_t, kept until the
+			       * unused_wall of the range is figured out */
+	time_t start;
+} local_hour_t;
+
+typedef struct {
+	char *cluster_name;
+	int dims;
+	rollup_rows_t event_rows;
+	int hour_cnt;
+	local_hour_t hours[ROLLUP_RANGE_HOURS];
+	rollup_rows_t job_rows;
+	pthread_mutex_t lock; /* protects next_hour and rc */
+	mysql_conn_t *mysql_conn;
+	int next_hour;
+	time_t now;
+	int rc;
+	rollup_rows_t resv_rows;
+	time_t rollup_job_time;
+	uint16_t track_wckey;
+} hour_range_t;
+
+typedef struct {
+	int id;
+	time_t orig_start;
+	double unused_wall;
+} resv_unused_t;
+
 static void _destroy_local_tres_usage(void *object)
 {
 	local_tres_usage_t *a_usage = (local_tres_usage_t *)object;
@@ -277,18 +317,11 @@ static int _update_unused_wall(local_resv_usage_t *r_usage, List job_tres,
 	/*
 	 * Here we are converting TRES seconds to wall seconds.  This is needed
 	 * to determine how much time is actually idle in the reservation.
+	 * It is taken off the unused_wall once all the hours of the range
+	 * are done, see _update_resv_unused_wall().
 	 */
-	r_usage->unused_wall -=	(double)job_seconds * tres_ratio;
+	r_usage->used_wall += (double)job_seconds * tres_ratio;
 
-	if (r_usage->unused_wall < 0) {
-		/*
-		 * With a Flex reservation you can easily have more time than is
-		 * possible.  Just print this debug3 warning if it happens.
-		 */
-		debug3("WARNING: Unused wall is less than zero; this should never happen outside a Flex reservation. Setting it to zero for resv id = %d, start = %ld.",
-		       r_usage->id, r_usage->orig_start);
-		r_usage->unused_wall = 0;
-	}
 	return SLURM_SUCCESS;
 }
 
@@ -839,8 +872,129 @@ static int _add_resv_usage_to_cluster(void *object, void *arg)
 	return SLURM_SUCCESS;
 }
 
-static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
-						   char *cluster_name,
+/* Columns of the range queries the hourly rollup works from */
+static char *event_req_inx[] = {
+	"node_name",
+	"time_start",
+	"time_end",
+	"state",
+	"tres",
+};
+enum {
+	EVENT_REQ_NAME,
+	EVENT_REQ_START,
+	EVENT_REQ_END,
+	EVENT_REQ_STATE,
+	EVENT_REQ_TRES,
+	EVENT_REQ_COUNT
+};
+
+static char *resv_req_inx[] = {
+	"id_resv",
+	"assoclist",
+	"flags",
+	"nodelist",
+	"tres",
+	"time_start",
+	"time_end",
+	"unused_wall"
+};
+enum {
+	RESV_REQ_ID,
+	RESV_REQ_ASSOCS,
+	RESV_REQ_FLAGS,
+	RESV_REQ_NODES,
+	RESV_REQ_TRES,
+	RESV_REQ_START,
+	RESV_REQ_END,
+	RESV_REQ_UNUSED,
+	RESV_REQ_COUNT
+};
+
+static char *job_req_inx[] = {
+	"job.job_db_inx",
+//	"job.id_job",
+	"job.id_assoc",
+	"job.id_wckey",
+	"job.array_task_pending",
+	"job.time_eligible",
+	"job.time_start",
+	"job.time_end",
+	"job.time_suspended",
+	"job.cpus_req",
+	"job.id_resv",
+	"job.tres_alloc"
+};
+enum {
+	JOB_REQ_DB_INX,
+//	JOB_REQ_JOBID,
+	JOB_REQ_ASSOCID,
+	JOB_REQ_WCKEYID,
+	JOB_REQ_ARRAY_PENDING,
+	JOB_REQ_ELG,
+	JOB_REQ_START,
+	JOB_REQ_END,
+	JOB_REQ_SUSPENDED,
+	JOB_REQ_RCPU,
+	JOB_REQ_RESVID,
+	JOB_REQ_TRES,
+	JOB_REQ_COUNT
+};
+
+static char *suspend_req_inx[] = {
+	"time_start",
+	"time_end"
+};
+enum {
+	SUSPEND_REQ_START,
+	SUSPEND_REQ_END,
+	SUSPEND_REQ_COUNT
+};
+
+static char *_req_inx_str(char **req_inx, int cnt)
+{
+	char *str = NULL;
+	int i = 0;
+
+	xstrfmtcat(str, "%s", req_inx[i]);
+	for (i = 1; i < cnt; i++)
+		xstrfmtcat(str, ", %s", req_inx[i]);
+
+	return str;
+}
+
+/*
+ * Run query and keep the whole result around so the rows can be walked by
+ * every hour of the range, possibly from several threads at once.
+ */
+static int _get_rollup_rows(mysql_conn_t *mysql_conn, char *query,
+			    rollup_rows_t *rollup_rows)
+{
+	MYSQL_ROW row;
+	int cnt = 0;
+
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	if (!(rollup_rows->result = mysql_db_query_ret(mysql_conn, query, 0)))
+		return SLURM_ERROR;
+
+	rollup_rows->rows = xcalloc(mysql_num_rows(rollup_rows->result) + 1,
+				    sizeof(MYSQL_ROW));
+	while ((row = mysql_fetch_row(rollup_rows->result)))
+		rollup_rows->rows[cnt++] = row;
+	rollup_rows->cnt = cnt;
+
+	return SLURM_SUCCESS;
+}
+
+static void _free_rollup_rows(rollup_rows_t *rollup_rows)
+{
+	if (rollup_rows->result)
+		mysql_free_result(rollup_rows->result);
+	xfree(rollup_rows->rows);
+	memset(rollup_rows, 0, sizeof(rollup_rows_t));
+}
+
+static local_cluster_usage_t *_setup_cluster_usage(rollup_rows_t *event_rows,
 						   time_t curr_start,
 						   time_t curr_end,
 						   List resv_usage_list,
@@ -848,68 +1002,33 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 						   int dims)
 {
 	local_cluster_usage_t *c_usage = NULL;
-	char *query = NULL;
-	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	int i = 0;
+	int i;
 	ListIterator d_itr = NULL;
 	ListIterator r_itr = NULL;
 	local_cluster_usage_t *loc_c_usage;
 	local_resv_usage_t *loc_r_usage;
 
-	char *event_req_inx[] = {
-		"node_name",
-		"time_start",
-		"time_end",
-		"state",
-		"tres",
-	};
-	char *event_str = NULL;
-	enum {
-		EVENT_REQ_NAME,
-		EVENT_REQ_START,
-		EVENT_REQ_END,
-		EVENT_REQ_STATE,
-		EVENT_REQ_TRES,
-		EVENT_REQ_COUNT
-	};
-
-	xstrfmtcat(event_str, "%s", event_req_inx[i]);
-	for(i=1; i<EVENT_REQ_COUNT; i++) {
-		xstrfmtcat(event_str, ", %s", event_req_inx[i]);
-	}
-
-	/* first get the events during this time.  All that is
-	 * except things with the maintainance flag set in the
-	 * state.  We handle those later with the reservations.
-	 */
-	query = xstrdup_printf("select %s from \"%s_%s\" where "
-			       "!(state & %d) && (time_start < %ld "
-			       "&& (time_end >= %ld "
-			       "|| time_end = 0)) "
-			       "order by node_name, time_start",
-			       event_str, cluster_name, event_table,
-			       NODE_STATE_MAINT,
-			       curr_end, curr_start);
-	xfree(event_str);
-
-	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
-		xfree(query);
-		return NULL;
-	}
-
-	xfree(query);
-
 	d_itr = list_iterator_create(cluster_down_list);
 	r_itr = list_iterator_create(resv_usage_list);
-	while ((row = mysql_fetch_row(result))) {
-		time_t row_start = slurm_atoul(row[EVENT_REQ_START]);
-		time_t row_end = slurm_atoul(row[EVENT_REQ_END]);
-		uint16_t state = slurm_atoul(row[EVENT_REQ_STATE]);
-		time_t local_start, local_end;
+	for (i = 0; i < event_rows->cnt; i++) {
+		time_t row_start, row_end, local_start, local_end;
+		uint16_t state;
 		int seconds, resv_seconds;
 
+		row = event_rows->rows[i];
+		row_start = slurm_atoul(row[EVENT_REQ_START]);
+		row_end = slurm_atoul(row[EVENT_REQ_END]);
+		state = slurm_atoul(row[EVENT_REQ_STATE]);
+
+		/*
+		 * The events were gotten for the whole range, only look at
+		 * the ones during this hour.
+		 */
+		if ((row_start >= curr_end) ||
+		    (row_end && (row_end < curr_start)))
+			continue;
+
 		if (row_start < curr_start)
 			row_start = curr_start;
 
@@ -1065,9 +1184,8 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 			/*      seconds, cluster_name); */
 		}
 	}
-	mysql_free_result(result);
-
 	list_iterator_destroy(d_itr);
+	list_iterator_destroy(r_itr);
 
 	if (c_usage)
 		(void)list_for_each(resv_usage_list,
@@ -1076,61 +1194,15 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 	return c_usage;
 }
 
-extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
-			     char *cluster_name,
-			     time_t curr_start,
-			     time_t curr_end,
-			     List resv_usage_list,
-			     int dims)
+static void _setup_resv_usage(rollup_rows_t *resv_rows,
+			      time_t curr_start,
+			      time_t curr_end,
+			      List resv_usage_list,
+			      int dims)
 {
-	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
 	int i;
-	char *query;
-	char *resv_str = NULL;
 	local_resv_usage_t *r_usage = NULL;
-	char *resv_req_inx[] = {
-		"id_resv",
-		"assoclist",
-		"flags",
-		"nodelist",
-		"tres",
-		"time_start",
-		"time_end",
-		"unused_wall"
-	};
-	enum {
-		RESV_REQ_ID,
-		RESV_REQ_ASSOCS,
-		RESV_REQ_FLAGS,
-		RESV_REQ_NODES,
-		RESV_REQ_TRES,
-		RESV_REQ_START,
-		RESV_REQ_END,
-		RESV_REQ_UNUSED,
-		RESV_REQ_COUNT
-	};
-
-	/* now get the reservations during this time */
-
-	i=0;
-	xstrfmtcat(resv_str, "%s", resv_req_inx[i]);
-	for(i=1; i<RESV_REQ_COUNT; i++)
-		xstrfmtcat(resv_str, ", %s", resv_req_inx[i]);
-
-	query = xstrdup_printf("select %s from \"%s_%s\" where "
-			       "(time_start < %ld && time_end >= %ld) "
-			       "order by time_start",
-			       resv_str, cluster_name, resv_table,
-			       curr_end, curr_start);
-	xfree(resv_str);
-	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-
-	result = mysql_db_query_ret(mysql_conn, query, 0);
-	xfree(query);
-
-	if (!result)
-		return SLURM_ERROR;
 
 	/*
 	 * If a reservation overlaps another reservation we
@@ -1152,12 +1224,18 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 	 * option which will allow jobs to continue to run in the
 	 * reservation that aren't suppose to.
 	 */
-	while ((row = mysql_fetch_row(result))) {
-		time_t row_start = slurm_atoul(row[RESV_REQ_START]);
-		time_t row_end = slurm_atoul(row[RESV_REQ_END]);
+	for (i = 0; i < resv_rows->cnt; i++) {
+		time_t row_start, row_end, orig_start;
 		int unused;
 		int resv_seconds;
-		time_t orig_start = row_start;
+
+		row = resv_rows->rows[i];
+		orig_start = row_start = slurm_atoul(row[RESV_REQ_START]);
+		row_end = slurm_atoul(row[RESV_REQ_END]);
+
+		/* Only the reservations during this hour */
+		if ((row_start >= curr_end) || (row_end < curr_start))
+			continue;
 
 		if (row_start >= curr_start) {
 			/*
@@ -1206,25 +1284,26 @@ extern int _setup_resv_usage(mysql_conn_t *mysql_conn,
 		r_usage->hl = hostlist_create_dims(row[RESV_REQ_NODES], dims);
 		list_append(resv_usage_list, r_usage);
 	}
-	mysql_free_result(result);
-
-	return SLURM_SUCCESS;
 }
 
-extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name,
-				  time_t start, time_t end,
-				  uint16_t archive_data)
+/*
+ * Roll up a single hour of the range into the assoc, wckey and cluster usage
+ * tables. Nothing is committed here.
+ */
+static int _hour_rollup(mysql_conn_t *mysql_conn, hour_range_t *range,
+			local_hour_t *hour)
 {
 	int rc = SLURM_SUCCESS;
-	int add_sec = 3600;
-	int i=0, dims;
-	time_t now = time(NULL);
-	time_t curr_start = start;
-	time_t curr_end = curr_start + add_sec;
+	int j;
+	int last_id = -1;
+	int last_wckeyid = -1;
+	char *cluster_name = range->cluster_name;
+	time_t curr_start = hour->start;
+	time_t curr_end = hour->end;
+	time_t now = range->now;
+	uint16_t track_wckey = range->track_wckey;
 	char *query = NULL;
-	MYSQL_RES *result = NULL;
-	MYSQL_ROW row;
+	char *suspend_str = NULL;
 	ListIterator a_itr = NULL;
 	ListIterator c_itr = NULL;
 	ListIterator w_itr = NULL;
@@ -1232,623 +1311,805 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	List assoc_usage_list = list_create(_destroy_local_id_usage);
 	List cluster_down_list = list_create(_destroy_local_cluster_usage);
 	List wckey_usage_list = list_create(_destroy_local_id_usage);
-	List resv_usage_list = list_create(_destroy_local_resv_usage);
-	uint16_t track_wckey = slurm_get_track_wckey();
+	List resv_usage_list = hour->resv_usage_list;
 	local_cluster_usage_t *loc_c_usage = NULL;
 	local_cluster_usage_t *c_usage = NULL;
 	local_resv_usage_t *r_usage = NULL;
 	local_id_usage_t *a_usage = NULL;
 	local_id_usage_t *w_usage = NULL;
-	/* char start_char[20], end_char[20]; */
-
-	char *job_req_inx[] = {
-		"job.job_db_inx",
-//		"job.id_job",
-		"job.id_assoc",
-		"job.id_wckey",
-		"job.array_task_pending",
-		"job.time_eligible",
-		"job.time_start",
-		"job.time_end",
-		"job.time_suspended",
-		"job.cpus_req",
-		"job.id_resv",
-		"job.tres_alloc"
-	};
-	char *job_str = NULL;
-	enum {
-		JOB_REQ_DB_INX,
-//		JOB_REQ_JOBID,
-		JOB_REQ_ASSOCID,
-		JOB_REQ_WCKEYID,
-		JOB_REQ_ARRAY_PENDING,
-		JOB_REQ_ELG,
-		JOB_REQ_START,
-		JOB_REQ_END,
-		JOB_REQ_SUSPENDED,
-		JOB_REQ_RCPU,
-		JOB_REQ_RESVID,
-		JOB_REQ_TRES,
-		JOB_REQ_COUNT
-	};
-
-	char *suspend_req_inx[] = {
-		"time_start",
-		"time_end"
-	};
-	char *suspend_str = NULL;
-	enum {
-		SUSPEND_REQ_START,
-		SUSPEND_REQ_END,
-		SUSPEND_REQ_COUNT
-	};
-
-	i=0;
-	xstrfmtcat(job_str, "%s", job_req_inx[i]);
-	for(i=1; i<JOB_REQ_COUNT; i++) {
-		xstrfmtcat(job_str, ", %s", job_req_inx[i]);
-	}
-
-	i=0;
-	xstrfmtcat(suspend_str, "%s", suspend_req_inx[i]);
-	for(i=1; i<SUSPEND_REQ_COUNT; i++) {
-		xstrfmtcat(suspend_str, ", %s", suspend_req_inx[i]);
-	}
-
-	/* We need to figure out the dimensions of this cluster */
-	query = xstrdup_printf("select dimensions from %s where name='%s'",
-			       cluster_table, cluster_name);
-	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-	result = mysql_db_query_ret(mysql_conn, query, 0);
-	xfree(query);
-
-	if (!result) {
-		error("%s: error querying cluster_table", __func__);
-		rc = SLURM_ERROR;
-		goto end_it;
-	}
-	row = mysql_fetch_row(result);
 
-	if (!row) {
-		error("%s: no cluster by name %s known",
-		      __func__, cluster_name);
-		rc = SLURM_ERROR;
-		goto end_it;
-	}
+	suspend_str = _req_inx_str(suspend_req_inx, SUSPEND_REQ_COUNT);
 
-	dims = atoi(row[0]);
-	mysql_free_result(result);
-
-/* 	info("begin start %s", slurm_ctime2(&curr_start)); */
-/* 	info("begin end %s", slurm_ctime2(&curr_end)); */
 	a_itr = list_iterator_create(assoc_usage_list);
 	c_itr = list_iterator_create(cluster_down_list);
 	w_itr = list_iterator_create(wckey_usage_list);
 	r_itr = list_iterator_create(resv_usage_list);
-	while (curr_start < end) {
-		int last_id = -1;
-		int last_wckeyid = -1;
 
-		DB_DEBUG(DB_USAGE, mysql_conn->conn,
-		         "%s curr hour is now %ld-%ld",
-		         cluster_name, curr_start, curr_end);
+	DB_DEBUG(DB_USAGE, mysql_conn->conn,
+	         "%s curr hour is now %ld-%ld",
+	         cluster_name, curr_start, curr_end);
 /* 		info("start %s", slurm_ctime2(&curr_start)); */
 /* 		info("end %s", slurm_ctime2(&curr_end)); */
 
-		if ((rc = _setup_resv_usage(mysql_conn, cluster_name,
-					    curr_start, curr_end,
-					    resv_usage_list, dims))
-		    != SLURM_SUCCESS)
-			goto end_it;
+	_setup_resv_usage(&range->resv_rows, curr_start, curr_end,
+			  resv_usage_list, range->dims);
 
-		c_usage = _setup_cluster_usage(mysql_conn, cluster_name,
-					       curr_start, curr_end,
-					       resv_usage_list,
-					       cluster_down_list,
-					       dims);
-
-		if (c_usage)
-			xassert(c_usage->loc_tres);
-
-		/* now get the jobs during this time only  */
-		query = xstrdup_printf("select %s from \"%s_%s\" as job "
-				       "where (job.time_eligible && "
-				       "job.time_eligible < %ld && "
-				       "(job.time_end >= %ld || "
-				       "job.time_end = 0)) "
-				       "group by job.job_db_inx "
-				       "order by job.id_assoc, "
-				       "job.time_eligible",
-				       job_str, cluster_name, job_table,
-				       curr_end, curr_start);
+	c_usage = _setup_cluster_usage(&range->event_rows,
+				       curr_start, curr_end,
+				       resv_usage_list,
+				       cluster_down_list,
+				       range->dims);
 
-		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
-		if (!(result = mysql_db_query_ret(
-			      mysql_conn, query, 0))) {
-			rc = SLURM_ERROR;
-			goto end_it;
-		}
-		xfree(query);
+	if (c_usage)
+		xassert(c_usage->loc_tres);
+
+	/* now go through the jobs during this time only */
+	for (j = 0; j < range->job_rows.cnt; j++) {
+		MYSQL_ROW row = range->job_rows.rows[j];
+		//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
+		uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
+		uint32_t array_pending =
+			slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
+		uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
+		time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
+		time_t row_start = slurm_atoul(row[JOB_REQ_START]);
+		time_t row_end = slurm_atoul(row[JOB_REQ_END]);
+		uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
+		List loc_tres = NULL;
+		int loc_seconds = 0;
+		int seconds = 0, suspend_seconds = 0;
+
+		/* Same as the job query used to do for every hour */
+		if (!row_eligible || (row_eligible >= curr_end) ||
+		    (row_end && (row_end < curr_start)))
+			continue;
 
-		while ((row = mysql_fetch_row(result))) {
-			//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
-			uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
-			uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
-			uint32_t array_pending =
-				slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
-			uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
-			time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
-			time_t row_start = slurm_atoul(row[JOB_REQ_START]);
-			time_t row_end = slurm_atoul(row[JOB_REQ_END]);
-			uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
-			List loc_tres = NULL;
-			int loc_seconds = 0;
-			int seconds = 0, suspend_seconds = 0;
-
-			if (row_start && (row_start < curr_start))
-				row_start = curr_start;
-
-			if (!row_start && row_end)
-				row_start = row_end;
-
-			if (!row_end || row_end > curr_end)
-				row_end = curr_end;
-
-			if (!row_start || ((row_end - row_start) < 1))
-				goto calc_cluster;
-
-			seconds = (row_end - row_start);
-
-			if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
-				MYSQL_RES *result2 = NULL;
-				MYSQL_ROW row2;
-				/* get the suspended time for this job */
-				query = xstrdup_printf(
-					"select %s from \"%s_%s\" where "
-					"(time_start < %ld && (time_end >= %ld "
-					"|| time_end = 0)) && job_db_inx=%s "
-					"order by time_start",
-					suspend_str, cluster_name,
-					suspend_table,
-					curr_end, curr_start,
-					row[JOB_REQ_DB_INX]);
-
-				debug4("%d(%s:%d) query\n%s",
-				       mysql_conn->conn, THIS_FILE,
-				       __LINE__, query);
-				if (!(result2 = mysql_db_query_ret(
-					      mysql_conn,
-					      query, 0))) {
-					rc = SLURM_ERROR;
-					mysql_free_result(result);
-					goto end_it;
-				}
-				xfree(query);
-				while ((row2 = mysql_fetch_row(result2))) {
-					int tot_time = 0;
-					time_t local_start = slurm_atoul(
-						row2[SUSPEND_REQ_START]);
-					time_t local_end = slurm_atoul(
-						row2[SUSPEND_REQ_END]);
-
-					if (!local_start)
-						continue;
-
-					if (row_start > local_start)
-						local_start = row_start;
-					if (!local_end || row_end < local_end)
-						local_end = row_end;
-					tot_time = (local_end - local_start);
-
-					if (tot_time > 0)
-						suspend_seconds += tot_time;
-				}
-				mysql_free_result(result2);
-			}
+		if (row_start && (row_start < curr_start))
+			row_start = curr_start;
 
-			if (last_id != assoc_id) {
-				a_usage = xmalloc(sizeof(local_id_usage_t));
-				a_usage->id = assoc_id;
-				list_append(assoc_usage_list, a_usage);
-				last_id = assoc_id;
-				/* a_usage->loc_tres is made later,
-				   don't do it here.
-				*/
-			}
+		if (!row_start && row_end)
+			row_start = row_end;
+
+		if (!row_end || row_end > curr_end)
+			row_end = curr_end;
 
-			/* Short circuit this so so we don't get a pointer. */
-			if (!track_wckey)
-				last_wckeyid = wckey_id;
+		if (!row_start || ((row_end - row_start) < 1))
+			goto calc_cluster;
+
+		seconds = (row_end - row_start);
+
+		if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
+			MYSQL_RES *result2 = NULL;
+			MYSQL_ROW row2;
+			/* get the suspended time for this job */
+			query = xstrdup_printf(
+				"select %s from \"%s_%s\" where "
+				"(time_start < %ld && (time_end >= %ld "
+				"|| time_end = 0)) && job_db_inx=%s "
+				"order by time_start",
+				suspend_str, cluster_name,
+				suspend_table,
+				curr_end, curr_start,
+				row[JOB_REQ_DB_INX]);
+
+			debug4("%d(%s:%d) query\n%s",
+			       mysql_conn->conn, THIS_FILE,
+			       __LINE__, query);
+			if (!(result2 = mysql_db_query_ret(
+				      mysql_conn,
+				      query, 0))) {
+				rc = SLURM_ERROR;
+				goto end_it;
+			}
+			xfree(query);
+			while ((row2 = mysql_fetch_row(result2))) {
+				int tot_time = 0;
+				time_t local_start = slurm_atoul(
+					row2[SUSPEND_REQ_START]);
+				time_t local_end = slurm_atoul(
+					row2[SUSPEND_REQ_END]);
+
+				if (!local_start)
+					continue;
 
-			/* do the wckey calculation */
-			if (last_wckeyid != wckey_id) {
-				list_iterator_reset(w_itr);
-				while ((w_usage = list_next(w_itr)))
-					if (w_usage->id == wckey_id)
-						break;
+				if (row_start > local_start)
+					local_start = row_start;
+				if (!local_end || row_end < local_end)
+					local_end = row_end;
+				tot_time = (local_end - local_start);
 
-				if (!w_usage) {
-					w_usage = xmalloc(
-						sizeof(local_id_usage_t));
-					w_usage->id = wckey_id;
-					list_append(wckey_usage_list,
-						    w_usage);
-					w_usage->loc_tres = list_create(
-						_destroy_local_tres_usage);
-				}
-				last_wckeyid = wckey_id;
+				if (tot_time > 0)
+					suspend_seconds += tot_time;
 			}
+			mysql_free_result(result2);
+		}
 
-			/* do the cluster allocated calculation */
-		calc_cluster:
+		if (last_id != assoc_id) {
+			a_usage = xmalloc(sizeof(local_id_usage_t));
+			a_usage->id = assoc_id;
+			list_append(assoc_usage_list, a_usage);
+			last_id = assoc_id;
+			/* a_usage->loc_tres is made later,
+			   don't do it here.
+			*/
+		}
 
-			/*
-			 * We need to have this clean for each job
-			 * since we add the time to the cluster individually.
-			 */
-			loc_tres = list_create(_destroy_local_tres_usage);
+		/* Short circuit this so so we don't get a pointer. */
+		if (!track_wckey)
+			last_wckeyid = wckey_id;
+
+		/* do the wckey calculation */
+		if (last_wckeyid != wckey_id) {
+			list_iterator_reset(w_itr);
+			while ((w_usage = list_next(w_itr)))
+				if (w_usage->id == wckey_id)
+					break;
+
+			if (!w_usage) {
+				w_usage = xmalloc(
+					sizeof(local_id_usage_t));
+				w_usage->id = wckey_id;
+				list_append(wckey_usage_list,
+					    w_usage);
+				w_usage->loc_tres = list_create(
+					_destroy_local_tres_usage);
+			}
+			last_wckeyid = wckey_id;
+		}
 
-			_add_tres_time_2_list(loc_tres, row[JOB_REQ_TRES],
+		/* do the cluster allocated calculation */
+	calc_cluster:
+
+		/*
+		 * We need to have this clean for each job
+		 * since we add the time to the cluster individually.
+		 */
+		loc_tres = list_create(_destroy_local_tres_usage);
+
+		_add_tres_time_2_list(loc_tres, row[JOB_REQ_TRES],
+				      TIME_ALLOC, seconds,
+				      suspend_seconds, 0);
+		if (w_usage)
+			_add_tres_time_2_list(w_usage->loc_tres,
+					      row[JOB_REQ_TRES],
 					      TIME_ALLOC, seconds,
 					      suspend_seconds, 0);
-			if (w_usage)
-				_add_tres_time_2_list(w_usage->loc_tres,
-						      row[JOB_REQ_TRES],
-						      TIME_ALLOC, seconds,
-						      suspend_seconds, 0);
-
-			/*
-			 * Now figure out there was a disconnected
-			 * slurmctld during this job.
-			 */
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				int temp_end = row_end;
-				int temp_start = row_start;
-				if (loc_c_usage->start > temp_start)
-					temp_start = loc_c_usage->start;
-				if (loc_c_usage->end < temp_end)
-					temp_end = loc_c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds < 1)
-					continue;
 
-				_remove_job_tres_time_from_cluster(
-					loc_c_usage->loc_tres,
-					loc_tres,
-					loc_seconds);
-				/* info("Job %u was running for " */
-				/*      "%d seconds while " */
-				/*      "cluster %s's slurmctld " */
-				/*      "wasn't responding", */
-				/*      job_id, loc_seconds, cluster_name); */
-			}
+		/*
+		 * Now figure out there was a disconnected
+		 * slurmctld during this job.
+		 */
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
+			int temp_end = row_end;
+			int temp_start = row_start;
+			if (loc_c_usage->start > temp_start)
+				temp_start = loc_c_usage->start;
+			if (loc_c_usage->end < temp_end)
+				temp_end = loc_c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds < 1)
+				continue;
 
-			/* first figure out the reservation */
-			if (resv_id) {
-				if (seconds <= 0) {
-					_transfer_loc_tres(&loc_tres, a_usage);
-					continue;
-				}
-				/*
-				 * Since we have already added the entire
-				 * reservation as used time on the cluster we
-				 * only need to calculate the used time for the
-				 * reservation and then divy up the unused time
-				 * over the associations able to run in the
-				 * reservation. Since the job was to run, or ran
-				 * a reservation we don't care about eligible
-				 * time since that could totally skew the
-				 * clusters reserved time since the job may be
-				 * able to run outside of the reservation.
-				 */
-				list_iterator_reset(r_itr);
-				while ((r_usage = list_next(r_itr))) {
-					int temp_end, temp_start;
-					/*
-					 * since the reservation could have
-					 * changed in some way, thus making a
-					 * new reservation record in the
-					 * database, we have to make sure all
-					 * of the reservations are checked to
-					 * see if such a thing has happened
-					 */
-					if (r_usage->id != resv_id)
-						continue;
-					temp_end = row_end;
-					temp_start = row_start;
-					if (r_usage->start > temp_start)
-						temp_start =
-							r_usage->start;
-					if (r_usage->end < temp_end)
-						temp_end = r_usage->end;
-
-					loc_seconds = (temp_end - temp_start);
-
-					if (loc_seconds <= 0)
-						continue;
-
-					if (c_usage &&
-					    (r_usage->flags &
-					     RESERVE_FLAG_IGN_JOBS))
-						/*
-						 * job usage was not
-						 * bundled with resv
-						 * usage so need to
-						 * account for it
-						 * individually here
-						 */
-						_add_tres_time_2_list(
-							c_usage->loc_tres,
-							row[JOB_REQ_TRES],
-							TIME_ALLOC,
-							loc_seconds,
-							0, 0);
-
-					_add_time_tres_list(
-						r_usage->loc_tres,
-						loc_tres, TIME_ALLOC,
-						loc_seconds, 1);
-					if ((rc = _update_unused_wall(
-						     r_usage,
-						     loc_tres,
-						     loc_seconds))
-					    != SLURM_SUCCESS)
-						goto end_it;
-				}
+			_remove_job_tres_time_from_cluster(
+				loc_c_usage->loc_tres,
+				loc_tres,
+				loc_seconds);
+			/* info("Job %u was running for " */
+			/*      "%d seconds while " */
+			/*      "cluster %s's slurmctld " */
+			/*      "wasn't responding", */
+			/*      job_id, loc_seconds, cluster_name); */
+		}
 
+		/* first figure out the reservation */
+		if (resv_id) {
+			if (seconds <= 0) {
 				_transfer_loc_tres(&loc_tres, a_usage);
 				continue;
 			}
-
 			/*
-			 * only record time for the clusters that have
-			 * registered.  This continue should rarely if
-			 * ever happen.
+			 * Since we have already added the entire
+			 * reservation as used time on the cluster we
+			 * only need to calculate the used time for the
+			 * reservation and then divy up the unused time
+			 * over the associations able to run in the
+			 * reservation. Since the job was to run, or ran
+			 * a reservation we don't care about eligible
+			 * time since that could totally skew the
+			 * clusters reserved time since the job may be
+			 * able to run outside of the reservation.
 			 */
-			if (!c_usage) {
-				_transfer_loc_tres(&loc_tres, a_usage);
-				continue;
-			}
+			list_iterator_reset(r_itr);
+			while ((r_usage = list_next(r_itr))) {
+				int temp_end, temp_start;
+				/*
+				 * since the reservation could have
+				 * changed in some way, thus making a
+				 * new reservation record in the
+				 * database, we have to make sure all
+				 * of the reservations are checked to
+				 * see if such a thing has happened
+				 */
+				if (r_usage->id != resv_id)
+					continue;
+				temp_end = row_end;
+				temp_start = row_start;
+				if (r_usage->start > temp_start)
+					temp_start =
+						r_usage->start;
+				if (r_usage->end < temp_end)
+					temp_end = r_usage->end;
 
-			if (row_start && (seconds > 0)) {
-				/* info("%d assoc %d adds " */
-				/*      "(%d)(%d-%d) * %d = %d " */
-				/*      "to %d", */
-				/*      job_id, */
-				/*      a_usage->id, */
-				/*      seconds, */
-				/*      row_end, row_start, */
-				/*      row_acpu, */
-				/*      seconds * row_acpu, */
-				/*      row_acpu); */
-
-				_add_job_alloc_time_to_cluster(
-					c_usage->loc_tres,
-					loc_tres);
-			}
+				loc_seconds = (temp_end - temp_start);
 
-			/*
-			 * The loc_tres isn't needed after this so transfer to
-			 * the association and go on our merry way.
-			 */
-			_transfer_loc_tres(&loc_tres, a_usage);
+				if (loc_seconds <= 0)
+					continue;
 
-			/* now reserved time */
-			if (!row_start || (row_start >= c_usage->start)) {
-				int temp_end = row_start;
-				int temp_start = row_eligible;
-				if (c_usage->start > temp_start)
-					temp_start = c_usage->start;
-				if (c_usage->end < temp_end)
-					temp_end = c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds > 0) {
+				if (c_usage &&
+				    (r_usage->flags &
+				     RESERVE_FLAG_IGN_JOBS))
 					/*
-					 * If we have pending jobs in an array
-					 * they haven't been inserted into the
-					 * database yet as proper job records,
-					 * so handle them here.
+					 * job usage was not
+					 * bundled with resv
+					 * usage so need to
+					 * account for it
+					 * individually here
 					 */
-					if (array_pending)
-						loc_seconds *= array_pending;
-
-					/* info("%d assoc %d reserved " */
-					/*      "(%d)(%d-%d) * %d * %d = %d " */
-					/*      "to %d", */
-					/*      job_id, */
-					/*      assoc_id, */
-					/*      temp_end - temp_start, */
-					/*      temp_end, temp_start, */
-					/*      row_rcpu, */
-					/*      array_pending, */
-					/*      loc_seconds, */
-					/*      row_rcpu); */
-
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_RESV, TRES_CPU,
-						       loc_seconds *
-						       (uint64_t) row_rcpu,
-						       0);
-				}
+					_add_tres_time_2_list(
+						c_usage->loc_tres,
+						row[JOB_REQ_TRES],
+						TIME_ALLOC,
+						loc_seconds,
+						0, 0);
+
+				_add_time_tres_list(
+					r_usage->loc_tres,
+					loc_tres, TIME_ALLOC,
+					loc_seconds, 1);
+				if ((rc = _update_unused_wall(
+					     r_usage,
+					     loc_tres,
+					     loc_seconds))
+				    != SLURM_SUCCESS)
+					goto end_it;
 			}
+
+			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
 		}
-		mysql_free_result(result);
 
-		/* now figure out how much more to add to the
-		   associations that could had run in the reservation
-		*/
-		query = NULL;
-		list_iterator_reset(r_itr);
-		while ((r_usage = list_next(r_itr))) {
-			ListIterator t_itr;
-			local_tres_usage_t *loc_tres;
+		/*
+		 * only record time for the clusters that have
+		 * registered.  This continue should rarely if
+		 * ever happen.
+		 */
+		if (!c_usage) {
+			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
+		}
 
-			xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
-				   cluster_name, resv_table,
-				   r_usage->unused_wall, r_usage->id,
-				   r_usage->orig_start);
+		if (row_start && (seconds > 0)) {
+			/* info("%d assoc %d adds " */
+			/*      "(%d)(%d-%d) * %d = %d " */
+			/*      "to %d", */
+			/*      job_id, */
+			/*      a_usage->id, */
+			/*      seconds, */
+			/*      row_end, row_start, */
+			/*      row_acpu, */
+			/*      seconds * row_acpu, */
+			/*      row_acpu); */
+
+			_add_job_alloc_time_to_cluster(
+				c_usage->loc_tres,
+				loc_tres);
+		}
 
-			if (!r_usage->loc_tres ||
-			    !list_count(r_usage->loc_tres))
-				continue;
+		/*
+		 * The loc_tres isn't needed after this so transfer to
+		 * the association and go on our merry way.
+		 */
+		_transfer_loc_tres(&loc_tres, a_usage);
+
+		/* now reserved time */
+		if (!row_start || (row_start >= c_usage->start)) {
+			int temp_end = row_start;
+			int temp_start = row_eligible;
+			if (c_usage->start > temp_start)
+				temp_start = c_usage->start;
+			if (c_usage->end < temp_end)
+				temp_end = c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds > 0) {
+				/*
+				 * If we have pending jobs in an array
+				 * they haven't been inserted into the
+				 * database yet as proper job records,
+				 * so handle them here.
+				 */
+				if (array_pending)
+					loc_seconds *= array_pending;
 
-			t_itr = list_iterator_create(r_usage->loc_tres);
-			while ((loc_tres = list_next(t_itr))) {
-				int64_t idle = loc_tres->total_time -
-					loc_tres->time_alloc;
-				char *assoc = NULL;
-				ListIterator tmp_itr = NULL;
-				int assoc_cnt, resv_unused_secs;
-
-				if (idle <= 0)
-					break; /* since this will be
-						* the same for all TRES	*/
-
-				/* now divide that time by the number of
-				   associations in the reservation and add
-				   them to each association */
-				resv_unused_secs = idle;
-				assoc_cnt = list_count(r_usage->local_assocs);
-				if (assoc_cnt)
-					resv_unused_secs /= assoc_cnt;
-				/* info("resv %d got %d seconds for TRES %u " */
-				/*      "for %d assocs", */
-				/*      r_usage->id, resv_unused_secs, */
-				/*      loc_tres->id, */
-				/*      list_count(r_usage->local_assocs)); */
-				tmp_itr = list_iterator_create(
-					r_usage->local_assocs);
-				while ((assoc = list_next(tmp_itr))) {
-					uint32_t associd = slurm_atoul(assoc);
-					if ((last_id != associd) &&
-					    !(a_usage = list_find_first(
-						      assoc_usage_list,
-						      _find_id_usage,
-						      &associd))) {
-						a_usage = xmalloc(
-							sizeof(local_id_usage_t));
-						a_usage->id = associd;
-						list_append(assoc_usage_list,
-							    a_usage);
-						last_id = associd;
-						a_usage->loc_tres = list_create(
-							_destroy_local_tres_usage);
-					}
-
-					_add_time_tres(a_usage->loc_tres,
-						       TIME_ALLOC, loc_tres->id,
-						       resv_unused_secs, 0);
-				}
-				list_iterator_destroy(tmp_itr);
+				/* info("%d assoc %d reserved " */
+				/*      "(%d)(%d-%d) * %d * %d = %d " */
+				/*      "to %d", */
+				/*      job_id, */
+				/*      assoc_id, */
+				/*      temp_end - temp_start, */
+				/*      temp_end, temp_start, */
+				/*      row_rcpu, */
+				/*      array_pending, */
+				/*      loc_seconds, */
+				/*      row_rcpu); */
+
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_RESV, TRES_CPU,
+					       loc_seconds *
+					       (uint64_t) row_rcpu,
+					       0);
 			}
-			list_iterator_destroy(t_itr);
 		}
+	}
 
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("couldn't update reservations with unused time");
-				goto end_it;
-			}
-		}
+	/* now figure out how much more to add to the
+	   associations that could had run in the reservation
+	*/
+	list_iterator_reset(r_itr);
+	while ((r_usage = list_next(r_itr))) {
+		ListIterator t_itr;
+		local_tres_usage_t *loc_tres;
 
-		/* now apply the down time from the slurmctld disconnects */
-		if (c_usage) {
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				local_tres_usage_t *loc_tres;
-				ListIterator tmp_itr = list_iterator_create(
-					loc_c_usage->loc_tres);
-				while ((loc_tres = list_next(tmp_itr)))
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_DOWN,
-						       loc_tres->id,
-						       loc_tres->total_time,
-						       0);
-				list_iterator_destroy(tmp_itr);
-			}
+		if (!r_usage->loc_tres ||
+		    !list_count(r_usage->loc_tres))
+			continue;
 
-			if ((rc = _process_cluster_usage(
-				     mysql_conn, cluster_name, curr_start,
-				     curr_end, now, c_usage))
-			    != SLURM_SUCCESS) {
-				goto end_it;
+		t_itr = list_iterator_create(r_usage->loc_tres);
+		while ((loc_tres = list_next(t_itr))) {
+			int64_t idle = loc_tres->total_time -
+				loc_tres->time_alloc;
+			char *assoc = NULL;
+			ListIterator tmp_itr = NULL;
+			int assoc_cnt, resv_unused_secs;
+
+			if (idle <= 0)
+				break; /* since this will be
+					* the same for all TRES	*/
+
+			/* now divide that time by the number of
+			   associations in the reservation and add
+			   them to each association */
+			resv_unused_secs = idle;
+			assoc_cnt = list_count(r_usage->local_assocs);
+			if (assoc_cnt)
+				resv_unused_secs /= assoc_cnt;
+			/* info("resv %d got %d seconds for TRES %u " */
+			/*      "for %d assocs", */
+			/*      r_usage->id, resv_unused_secs, */
+			/*      loc_tres->id, */
+			/*      list_count(r_usage->local_assocs)); */
+			tmp_itr = list_iterator_create(
+				r_usage->local_assocs);
+			while ((assoc = list_next(tmp_itr))) {
+				uint32_t associd = slurm_atoul(assoc);
+				if ((last_id != associd) &&
+				    !(a_usage = list_find_first(
+					      assoc_usage_list,
+					      _find_id_usage,
+					      &associd))) {
+					a_usage = xmalloc(
+						sizeof(local_id_usage_t));
+					a_usage->id = associd;
+					list_append(assoc_usage_list,
+						    a_usage);
+					last_id = associd;
+					a_usage->loc_tres = list_create(
+						_destroy_local_tres_usage);
+				}
+
+				_add_time_tres(a_usage->loc_tres,
+					       TIME_ALLOC, loc_tres->id,
+					       resv_unused_secs, 0);
 			}
+			list_iterator_destroy(tmp_itr);
 		}
+		list_iterator_destroy(t_itr);
+	}
 
-		list_iterator_reset(a_itr);
-		while ((a_usage = list_next(a_itr)))
-			_create_id_usage_insert(cluster_name, ASSOC_TABLES,
-						curr_start, now,
-						a_usage, &query);
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add assoc hour rollup");
-				goto end_it;
-			}
+	/* now apply the down time from the slurmctld disconnects */
+	if (c_usage) {
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
+			local_tres_usage_t *loc_tres;
+			ListIterator tmp_itr = list_iterator_create(
+				loc_c_usage->loc_tres);
+			while ((loc_tres = list_next(tmp_itr)))
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_DOWN,
+					       loc_tres->id,
+					       loc_tres->total_time,
+					       0);
+			list_iterator_destroy(tmp_itr);
 		}
 
-		if (!track_wckey)
-			goto end_loop;
-
-		list_iterator_reset(w_itr);
-		while ((w_usage = list_next(w_itr)))
-			_create_id_usage_insert(cluster_name, WCKEY_TABLES,
-						curr_start, now,
-						w_usage, &query);
-		if (query) {
-			DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
-			         query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add wckey hour rollup");
-				goto end_it;
-			}
+		if ((rc = _process_cluster_usage(
+			     mysql_conn, cluster_name, curr_start,
+			     curr_end, now, c_usage))
+		    != SLURM_SUCCESS) {
+			goto end_it;
 		}
+	}
 
-	end_loop:
-		_destroy_local_cluster_usage(c_usage);
+	list_iterator_reset(a_itr);
+	while ((a_usage = list_next(a_itr)))
+		_create_id_usage_insert(cluster_name, ASSOC_TABLES,
+					curr_start, now,
+					a_usage, &query);
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
+		         query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't add assoc hour rollup");
+			goto end_it;
+		}
+	}
 
-		c_usage     = NULL;
-		r_usage     = NULL;
-		a_usage     = NULL;
-		w_usage     = NULL;
+	if (!track_wckey)
+		goto end_it;
 
-		list_flush(assoc_usage_list);
-		list_flush(cluster_down_list);
-		list_flush(wckey_usage_list);
-		list_flush(resv_usage_list);
-		curr_start = curr_end;
-		curr_end = curr_start + add_sec;
+	list_iterator_reset(w_itr);
+	while ((w_usage = list_next(w_itr)))
+		_create_id_usage_insert(cluster_name, WCKEY_TABLES,
+					curr_start, now,
+					w_usage, &query);
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s",
+		         query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't add wckey hour rollup");
+			goto end_it;
+		}
 	}
+
 end_it:
 	xfree(query);
 	xfree(suspend_str);
-	xfree(job_str);
 	_destroy_local_cluster_usage(c_usage);
 
-	if (a_itr)
-		list_iterator_destroy(a_itr);
-	if (c_itr)
-		list_iterator_destroy(c_itr);
-	if (w_itr)
-		list_iterator_destroy(w_itr);
-	if (r_itr)
-		list_iterator_destroy(r_itr);
+	list_iterator_destroy(a_itr);
+	list_iterator_destroy(c_itr);
+	list_iterator_destroy(w_itr);
+	list_iterator_destroy(r_itr);
 
 	FREE_NULL_LIST(assoc_usage_list);
 	FREE_NULL_LIST(cluster_down_list);
 	FREE_NULL_LIST(wckey_usage_list);
-	FREE_NULL_LIST(resv_usage_list);
+
+	return rc;
+}
+
+/*
+ * Worker for a range rolled up with RollupThreads.  Each worker has its own
+ * connection and commits the hours it did when there are none left.
+ */
+static void *_hour_rollup_thread(void *arg)
+{
+	hour_range_t *range = (hour_range_t *)arg;
+	local_hour_t *hour;
+	mysql_conn_t mysql_conn;
+	int rc;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = range->mysql_conn->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	if ((rc = check_connection(&mysql_conn)) != SLURM_SUCCESS)
+		goto end_it;
+
+	while (rc == SLURM_SUCCESS) {
+		slurm_mutex_lock(&range->lock);
+		if (range->rc || (range->next_hour >= range->hour_cnt)) {
+			slurm_mutex_unlock(&range->lock);
+			break;
+		}
+		hour = &range->hours[range->next_hour++];
+		slurm_mutex_unlock(&range->lock);
+
+		rc = _hour_rollup(&mysql_conn, range, hour);
+	}
+
+	if ((rc == SLURM_SUCCESS) && mysql_db_commit(&mysql_conn)) {
+		error("Couldn't commit cluster (%s) hour rollup",
+		      range->cluster_name);
+		rc = SLURM_ERROR;
+	}
+
+end_it:
+	if (rc != SLURM_SUCCESS) {
+		slurm_mutex_lock(&range->lock);
+		if (!range->rc)
+			range->rc = rc;
+		slurm_mutex_unlock(&range->lock);
+	}
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+
+	return NULL;
+}
+
+static int _find_resv_unused(void *x, void *key)
+{
+	resv_unused_t *resv_unused = (resv_unused_t *)x;
+	local_resv_usage_t *r_usage = (local_resv_usage_t *)key;
+
+	if ((resv_unused->id == r_usage->id) &&
+	    (resv_unused->orig_start == r_usage->orig_start))
+		return 1;
+	return 0;
+}
+
+/*
+ * Walk the hours of the range in order to figure out the unused_wall of each
+ * reservation at the end of the range.  This is done here instead of in each
+ * hour since an hour needs the unused_wall left by the one before it.
+ */
+static int _update_resv_unused_wall(mysql_conn_t *mysql_conn,
+				    hour_range_t *range)
+{
+	int rc = SLURM_SUCCESS;
+	int i;
+	char *query = NULL;
+	List resv_unused_list = list_create(xfree_ptr);
+	ListIterator itr;
+	local_resv_usage_t *r_usage;
+	resv_unused_t *resv_unused;
+
+	for (i = 0; i < range->hour_cnt; i++) {
+		itr = list_iterator_create(range->hours[i].resv_usage_list);
+		while ((r_usage = list_next(itr))) {
+			if (!(resv_unused = list_find_first(resv_unused_list,
+							    _find_resv_unused,
+							    r_usage))) {
+				resv_unused = xmalloc(sizeof(resv_unused_t));
+				resv_unused->id = r_usage->id;
+				resv_unused->orig_start = r_usage->orig_start;
+				resv_unused->unused_wall = r_usage->unused_wall;
+				list_append(resv_unused_list, resv_unused);
+			} else
+				resv_unused->unused_wall +=
+					r_usage->end - r_usage->start;
+
+			resv_unused->unused_wall -= r_usage->used_wall;
+			if (resv_unused->unused_wall < 0) {
+				/*
+				 * With a Flex reservation you can easily have
+				 * more time than is possible.  Just print this
+				 * debug3 warning if it happens.
+				 */
+				debug3("WARNING: Unused wall is less than zero; this should never happen outside a Flex reservation. Setting it to zero for resv id = %d, start = %ld.",
+				       r_usage->id, r_usage->orig_start);
+				resv_unused->unused_wall = 0;
+			}
+		}
+		list_iterator_destroy(itr);
+	}
+
+	itr = list_iterator_create(resv_unused_list);
+	while ((resv_unused = list_next(itr)))
+		xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
+			   range->cluster_name, resv_table,
+			   resv_unused->unused_wall, resv_unused->id,
+			   resv_unused->orig_start);
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(resv_unused_list);
+
+	if (query) {
+		DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS)
+			error("couldn't update reservations with unused time");
+	}
+
+	return rc;
+}
+
+/*
+ * Get the events, reservations and jobs for the whole range in one query
+ * each.  The hours pick out what they need from these rows.
+ */
+static int _get_range_rows(mysql_conn_t *mysql_conn, hour_range_t *range,
+			   time_t range_start, time_t range_end)
+{
+	int rc;
+	char *query, *str;
+
+	str = _req_inx_str(event_req_inx, EVENT_REQ_COUNT);
+	/*
+	 * All events except things with the maintainance flag set in the
+	 * state.  We handle those later with the reservations.
+	 */
+	query = xstrdup_printf("select %s from \"%s_%s\" where "
+			       "!(state & %d) && (time_start < %ld "
+			       "&& (time_end >= %ld "
+			       "|| time_end = 0)) "
+			       "order by node_name, time_start",
+			       str, range->cluster_name, event_table,
+			       NODE_STATE_MAINT,
+			       range_end, range_start);
+	xfree(str);
+	rc = _get_rollup_rows(mysql_conn, query, &range->event_rows);
+	xfree(query);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	str = _req_inx_str(resv_req_inx, RESV_REQ_COUNT);
+	query = xstrdup_printf("select %s from \"%s_%s\" where "
+			       "(time_start < %ld && time_end >= %ld) "
+			       "order by time_start",
+			       str, range->cluster_name, resv_table,
+			       range_end, range_start);
+	xfree(str);
+	rc = _get_rollup_rows(mysql_conn, query, &range->resv_rows);
+	xfree(query);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	str = _req_inx_str(job_req_inx, JOB_REQ_COUNT);
+	query = xstrdup_printf("select %s from \"%s_%s\" as job ",
+			       str, range->cluster_name, job_table);
+	xfree(str);
+	/*
+	 * Looking at time_eligible and time_end goes through most of the job
+	 * table, rollup_job_table only has the jobs that can still be running.
+	 */
+	if (range->rollup_job_time && (range->rollup_job_time <= range_start))
+		xstrfmtcat(query, "inner join \"%s_%s\" as rjob "
+			   "on rjob.job_db_inx=job.job_db_inx ",
+			   range->cluster_name, rollup_job_table);
+	xstrfmtcat(query, "where (job.time_eligible && "
+		   "job.time_eligible < %ld && "
+		   "(job.time_end >= %ld || "
+		   "job.time_end = 0)) "
+		   "group by job.job_db_inx "
+		   "order by job.id_assoc, "
+		   "job.time_eligible",
+		   range_end, range_start);
+	rc = _get_rollup_rows(mysql_conn, query, &range->job_rows);
+	xfree(query);
+
+	return rc;
+}
+
+static void _free_range(hour_range_t *range)
+{
+	int i;
+
+	_free_rollup_rows(&range->event_rows);
+	_free_rollup_rows(&range->resv_rows);
+	_free_rollup_rows(&range->job_rows);
+
+	for (i = 0; i < range->hour_cnt; i++)
+		FREE_NULL_LIST(range->hours[i].resv_usage_list);
+	range->hour_cnt = 0;
+	range->next_hour = 0;
+	range->rc = SLURM_SUCCESS;
+}
+
+extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
+				  char *cluster_name,
+				  time_t start, time_t end,
+				  time_t rollup_job_time,
+				  uint16_t archive_data)
+{
+	int rc = SLURM_SUCCESS;
+	int add_sec = 3600;
+	int i, thread_cnt;
+	int rollup_threads = 1;
+	time_t curr_start = start;
+	time_t curr_end = curr_start + add_sec;
+	char *query = NULL;
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	hour_range_t range;
+	pthread_t *thread_ids = NULL;
+
+	memset(&range, 0, sizeof(hour_range_t));
+	range.cluster_name = cluster_name;
+	range.mysql_conn = mysql_conn;
+	range.now = time(NULL);
+	range.rollup_job_time = rollup_job_time;
+	range.track_wckey = slurm_get_track_wckey();
+	slurm_mutex_init(&range.lock);
+
+	if (slurmdbd_conf && slurmdbd_conf->rollup_threads)
+		rollup_threads = slurmdbd_conf->rollup_threads;
+
+	/* We need to figure out the dimensions of this cluster */
+	query = xstrdup_printf("select dimensions from %s where name='%s'",
+			       cluster_table, cluster_name);
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+
+	if (!result) {
+		error("%s: error querying cluster_table", __func__);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+	row = mysql_fetch_row(result);
+
+	if (!row) {
+		error("%s: no cluster by name %s known",
+		      __func__, cluster_name);
+		mysql_free_result(result);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+
+	range.dims = atoi(row[0]);
+	mysql_free_result(result);
+
+/* 	info("begin start %s", slurm_ctime2(&curr_start)); */
+/* 	info("begin end %s", slurm_ctime2(&curr_end)); */
+	while (curr_start < end) {
+		time_t range_start = curr_start;
+
+		while ((curr_start < end) &&
+		       (range.hour_cnt < ROLLUP_RANGE_HOURS)) {
+			local_hour_t *hour = &range.hours[range.hour_cnt++];
+
+			hour->start = curr_start;
+			hour->end = curr_end;
+			hour->resv_usage_list =
+				list_create(_destroy_local_resv_usage);
+			curr_start = curr_end;
+			curr_end = curr_start + add_sec;
+		}
+
+		if ((rc = _get_range_rows(mysql_conn, &range,
+					  range_start, curr_start))
+		    != SLURM_SUCCESS)
+			goto end_it;
+
+		thread_cnt = MIN(rollup_threads, range.hour_cnt);
+		if (thread_cnt <= 1) {
+			for (i = 0; i < range.hour_cnt; i++) {
+				if ((rc = _hour_rollup(mysql_conn, &range,
+						       &range.hours[i]))
+				    != SLURM_SUCCESS)
+					goto end_it;
+			}
+		} else {
+			thread_ids = xcalloc(thread_cnt, sizeof(pthread_t));
+			for (i = 0; i < thread_cnt; i++)
+				slurm_thread_create(&thread_ids[i],
+						    _hour_rollup_thread,
+						    &range);
+			for (i = 0; i < thread_cnt; i++)
+				pthread_join(thread_ids[i], NULL);
+			xfree(thread_ids);
+
+			if ((rc = range.rc) != SLURM_SUCCESS)
+				goto end_it;
+		}
+
+		if ((rc = _update_resv_unused_wall(mysql_conn, &range))
+		    != SLURM_SUCCESS)
+			goto end_it;
+
+		_free_range(&range);
+	}
+end_it:
+	_free_range(&range);
+	slurm_mutex_destroy(&range.lock);
 
 /* 	info("stop start %s", slurm_ctime2(&curr_start)); */
 /* 	info("stop end %s", slurm_ctime2(&curr_end)); */
@@ -43,10 +43,17 @@
 
 #include "accounting_storage_mysql.h"
 
+/*
+ * Roll up the hours from start to end.  If rollup_job_time is set and not
+ * after start the jobs are gotten through rollup_job_table, which has every
+ * job that was running or pending at or after rollup_job_time, instead of
+ * going through the whole job table.
+ */
 extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 				  char *cluster_name,
 				  time_t start,
 				  time_t end,
+				  time_t rollup_job_time,
 				  uint16_t archive_data);
 extern int as_mysql_nonhour_rollup(mysql_conn_t *mysql_conn,
 				   bool run_month,
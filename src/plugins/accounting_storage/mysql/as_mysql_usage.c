@@ -59,6 +59,55 @@ typedef struct {
 	time_t sent_start;
 } local_rollup_t;
 
+/*
+ * rollup_job_table has the jobs the hourly rollup still needs to look at.
+ * Fill it from the job table the first time, after that jobs are added as
+ * they are started.
+ */
+static int _setup_rollup_jobs(mysql_conn_t *mysql_conn, char *cluster_name,
+			      time_t hour_start)
+{
+	int rc;
+	char *query = xstrdup_printf(
+		"insert ignore into \"%s_%s\" (job_db_inx) "
+		"select job_db_inx from \"%s_%s\" "
+		"where time_end = 0 || time_end >= %ld;"
+		"update \"%s_%s\" set rollup_job_time=%ld;",
+		cluster_name, rollup_job_table,
+		cluster_name, job_table, hour_start,
+		cluster_name, last_ran_table, hour_start);
+
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+
+	return rc;
+}
+
+/*
+ * Remove the jobs that ended before hour_end, the hours they were around for
+ * are rolled up.  Jobs that were purged are removed as well.
+ */
+static int _prune_rollup_jobs(mysql_conn_t *mysql_conn, char *cluster_name,
+			      time_t hour_end)
+{
+	int rc;
+	char *query = xstrdup_printf(
+		"delete rjob from \"%s_%s\" as rjob "
+		"left join \"%s_%s\" as job "
+		"on job.job_db_inx=rjob.job_db_inx "
+		"where job.job_db_inx is null || "
+		"(job.time_end && job.time_end < %ld);",
+		cluster_name, rollup_job_table,
+		cluster_name, job_table, hour_end);
+
+	DB_DEBUG(DB_USAGE, mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+
+	return rc;
+}
+
 static void *_cluster_rollup_usage(void *arg)
 {
 	local_rollup_t *local_rollup = (local_rollup_t *)arg;
@@ -74,6 +123,7 @@ static void *_cluster_rollup_usage(void *arg)
 	time_t last_hour = local_rollup->sent_start;
 	time_t last_day = local_rollup->sent_start;
 	time_t last_month = local_rollup->sent_start;
+	time_t rollup_job_time = 0;
 	slurmdb_rollup_stats_t *rollup_stats = local_rollup->rollup_stats;
 	time_t hour_start;
 	time_t hour_end;
@@ -86,7 +136,16 @@ static void *_cluster_rollup_usage(void *arg)
 	char *update_req_inx[] = {
 		"hourly_rollup",
 		"daily_rollup",
-		"monthly_rollup"
+		"monthly_rollup",
+		"rollup_job_time"
+	};
+
+	enum {
+		UPDATE_REQ_HOUR,
+		UPDATE_REQ_DAY,
+		UPDATE_REQ_MONTH,
+		UPDATE_REQ_ROLLUP_JOB,
+		UPDATE_REQ_COUNT
 	};
 
 	/*
@@ -109,7 +168,7 @@ static void *_cluster_rollup_usage(void *arg)
 
 	if (!local_rollup->sent_start) {
 		char *tmp = NULL, *sep = "";
-		for (i = 0; i < DBD_ROLLUP_COUNT; i++) {
+		for (i = 0; i < UPDATE_REQ_COUNT; i++) {
 			xstrfmtcat(tmp, "%s%s", sep, update_req_inx[i]);
 			sep = ", ";
 		}
@@ -129,9 +188,11 @@ static void *_cluster_rollup_usage(void *arg)
 		xfree(query);
 		row = mysql_fetch_row(result);
 		if (row) {
-			last_hour = slurm_atoul(row[DBD_ROLLUP_HOUR]);
-			last_day = slurm_atoul(row[DBD_ROLLUP_DAY]);
-			last_month = slurm_atoul(row[DBD_ROLLUP_MONTH]);
+			last_hour = slurm_atoul(row[UPDATE_REQ_HOUR]);
+			last_day = slurm_atoul(row[UPDATE_REQ_DAY]);
+			last_month = slurm_atoul(row[UPDATE_REQ_MONTH]);
+			rollup_job_time = slurm_atoul(
+				row[UPDATE_REQ_ROLLUP_JOB]);
 
 			/* only record timestamps if db provided */
 			rollup_stats->timestamp[DBD_ROLLUP_HOUR] = last_hour;
@@ -294,12 +355,21 @@ static void *_cluster_rollup_usage(void *arg)
 /* 	info("month end %s", slurm_ctime2(&month_end)); */
 /* 	info("diff is %d", month_end-month_start); */
 
+	if (!local_rollup->sent_start && !rollup_job_time) {
+		if ((rc = _setup_rollup_jobs(&mysql_conn,
+					     local_rollup->cluster_name,
+					     hour_start)) != SLURM_SUCCESS)
+			goto end_it;
+		rollup_job_time = hour_start;
+	}
+
 	if ((hour_end - hour_start) > 0) {
 		START_TIMER;
 		rc = as_mysql_hourly_rollup(&mysql_conn,
 					    local_rollup->cluster_name,
 					    hour_start,
 					    hour_end,
+					    rollup_job_time,
 					    local_rollup->archive_data);
 		snprintf(timer_str, sizeof(timer_str),
 			 "hourly_rollup for %s", local_rollup->cluster_name);
@@ -308,6 +378,12 @@ static void *_cluster_rollup_usage(void *arg)
 		rollup_stats->timestamp[DBD_ROLLUP_HOUR] = hour_end;
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
+
+		if (!local_rollup->sent_end && rollup_job_time &&
+		    ((rc = _prune_rollup_jobs(&mysql_conn,
+					      local_rollup->cluster_name,
+					      hour_end)) != SLURM_SUCCESS))
+			goto end_it;
 	}
 
 	if ((day_end - day_start) > 0) {
@@ -344,11 +420,15 @@ static void *_cluster_rollup_usage(void *arg)
 
 	if ((hour_end - hour_start) > 0) {
 		/* If we have a sent_end do not update the last_run_table */
-		if (!local_rollup->sent_end)
+		if (!local_rollup->sent_end) {
 			query = xstrdup_printf(
 				"update \"%s_%s\" set hourly_rollup=%ld",
 				local_rollup->cluster_name,
 				last_ran_table, hour_end);
+			if (rollup_job_time)
+				xstrfmtcat(query, ", rollup_job_time=%ld",
+					   hour_end);
+		}
 	} else
 		debug2("No need to roll cluster %s this hour %ld <= %ld",
 		       local_rollup->cluster_name, hour_end, hour_start);
@@ -559,3 +559,8 @@ extern int acct_storage_p_shutdown(void *db_conn, bool dbd)
 {
 	return SLURM_SUCCESS;
 }
+
+extern List acct_storage_p_get_updates(void *db_conn, uint64_t *change_id)
+{
+	return NULL;
+}
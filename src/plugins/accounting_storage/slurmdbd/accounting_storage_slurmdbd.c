@@ -3185,3 +3185,44 @@ extern int acct_storage_p_shutdown(void *db_conn)
 
 	return rc;
 }
+
+extern List acct_storage_p_get_updates(void *db_conn, uint64_t *change_id)
+{
+	slurm_persist_conn_t *persist_conn = db_conn;
+	persist_msg_t req = {0}, resp = {0};
+	dbd_updates_msg_t get_msg = {0}, *got_msg;
+	int rc;
+	List ret_list = NULL;
+
+	/* Older SlurmDBDs don't keep the changes, read everything again */
+	if (!persist_conn ||
+	    (persist_conn->version < SLURM_21_08_PROTOCOL_VERSION))
+		return NULL;
+
+	get_msg.change_id = *change_id;
+
+	req.msg_type = DBD_GET_UPDATES;
+	req.conn = db_conn;
+	req.data = &get_msg;
+	rc = dbd_conn_send_recv(SLURM_PROTOCOL_VERSION, &req, &resp);
+
+	if (rc != SLURM_SUCCESS)
+		error("DBD_GET_UPDATES failure: %m");
+	else if (resp.msg_type == PERSIST_RC) {
+		persist_rc_msg_t *msg = resp.data;
+		slurm_seterrno(msg->rc);
+		debug("%s", msg->comment);
+		slurm_persist_free_rc_msg(msg);
+	} else if (resp.msg_type != DBD_GOT_UPDATES) {
+		error("response type not DBD_GOT_UPDATES: %u",
+		      resp.msg_type);
+	} else {
+		got_msg = (dbd_updates_msg_t *) resp.data;
+		*change_id = got_msg->change_id;
+		ret_list = got_msg->update_list;
+		got_msg->update_list = NULL;
+		slurmdbd_free_updates_msg(got_msg);
+	}
+
+	return ret_list;
+}
@@ -45,16 +45,20 @@
 #include "src/common/xstring.h"
 
 #include "slurmdbd_agent.h"
+#include "slurmdbd_spool.h"
 
 enum {
 	MAX_DBD_ACTION_DISCARD,
-	MAX_DBD_ACTION_EXIT
+	MAX_DBD_ACTION_EXIT,
+	MAX_DBD_ACTION_SPOOL
 };
 
 slurm_persist_conn_t *slurmdbd_conn = NULL;
 
 
 #define DBD_MAGIC		0xDEAD3219
+#define DBD_MULT_MSG_MAX	1000	/* messages in one DBD_SEND_MULT_MSG */
+#define DBD_MULT_MSG_WINDOW	4	/* DBD_SEND_MULT_MSG without reply */
 #define DEBUG_PRINT_MAX_MSG_TYPES 10
 #define MAX_DBD_DEFAULT_ACTION MAX_DBD_ACTION_DISCARD
 
@@ -70,6 +74,12 @@ static pthread_mutex_t slurmdbd_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 
 static int max_dbd_msg_action = MAX_DBD_DEFAULT_ACTION;
+static bool spool_active = false;
+
+/* Messages at the head of agent_list sent without a reply yet */
+static uint32_t agent_inflight = 0;
+/* Sequence number of the next DBD_SEND_MULT_MSG */
+static uint32_t mult_msg_seq = 1;
 
 static int _unpack_return_code(uint16_t rpc_version, buf_t *buffer)
 {
@@ -152,7 +162,15 @@ static int _get_return_code(void)
 	return rc;
 }
 
-static int _handle_mult_rc_ret(void)
+/*
+ * Read the reply to the DBD_SEND_MULT_MSG with sequence number seq holding
+ * the first cnt messages of agent_list and remove the ones processed.
+ * IN refused - the slurmdbd refused this batch because an earlier one failed,
+ *		just read the reply
+ * RET SLURM_SUCCESS if all cnt messages were processed,
+ *     SLURM_COMMUNICATIONS_RECEIVE_ERROR if there was no reply
+ */
+static int _handle_mult_rc_ret(uint32_t seq, uint32_t cnt, bool refused)
 {
 	buf_t *buffer;
 	uint16_t msg_type;
@@ -160,10 +178,11 @@ static int _handle_mult_rc_ret(void)
 	dbd_list_msg_t *list_msg = NULL;
 	int rc = SLURM_ERROR;
 	buf_t *out_buf = NULL;
+	uint32_t acked = 0;
 
 	buffer = slurm_persist_recv_msg(slurmdbd_conn);
 	if (buffer == NULL)
-		return rc;
+		return SLURM_COMMUNICATIONS_RECEIVE_ERROR;
 
 	safe_unpack16(&msg_type, buffer);
 	switch (msg_type) {
@@ -175,12 +194,22 @@ static int _handle_mult_rc_ret(void)
 			error("unpack message error");
 			break;
 		}
+		if (refused) {
+			slurmdbd_free_list_msg(list_msg);
+			break;
+		}
+		if (list_msg->seq != seq) {
+			error("DBD_GOT_MULT_MSG sequence %u, expected %u",
+			      list_msg->seq, seq);
+			slurmdbd_free_list_msg(list_msg);
+			break;
+		}
 
 		slurm_mutex_lock(&agent_lock);
 		if (agent_list) {
 			ListIterator itr =
 				list_iterator_create(list_msg->my_list);
-			while ((out_buf = list_next(itr))) {
+			while ((out_buf = list_next(itr)) && (acked < cnt)) {
 				buf_t *b;
 				if ((rc = _unpack_return_code(
 					     slurmdbd_conn->version, out_buf))
@@ -189,6 +218,9 @@ static int _handle_mult_rc_ret(void)
 
 				if ((b = list_dequeue(agent_list))) {
 					free_buf(b);
+					if (spool_active)
+						dbd_spool_ack();
+					acked++;
 				} else {
 					error("DBD_GOT_MULT_MSG "
 					      "unpack message error");
@@ -198,6 +230,8 @@ static int _handle_mult_rc_ret(void)
 		}
 		slurm_mutex_unlock(&agent_lock);
 		slurmdbd_free_list_msg(list_msg);
+		if (acked < cnt)
+			rc = SLURM_ERROR;
 		break;
 	case PERSIST_RC:
 		if (slurm_persist_unpack_rc_msg(
@@ -360,7 +394,12 @@ static void _load_dbd_state(void)
 				error("no buffer given");
 				continue;
 			}
-			if (!list_enqueue(agent_list, buffer))
+			if (spool_active) {
+				/* The spool replaces dbd.messages */
+				if (dbd_spool_append(buffer, false))
+					error("unable to spool recovered RPC");
+				free_buf(buffer);
+			} else if (!list_enqueue(agent_list, buffer))
 				fatal("list_enqueue, no memory");
 			recovered++;
 			buffer = NULL;
@@ -369,6 +408,14 @@ static void _load_dbd_state(void)
 	end_it:
 		verbose("recovered %d pending RPCs", recovered);
 		(void) close(fd);
+		if (spool_active) {
+			dbd_spool_sync_t sync;
+
+			/* Only once at startup, agent_lock is not contended */
+			dbd_spool_sync_prep(&sync, true);
+			dbd_spool_sync_fds(&sync);
+			(void) unlink(dbd_fname);
+		}
 	}
 	xfree(dbd_fname);
 }
@@ -480,11 +527,16 @@ static int _purge_step_req(void)
 	int purged = 0;
 	ListIterator iter;
 	uint16_t msg_type;
-	uint32_t offset;
+	uint32_t offset, skip = agent_inflight;
 	buf_t *buffer;
 
 	iter = list_iterator_create(agent_list);
 	while ((buffer = list_next(iter))) {
+		/* The agent is waiting for the reply to these */
+		if (skip) {
+			skip--;
+			continue;
+		}
 		offset = get_buf_offset(buffer);
 		if (offset < 2)
 			continue;
@@ -509,11 +561,16 @@ static int _purge_job_start_req(void)
 	int purged = 0;
 	ListIterator iter;
 	uint16_t msg_type;
-	uint32_t offset;
+	uint32_t offset, skip = agent_inflight;
 	buf_t *buffer;
 
 	iter = list_iterator_create(agent_list);
 	while ((buffer = list_next(iter))) {
+		/* The agent is waiting for the reply to these */
+		if (skip) {
+			skip--;
+			continue;
+		}
 		offset = get_buf_offset(buffer);
 		if (offset < 2)
 			continue;
@@ -532,6 +589,10 @@ static int _purge_job_start_req(void)
 
 static void _max_dbd_msg_action(uint32_t *msg_cnt)
 {
+	/* Nothing is discarded, the spool holds what does not fit in memory */
+	if (spool_active)
+		return;
+
 	if (max_dbd_msg_action == MAX_DBD_ACTION_EXIT) {
 		if (*msg_cnt < slurm_conf.max_dbd_msgs)
 			return;
@@ -598,23 +659,140 @@ static void _print_agent_list_msg_types(void)
 	xfree(mlist);
 }
 
+/*
+ * Pack a DBD_SEND_MULT_MSG with up to DBD_MULT_MSG_MAX messages of agent_list
+ * following the ones already in flight.
+ * Call with agent_lock held.
+ * OUT cnt - number of messages packed
+ * RET message or NULL if there is nothing left to send
+ */
+static buf_t *_pack_mult_msg(uint32_t seq, uint32_t *cnt)
+{
+	persist_msg_t list_req = {0};
+	dbd_list_msg_t list_msg = { NULL };
+	ListIterator itr;
+	buf_t *msg_buf, *buffer = NULL;
+	uint32_t skip = agent_inflight;
+
+	*cnt = 0;
+	list_msg.my_list = list_create(NULL);
+	list_msg.seq = seq;
+	itr = list_iterator_create(agent_list);
+	while ((msg_buf = list_next(itr)) && (*cnt < DBD_MULT_MSG_MAX)) {
+		if (skip) {
+			skip--;
+			continue;
+		}
+		list_enqueue(list_msg.my_list, msg_buf);
+		(*cnt)++;
+	}
+	list_iterator_destroy(itr);
+
+	if (*cnt) {
+		list_req.msg_type = DBD_SEND_MULT_MSG;
+		list_req.conn = slurmdbd_conn;
+		list_req.data = &list_msg;
+		buffer = pack_slurmdbd_msg(&list_req, SLURM_PROTOCOL_VERSION);
+	}
+	FREE_NULL_LIST(list_msg.my_list);
+
+	return buffer;
+}
+
+/*
+ * Send agent_list in DBD_SEND_MULT_MSG batches with up to DBD_MULT_MSG_WINDOW
+ * of them waiting for a reply, so the slurmdbd does not wait on the network
+ * between batches.  The slurmdbd processes them in order and refuses the ones
+ * following a failed batch.  Messages stay at the head of agent_list until
+ * their reply arrives, so after a failure the rest is sent again from there
+ * with the sequence number of the failed batch.
+ * Call with slurmdbd_lock held.
+ * RET SLURM_SUCCESS if every batch sent was processed
+ */
+static int _send_mult_msgs(void)
+{
+	uint32_t batch_cnt[DBD_MULT_MSG_WINDOW];
+	uint32_t batch_seq[DBD_MULT_MSG_WINDOW];
+	int first = 0, outstanding = 0, i;
+	int rc = SLURM_SUCCESS, batch_rc;
+	bool stop = false, refused = false;
+	uint32_t cnt, seq;
+	buf_t *buffer;
+
+	while (1) {
+		/* Fill the window */
+		while (!stop && !halt_agent && !*slurmdbd_conn->shutdown &&
+		       (outstanding < DBD_MULT_MSG_WINDOW)) {
+			slurm_mutex_lock(&agent_lock);
+			if ((buffer = _pack_mult_msg(mult_msg_seq, &cnt)))
+				agent_inflight += cnt;
+			slurm_mutex_unlock(&agent_lock);
+			if (!buffer)
+				break;
+
+			rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
+			free_buf(buffer);
+			if (rc != SLURM_SUCCESS) {
+				if (!*slurmdbd_conn->shutdown)
+					error("Failure sending message: %d: %m",
+					      rc);
+				slurm_mutex_lock(&agent_lock);
+				agent_inflight -= cnt;
+				slurm_mutex_unlock(&agent_lock);
+				stop = true;
+				break;
+			}
+
+			i = (first + outstanding) % DBD_MULT_MSG_WINDOW;
+			batch_cnt[i] = cnt;
+			batch_seq[i] = mult_msg_seq++;
+			if (!mult_msg_seq)	/* 0 means no sequence */
+				mult_msg_seq = 1;
+			outstanding++;
+		}
+		if (!outstanding)
+			break;
+
+		/* Wait for the oldest batch */
+		seq = batch_seq[first];
+		batch_rc = _handle_mult_rc_ret(seq, batch_cnt[first], refused);
+		slurm_mutex_lock(&agent_lock);
+		if (batch_rc == SLURM_COMMUNICATIONS_RECEIVE_ERROR) {
+			/* The connection is gone and all replies with it */
+			for (i = 0; i < outstanding; i++)
+				agent_inflight -= batch_cnt[
+					(first + i) % DBD_MULT_MSG_WINDOW];
+			outstanding = 0;
+		} else {
+			agent_inflight -= batch_cnt[first];
+			first = (first + 1) % DBD_MULT_MSG_WINDOW;
+			outstanding--;
+		}
+		slurm_mutex_unlock(&agent_lock);
+
+		if ((batch_rc != SLURM_SUCCESS) && !refused) {
+			rc = batch_rc;
+			stop = refused = true;
+			/* The slurmdbd expects this one again */
+			mult_msg_seq = seq;
+		}
+	}
+
+	return rc;
+}
+
 static void *_agent(void *x)
 {
 	int rc;
 	uint32_t cnt;
 	buf_t *buffer;
+	bool mult_msg;
+	dbd_spool_sync_t sync;
 	struct timespec abs_time;
 	static time_t fail_time = 0;
 	int sigarray[] = {SIGUSR1, 0};
-	persist_msg_t list_req = {0};
-	dbd_list_msg_t list_msg;
 	DEF_TIMERS;
 
-	list_req.msg_type = DBD_SEND_MULT_MSG;
-	list_req.conn = slurmdbd_conn;
-	list_req.data = &list_msg;
-	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
-
 	/* Prepare to catch SIGUSR1 to interrupt pending
 	 * I/O and terminate in a timely fashion. */
 	xsignal(SIGUSR1, _sig_handler);
@@ -622,7 +800,7 @@ static void *_agent(void *x)
 
 	log_flag(AGENT, "slurmdbd agent_count=%d with msg_type=%s",
 		 list_count(agent_list),
-		 slurmdbd_msg_type_2_str(list_req.msg_type, 1));
+		 slurmdbd_msg_type_2_str(DBD_SEND_MULT_MSG, 1));
 
 	while (*slurmdbd_conn->shutdown == 0) {
 		slurm_mutex_lock(&slurmdbd_lock);
@@ -648,10 +826,30 @@ static void *_agent(void *x)
 
 		slurm_mutex_lock(&agent_lock);
 		cnt = list_count(agent_list);
+		if (spool_active && dbd_spool_behind() &&
+		    (cnt < (slurm_conf.max_dbd_msgs / 2))) {
+			dbd_spool_load(agent_list,
+				       slurm_conf.max_dbd_msgs - cnt);
+			cnt = list_count(agent_list);
+		}
 		if ((cnt == 0) || (slurmdbd_conn->fd < 0) ||
 		    (fail_time && (difftime(time(NULL), fail_time) < 10))) {
 			slurm_mutex_unlock(&slurmdbd_lock);
 			_max_dbd_msg_action(&cnt);
+			/*
+			 * Woken by every message, get them on disk.  The sync
+			 * is done without agent_lock so slurmdbd_agent_send()
+			 * does not wait for it, then look for new messages.
+			 */
+			if (spool_active) {
+				dbd_spool_save_head();
+				if (dbd_spool_sync_prep(&sync, true)) {
+					slurm_mutex_unlock(&agent_lock);
+					dbd_spool_sync_fds(&sync);
+					END_TIMER2("slurmdbd agent: spool sync");
+					continue;
+				}
+			}
 			END_TIMER2("slurmdbd agent: sleep");
 			log_flag(AGENT, "slurmdbd agent sleeping with agent_count=%d",
 				 list_count(agent_list));
@@ -665,32 +863,14 @@ static void *_agent(void *x)
 		           (slurm_conf.debug_flags & DEBUG_FLAG_AGENT))
 			info("agent_count:%d", cnt);
 		/* Leave item on the queue until processing complete */
-		if (agent_list) {
-			int handle_agent_count = 1000;
-			if (cnt > handle_agent_count) {
-				int agent_count = 0;
-				ListIterator agent_itr =
-					list_iterator_create(agent_list);
-				list_msg.my_list = list_create(NULL);
-				while ((buffer = list_next(agent_itr))) {
-					list_enqueue(list_msg.my_list, buffer);
-					agent_count++;
-					if (agent_count > handle_agent_count)
-						break;
-				}
-				list_iterator_destroy(agent_itr);
-				buffer = pack_slurmdbd_msg(
-					&list_req, SLURM_PROTOCOL_VERSION);
-			} else if (cnt > 1) {
-				list_msg.my_list = agent_list;
-				buffer = pack_slurmdbd_msg(
-					&list_req, SLURM_PROTOCOL_VERSION);
-			} else
-				buffer = list_peek(agent_list);
-		} else
+		mult_msg = (agent_list && (cnt > 1));
+		if (agent_list && !mult_msg &&
+		    (buffer = list_peek(agent_list)))
+			agent_inflight = 1;
+		else
 			buffer = NULL;
 		slurm_mutex_unlock(&agent_lock);
-		if (buffer == NULL) {
+		if (!mult_msg && (buffer == NULL)) {
 			slurm_mutex_unlock(&slurmdbd_lock);
 
 			slurm_mutex_lock(&assoc_cache_mutex);
@@ -706,16 +886,21 @@ static void *_agent(void *x)
 		/* NOTE: agent_lock is clear here, so we can add more
 		 * requests to the queue while waiting for this RPC to
 		 * complete. */
-		rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
-		if (rc != SLURM_SUCCESS) {
+		if (mult_msg) {
+			rc = _send_mult_msgs();
+			if ((rc != SLURM_SUCCESS) && *slurmdbd_conn->shutdown) {
+				slurm_mutex_unlock(&slurmdbd_lock);
+				END_TIMER2("slurmdbd agent: shutdown");
+				break;
+			}
+		} else if ((rc = slurm_persist_send_msg(slurmdbd_conn, buffer))
+			   != SLURM_SUCCESS) {
 			if (*slurmdbd_conn->shutdown) {
 				slurm_mutex_unlock(&slurmdbd_lock);
 				END_TIMER2("slurmdbd agent: shutdown");
 				break;
 			}
 			error("Failure sending message: %d: %m", rc);
-		} else if (list_msg.my_list) {
-			rc = _handle_mult_rc_ret();
 		} else {
 			rc = _get_return_code();
 			if (rc == EAGAIN) {
@@ -736,31 +921,27 @@ static void *_agent(void *x)
 		slurm_mutex_unlock(&assoc_cache_mutex);
 
 		slurm_mutex_lock(&agent_lock);
+		if (!mult_msg)
+			agent_inflight = 0;
 		if (agent_list && (rc == SLURM_SUCCESS)) {
 			/*
-			 * If we sent a mult_msg we just need to free buffer,
-			 * we don't need to requeue, just mark list_msg.my_list
-			 * as NULL as that is the sign we sent a mult_msg.
+			 * A mult_msg removed the messages as their replies
+			 * came in.
 			 */
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
-			} else
+			if (!mult_msg) {
 				buffer = list_dequeue(agent_list);
-
-			free_buf(buffer);
-			fail_time = 0;
-		} else {
-			/* We need to free a mult_msg even on failure */
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
 				free_buf(buffer);
+				if (spool_active)
+					dbd_spool_ack();
 			}
 
+			if (spool_active)
+				dbd_spool_save_head();
+			fail_time = 0;
+		} else {
 			fail_time = time(NULL);
+			if (spool_active)
+				dbd_spool_save_head();
 
 			if (slurm_conf.debug_flags & DEBUG_FLAG_AGENT) {
 				info("slurmdbd agent failed with rc:%d",
@@ -768,12 +949,22 @@ static void *_agent(void *x)
 				_print_agent_list_msg_types();
 			}
 		}
-		slurm_mutex_unlock(&agent_lock);
+		if (spool_active && dbd_spool_sync_prep(&sync, true)) {
+			slurm_mutex_unlock(&agent_lock);
+			dbd_spool_sync_fds(&sync);
+		} else
+			slurm_mutex_unlock(&agent_lock);
 		END_TIMER2("slurmdbd agent: full loop");
 	}
 
 	slurm_mutex_lock(&agent_lock);
-	_save_dbd_state();
+	agent_inflight = 0;
+	if (spool_active) {
+		/* Everything pending is already in the spool */
+		dbd_spool_close();
+		spool_active = false;
+	} else
+		_save_dbd_state();
 
 	log_flag(AGENT, "slurmdbd agent ending with agent_count=%d",
 		 list_count(agent_list));
@@ -793,6 +984,16 @@ static void _create_agent(void)
 
 	if (agent_list == NULL) {
 		agent_list = list_create(slurmdbd_free_buffer);
+		if (max_dbd_msg_action == MAX_DBD_ACTION_SPOOL) {
+			char *spool_dir = xstrdup_printf(
+				"%s/dbd.spool", slurm_conf.state_save_location);
+			if (dbd_spool_open(spool_dir) == SLURM_SUCCESS)
+				spool_active = true;
+			else
+				error("unable to open %s, discarding messages once MaxDBDMsgs is reached",
+				      spool_dir);
+			xfree(spool_dir);
+		}
 		_load_dbd_state();
 	}
 
@@ -908,6 +1109,7 @@ extern int slurmdbd_agent_send(uint16_t rpc_version, persist_msg_t *req)
 {
 	buf_t *buffer;
 	uint32_t cnt, rc = SLURM_SUCCESS;
+	dbd_spool_sync_t sync;
 	static time_t syslog_time = 0;
 
 	xassert(running_in_slurmctld());
@@ -932,6 +1134,8 @@ extern int slurmdbd_agent_send(uint16_t rpc_version, persist_msg_t *req)
 		}
 	}
 	cnt = list_count(agent_list);
+	if (spool_active)
+		cnt += dbd_spool_pending();
 	if ((cnt >= (slurm_conf.max_dbd_msgs / 2)) &&
 	    (difftime(time(NULL), syslog_time) > 120)) {
 		/* Record critical error every 120 seconds */
@@ -945,7 +1149,23 @@ extern int slurmdbd_agent_send(uint16_t rpc_version, persist_msg_t *req)
 	/* Handle action */
 	_max_dbd_msg_action(&cnt);
 
-	if (cnt < slurm_conf.max_dbd_msgs) {
+	if (spool_active) {
+		bool loaded = (!dbd_spool_behind() &&
+			       (list_count(agent_list) <
+				slurm_conf.max_dbd_msgs));
+
+		if (dbd_spool_append(buffer, loaded) != SLURM_SUCCESS) {
+			error("unable to spool %s:%u request, discarding it",
+			      slurmdbd_msg_type_2_str(req->msg_type, 1),
+			      req->msg_type);
+			(slurmdbd_conn->trigger_callbacks.acct_full)();
+			free_buf(buffer);
+			rc = SLURM_ERROR;
+		} else if (!loaded)
+			free_buf(buffer);
+		else if (list_enqueue(agent_list, buffer) == NULL)
+			fatal("list_enqueue: memory allocation failure");
+	} else if (cnt < slurm_conf.max_dbd_msgs) {
 		if (list_enqueue(agent_list, buffer) == NULL)
 			fatal("list_enqueue: memory allocation failure");
 	} else {
@@ -959,7 +1179,15 @@ extern int slurmdbd_agent_send(uint16_t rpc_version, persist_msg_t *req)
 	}
 
 	slurm_cond_broadcast(&agent_cond);
-	slurm_mutex_unlock(&agent_lock);
+	/*
+	 * The agent syncs the spool when it wakes up, unless it is busy with
+	 * the SlurmDBD.  Sync here then, without holding up the other callers.
+	 */
+	if (spool_active && dbd_spool_sync_prep(&sync, false)) {
+		slurm_mutex_unlock(&agent_lock);
+		dbd_spool_sync_fds(&sync);
+	} else
+		slurm_mutex_unlock(&agent_lock);
 	return rc;
 }
 
@@ -974,6 +1202,8 @@ extern bool slurmdbd_conn_active(void)
 
 extern int slurmdbd_agent_queue_count(void)
 {
+	if (spool_active)
+		return list_count(agent_list) + dbd_spool_pending();
 	return list_count(agent_list);
 }
 
@@ -1001,6 +1231,8 @@ extern void slurmdbd_agent_config_setup(void)
 			max_dbd_msg_action = MAX_DBD_ACTION_DISCARD;
 		else if (!xstrcasecmp(type, "exit"))
 			max_dbd_msg_action = MAX_DBD_ACTION_EXIT;
+		else if (!xstrcasecmp(type, "spool"))
+			max_dbd_msg_action = MAX_DBD_ACTION_SPOOL;
 		else
 			fatal("Unknown SlurmctldParameters option for max_dbd_msg_action '%s'",
 			      type);
@@ -0,0 +1,667 @@
+/****************************************************************************\
+ *  slurmdbd_spool.c - on disk queue of messages pending for the SlurmDBD
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <ctype.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "src/common/slurm_xlator.h"
+
+#include "src/common/fd.h"
+#include "src/common/slurmdbd_pack.h"
+#include "src/common/xstring.h"
+
+#include "slurmdbd_spool.h"
+
+/*
+ * A segment starts with SPOOL_MAGIC and the protocol version its messages
+ * were packed with, followed by records of
+ * [message size][crc32 of message][message][DBD_MAGIC].
+ * A record never spans two segments.
+ */
+#define SPOOL_MAGIC		0xDB5B0001
+#define SPOOL_REC_MAGIC		0xDEAD3219
+#define SPOOL_HDR_SIZE		(2 * sizeof(uint32_t))
+#define SPOOL_REC_SIZE(_len)	((_len) + (3 * sizeof(uint32_t)))
+#define SPOOL_SEG_SIZE		(64 * 1024 * 1024)
+
+/* Most records appended and seconds passed before the segment is synced */
+#define SPOOL_SYNC_CNT		100
+#define SPOOL_SYNC_SEC		1
+
+typedef struct {
+	uint32_t end;	/* size of a full segment, 0 if not known yet */
+	uint32_t off;	/* offset of the next record */
+	uint32_t seg;	/* segment number */
+} spool_pos_t;
+
+static char *spool_dir = NULL;
+static int write_fd = -1;
+static int full_fd = -1;	/* full segment with records not synced */
+static spool_pos_t head;	/* oldest record not acknowledged */
+static spool_pos_t read_pos;	/* oldest record not loaded */
+static spool_pos_t tail;	/* end of the newest record */
+static spool_pos_t saved_head;	/* head as in the head file */
+static uint32_t pending = 0;	/* records not loaded */
+static uint32_t unsynced = 0;	/* records appended since the last fsync */
+static time_t sync_time = 0;	/* time of the last fsync */
+
+/* On disk sizes of the loaded records, oldest first */
+static uint32_t *loaded_len = NULL;
+static uint32_t loaded_cnt = 0;
+static uint32_t loaded_first = 0;
+static uint32_t loaded_size = 0;
+
+static uint32_t crc_table[256];
+
+static void _init_crc(void)
+{
+	uint32_t c;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+		crc_table[i] = c;
+	}
+}
+
+static uint32_t _crc32(const char *data, uint32_t len)
+{
+	uint32_t c = 0xFFFFFFFF;
+
+	while (len--)
+		c = crc_table[(c ^ (uint8_t) *data++) & 0xFF] ^ (c >> 8);
+
+	return c ^ 0xFFFFFFFF;
+}
+
+static char *_seg_path(uint32_t seg)
+{
+	return xstrdup_printf("%s/%010u", spool_dir, seg);
+}
+
+static int _write_all(int fd, char *data, uint32_t size)
+{
+	ssize_t wrote;
+
+	while (size) {
+		wrote = write(fd, data, size);
+		if (wrote > 0) {
+			data += wrote;
+			size -= wrote;
+		} else if ((wrote == -1) && (errno == EINTR))
+			continue;
+		else
+			return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* Return the offset the records of the segment at pos end at */
+static uint32_t _seg_end(spool_pos_t *pos)
+{
+	struct stat st;
+	char *path;
+
+	if (pos->seg == tail.seg)
+		return tail.off;
+	if (pos->end)
+		return pos->end;
+
+	path = _seg_path(pos->seg);
+	if (stat(path, &st) < 0)
+		pos->end = SPOOL_HDR_SIZE;
+	else
+		pos->end = st.st_size;
+	xfree(path);
+
+	return pos->end;
+}
+
+/* Move pos to the next segment if it is at the end of a full segment */
+static void _roll(spool_pos_t *pos, bool remove)
+{
+	char *path;
+
+	while ((pos->seg < tail.seg) && (pos->off >= _seg_end(pos))) {
+		if (remove) {
+			path = _seg_path(pos->seg);
+			(void) unlink(path);
+			xfree(path);
+		}
+		pos->seg++;
+		pos->off = SPOOL_HDR_SIZE;
+		pos->end = 0;
+	}
+}
+
+/*
+ * Map a segment for reading.
+ * OUT size - size of the mapping
+ * OUT version - protocol version of the messages
+ * RET mapping or NULL on error
+ */
+static char *_map_seg(uint32_t seg, uint32_t *size, uint16_t *version)
+{
+	struct stat st;
+	char *path = _seg_path(seg);
+	char *map = NULL;
+	uint32_t *hdr;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		error("%s: open %s: %m", __func__, path);
+		goto end_it;
+	}
+	if ((fstat(fd, &st) < 0) || (st.st_size < SPOOL_HDR_SIZE)) {
+		error("%s: bad segment %s", __func__, path);
+		goto end_it;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		error("%s: mmap %s: %m", __func__, path);
+		map = NULL;
+		goto end_it;
+	}
+	hdr = (uint32_t *) map;
+	if (hdr[0] != SPOOL_MAGIC) {
+		error("%s: bad magic in %s", __func__, path);
+		munmap(map, st.st_size);
+		map = NULL;
+		goto end_it;
+	}
+	*size = st.st_size;
+	*version = hdr[1];
+
+end_it:
+	if (fd >= 0)
+		close(fd);
+	xfree(path);
+	return map;
+}
+
+/*
+ * Check the record at off in a mapped segment of size end.
+ * OUT data/len - message of the record
+ * RET true if the record is complete and its checksum matches
+ */
+static bool _get_rec(char *map, uint32_t end, uint32_t off,
+		     char **data, uint32_t *len)
+{
+	uint32_t hdr[2], magic;
+
+	if ((off + SPOOL_REC_SIZE(0)) > end)
+		return false;
+	memcpy(hdr, map + off, sizeof(hdr));
+	if ((hdr[0] > SPOOL_SEG_SIZE) ||
+	    ((off + SPOOL_REC_SIZE(hdr[0])) > end))
+		return false;
+	memcpy(&magic, map + off + sizeof(hdr) + hdr[0], sizeof(magic));
+	if (magic != SPOOL_REC_MAGIC)
+		return false;
+	*data = map + off + sizeof(hdr);
+	*len = hdr[0];
+	if (_crc32(*data, *len) != hdr[1])
+		return false;
+
+	return true;
+}
+
+/*
+ * Count the good records of a segment from off and cut off anything after
+ * them, a record the slurmctld was writing when it died or a corrupted one.
+ * RET offset the records end at
+ */
+static uint32_t _check_seg(uint32_t seg, uint32_t off, uint16_t *version)
+{
+	char *map, *data, *path;
+	uint32_t size = 0, len;
+
+	if (!(map = _map_seg(seg, &size, version)))
+		return SPOOL_HDR_SIZE;
+
+	while (_get_rec(map, size, off, &data, &len)) {
+		off += SPOOL_REC_SIZE(len);
+		pending++;
+	}
+	munmap(map, size);
+
+	if (off < size) {
+		error("%s: discarding %u bytes of incomplete or corrupted records in segment %u",
+		      __func__, size - off, seg);
+		path = _seg_path(seg);
+		if (truncate(path, off) < 0)
+			error("%s: truncate %s: %m", __func__, path);
+		xfree(path);
+	}
+
+	return off;
+}
+
+static int _new_seg(uint32_t seg)
+{
+	uint32_t hdr[2] = { SPOOL_MAGIC, SLURM_PROTOCOL_VERSION };
+	char *path;
+
+	if (write_fd >= 0) {
+		if (!unsynced)
+			close(write_fd);
+		else if (full_fd < 0)
+			full_fd = write_fd;	/* left to dbd_spool_sync_fds() */
+		else
+			(void) fsync_and_close(write_fd, "dbd spool");
+	}
+	unsynced = 0;
+
+	path = _seg_path(seg);
+	write_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+	if (write_fd < 0) {
+		error("%s: open %s: %m", __func__, path);
+		xfree(path);
+		return SLURM_ERROR;
+	}
+	xfree(path);
+	fd_set_close_on_exec(write_fd);
+
+	if (_write_all(write_fd, (char *) hdr, sizeof(hdr))) {
+		error("%s: write segment %u: %m", __func__, seg);
+		return SLURM_ERROR;
+	}
+	tail.seg = seg;
+	tail.off = SPOOL_HDR_SIZE;
+	tail.end = 0;
+
+	return SLURM_SUCCESS;
+}
+
+static void _push_loaded(uint32_t len)
+{
+	if (loaded_cnt == loaded_size) {
+		uint32_t *old = loaded_len, i;
+
+		loaded_size = loaded_size ? (loaded_size * 2) : 1024;
+		loaded_len = xcalloc(loaded_size, sizeof(uint32_t));
+		for (i = 0; i < loaded_cnt; i++)
+			loaded_len[i] = old[(loaded_first + i) % loaded_cnt];
+		loaded_first = 0;
+		xfree(old);
+	}
+	loaded_len[(loaded_first + loaded_cnt) % loaded_size] = len;
+	loaded_cnt++;
+}
+
+/* Forget a record that was not loaded because it could not be converted */
+static void _skip_loaded(uint32_t len)
+{
+	if (loaded_cnt) {
+		loaded_len[(loaded_first + loaded_cnt - 1) % loaded_size] +=
+			len;
+	} else {
+		head.off += len;
+		_roll(&head, true);
+	}
+}
+
+extern int dbd_spool_open(char *dir)
+{
+	DIR *dp;
+	struct dirent *ent;
+	char *path, *end_ptr;
+	uint32_t seg, min_seg = NO_VAL, max_seg = 0, hdr[2];
+	uint16_t version = 0;
+	int fd;
+
+	xassert(!spool_dir);
+
+	if ((mkdir(dir, 0700) < 0) && (errno != EEXIST)) {
+		error("%s: mkdir %s: %m", __func__, dir);
+		return SLURM_ERROR;
+	}
+	if (!(dp = opendir(dir))) {
+		error("%s: opendir %s: %m", __func__, dir);
+		return SLURM_ERROR;
+	}
+	while ((ent = readdir(dp))) {
+		if (!isdigit((int) ent->d_name[0]))
+			continue;
+		seg = strtoul(ent->d_name, &end_ptr, 10);
+		if (end_ptr[0])
+			continue;
+		min_seg = MIN(min_seg, seg);
+		max_seg = MAX(max_seg, seg);
+	}
+	closedir(dp);
+
+	_init_crc();
+	spool_dir = xstrdup(dir);
+	pending = 0;
+	memset(&head, 0, sizeof(head));
+	memset(&tail, 0, sizeof(tail));
+
+	if (min_seg == NO_VAL) {
+		if (_new_seg(0))
+			goto fail;
+		head = tail;
+		read_pos = saved_head = head;
+		return SLURM_SUCCESS;
+	}
+
+	path = xstrdup_printf("%s/head", spool_dir);
+	if (((fd = open(path, O_RDONLY)) >= 0) &&
+	    (read(fd, hdr, sizeof(hdr)) == sizeof(hdr)) &&
+	    (hdr[0] >= min_seg) && (hdr[0] <= max_seg)) {
+		head.seg = hdr[0];
+		head.off = MAX(hdr[1], SPOOL_HDR_SIZE);
+	} else {
+		head.seg = min_seg;
+		head.off = SPOOL_HDR_SIZE;
+	}
+	if (fd >= 0)
+		close(fd);
+	xfree(path);
+
+	/* Segments before the head were completely acknowledged */
+	for (seg = min_seg; seg < head.seg; seg++) {
+		path = _seg_path(seg);
+		(void) unlink(path);
+		xfree(path);
+	}
+
+	for (seg = head.seg; seg <= max_seg; seg++) {
+		tail.seg = seg;
+		tail.off = _check_seg(seg, (seg == head.seg) ? head.off :
+				      SPOOL_HDR_SIZE, &version);
+	}
+	read_pos = saved_head = head;
+
+	/* Keep the messages of a segment in one protocol version */
+	if (version != SLURM_PROTOCOL_VERSION) {
+		if (_new_seg(tail.seg + 1))
+			goto fail;
+	} else {
+		path = _seg_path(tail.seg);
+		write_fd = open(path, O_WRONLY | O_APPEND);
+		if (write_fd < 0) {
+			error("%s: open %s: %m", __func__, path);
+			xfree(path);
+			goto fail;
+		}
+		xfree(path);
+		fd_set_close_on_exec(write_fd);
+	}
+
+	verbose("dbd spool %s has %u pending RPCs", spool_dir, pending);
+	return SLURM_SUCCESS;
+
+fail:
+	if (write_fd >= 0) {
+		close(write_fd);
+		write_fd = -1;
+	}
+	xfree(spool_dir);
+	return SLURM_ERROR;
+}
+
+extern void dbd_spool_close(void)
+{
+	if (!spool_dir)
+		return;
+
+	dbd_spool_save_head();
+	if (full_fd >= 0) {
+		(void) fsync_and_close(full_fd, "dbd spool");
+		full_fd = -1;
+	}
+	if (write_fd >= 0) {
+		(void) fsync_and_close(write_fd, "dbd spool");
+		write_fd = -1;
+	}
+	unsynced = 0;
+	xfree(loaded_len);
+	loaded_cnt = loaded_first = loaded_size = 0;
+	xfree(spool_dir);
+}
+
+extern int dbd_spool_append(buf_t *buffer, bool loaded)
+{
+	uint32_t hdr[2], magic = SPOOL_REC_MAGIC;
+	uint32_t len = get_buf_offset(buffer);
+	char *data = get_buf_data(buffer);
+
+	xassert(spool_dir);
+	xassert(!loaded || !dbd_spool_behind());
+
+	if ((write_fd < 0) ||
+	    (((tail.off + SPOOL_REC_SIZE(len)) > SPOOL_SEG_SIZE) &&
+	     (tail.off > SPOOL_HDR_SIZE))) {
+		bool caught_up = !dbd_spool_behind();
+
+		if (_new_seg(tail.seg + 1))
+			return SLURM_ERROR;
+		if (caught_up)
+			read_pos = tail;
+	}
+
+	hdr[0] = len;
+	hdr[1] = _crc32(data, len);
+	if (_write_all(write_fd, (char *) hdr, sizeof(hdr)) ||
+	    _write_all(write_fd, data, len) ||
+	    _write_all(write_fd, (char *) &magic, sizeof(magic))) {
+		error("%s: write segment %u: %m", __func__, tail.seg);
+		/* Do not leave a partial record behind */
+		if (ftruncate(write_fd, tail.off) < 0) {
+			close(write_fd);
+			write_fd = -1;
+		}
+		return SLURM_ERROR;
+	}
+	tail.off += SPOOL_REC_SIZE(len);
+	unsynced++;
+
+	if (loaded) {
+		_push_loaded(SPOOL_REC_SIZE(len));
+		read_pos = tail;
+	} else
+		pending++;
+
+	return SLURM_SUCCESS;
+}
+
+extern bool dbd_spool_behind(void)
+{
+	return ((read_pos.seg != tail.seg) || (read_pos.off != tail.off));
+}
+
+extern int dbd_spool_load(List list, int max)
+{
+	char *map, *data;
+	uint32_t size = 0, end, len;
+	uint16_t version = 0;
+	buf_t *buffer;
+	int loaded = 0;
+
+	xassert(spool_dir);
+
+	while ((loaded < max) && dbd_spool_behind()) {
+		_roll(&read_pos, false);
+		if (!(map = _map_seg(read_pos.seg, &size, &version))) {
+			read_pos.off = _seg_end(&read_pos);
+			if (read_pos.seg == tail.seg)
+				break;
+			continue;
+		}
+		end = MIN(size, _seg_end(&read_pos));
+
+		while ((loaded < max) && (read_pos.off < end)) {
+			if (!_get_rec(map, end, read_pos.off, &data, &len)) {
+				error("%s: corrupted record in segment %u at %u, skipping the rest of it",
+				      __func__, read_pos.seg, read_pos.off);
+				_skip_loaded(end - read_pos.off);
+				read_pos.off = end;
+				break;
+			}
+
+			buffer = init_buf(len);
+			memcpy(get_buf_data(buffer), data, len);
+			set_buf_offset(buffer, len);
+			read_pos.off += SPOOL_REC_SIZE(len);
+			if (pending)
+				pending--;
+
+			if (version != SLURM_PROTOCOL_VERSION) {
+				/*
+				 * Repack with the current protocol version
+				 * like the ones in dbd.messages.
+				 */
+				persist_msg_t msg = {0};
+				int rc;
+
+				set_buf_offset(buffer, 0);
+				rc = unpack_slurmdbd_msg(&msg, version, buffer);
+				free_buf(buffer);
+				if (rc == SLURM_SUCCESS)
+					buffer = pack_slurmdbd_msg(
+						&msg, SLURM_PROTOCOL_VERSION);
+				else
+					buffer = NULL;
+				slurmdbd_free_msg(&msg);
+			}
+			if (!buffer) {
+				error("%s: unable to convert message from protocol version %hu",
+				      __func__, version);
+				_skip_loaded(SPOOL_REC_SIZE(len));
+				continue;
+			}
+
+			list_enqueue(list, buffer);
+			_push_loaded(SPOOL_REC_SIZE(len));
+			loaded++;
+		}
+		munmap(map, size);
+	}
+
+	if (!dbd_spool_behind())
+		pending = 0;
+
+	return loaded;
+}
+
+extern uint32_t dbd_spool_pending(void)
+{
+	return pending;
+}
+
+extern void dbd_spool_ack(void)
+{
+	if (!loaded_cnt) {
+		error("%s: no loaded message to acknowledge", __func__);
+		return;
+	}
+
+	head.off += loaded_len[loaded_first];
+	loaded_first = (loaded_first + 1) % loaded_size;
+	loaded_cnt--;
+	_roll(&head, true);
+}
+
+extern bool dbd_spool_sync_prep(dbd_spool_sync_t *sync, bool force)
+{
+	sync->full_fd = full_fd;
+	full_fd = -1;
+	sync->tail_fd = -1;
+
+	if ((write_fd >= 0) && unsynced &&
+	    (force || (unsynced >= SPOOL_SYNC_CNT) ||
+	     (difftime(time(NULL), sync_time) >= SPOOL_SYNC_SEC))) {
+		if ((sync->tail_fd = dup(write_fd)) < 0) {
+			error("%s: dup segment %u: %m", __func__, tail.seg);
+			if (fsync(write_fd) < 0)
+				error("%s: fsync segment %u: %m",
+				      __func__, tail.seg);
+		} else
+			fd_set_close_on_exec(sync->tail_fd);
+		unsynced = 0;
+		sync_time = time(NULL);
+	}
+
+	return ((sync->full_fd >= 0) || (sync->tail_fd >= 0));
+}
+
+extern void dbd_spool_sync_fds(dbd_spool_sync_t *sync)
+{
+	if (sync->full_fd >= 0)
+		(void) fsync_and_close(sync->full_fd, "dbd spool");
+	if (sync->tail_fd >= 0)
+		(void) fsync_and_close(sync->tail_fd, "dbd spool");
+	sync->full_fd = sync->tail_fd = -1;
+}
+
+extern void dbd_spool_save_head(void)
+{
+	uint32_t hdr[2];
+	char *path, *new_path;
+	int fd;
+
+	if (!spool_dir)
+		return;
+
+	if ((head.seg == saved_head.seg) && (head.off == saved_head.off))
+		return;
+
+	hdr[0] = head.seg;
+	hdr[1] = head.off;
+	path = xstrdup_printf("%s/head", spool_dir);
+	new_path = xstrdup_printf("%s/head.new", spool_dir);
+	fd = open(new_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		error("%s: open %s: %m", __func__, new_path);
+	} else if (_write_all(fd, (char *) hdr, sizeof(hdr))) {
+		error("%s: write %s: %m", __func__, new_path);
+		close(fd);
+	} else {
+		close(fd);
+		if (rename(new_path, path) < 0)
+			error("%s: rename %s: %m", __func__, new_path);
+		else
+			saved_head = head;
+	}
+	xfree(path);
+	xfree(new_path);
+}
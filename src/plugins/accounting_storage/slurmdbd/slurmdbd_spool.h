@@ -0,0 +1,109 @@
+/****************************************************************************\
+ *  slurmdbd_spool.h - on disk queue of messages pending for the SlurmDBD
+ *****************************************************************************
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURMDBD_SPOOL_H
+#define _SLURMDBD_SPOOL_H
+
+#include "src/common/list.h"
+#include "src/common/pack.h"
+
+/*
+ * The spool is a directory of append only segment files holding every
+ * message given to the agent in order.  Messages are loaded from it into the
+ * agent list and removed once the SlurmDBD acknowledged them, so the number of
+ * pending messages is only bounded by the disk and they survive a crash.
+ *
+ * None of these functions lock, the caller must hold the agent lock, except
+ * dbd_spool_sync_fds() which must be called without it.
+ */
+
+/* Segments to sync to disk, see dbd_spool_sync_prep() */
+typedef struct {
+	int full_fd;	/* segment that filled up, -1 if none */
+	int tail_fd;	/* newest segment, -1 if none */
+} dbd_spool_sync_t;
+
+/*
+ * Open the spool in dir, creating it if needed, and check the messages left
+ * from a previous run.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int dbd_spool_open(char *dir);
+
+/* Save the position of the oldest pending message and close the spool */
+extern void dbd_spool_close(void);
+
+/*
+ * Append a packed message to the spool.  It is on disk once it went through
+ * dbd_spool_sync_prep() and dbd_spool_sync_fds().
+ * IN buffer - message, the buffer is not consumed
+ * IN loaded - the caller keeps the buffer in the agent list, only allowed
+ *             when dbd_spool_behind() is false
+ * RET SLURM_SUCCESS or SLURM_ERROR if it could not be written
+ */
+extern int dbd_spool_append(buf_t *buffer, bool loaded);
+
+/* Return true if there are messages on disk not loaded into the agent list */
+extern bool dbd_spool_behind(void);
+
+/*
+ * Load up to max messages not yet loaded from the spool into list.
+ * RET number of messages loaded
+ */
+extern int dbd_spool_load(List list, int max);
+
+/* Return the number of messages on disk not loaded into the agent list */
+extern uint32_t dbd_spool_pending(void);
+
+/* The oldest loaded message was accepted by the SlurmDBD, forget it */
+extern void dbd_spool_ack(void);
+
+/*
+ * Take the segments holding messages appended since the last sync, so they
+ * can be synced by dbd_spool_sync_fds() once the agent lock is released.
+ * Unless force is set, the newest segment is only taken after 100 messages or
+ * one second since its last sync, whichever comes first.
+ * OUT sync - segments to pass to dbd_spool_sync_fds()
+ * RET true if there is anything to sync
+ */
+extern bool dbd_spool_sync_prep(dbd_spool_sync_t *sync, bool force);
+
+/* Sync and close the segments taken by dbd_spool_sync_prep() */
+extern void dbd_spool_sync_fds(dbd_spool_sync_t *sync);
+
+/* Write the position of the oldest pending message if it changed */
+extern void dbd_spool_save_head(void);
+
+#endif
@@ -1437,6 +1437,7 @@ extern int bb_post_persist_create(job_record_t *job_ptr, bb_alloc_t *bb_alloc,
 			/*        grp_used_tres_run_secs[state_ptr->tres_pos]); */
 			assoc_ptr = assoc_ptr->usage->parent_assoc_ptr;
 		}
+		assoc_mgr_reset_grp_tres_avail();
 
 		if (job_ptr && job_ptr->tres_alloc_cnt)
 			job_ptr->tres_alloc_cnt[state_ptr->tres_pos] -= size_mb;
@@ -1525,6 +1526,7 @@ extern int bb_post_persist_delete(bb_alloc_t *bb_alloc, bb_state_t *state_ptr)
 			/*        grp_used_tres_run_secs[state_ptr->tres_pos]); */
 			assoc_ptr = assoc_ptr->usage->parent_assoc_ptr;
 		}
+		assoc_mgr_reset_grp_tres_avail();
 
 		if (bb_alloc->qos_ptr) {
 			if (bb_alloc->qos_ptr->usage->grp_used_tres[
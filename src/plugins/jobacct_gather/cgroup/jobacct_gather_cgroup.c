@@ -103,15 +103,47 @@ const char plugin_name[] = "Job accounting gather cgroup plugin";
 const char plugin_type[] = "jobacct_gather/cgroup";
 const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 
-static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
+/* Counters read from the cgroups of one task */
+typedef struct {
+	uint32_t taskid;
+	bool have_cpu;			/* utime and stime are set */
+	bool have_rss;			/* total_rss is set */
+	bool have_pgmajfault;		/* total_pgmajfault is set */
+	unsigned long utime;
+	unsigned long stime;
+	unsigned long total_rss;
+	unsigned long total_pgmajfault;
+} task_cg_stats_t;
+
+static jag_callbacks_t callbacks;
+static bool use_cgroup_stats = false;
+static List task_stats_list = NULL;	/* task_cg_stats_t of this poll */
+
+static int _find_task_stats(void *x, void *key)
+{
+	task_cg_stats_t *stats = (task_cg_stats_t *) x;
+	uint32_t taskid = *(uint32_t *) key;
+
+	if (stats->taskid == taskid)
+		return 1;
+	return 0;
+}
+
+/*
+ * Read the counters of a task's cgroups.
+ * RET SLURM_SUCCESS if all counters were read, SLURM_ERROR otherwise
+ */
+static int _get_task_cg_stats(uint32_t taskid, task_cg_stats_t *stats)
 {
-	unsigned long utime, stime, total_rss, total_pgpgin;
 	char *cpu_time = NULL, *memory_stat = NULL, *ptr;
 	size_t cpu_time_size = 0, memory_stat_size = 0;
-	xcgroup_t *task_cpuacct_cg = NULL;;
+	xcgroup_t *task_cpuacct_cg = NULL;
 	xcgroup_t *task_memory_cg = NULL;
 	bool exit_early = false;
 
+	memset(stats, 0, sizeof(*stats));
+	stats->taskid = taskid;
+
 	/* Find which task cgroups to use */
 	task_memory_cg = list_find_first(task_memory_cg_list,
 					 find_task_cg_info,
@@ -135,31 +167,23 @@ static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 		exit_early = true;
 	}
 	if (exit_early)
-		return;
+		return SLURM_ERROR;
 
-	//DEF_TIMERS;
-	//START_TIMER;
-	/* info("before"); */
 	xcgroup_get_param(task_cpuacct_cg, "cpuacct.stat",
 			  &cpu_time, &cpu_time_size);
 	if (cpu_time == NULL) {
-		debug2("%s: failed to collect cpuacct.stat pid %d ppid %d",
-		       __func__, prec->pid, prec->ppid);
-	} else {
-		sscanf(cpu_time, "%*s %lu %*s %lu", &utime, &stime);
-		/*
-		 * Store unnormalized times, we will normalize in when
-		 * transfering to a struct jobacctinfo in job_common_poll_data()
-		 */
-		prec->usec = utime;
-		prec->ssec = stime;
+		debug2("%s: failed to collect cpuacct.stat of task %u",
+		       __func__, taskid);
+	} else if (sscanf(cpu_time, "%*s %lu %*s %lu",
+			  &stats->utime, &stats->stime) == 2) {
+		stats->have_cpu = true;
 	}
 
 	xcgroup_get_param(task_memory_cg, "memory.stat",
 			  &memory_stat, &memory_stat_size);
 	if (memory_stat == NULL) {
-		debug2("%s: failed to collect memory.stat  pid %d ppid %d",
-		       __func__, prec->pid, prec->ppid);
+		debug2("%s: failed to collect memory.stat of task %u",
+		       __func__, taskid);
 	} else {
 		/*
 		 * This number represents the amount of "dirty" private memory
@@ -167,25 +191,96 @@ static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 		 * different than what proc presents, but is probably more
 		 * accurate on what the user is actually using.
 		 */
-		if ((ptr = strstr(memory_stat, "total_rss"))) {
-			sscanf(ptr, "total_rss %lu", &total_rss);
-			prec->tres_data[TRES_ARRAY_MEM].size_read = total_rss;
-		}
+		if ((ptr = strstr(memory_stat, "total_rss")) &&
+		    (sscanf(ptr, "total_rss %lu", &stats->total_rss) == 1))
+			stats->have_rss = true;
 
 		/*
 		 * total_pgmajfault is what is reported in proc, so we use
 		 * the same thing here.
 		 */
-		if ((ptr = strstr(memory_stat, "total_pgmajfault"))) {
-			sscanf(ptr, "total_pgmajfault %lu", &total_pgpgin);
-			prec->tres_data[TRES_ARRAY_PAGES].size_read =
-				total_pgpgin;
-		}
+		if ((ptr = strstr(memory_stat, "total_pgmajfault")) &&
+		    (sscanf(ptr, "total_pgmajfault %lu",
+			    &stats->total_pgmajfault) == 1))
+			stats->have_pgmajfault = true;
 	}
 
 	xfree(cpu_time);
 	xfree(memory_stat);
 
+	if (!stats->have_cpu || !stats->have_rss)
+		return SLURM_ERROR;
+	return SLURM_SUCCESS;
+}
+
+/*
+ * get_precs() callback used with JobAcctGatherParams=UseCgroupStats.
+ * Read the cgroups of every task first. Only if all of them could be read
+ * are the task records built from the cgroups alone, otherwise this poll
+ * scans /proc as usual and the next one tries the cgroups again.
+ */
+static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
+		       jag_callbacks_t *cbs)
+{
+	struct jobacctinfo *jobacct;
+	task_cg_stats_t *stats;
+	ListIterator itr;
+	uint32_t failed = 0;
+
+	if (!task_stats_list)
+		task_stats_list = list_create(xfree_ptr);
+	list_flush(task_stats_list);
+
+	if (task_list) {
+		itr = list_iterator_create(task_list);
+		while ((jobacct = list_next(itr))) {
+			if (list_find_first(task_stats_list, _find_task_stats,
+					    &jobacct->id.taskid))
+				continue;
+			stats = xmalloc(sizeof(*stats));
+			if (_get_task_cg_stats(jobacct->id.taskid, stats))
+				failed++;
+			list_append(task_stats_list, stats);
+		}
+		list_iterator_destroy(itr);
+	}
+
+	if (!failed)
+		return jag_common_get_task_precs(task_list, pgid_plugin,
+						 cont_id, cbs);
+
+	debug("%s: cgroup counters of %u tasks could not be read, scanning /proc for this poll",
+	      plugin_type, failed);
+	return jag_common_get_proc_precs(task_list, pgid_plugin, cont_id, cbs);
+}
+
+static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
+{
+	task_cg_stats_t task_stats, *stats = NULL;
+
+	/* The cgroups were already read in this poll by _get_precs() */
+	if (use_cgroup_stats)
+		stats = list_find_first(task_stats_list, _find_task_stats,
+					&taskid);
+	if (!stats) {
+		stats = &task_stats;
+		(void) _get_task_cg_stats(taskid, stats);
+	}
+
+	/*
+	 * Store unnormalized times, we will normalize in when
+	 * transfering to a struct jobacctinfo in job_common_poll_data()
+	 */
+	if (stats->have_cpu) {
+		prec->usec = stats->utime;
+		prec->ssec = stats->stime;
+	}
+	if (stats->have_rss)
+		prec->tres_data[TRES_ARRAY_MEM].size_read = stats->total_rss;
+	if (stats->have_pgmajfault)
+		prec->tres_data[TRES_ARRAY_PAGES].size_read =
+			stats->total_pgmajfault;
+
 	/* FIXME: Enable when kernel support ready.
 	 *
 	 * "Read" and "Write" from blkio.throttle.io_service_bytes are
@@ -297,13 +392,24 @@ extern int fini (void)
 extern void jobacct_gather_p_poll_data(
 	List task_list, bool pgid_plugin, uint64_t cont_id, bool profile)
 {
-	static jag_callbacks_t callbacks;
 	static bool first = 1;
 
 	if (first) {
+		char *params = slurm_conf.job_acct_gather_params;
+
 		memset(&callbacks, 0, sizeof(jag_callbacks_t));
 		first = 0;
 		callbacks.prec_extra = _prec_extra;
+
+		if (xstrcasestr(params, "UseCgroupStats") &&
+		    (xstrcasestr(params, "NoShare") ||
+		     xstrcasestr(params, "UsePss"))) {
+			info("%s: UseCgroupStats ignored, NoShare and UsePss need per-process data",
+			     plugin_type);
+		} else if (xstrcasestr(params, "UseCgroupStats")) {
+			use_cgroup_stats = true;
+			callbacks.get_precs = _get_precs;
+		}
 	}
 
 	jag_common_poll_data(task_list, pgid_plugin, cont_id, &callbacks,
@@ -315,6 +421,7 @@ extern void jobacct_gather_p_poll_data(
 extern int jobacct_gather_p_endpoll(void)
 {
 	jag_common_fini();
+	FREE_NULL_LIST(task_stats_list);
 
 	return SLURM_SUCCESS;
 }
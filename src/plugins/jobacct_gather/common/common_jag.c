@@ -39,6 +39,7 @@
 \*****************************************************************************/
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <time.h>
@@ -52,6 +53,7 @@
 #include "src/common/slurm_acct_gather_energy.h"
 #include "src/common/slurm_acct_gather_filesystem.h"
 #include "src/common/slurm_acct_gather_interconnect.h"
+#include "src/common/timers.h"
 #include "src/common/xstring.h"
 #include "src/slurmd/common/proctrack.h"
 
@@ -78,6 +80,25 @@ static int my_pagesize = 0;
 static DIR  *slash_proc = NULL;
 static int energy_profile = ENERGY_DATA_NODE_ENERGY_UP;
 
+/*
+ * Processes of the proctrack container seen on the last poll, sorted by pid.
+ * Their /proc/<pid>/stat and io files are kept open between polls.
+ */
+typedef struct {
+	pid_t pid;
+	int stat_fd;	/* -1 if not open */
+	int io_fd;	/* -1 if not open */
+	bool lwp;	/* Light Weight Process, never read */
+} jag_pid_t;
+
+static jag_pid_t *pid_cache = NULL;
+static int pid_cache_cnt = 0;
+
+/* Cost of the polls done for this step, reported in jag_common_fini() */
+static uint32_t poll_cnt = 0;
+static uint64_t poll_usec_max = 0;
+static uint64_t poll_usec_tot = 0;
+
 static int _find_prec(void *x, void *key)
 {
 	jag_prec_t *prec = (jag_prec_t *) x;
@@ -301,7 +322,8 @@ again:
 
 /* _get_process_data_line() - get line of data from /proc/<pid>/stat
  *
- * IN:	in - input file descriptor
+ * IN:	in - input file descriptor, read from the start so it may be kept
+ *	     open across polls
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -323,7 +345,7 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
 	int exit_signal, last_cpu;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
+	num_read = pread(in, sbuf, (sizeof(sbuf) - 1), 0);
 	if (num_read <= 0)
 		return 0;
 	sbuf[num_read] = '\0';
@@ -359,14 +381,6 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
 	if ((nvals < 37) || (rss < 0))
 		return 0;
 
-	/*
-	 * If current pid corresponds to a Light Weight Process (Thread POSIX)
-	 * or there was an error, skip it, we will only account the original
-	 * process (pid==tgid).
-	 */
-	if (_is_a_lwp(prec->pid))
-		return 0;
-
 	/* Copy the values that slurm records into our data structure */
 	prec->ppid  = ppid;
 
@@ -428,14 +442,14 @@ static int _get_process_memory_line(int in, jag_prec_t *prec)
 	return 1;
 }
 
-static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
+static int _remove_share_data(pid_t pid, jag_prec_t *prec)
 {
 	FILE *statm_fp = NULL;
 	char proc_statm_file[256];	/* Allow ~20x extra length */
 	int rc = 0, fd;
 
-	snprintf(proc_statm_file, sizeof(proc_statm_file), "%sm",
-		 proc_stat_file);
+	snprintf(proc_statm_file, sizeof(proc_statm_file), "/proc/%d/statm",
+		 pid);
 	if (!(statm_fp = fopen(proc_statm_file, "r")))
 		return rc;  /* Assume the process went away */
 	fd = fileno(statm_fp);
@@ -465,7 +479,7 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	int num_read, nvals;
 	uint64_t rchar, wchar;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
+	num_read = pread(in, sbuf, (sizeof(sbuf) - 1), 0);
 	if (num_read <= 0)
 		return 0;
 	sbuf[num_read] = '\0';
@@ -475,9 +489,6 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	if (nvals < 4)
 		return 0;
 
-	if (_is_a_lwp(prec->pid))
-		return 0;
-
 	/* keep real value here since we aren't doubles */
 	prec->tres_data[TRES_ARRAY_FS_DISK].size_read = rchar;
 	prec->tres_data[TRES_ARRAY_FS_DISK].size_write = wchar;
@@ -498,15 +509,19 @@ static int _init_tres(jag_prec_t *prec, void *empty)
 	return SLURM_SUCCESS;
 }
 
-static void _handle_stats(char *proc_stat_file, char *proc_io_file,
-			  char *proc_smaps_file, jag_callbacks_t *callbacks,
-			  int tres_count)
+/*
+ * Build a process record for pid from its opened /proc/<pid>/stat and
+ * /proc/<pid>/io (io_fd may be -1). The caller has already checked that pid
+ * is not a Light Weight Process.
+ *
+ * RET false if the stat file could not be read (the process went away)
+ */
+static bool _handle_stats(pid_t pid, int stat_fd, int io_fd,
+			  jag_callbacks_t *callbacks, int tres_count)
 {
 	static int no_share_data = -1;
 	static int use_pss = -1;
-	FILE *stat_fp = NULL;
-	FILE *io_fp = NULL;
-	int fd, fd2;
+	char proc_file[256];	/* Allow ~20x extra length */
 	jag_prec_t *prec = NULL;
 
 	if (no_share_data == -1) {
@@ -521,22 +536,6 @@ static void _handle_stats(char *proc_stat_file, char *proc_io_file,
 			use_pss = 0;
 	}
 
-	if (!(stat_fp = fopen(proc_stat_file, "r")))
-		return;  /* Assume the process went away */
-	/*
-	 * Close the file on exec() of user tasks.
-	 *
-	 * NOTE: If we fork() slurmstepd after the
-	 * fopen() above and before the fcntl() below,
-	 * then the user task may have this extra file
-	 * open, which can cause problems for
-	 * checkpoint/restart, but this should be a very rare
-	 * problem in practice.
-	 */
-	fd = fileno(stat_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_stat_file);
-
 	prec = xmalloc(sizeof(jag_prec_t));
 
 	if (!tres_count) {
@@ -554,13 +553,11 @@ static void _handle_stats(char *proc_stat_file, char *proc_io_file,
 
 	(void)_init_tres(prec, NULL);
 
-	if (!_get_process_data_line(fd, prec)) {
-		fclose(stat_fp);
-		goto bail_out;
+	if (!_get_process_data_line(stat_fd, prec)) {
+		destroy_jag_prec(prec);
+		return false;
 	}
 
-	fclose(stat_fp);
-
 	if (acct_gather_filesystem_g_get_data(prec->tres_data) < 0) {
 		log_flag(JAG, "problem retrieving filesystem data");
 	}
@@ -570,53 +567,187 @@ static void _handle_stats(char *proc_stat_file, char *proc_io_file,
 	}
 
 	/* Remove shared data from rss */
-	if (no_share_data && !_remove_share_data(proc_stat_file, prec))
+	if (no_share_data && !_remove_share_data(pid, prec))
 		goto bail_out;
 
 	/* Use PSS instead if RSS */
-	if (use_pss && _get_pss(proc_smaps_file, prec) == -1)
-		goto bail_out;
-
-	if ((io_fp = fopen(proc_io_file, "r"))) {
-		fd2 = fileno(io_fp);
-		if (fcntl(fd2, F_SETFD, FD_CLOEXEC) == -1)
-			error("%s: fcntl: %m", __func__);
-		if (!_get_process_io_data_line(fd2, prec)) {
-			fclose(io_fp);
+	if (use_pss) {
+		snprintf(proc_file, sizeof(proc_file), "/proc/%d/smaps", pid);
+		if (_get_pss(proc_file, prec) == -1)
 			goto bail_out;
-		}
-		fclose(io_fp);
 	}
 
+	if ((io_fd >= 0) && !_get_process_io_data_line(io_fd, prec))
+		goto bail_out;
+
 	destroy_jag_prec(list_remove_first(prec_list, _find_prec, &prec->pid));
 	list_append(prec_list, prec);
-	return;
+	return true;
 
 bail_out:
-	xfree(prec->tres_data);
-	xfree(prec);
-	return;
+	destroy_jag_prec(prec);
+	return true;
+}
+
+/* Open /proc/<pid>/<name>, closed on exec() of user tasks */
+static int _open_proc_file(pid_t pid, char *name)
+{
+	char proc_file[256];	/* Allow ~20x extra length */
+
+	snprintf(proc_file, sizeof(proc_file), "/proc/%d/%s", pid, name);
+	return open(proc_file, O_RDONLY | O_CLOEXEC);
+}
+
+/* Read the stats of pid without keeping any file open */
+static void _handle_pid(pid_t pid, jag_callbacks_t *callbacks, int tres_count)
+{
+	int stat_fd, io_fd;
+
+	/*
+	 * If pid corresponds to a Light Weight Process (Thread POSIX) or
+	 * there was an error, skip it, we will only account the original
+	 * process (pid==tgid).
+	 */
+	if (_is_a_lwp(pid))
+		return;
+
+	if ((stat_fd = _open_proc_file(pid, "stat")) < 0)
+		return;  /* Assume the process went away */
+	io_fd = _open_proc_file(pid, "io");
+
+	(void) _handle_stats(pid, stat_fd, io_fd, callbacks, tres_count);
+
+	close(stat_fd);
+	if (io_fd >= 0)
+		close(io_fd);
+}
+
+static int _cmp_pid(const void *x, const void *y)
+{
+	pid_t pid1 = *(pid_t *) x;
+	pid_t pid2 = *(pid_t *) y;
+
+	return (pid1 > pid2) - (pid1 < pid2);
+}
+
+static void _close_cached_pid(jag_pid_t *cpid)
+{
+	if (cpid->stat_fd >= 0)
+		close(cpid->stat_fd);
+	if (cpid->io_fd >= 0)
+		close(cpid->io_fd);
+	cpid->stat_fd = cpid->io_fd = -1;
+}
+
+/* Log running out of file descriptors at most once a minute */
+static void _cache_open_error(pid_t pid)
+{
+	static time_t error_time = 0;
+	time_t now;
+
+	if ((errno != EMFILE) && (errno != ENFILE))
+		return;	/* Assume the process went away */
+
+	now = time(NULL);
+	if (difftime(now, error_time) > 60) {
+		error("%s: can not keep /proc files of pid %d open, reading them on each poll instead: %m",
+		      __func__, pid);
+		error_time = now;
+	}
+}
+
+/*
+ * Keep the stat and io files of cpid open. If that fails, the files are
+ * opened again on the next poll and _get_precs() reads the process with
+ * _handle_pid() in the meantime.
+ */
+static void _open_cached_pid(jag_pid_t *cpid)
+{
+	int rc;
+
+	/* Remember LWPs so they are not checked again, retry on errors */
+	if ((rc = _is_a_lwp(cpid->pid))) {
+		cpid->lwp = (rc == 1);
+		return;
+	}
+
+	if ((cpid->stat_fd = _open_proc_file(cpid->pid, "stat")) < 0) {
+		_cache_open_error(cpid->pid);
+		return;
+	}
+	if ((cpid->io_fd = _open_proc_file(cpid->pid, "io")) < 0) {
+		int open_errno = errno;
+
+		_cache_open_error(cpid->pid);
+		/* Don't lose the io counters, read both transiently */
+		if ((open_errno == EMFILE) || (open_errno == ENFILE))
+			_close_cached_pid(cpid);
+	}
+}
+
+/*
+ * Bring pid_cache in line with the pids proctrack has in the container.
+ * Both are sorted, so this is a single merge pass: pids still there keep
+ * their open files, new pids are opened and pids gone are closed.
+ */
+static void _update_pid_cache(pid_t *pids, int npids)
+{
+	jag_pid_t *new_cache = NULL;
+	int i, j = 0, new_cnt = 0;
+
+	if (npids) {
+		qsort(pids, npids, sizeof(pid_t), _cmp_pid);
+		new_cache = xcalloc(npids, sizeof(jag_pid_t));
+	}
+
+	for (i = 0; i < npids; i++) {
+		jag_pid_t *cpid = &new_cache[new_cnt];
+
+		if (i && (pids[i] == pids[i - 1]))
+			continue;
+
+		while ((j < pid_cache_cnt) && (pid_cache[j].pid < pids[i]))
+			_close_cached_pid(&pid_cache[j++]);
+
+		if ((j < pid_cache_cnt) && (pid_cache[j].pid == pids[i])) {
+			*cpid = pid_cache[j++];
+		} else {
+			cpid->pid = pids[i];
+			cpid->stat_fd = cpid->io_fd = -1;
+		}
+
+		if ((cpid->stat_fd < 0) && !cpid->lwp)
+			_open_cached_pid(cpid);
+		new_cnt++;
+	}
+
+	while (j < pid_cache_cnt)
+		_close_cached_pid(&pid_cache[j++]);
+
+	xfree(pid_cache);
+	pid_cache = new_cache;
+	pid_cache_cnt = new_cnt;
 }
 
 static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 		       jag_callbacks_t *callbacks)
 {
-	char	proc_stat_file[256];	/* Allow ~20x extra length */
-	char	proc_io_file[256];	/* Allow ~20x extra length */
-	char	proc_smaps_file[256];	/* Allow ~20x extra length */
 	static	int	slash_proc_open = 0;
-	int i;
+	int i, tres_count;
 	struct jobacctinfo *jobacct = NULL;
 
 	xassert(task_list);
 
 	jobacct = list_peek(task_list);
+	tres_count = jobacct ? jobacct->tres_count : 0;
 
 	if (!pgid_plugin) {
 		pid_t *pids = NULL;
 		int npids = 0;
 		/* get only the processes in the proctrack container */
 		proctrack_g_get_pids(cont_id, &pids, &npids);
+		_update_pid_cache(pids, npids);
+		xfree(pids);
 		if (!npids) {
 			/* update consumed energy even if pids do not exist */
 			if (jobacct) {
@@ -638,18 +769,28 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 				 cont_id);
 			goto finished;
 		}
-		for (i = 0; i < npids; i++) {
-			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
-			snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
-			snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
-			_handle_stats(proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks,
-				      jobacct ? jobacct->tres_count : 0);
+		for (i = 0; i < pid_cache_cnt; i++) {
+			jag_pid_t *cpid = &pid_cache[i];
+
+			if (cpid->lwp)
+				continue;
+			if (cpid->stat_fd < 0) {
+				/* Could not be kept open, read it once */
+				_handle_pid(cpid->pid, callbacks, tres_count);
+				continue;
+			}
+			/*
+			 * A reaped process can't be read through the old file
+			 * anymore, reopen it if the pid shows up again.
+			 */
+			if (!_handle_stats(cpid->pid, cpid->stat_fd,
+					   cpid->io_fd, callbacks, tres_count))
+				_close_cached_pid(cpid);
 		}
-		xfree(pids);
 	} else {
 		struct dirent *slash_proc_entry;
-		char  *iptr = NULL, *optr = NULL, *optr2 = NULL;
+		char *end_ptr = NULL;
+		long pid;
 
 		if (slash_proc_open) {
 			rewinddir(slash_proc);
@@ -661,80 +802,13 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			}
 			slash_proc_open=1;
 		}
-		strcpy(proc_stat_file, "/proc/");
-		strcpy(proc_io_file, "/proc/");
-		strcpy(proc_smaps_file, "/proc/");
 
 		while ((slash_proc_entry = readdir(slash_proc))) {
-
-			/* Save a few cyles by simulating
-			 * strcat(statFileName, slash_proc_entry->d_name);
-			 * strcat(statFileName, "/stat");
-			 * while checking for a numeric filename (which really
-			 * should be a pid). Then do the same for the
-			 * /proc/<pid>/io file name.
-			 */
-			optr = proc_stat_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-
-			if (i == -1)
+			/* Only numeric entries are processes */
+			pid = strtol(slash_proc_entry->d_name, &end_ptr, 10);
+			if ((pid <= 0) || (*end_ptr != '\0'))
 				continue;
-			iptr = (char*)"/stat";
-
-			do {
-				*optr++ = *iptr++;
-			} while (*iptr);
-			*optr = 0;
-
-			optr2 = proc_io_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/io";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			optr2 = proc_smaps_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/smaps";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			_handle_stats(proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks,
-				      jobacct ? jobacct->tres_count : 0);
+			_handle_pid((pid_t) pid, callbacks, tres_count);
 		}
 	}
 
@@ -743,6 +817,64 @@ finished:
 	return prec_list;
 }
 
+static int _get_task_prec(void *x, void *arg)
+{
+	struct jobacctinfo *jobacct = (struct jobacctinfo *) x;
+	jag_prec_t *prec;
+
+	if ((prec = list_find_first(prec_list, _find_prec, &jobacct->pid)))
+		return SLURM_SUCCESS;
+
+	prec = xmalloc(sizeof(jag_prec_t));
+	prec->pid = jobacct->pid;
+	prec->tres_count = jobacct->tres_count;
+	prec->tres_data = xcalloc(prec->tres_count,
+				  sizeof(acct_gather_data_t));
+	(void) _init_tres(prec, NULL);
+	list_append(prec_list, prec);
+
+	return SLURM_SUCCESS;
+}
+
+extern List jag_common_get_task_precs(List task_list, bool pgid_plugin,
+				      uint64_t cont_id,
+				      jag_callbacks_t *callbacks)
+{
+	jag_prec_t *prec;
+	ListIterator itr;
+
+	xassert(task_list);
+	xassert(callbacks->prec_extra);
+
+	(void) list_for_each(task_list, _get_task_prec, NULL);
+
+	itr = list_iterator_create(prec_list);
+	while ((prec = list_next(itr))) {
+		if (acct_gather_filesystem_g_get_data(prec->tres_data) < 0)
+			log_flag(JAG, "problem retrieving filesystem data");
+		if (acct_gather_interconnect_g_get_data(prec->tres_data) < 0)
+			log_flag(JAG, "problem retrieving interconnect data");
+	}
+	list_iterator_destroy(itr);
+
+	return prec_list;
+}
+
+extern List jag_common_get_proc_precs(List task_list, bool pgid_plugin,
+				      uint64_t cont_id,
+				      jag_callbacks_t *callbacks)
+{
+	return _get_precs(task_list, pgid_plugin, cont_id, callbacks);
+}
+
+extern void jag_common_poll_stats(uint32_t *cnt, uint64_t *usec_tot,
+				  uint64_t *usec_max)
+{
+	*cnt = poll_cnt;
+	*usec_tot = poll_usec_tot;
+	*usec_max = poll_usec_max;
+}
+
 static void _record_profile(struct jobacctinfo *jobacct)
 {
 	enum {
@@ -889,8 +1021,15 @@ extern void jag_common_init(long in_hertz)
 
 extern void jag_common_fini(void)
 {
+	if (poll_cnt)
+		debug("%s: %u polls took %"PRIu64" usec total, %"PRIu64" usec average, %"PRIu64" usec max",
+		      __func__, poll_cnt, poll_usec_tot,
+		      poll_usec_tot / poll_cnt, poll_usec_max);
+
 	FREE_NULL_LIST(prec_list);
 
+	_update_pid_cache(NULL, 0);
+
 	if (slash_proc)
 		(void) closedir(slash_proc);
 }
@@ -950,6 +1089,7 @@ extern void jag_common_poll_data(
 	int energy_counted = 0;
 	time_t ct;
 	int i = 0;
+	DEF_TIMERS;
 
 	xassert(callbacks);
 
@@ -963,6 +1103,7 @@ extern void jag_common_poll_data(
 		return;
 	}
 	processing = 1;
+	START_TIMER;
 
 	if (!callbacks->get_precs)
 		callbacks->get_precs = _get_precs;
@@ -1156,5 +1297,11 @@ extern void jag_common_poll_data(
 						total_job_vsize);
 
 finished:
+	END_TIMER;
+	poll_cnt++;
+	poll_usec_tot += DELTA_TIMER;
+	poll_usec_max = MAX(poll_usec_max, DELTA_TIMER);
+	log_flag(JAG, "poll took %s", TIME_STR);
+
 	processing = 0;
 }
@@ -68,6 +68,30 @@ extern void jag_common_init(long in_hertz);
 extern void jag_common_fini(void);
 extern void destroy_jag_prec(void *object);
 
+/*
+ * Alternative get_precs() callback that does not look at /proc.  A single
+ * record is kept per task, keyed by the task's pid, and prec_extra() is
+ * expected to fill it in from counters aggregated over the whole task
+ * (e.g. its cgroup).
+ */
+extern List jag_common_get_task_precs(List task_list, bool pgid_plugin,
+				      uint64_t cont_id,
+				      jag_callbacks_t *callbacks);
+
+/* The default get_precs() callback, reading every process from /proc */
+extern List jag_common_get_proc_precs(List task_list, bool pgid_plugin,
+				      uint64_t cont_id,
+				      jag_callbacks_t *callbacks);
+
+/*
+ * Get the cost of the polls done for this step
+ * OUT cnt - number of polls
+ * OUT usec_tot - total time spent polling
+ * OUT usec_max - time of the longest poll
+ */
+extern void jag_common_poll_stats(uint32_t *cnt, uint64_t *usec_tot,
+				  uint64_t *usec_max);
+
 extern void jag_common_poll_data(
 	List task_list, bool pgid_plugin, uint64_t cont_id,
 	jag_callbacks_t *callbacks, bool profile);
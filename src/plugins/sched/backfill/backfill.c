@@ -190,6 +190,7 @@ static int bf_job_part_count_reserve = 0;
 static int bf_max_job_array_resv = BF_MAX_JOB_ARRAY_RESV;
 static int bf_min_age_reserve = 0;
 static bool bf_running_job_reserve = false;
+static bool bf_licenses = false;
 static uint32_t bf_min_prio_reserve = 0;
 static List deadlock_global_list;
 static bool bf_hetjob_immediate = false;
@@ -941,6 +942,11 @@ static void _load_config(void)
 	else
 		bf_running_job_reserve = false;
 
+	if (xstrcasestr(sched_params, "bf_licenses"))
+		bf_licenses = true;
+	else
+		bf_licenses = false;
+
 	if ((tmp_ptr = xstrcasestr(sched_params, "max_rpc_cnt=")))
 		max_rpc_cnt = atoi(tmp_ptr + 12);
 	else if ((tmp_ptr = xstrcasestr(sched_params, "max_rpc_count=")))
@@ -1573,6 +1579,7 @@ static int _attempt_backfill(void)
 	time_t now, sched_start, later_start, start_res, resv_end, window_end;
 	time_t het_job_time, orig_sched_start, orig_start_time = (time_t) 0;
 	node_space_map_t *node_space;
+	license_timeline_t *license_timeline = NULL;
 	struct timeval bf_time1, bf_time2;
 	int rc = 0, error_code;
 	int job_test_count = 0, test_time_count = 0, pend_time;
@@ -1667,6 +1674,10 @@ static int _attempt_backfill(void)
 			      &node_space_handler);
 	}
 
+	/* Track when licenses held by running jobs are released */
+	if (bf_licenses)
+		license_timeline = license_timeline_create(sched_start);
+
 	if (slurm_conf.debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 		_dump_node_space_table(node_space);
 
@@ -1958,8 +1969,9 @@ next_task:
 		}
 
 		if ((!job_independent(job_ptr)) ||
-		    (license_job_test(job_ptr, time(NULL), true) !=
-		     SLURM_SUCCESS)) {
+		    (!license_timeline &&
+		     (license_job_test(job_ptr, time(NULL), true) !=
+		      SLURM_SUCCESS))) {
 			log_flag(BACKFILL, "%pJ not runable now",
 				 job_ptr);
 			continue;
@@ -2105,6 +2117,20 @@ next_task:
 		start_res = MAX(later_start, het_job_time);
 		resv_end = 0;
 		later_start = 0;
+		if (license_timeline) {
+			time_t lic_start = MAX(start_res, now);
+			lic_start = license_timeline_start(
+				license_timeline, job_ptr, lic_start,
+				lic_start + ((time_t) time_limit * 60));
+			if (!lic_start) {
+				log_flag(BACKFILL, "%pJ licenses never available",
+					 job_ptr);
+				_set_job_time_limit(job_ptr, orig_time_limit);
+				continue;
+			}
+			if (lic_start > now)
+				start_res = MAX(start_res, lic_start);
+		}
 		/* Determine impact of any advance reservations */
 		j = job_test_resv(job_ptr, &start_res, true, &avail_bitmap,
 				  &exc_core_bitmap, &resv_overlap, false);
@@ -2495,6 +2521,11 @@ skip_start:
 				if (save_time_limit != job_ptr->time_limit)
 					jobacct_storage_job_start_direct(
 							acct_db_conn, job_ptr);
+				if (license_timeline)
+					license_timeline_add(
+						license_timeline, job_ptr,
+						job_ptr->start_time,
+						job_ptr->end_time);
 				job_start_cnt++;
 				if (max_backfill_jobs_start &&
 				    (job_start_cnt >= max_backfill_jobs_start)){
@@ -2605,6 +2636,28 @@ skip_start:
 			break;
 		}
 
+		if (license_timeline) {
+			time_t lic_start = license_timeline_start(
+				license_timeline, job_ptr, job_ptr->start_time,
+				end_reserve);
+			if (!lic_start) {
+				log_flag(BACKFILL, "%pJ licenses never available",
+					 job_ptr);
+				job_ptr->start_time = orig_start_time;
+				_set_job_time_limit(job_ptr, orig_time_limit);
+				continue;
+			}
+			if (lic_start > job_ptr->start_time) {
+				/* Licenses are used by other jobs during
+				 * some of the run time, try when freed */
+				later_start = lic_start;
+				job_ptr->start_time = 0;
+				log_flag(BACKFILL, "%pJ licenses not available until %ld",
+					 job_ptr, later_start);
+				goto TRY_LATER;
+			}
+		}
+
 		if ((job_ptr->start_time > now) &&
 		    (job_ptr->state_reason != WAIT_BURST_BUFFER_RESOURCE) &&
 		    (job_ptr->state_reason != WAIT_BURST_BUFFER_STAGING) &&
@@ -2708,6 +2761,10 @@ skip_start:
 		    !(job_ptr->bit_flags & JOB_MAGNETIC)) {
 			_add_reservation(start_time, end_reserve, avail_bitmap,
 					 node_space, &node_space_recs);
+			if (license_timeline)
+				license_timeline_add(license_timeline, job_ptr,
+						     job_ptr->start_time,
+						     end_reserve);
 		}
 		if (slurm_conf.debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 			_dump_node_space_table(node_space);
@@ -2764,6 +2821,7 @@ skip_start:
 			break;
 	}
 	xfree(node_space);
+	license_timeline_destroy(license_timeline);
 	FREE_NULL_LIST(job_queue);
 
 	gettimeofday(&bf_time2, NULL);
@@ -331,6 +331,14 @@ static avail_res_t **_get_res_avail(job_record_t *job_ptr,
 
 	xassert(*cons_common_callbacks.can_job_run_on_node);
 
+	/*
+	 * Skip the detailed GRES tests on nodes lacking enough free GRES.
+	 * The index only covers the current allocations, not copies of them
+	 * made for will-run and preemption tests.
+	 */
+	if (is_cons_tres && !test_only && (node_usage == select_node_usage))
+		gres_node_avail_filter(job_ptr->gres_list, node_map);
+
 	avail_res_array = xcalloc(select_node_cnt, sizeof(avail_res_t *));
 	i_first = bit_ffs(node_map);
 	if (i_first != -1)
@@ -55,6 +55,7 @@
 #define OPT_LONG_FEDR      0x105
 #define OPT_LONG_WHETJOB   0x106
 #define OPT_LONG_LOCAL_UID 0x107
+#define OPT_LONG_CHUNK_SIZE 0x108
 
 #define JOB_HASH_SIZE 1000
 
@@ -331,6 +332,10 @@ sacct [<OPTION>]                                                            \n \
      -b, --brief:                                                           \n\
 	           Equivalent to '--format=jobstep,state,error'.            \n\
      -c, --completion: Use job completion instead of accounting data.       \n\
+         --chunk-size=<count>:                                              \n\
+	           Get and print jobs this many at a time instead of all    \n\
+	           at once. Jobs are then sorted and federated duplicates   \n\
+	           removed within each chunk only.                          \n\
          --delimiter:                                                       \n\
 	           ASCII characters used to separate the fields when        \n\
 	           specifying the  -p  or  -P options. The default delimiter\n\
@@ -596,7 +601,8 @@ static void _remove_duplicate_fed_jobs(List jobs)
 	xfree(hash_job);
 }
 
-extern int get_data(void)
+/* Remove duplicates, sort and aggregate the step stats of the jobs */
+static void _process_jobs(List job_list)
 {
 	slurmdb_job_rec_t *job = NULL;
 	slurmdb_step_rec_t *step = NULL;
@@ -606,16 +612,6 @@ extern int get_data(void)
 	int cnt;
 	char *tmp_usage;
 
-	if (params.opt_completion) {
-		jobs = slurmdb_jobcomp_jobs_get(job_cond);
-		return SLURM_SUCCESS;
-	} else {
-		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
-	}
-
-	if (!jobs)
-		return SLURM_ERROR;
-
 	/*
 	 * Remove duplicate federated jobs. The db will remove duplicates for
 	 * one cluster but not when jobs for multiple clusters are requested.
@@ -625,11 +621,11 @@ extern int get_data(void)
 	 * appear to run before any of the other tasks.
 	 */
 	if (params.cluster_name && !(job_cond->flags & JOBCOND_FLAG_DUP))
-		_remove_duplicate_fed_jobs(jobs);
+		_remove_duplicate_fed_jobs(job_list);
 	else
-		list_sort(jobs, _sort_desc_submit_time);
+		list_sort(job_list, _sort_desc_submit_time);
 
-	itr = list_iterator_create(jobs);
+	itr = list_iterator_create(job_list);
 	while ((job = list_next(itr))) {
 
 		if (!job->steps || !(cnt = list_count(job->steps)))
@@ -669,6 +665,38 @@ extern int get_data(void)
 		list_iterator_destroy(itr_step);
 	}
 	list_iterator_destroy(itr);
+}
+
+/* Print each chunk as it comes instead of waiting for every job */
+static int _print_chunk(List job_list, void *arg)
+{
+	_process_jobs(job_list);
+
+	jobs = job_list;
+	do_list();
+	jobs = NULL;
+
+	return SLURM_SUCCESS;
+}
+
+extern int get_data(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+
+	if (params.opt_completion) {
+		jobs = slurmdb_jobcomp_jobs_get(job_cond);
+		return SLURM_SUCCESS;
+	} else if (job_cond->chunk_size) {
+		return slurmdb_jobs_get_chunked(acct_db_conn, job_cond,
+						_print_chunk, NULL);
+	} else {
+		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
+	}
+
+	if (!jobs)
+		return SLURM_ERROR;
+
+	_process_jobs(jobs);
 
 	return SLURM_SUCCESS;
 }
@@ -696,6 +724,7 @@ extern void parse_command_line(int argc, char **argv)
                 {"accounts",       required_argument, 0,    'A'},
                 {"allocations",    no_argument,       0,    'X'},
                 {"brief",          no_argument,       0,    'b'},
+                {"chunk-size",     required_argument, 0,    OPT_LONG_CHUNK_SIZE},
                 {"completion",     no_argument,       0,    'c'},
                 {"constraints",    required_argument, 0,    'C'},
                 {"delimiter",      required_argument, 0,    OPT_LONG_DELIMITER},
@@ -781,6 +810,14 @@ extern void parse_command_line(int argc, char **argv)
 		case 'c':
 			params.opt_completion = 1;
 			break;
+		case OPT_LONG_CHUNK_SIZE:
+			if (parse_uint32(optarg, &job_cond->chunk_size) ||
+			    !job_cond->chunk_size) {
+				error("Invalid --chunk-size value \"%s\".",
+				      optarg);
+				exit(1);
+			}
+			break;
 		case OPT_LONG_DELIMITER:
 			fields_delimiter = optarg;
 			break;
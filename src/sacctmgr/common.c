@@ -976,7 +976,7 @@ extern int sacctmgr_remove_assoc_usage(slurmdb_assoc_cond_t *assoc_cond)
 		if (list_count(update_obj->objects)) {
 			list_append(update_list, update_obj);
 			rc = slurmdb_send_accounting_update(
-				update_list, cluster,
+				update_list, 0, cluster,
 				cluster_rec->control_host,
 				cluster_rec->control_port,
 				cluster_rec->rpc_version);
@@ -1068,7 +1068,7 @@ extern int sacctmgr_remove_qos_usage(slurmdb_qos_cond_t *qos_cond)
 		if (list_count(update_obj->objects)) {
 			list_append(update_list, update_obj);
 			rc = slurmdb_send_accounting_update(
-				update_list, cluster_name,
+				update_list, 0, cluster_name,
 				cluster_rec->control_host,
 				cluster_rec->control_port,
 				cluster_rec->rpc_version);
@@ -291,6 +291,21 @@ extern int sacctmgr_list_stats(int argc, char **argv)
 		list_iterator_destroy(itr);
 	}
 
+	if (stats_rec->mult_msg_cnt) {
+		printf("\nBatched messages (DBD_SEND_MULT_MSG)\n");
+		printf("\tTotal batches: %u\n", stats_rec->mult_msg_cnt);
+		printf("\tTotal records: %"PRIu64"\n", stats_rec->mult_msg_recs);
+		printf("\tMean records:  %"PRIu64"\n",
+		       stats_rec->mult_msg_recs / stats_rec->mult_msg_cnt);
+		printf("\tMax batch:     %"PRIu64"\n",
+		       stats_rec->mult_msg_time_max);
+		printf("\tTotal time:    %"PRIu64"\n",
+		       stats_rec->mult_msg_time_total);
+		printf("\tMean batch:    %"PRIu64"\n",
+		       stats_rec->mult_msg_time_total /
+		       stats_rec->mult_msg_cnt);
+	}
+
 	if (argc) {
 		if (!xstrncasecmp(argv[0], "ave_time", 2))
 			sort_by_ave_time = true;
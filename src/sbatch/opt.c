@@ -203,6 +203,7 @@ env_vars_t env_vars[] = {
   { "SBATCH_GPUS_PER_TASK", LONG_OPT_GPUS_PER_TASK },
   { "SLURM_HINT", LONG_OPT_HINT },
   { "SBATCH_HINT", LONG_OPT_HINT },
+  { "SBATCH_IO_AGGREGATE", LONG_OPT_IO_AGGREGATE },
   { "SBATCH_JOB_NAME", 'J' },
   { "SBATCH_MEM_BIND", LONG_OPT_MEM_BIND },
   { "SBATCH_MEM_PER_CPU", LONG_OPT_MEM_PER_CPU },
@@ -1170,6 +1171,8 @@ static void _help(void)
 "  -H, --hold                  submit job in held state\n"
 "      --ignore-pbs            Ignore #PBS and #BSUB options in the batch script\n"
 "  -i, --input=in              file for batch script's standard input\n"
+"      --io-aggregate[=msec]   coalesce output of job steps on each node for\n"
+"                              up to msec before sending it to srun\n"
 "  -J, --job-name=jobname      name of job\n"
 "  -k, --no-kill               do not kill job on node failure\n"
 "  -L, --licenses=names        required license, comma separated\n"
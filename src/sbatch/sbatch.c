@@ -76,6 +76,7 @@ static void *_get_script_buffer(const char *filename, int *size);
 static int   _job_wait(uint32_t job_id);
 static char *_script_wrap(char *command_string);
 static void  _set_exit_code(void);
+static void  _set_io_aggregate_env(void);
 static void  _set_prio_process_env(void);
 static int   _set_rlimit_env(void);
 static void  _set_spank_env(void);
@@ -197,6 +198,7 @@ int main(int argc, char **argv)
 		_set_spank_env();
 		_set_submit_dir_env();
 		_set_umask_env();
+		_set_io_aggregate_env();
 		if (local_env && !job_env_list) {
 			job_env_list = list_create(NULL);
 			list_append(job_env_list, local_env);
@@ -809,6 +811,19 @@ static void _set_submit_dir_env(void)
 		error("unable to set SLURM_SUBMIT_HOST in environment");
 }
 
+/*
+ * Set SLURM_IO_AGGREGATE so that job steps launched from the batch script
+ * inherit --io-aggregate
+ */
+static void _set_io_aggregate_env(void)
+{
+	if (sbopt.io_aggregate <= 0)
+		return;
+
+	if (setenvf(NULL, "SLURM_IO_AGGREGATE", "%d", sbopt.io_aggregate) < 0)
+		error("unable to set SLURM_IO_AGGREGATE in environment");
+}
+
 /* Set SLURM_UMASK environment variable with current state */
 static int _set_umask_env(void)
 {
@@ -45,6 +45,7 @@
 #include "src/slurmctld/acct_policy.h"
 #include "src/common/node_select.h"
 #include "src/common/slurm_priority.h"
+#include "src/common/xhash.h"
 
 #define _DEBUG 0
 
@@ -69,6 +70,21 @@ typedef struct het_job_limits {
 	slurmdb_qos_rec_t *qos_ptr_2;
 } het_job_limits_t;
 
+/*
+ * Index of the per account or per user used limits list of a QOS, found by
+ * the address of the list.  Only the slurmctld looks these records up, so
+ * the index is kept here rather than in slurmdb_qos_usage_t.  The getters
+ * also run under a QOS read lock, so the indexes have their own lock.
+ */
+typedef struct {
+	List list;		/* list indexed */
+	xhash_t *hash;		/* slurmdb_used_limits_t's of list */
+	xhash_idfunc_t idfunc;	/* key of hash */
+} used_limits_index_t;
+
+static pthread_mutex_t used_limits_index_lock = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *used_limits_index = NULL;
+
 static void _apply_limit_factor(uint64_t *limit, double limit_factor)
 {
 	int64_t new_val;
@@ -530,26 +546,106 @@ static int _get_tres_state_reason(int tres_pos, int unk_reason)
 	return unk_reason;
 }
 
-static int _find_used_limits_for_acct(void *x, void *key)
+static void _used_limits_acct_key(void *item, const char **key,
+				  uint32_t *key_len)
 {
-	slurmdb_used_limits_t *used_limits = (slurmdb_used_limits_t *)x;
-	char *account = (char *)key;
+	slurmdb_used_limits_t *used_limits = item;
 
-	if (!xstrcmp(account, used_limits->acct))
-		return 1;
+	*key = used_limits->acct ? used_limits->acct : "";
+	*key_len = strlen(*key);
+}
+
+static void _used_limits_user_key(void *item, const char **key,
+				  uint32_t *key_len)
+{
+	slurmdb_used_limits_t *used_limits = item;
+
+	*key = (char *) &used_limits->uid;
+	*key_len = sizeof(used_limits->uid);
+}
+
+static int _hash_used_limits(void *x, void *arg)
+{
+	xhash_add(arg, x);
 
 	return 0;
 }
 
-static int _find_used_limits_for_user(void *x, void *key)
+static void _used_limits_index_key(void *item, const char **key,
+				   uint32_t *key_len)
 {
-	slurmdb_used_limits_t *used_limits = (slurmdb_used_limits_t *)x;
-	uint32_t user_id = *(uint32_t *)key;
+	used_limits_index_t *index = item;
 
-	if (used_limits->uid == user_id)
-		return 1;
+	*key = (char *) &index->list;
+	*key_len = sizeof(index->list);
+}
 
-	return 0;
+static void _used_limits_index_free(void *item)
+{
+	used_limits_index_t *index = item;
+
+	xhash_free_ptr(&index->hash);
+	xfree(index);
+}
+
+/*
+ * Return the index of a used limits list.  Records are only added through
+ * the getters below, which add them to the index as well, so an index not
+ * holding as many records as its list belongs to a list filled without it
+ * (e.g. unpacked) or to a freed list whose address was reused, and is built
+ * again.  Indexes of lists freed with their QOS are left behind.
+ * Call with used_limits_index_lock held.
+ */
+static xhash_t *_used_limits_hash(List used_limits_list,
+				  xhash_idfunc_t idfunc)
+{
+	used_limits_index_t *index;
+
+	if (!used_limits_index)
+		used_limits_index = xhash_init(_used_limits_index_key,
+					       _used_limits_index_free);
+
+	if (!(index = xhash_get(used_limits_index,
+				(char *) &used_limits_list,
+				sizeof(used_limits_list)))) {
+		index = xmalloc(sizeof(*index));
+		index->list = used_limits_list;
+		xhash_add(used_limits_index, index);
+	}
+
+	if (!index->hash || (index->idfunc != idfunc) ||
+	    (xhash_count(index->hash) != list_count(used_limits_list))) {
+		xhash_free_ptr(&index->hash);
+		index->hash = xhash_init(idfunc, NULL);
+		index->idfunc = idfunc;
+		list_for_each(used_limits_list, _hash_used_limits,
+			      index->hash);
+	}
+
+	return index->hash;
+}
+
+/*
+ * Return true if the job request fits in the Grp TRES left to its association
+ * and all of its parents, in which case the limits don't need to be checked
+ * one by one.  A false return only means they have to be.
+ */
+static bool _fits_grp_tres_avail(slurmdb_assoc_rec_t *assoc_ptr,
+				 uint64_t *tres_req_cnt)
+{
+	uint64_t *grp_tres_avail;
+	int i;
+
+	if (!assoc_ptr)
+		return false;
+
+	grp_tres_avail = assoc_mgr_get_grp_tres_avail(assoc_ptr);
+	for (i = 0; i < g_tres_count; i++) {
+		if (tres_req_cnt[i] >= grp_tres_avail[i])
+			return false;
+	}
+
+	return true;
 }
 
 static bool _valid_job_assoc(job_record_t *job_ptr)
@@ -3677,6 +3773,7 @@ extern bool acct_policy_job_runnable_post_select(job_record_t *job_ptr,
 	uint32_t time_limit;
 	bool rc = true;
 	bool safe_limits = false;
+	bool grp_tres_fit = false;
 	int i, tres_pos = 0;
 	acct_policy_tres_usage_t tres_usage;
 	double usage_factor = 1.0;
@@ -3769,6 +3866,14 @@ extern bool acct_policy_job_runnable_post_select(job_record_t *job_ptr,
 	else if (qos_ptr_2 && !fuzzy_equal(qos_ptr_2->limit_factor, INFINITE))
                 limit_factor = qos_ptr_2->limit_factor;
 
+	/*
+	 * The headroom doesn't know about limit factors, in that case check
+	 * the Grp TRES of each association.
+	 */
+	if (limit_factor <= 0.0)
+		grp_tres_fit = _fits_grp_tres_avail(job_ptr->assoc_ptr,
+						    tres_req_cnt);
+
 	assoc_ptr = job_ptr->assoc_ptr;
 	while (assoc_ptr) {
 		for (i = 0; i < slurmctld_tres_cnt; i++) {
@@ -3866,16 +3971,20 @@ extern bool acct_policy_job_runnable_post_select(job_record_t *job_ptr,
 			break;
 		}
 
-		orig_node_cnt = tres_req_cnt[TRES_ARRAY_NODE];
-		_get_unique_job_node_cnt(job_ptr,
-					 assoc_ptr->usage->grp_node_bitmap,
-					 &tres_req_cnt[TRES_ARRAY_NODE]);
-		tres_usage = _validate_tres_usage_limits_for_assoc(
-			&tres_pos,
-			grp_tres_ctld, qos_rec.grp_tres_ctld,
-			tres_req_cnt, assoc_ptr->usage->grp_used_tres,
-			NULL, job_ptr->limit_set.tres, true);
-		tres_req_cnt[TRES_ARRAY_NODE] = orig_node_cnt;
+		if (grp_tres_fit) {
+			tres_usage = TRES_USAGE_OKAY;
+		} else {
+			orig_node_cnt = tres_req_cnt[TRES_ARRAY_NODE];
+			_get_unique_job_node_cnt(
+				job_ptr, assoc_ptr->usage->grp_node_bitmap,
+				&tres_req_cnt[TRES_ARRAY_NODE]);
+			tres_usage = _validate_tres_usage_limits_for_assoc(
+				&tres_pos,
+				grp_tres_ctld, qos_rec.grp_tres_ctld,
+				tres_req_cnt, assoc_ptr->usage->grp_used_tres,
+				NULL, job_ptr->limit_set.tres, true);
+			tres_req_cnt[TRES_ARRAY_NODE] = orig_node_cnt;
+		}
 		switch (tres_usage) {
 		case TRES_USAGE_CUR_EXCEEDS_LIMIT:
 			/* not possible because the curr_usage sent in is NULL*/
@@ -4937,24 +5046,26 @@ extern void acct_policy_set_qos_order(job_record_t *job_ptr,
 }
 
 /*
- * Checks for record in *user_limit_list of user_id if
- * *user_limit_list doesn't exist it will create it, if the user_id
+ * Checks for record in *acct_limit_list of acct if
+ * *acct_limit_list doesn't exist it will create it, if the acct
  * record doesn't exist it will add it to the list.
- * In all cases the user record is returned.
+ * In all cases the acct record is returned.
  */
 extern slurmdb_used_limits_t *acct_policy_get_acct_used_limits(
 	List *acct_limit_list, char *acct)
 {
 	slurmdb_used_limits_t *used_limits;
+	xhash_t *hash;
 
 	xassert(acct_limit_list);
 
+	slurm_mutex_lock(&used_limits_index_lock);
 	if (!*acct_limit_list)
 		*acct_limit_list = list_create(slurmdb_destroy_used_limits);
 
-	if (!(used_limits = list_find_first(*acct_limit_list,
-					    _find_used_limits_for_acct,
-					    acct))) {
+	hash = _used_limits_hash(*acct_limit_list, _used_limits_acct_key);
+
+	if (!(used_limits = xhash_get_str(hash, acct ? acct : ""))) {
 		int i = sizeof(uint64_t) * slurmctld_tres_cnt;
 
 		used_limits = xmalloc(sizeof(slurmdb_used_limits_t));
@@ -4964,7 +5075,9 @@ extern slurmdb_used_limits_t *acct_policy_get_acct_used_limits(
 		used_limits->tres_run_mins = xmalloc(i);
 
 		list_append(*acct_limit_list, used_limits);
+		xhash_add(hash, used_limits);
 	}
+	slurm_mutex_unlock(&used_limits_index_lock);
 
 	return used_limits;
 }
@@ -4979,15 +5092,18 @@ extern slurmdb_used_limits_t *acct_policy_get_user_used_limits(
 	List *user_limit_list, uint32_t user_id)
 {
 	slurmdb_used_limits_t *used_limits;
+	xhash_t *hash;
 
 	xassert(user_limit_list);
 
+	slurm_mutex_lock(&used_limits_index_lock);
 	if (!*user_limit_list)
 		*user_limit_list = list_create(slurmdb_destroy_used_limits);
 
-	if (!(used_limits = list_find_first(*user_limit_list,
-					    _find_used_limits_for_user,
-					    &user_id))) {
+	hash = _used_limits_hash(*user_limit_list, _used_limits_user_key);
+
+	if (!(used_limits = xhash_get(hash, (char *) &user_id,
+				      sizeof(user_id)))) {
 		int i = sizeof(uint64_t) * slurmctld_tres_cnt;
 
 		used_limits = xmalloc(sizeof(slurmdb_used_limits_t));
@@ -4997,7 +5113,9 @@ extern slurmdb_used_limits_t *acct_policy_get_user_used_limits(
 		used_limits->tres_run_mins = xmalloc(i);
 
 		list_append(*user_limit_list, used_limits);
+		xhash_add(hash, used_limits);
 	}
+	slurm_mutex_unlock(&used_limits_index_lock);
 
 	return used_limits;
 }
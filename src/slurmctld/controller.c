@@ -2847,6 +2847,11 @@ void update_logging(void)
 	} else
 		log_opts.syslog_level = LOG_LEVEL_FATAL;
 
+	if (xstrcasestr(slurm_conf.slurmctld_params, "async_log"))
+		log_opts.async = sched_log_opts.async = true;
+	else
+		log_opts.async = sched_log_opts.async = false;
+
 	log_alter(log_opts, SYSLOG_FACILITY_DAEMON,
 	          slurm_conf.slurmctld_logfile);
 
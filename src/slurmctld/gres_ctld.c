@@ -36,6 +36,7 @@
 
 #include "gres_ctld.h"
 #include "src/common/assoc_mgr.h"
+#include "src/common/node_conf.h"
 #include "src/common/xstring.h"
 
 /*
@@ -750,6 +751,7 @@ extern int gres_ctld_job_alloc(List job_gres_list, List node_gres_list,
 			rc = rc2;
 	}
 	list_iterator_destroy(job_gres_iter);
+	gres_node_avail_update(node_gres_list, node_index);
 
 	return rc;
 }
@@ -824,6 +826,7 @@ extern int gres_ctld_job_alloc_whole_node(
 		}
 	}
 	list_iterator_destroy(node_gres_iter);
+	gres_node_avail_update(node_gres_list, node_index);
 
 	return rc;
 }
@@ -1058,6 +1061,7 @@ extern int gres_ctld_job_dealloc(List job_gres_list, List node_gres_list,
 	int rc = SLURM_SUCCESS, rc2;
 	ListIterator job_gres_iter;
 	gres_state_t *job_gres_ptr, *node_gres_ptr;
+	node_record_t *node_ptr;
 
 	if (job_gres_list == NULL)
 		return SLURM_SUCCESS;
@@ -1087,6 +1091,9 @@ extern int gres_ctld_job_dealloc(List job_gres_list, List node_gres_list,
 			rc = rc2;
 	}
 	list_iterator_destroy(job_gres_iter);
+	if ((node_ptr = find_node_record2(node_name)))
+		gres_node_avail_update(node_gres_list,
+				       node_ptr - node_record_table_ptr);
 
 	return rc;
 }
@@ -10590,10 +10590,12 @@ extern void unlink_job_record(job_record_t *job_ptr)
  * reset_job_bitmaps - reestablish bitmaps for existing jobs.
  *	this should be called after rebuilding node information,
  *	but before using any job entries.
+ * IN same_node_order - true if the node table was rebuilt with the nodes in
+ *	the same order, keep the node bitmaps of jobs and steps
  * global: last_job_update - time of last job table update
  *	job_list - pointer to global job list
  */
-void reset_job_bitmaps(void)
+void reset_job_bitmaps(bool same_node_order)
 {
 	ListIterator job_iterator;
 	job_record_t *job_ptr;
@@ -10653,24 +10655,28 @@ void reset_job_bitmaps(void)
 			part_ptr_list = NULL;	/* clear for next job */
 		}
 
-		FREE_NULL_BITMAP(job_ptr->node_bitmap_cg);
-		if (job_ptr->nodes_completing &&
-		    node_name2bitmap(job_ptr->nodes_completing,
-				     false,  &job_ptr->node_bitmap_cg)) {
-			error("Invalid nodes (%s) for %pJ",
-			      job_ptr->nodes_completing, job_ptr);
-			job_fail = true;
-		}
-		FREE_NULL_BITMAP(job_ptr->node_bitmap);
-		if (job_ptr->nodes &&
-		    node_name2bitmap(job_ptr->nodes, false,
-				     &job_ptr->node_bitmap) && !job_fail) {
-			error("Invalid nodes (%s) for %pJ",
-			      job_ptr->nodes, job_ptr);
-			job_fail = true;
+		/* With the node indexes unchanged the bitmaps are still valid */
+		if (!same_node_order) {
+			FREE_NULL_BITMAP(job_ptr->node_bitmap_cg);
+			if (job_ptr->nodes_completing &&
+			    node_name2bitmap(job_ptr->nodes_completing,
+					     false, &job_ptr->node_bitmap_cg)) {
+				error("Invalid nodes (%s) for %pJ",
+				      job_ptr->nodes_completing, job_ptr);
+				job_fail = true;
+			}
+			FREE_NULL_BITMAP(job_ptr->node_bitmap);
+			if (job_ptr->nodes &&
+			    node_name2bitmap(job_ptr->nodes, false,
+					     &job_ptr->node_bitmap) &&
+			    !job_fail) {
+				error("Invalid nodes (%s) for %pJ",
+				      job_ptr->nodes, job_ptr);
+				job_fail = true;
+			}
+			if (reset_node_bitmap(job_ptr))
+				job_fail = true;
 		}
-		if (reset_node_bitmap(job_ptr))
-			job_fail = true;
 		if (!job_fail && !IS_JOB_FINISHED(job_ptr) &&
 		    job_ptr->job_resrcs && (cr_flag || gang_flag) &&
 		    valid_job_resources(job_ptr->job_resrcs,
@@ -10701,13 +10707,14 @@ void reset_job_bitmaps(void)
 			job_fail = true;
 		}
 
-		_reset_step_bitmaps(job_ptr);
+		if (!same_node_order)
+			_reset_step_bitmaps(job_ptr);
 
 		/* Do not increase the job->node_cnt for completed jobs */
 		if (! IS_JOB_COMPLETED(job_ptr))
 			build_node_details(job_ptr, false); /* set node_addr */
 
-		if (_reset_detail_bitmaps(job_ptr))
+		if (!same_node_order && _reset_detail_bitmaps(job_ptr))
 			job_fail = true;
 
 		if (job_fail) {
@@ -58,6 +58,29 @@
 List license_list = (List) NULL;
 time_t last_license_update = 0;
 static pthread_mutex_t license_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The records of license_list indexed by their id, rebuilt whenever the list
+ * changes. Id zero is never used, so a job license record with id zero has
+ * not been looked up yet.
+ */
+static licenses_t **license_by_id = NULL;
+static uint32_t license_id_cnt = 0;
+
+/* Licenses available over time, see license_timeline_create() */
+typedef struct {
+	char *name;		/* license name */
+	int cnt;		/* number of steps */
+	int size;		/* number of steps allocated */
+	time_t *begin;		/* start of each step, ascending */
+	int32_t *avail;		/* available from begin[i] until begin[i+1] */
+} license_steps_t;
+
+struct license_timeline {
+	uint32_t lic_cnt;
+	license_steps_t *lic;	/* indexed by license id */
+};
+
 static void _pack_license(struct licenses *lic, buf_t *buffer,
 			  uint16_t protocol_version);
 
@@ -121,6 +144,52 @@ static int _license_find_remote_rec(void *x, void *key)
 	return _license_find_rec(x, key);
 }
 
+/* Number the records of license_list and index them by id.
+ * license_mutex should be locked before calling this. */
+static void _license_index_rebuild(void)
+{
+	ListIterator iter;
+	licenses_t *license_entry;
+	uint32_t id = 1;
+
+	license_id_cnt = 1;
+	if (license_list)
+		license_id_cnt += list_count(license_list);
+	xrecalloc(license_by_id, license_id_cnt, sizeof(licenses_t *));
+	if (!license_list)
+		return;
+
+	iter = list_iterator_create(license_list);
+	while ((license_entry = list_next(iter))) {
+		license_entry->id = id;
+		license_by_id[id++] = license_entry;
+	}
+	list_iterator_destroy(iter);
+}
+
+/*
+ * Find the configured license matching a job's license record. The id saved
+ * in the job's record by a previous lookup is tried before searching by name.
+ * license_mutex should be locked before calling this.
+ */
+static licenses_t *_job_license_find(licenses_t *license_entry)
+{
+	licenses_t *match;
+
+	if (!license_list)
+		return NULL;
+
+	if ((license_entry->id < license_id_cnt) &&
+	    (match = license_by_id[license_entry->id]) &&
+	    !xstrcmp(match->name, license_entry->name))
+		return match;
+
+	match = list_find_first(license_list, _license_find_rec,
+				license_entry->name);
+	license_entry->id = match ? match->id : 0;
+	return match;
+}
+
 /* Given a license string, return a list of license_t records */
 static List _build_license_list(char *licenses, bool *valid)
 {
@@ -218,6 +287,7 @@ static void _add_res_rec_2_lic_list(slurmdb_res_rec_t *rec, bool sync)
 	license_entry->remote = sync ? 2 : 1;
 
 	list_push(license_list, license_entry);
+	_license_index_rebuild();
 	last_license_update = time(NULL);
 }
 
@@ -236,6 +306,7 @@ extern int license_init(char *licenses)
 	if (!valid)
 		fatal("Invalid configured licenses: %s", licenses);
 
+	_license_index_rebuild();
 	_licenses_print("init_license", license_list, NULL);
 	slurm_mutex_unlock(&license_mutex);
 	return SLURM_SUCCESS;
@@ -257,6 +328,7 @@ extern int license_update(char *licenses)
         slurm_mutex_lock(&license_mutex);
         if (!license_list) {        /* no licenses before now */
                 license_list = new_list;
+                _license_index_rebuild();
                 slurm_mutex_unlock(&license_mutex);
                 return SLURM_SUCCESS;
         }
@@ -293,6 +365,7 @@ extern int license_update(char *licenses)
 
         FREE_NULL_LIST(license_list);
         license_list = new_list;
+        _license_index_rebuild();
         _licenses_print("update_license", license_list, NULL);
         slurm_mutex_unlock(&license_mutex);
         return SLURM_SUCCESS;
@@ -402,6 +475,7 @@ extern void license_remove_remote(slurmdb_res_rec_t *rec)
 			     "removed with %u in use",
 			     license_entry->name, license_entry->used);
 			list_delete_item(iter);
+			_license_index_rebuild();
 			last_license_update = time(NULL);
 			break;
 		}
@@ -475,6 +549,7 @@ extern void license_sync_remote(List res_list)
 			license_entry->remote = 1;
 	}
 	list_iterator_destroy(iter);
+	_license_index_rebuild();
 
 	slurm_mutex_unlock(&license_mutex);
 }
@@ -484,6 +559,8 @@ extern void license_free(void)
 {
 	slurm_mutex_lock(&license_mutex);
 	FREE_NULL_LIST(license_list);
+	xfree(license_by_id);
+	license_id_cnt = 0;
 	slurm_mutex_unlock(&license_mutex);
 }
 
@@ -527,12 +604,7 @@ extern List license_validate(char *licenses, bool validate_configured,
 	_licenses_print("request_license", job_license_list, NULL);
 	iter = list_iterator_create(job_license_list);
 	while ((license_entry = list_next(iter))) {
-		if (license_list) {
-			match = list_find_first(license_list,
-						_license_find_rec,
-						license_entry->name);
-		} else
-			match = NULL;
+		match = _job_license_find(license_entry);
 		if (!match) {
 			debug("License name requested (%s) does not exist",
 			      license_entry->name);
@@ -603,8 +675,7 @@ extern int license_job_test(job_record_t *job_ptr, time_t when, bool reboot)
 	slurm_mutex_lock(&license_mutex);
 	iter = list_iterator_create(job_ptr->license_list);
 	while ((license_entry = list_next(iter))) {
-		match = list_find_first(license_list, _license_find_rec,
-			license_entry->name);
+		match = _job_license_find(license_entry);
 		if (!match) {
 			error("could not find license %s for job %u",
 			      license_entry->name, job_ptr->job_id);
@@ -657,6 +728,7 @@ extern List license_job_copy(List license_list_src)
 		license_entry_dest = xmalloc(sizeof(licenses_t));
 		license_entry_dest->name = xstrdup(license_entry_src->name);
 		license_entry_dest->total = license_entry_src->total;
+		license_entry_dest->id = license_entry_src->id;
 		list_push(license_list_dest, license_entry_dest);
 	}
 	list_iterator_destroy(iter);
@@ -682,8 +754,7 @@ extern int license_job_get(job_record_t *job_ptr)
 	slurm_mutex_lock(&license_mutex);
 	iter = list_iterator_create(job_ptr->license_list);
 	while ((license_entry = list_next(iter))) {
-		match = list_find_first(license_list, _license_find_rec,
-			license_entry->name);
+		match = _job_license_find(license_entry);
 		if (match) {
 			match->used += license_entry->total;
 			license_entry->used += license_entry->total;
@@ -718,8 +789,7 @@ extern int license_job_return(job_record_t *job_ptr)
 	slurm_mutex_lock(&license_mutex);
 	iter = list_iterator_create(job_ptr->license_list);
 	while ((license_entry = list_next(iter))) {
-		match = list_find_first(license_list, _license_find_rec,
-			license_entry->name);
+		match = _job_license_find(license_entry);
 		if (match) {
 			if (match->used >= license_entry->total)
 				match->used -= license_entry->total;
@@ -768,6 +838,310 @@ extern bool license_list_overlap(List list_1, List list_2)
 	return match;
 }
 
+/* Return the index of the step of license_steps starting at when, splitting
+ * the step covering when if needed */
+static int _steps_split(license_steps_t *steps, time_t when)
+{
+	int lo = 0, hi = steps->cnt - 1, mid;
+
+	if (when <= steps->begin[0])
+		return 0;
+
+	/* Find the last step starting at or before when */
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (steps->begin[mid] <= when)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	if (steps->begin[lo] == when)
+		return lo;
+
+	if (steps->cnt == steps->size) {
+		steps->size *= 2;
+		xrecalloc(steps->begin, steps->size, sizeof(time_t));
+		xrecalloc(steps->avail, steps->size, sizeof(int32_t));
+	}
+	lo++;
+	memmove(&steps->begin[lo + 1], &steps->begin[lo],
+		sizeof(time_t) * (steps->cnt - lo));
+	memmove(&steps->avail[lo + 1], &steps->avail[lo],
+		sizeof(int32_t) * (steps->cnt - lo));
+	steps->begin[lo] = when;
+	steps->avail[lo] = steps->avail[lo - 1];
+	steps->cnt++;
+
+	return lo;
+}
+
+/* Add cnt licenses available from start until end, forever if end is zero */
+static void _steps_add(license_steps_t *steps, time_t start, time_t end,
+		       int32_t cnt)
+{
+	int i, last;
+
+	if (end && (end <= start))
+		return;
+
+	i = _steps_split(steps, start);
+	last = end ? _steps_split(steps, end) : steps->cnt;
+	for ( ; i < last; i++)
+		steps->avail[i] += cnt;
+}
+
+/*
+ * Test if cnt licenses are available from start until end.
+ * RET start if they are, else the earliest time after start worth testing
+ *     again or zero if they will never be available
+ */
+static time_t _steps_fit(license_steps_t *steps, int32_t cnt, time_t start,
+			 time_t end)
+{
+	int i, fail = -1;
+
+	for (i = 0; i < steps->cnt; i++) {
+		if ((i + 1 < steps->cnt) && (steps->begin[i + 1] <= start))
+			continue;
+		if ((steps->begin[i] >= end) && (steps->begin[i] > start))
+			break;
+		if (steps->avail[i] < cnt)
+			fail = i;
+	}
+
+	if (fail == -1)
+		return start;
+	if (fail + 1 == steps->cnt)
+		return 0;
+	return steps->begin[fail + 1];
+}
+
+/* Find the timeline of a job's license, the id saved in the job's record is
+ * tried before searching by name */
+static license_steps_t *_timeline_find(license_timeline_t *timeline,
+				       licenses_t *license_entry)
+{
+	uint32_t id = license_entry->id;
+
+	if ((id < timeline->lic_cnt) &&
+	    !xstrcmp(timeline->lic[id].name, license_entry->name))
+		return &timeline->lic[id];
+
+	for (id = 1; id < timeline->lic_cnt; id++) {
+		if (!xstrcmp(timeline->lic[id].name, license_entry->name))
+			return &timeline->lic[id];
+	}
+
+	return NULL;
+}
+
+/*
+ * Guess when a job holding licenses will return them, zero if never.  Past
+ * its end time the job may be in its OverTimeLimit or being killed, which is
+ * guessed as the select plugin does for its nodes.  A suspended job needs
+ * the rest of its time limit once resumed.
+ */
+static time_t _job_lic_end(job_record_t *job_ptr, time_t now)
+{
+	time_t end_time;
+	uint16_t over_time_limit;
+
+	if (IS_JOB_SUSPENDED(job_ptr)) {
+		if ((job_ptr->time_limit == NO_VAL) ||
+		    (job_ptr->time_limit == INFINITE))
+			return 0;
+		end_time = now + (job_ptr->time_limit * 60) -
+			   job_ptr->pre_sus_time;
+		return MAX(end_time, now + 1);
+	}
+
+	if (!job_ptr->end_time || (job_ptr->end_time > now))
+		return job_ptr->end_time;
+
+	if (job_ptr->part_ptr &&
+	    (job_ptr->part_ptr->over_time_limit != NO_VAL16))
+		over_time_limit = job_ptr->part_ptr->over_time_limit;
+	else
+		over_time_limit = slurm_conf.over_time_limit;
+	if (over_time_limit == 0) {
+		end_time = job_ptr->end_time + slurm_conf.kill_wait;
+	} else if (over_time_limit == INFINITE16) {
+		/* No idea when the job might end, this is just a guess */
+		if (job_ptr->time_limit && (job_ptr->time_limit != NO_VAL) &&
+		    (job_ptr->time_limit != INFINITE))
+			end_time = now + (job_ptr->time_limit * 60);
+		else
+			end_time = now + (365 * 24 * 60 * 60);	/* one year */
+	} else {
+		end_time = job_ptr->end_time + slurm_conf.kill_wait +
+			   (over_time_limit * 60);
+	}
+
+	return MAX(end_time, now + 1);
+}
+
+/*
+ * license_timeline_create - Build the availability of licenses over time
+ *	from the licenses available now and the expected end time of the
+ *	running and suspended jobs holding them. job_list should be read
+ *	locked.
+ * IN now - start of the timeline
+ * RET timeline, free with license_timeline_destroy()
+ */
+extern license_timeline_t *license_timeline_create(time_t now)
+{
+	license_timeline_t *timeline = xmalloc(sizeof(*timeline));
+	license_steps_t *steps;
+	licenses_t *license_entry, *match;
+	ListIterator job_iter, iter;
+	job_record_t *job_ptr;
+	time_t end_time;
+	uint32_t id;
+
+	slurm_mutex_lock(&license_mutex);
+	timeline->lic_cnt = license_id_cnt;
+	timeline->lic = xcalloc(MAX(license_id_cnt, 1),
+				sizeof(license_steps_t));
+	for (id = 1; id < license_id_cnt; id++) {
+		match = license_by_id[id];
+		steps = &timeline->lic[id];
+		steps->name = xstrdup(match->name);
+		steps->cnt = 1;
+		steps->size = 16;
+		steps->begin = xcalloc(steps->size, sizeof(time_t));
+		steps->avail = xcalloc(steps->size, sizeof(int32_t));
+		steps->begin[0] = now;
+		steps->avail[0] = (int32_t) match->total - match->used;
+	}
+
+	if (license_id_cnt > 1) {
+		job_iter = list_iterator_create(job_list);
+		while ((job_ptr = list_next(job_iter))) {
+			if ((!IS_JOB_RUNNING(job_ptr) &&
+			     !IS_JOB_SUSPENDED(job_ptr)) ||
+			    !job_ptr->license_list ||
+			    !(end_time = _job_lic_end(job_ptr, now)))
+				continue;
+			iter = list_iterator_create(job_ptr->license_list);
+			while ((license_entry = list_next(iter))) {
+				if (!license_entry->used ||
+				    !(match = _job_license_find(license_entry)))
+					continue;
+				_steps_add(&timeline->lic[match->id],
+					   end_time, 0, license_entry->used);
+			}
+			list_iterator_destroy(iter);
+		}
+		list_iterator_destroy(job_iter);
+	}
+	slurm_mutex_unlock(&license_mutex);
+
+	return timeline;
+}
+
+/* Free a timeline built by license_timeline_create() */
+extern void license_timeline_destroy(license_timeline_t *timeline)
+{
+	uint32_t id;
+
+	if (!timeline)
+		return;
+
+	for (id = 0; id < timeline->lic_cnt; id++) {
+		xfree(timeline->lic[id].name);
+		xfree(timeline->lic[id].begin);
+		xfree(timeline->lic[id].avail);
+	}
+	xfree(timeline->lic);
+	xfree(timeline);
+}
+
+/*
+ * license_timeline_start - Find when the licenses required for a job are
+ *	available for its whole run time
+ * IN timeline - licenses available over time
+ * IN job_ptr - job identification
+ * IN start - earliest start time of the job
+ * IN end - end time of the job if started at start
+ * RET earliest start time at or after start, zero if never
+ */
+extern time_t license_timeline_start(license_timeline_t *timeline,
+				     job_record_t *job_ptr, time_t start,
+				     time_t end)
+{
+	ListIterator iter;
+	licenses_t *license_entry;
+	license_steps_t *steps;
+	time_t next, resv_end, run_time = MAX(end - start, 0);
+	int32_t resv_cnt;
+
+	if (!job_ptr->license_list)	/* no licenses needed */
+		return start;
+
+	while (start) {
+		next = start;
+		iter = list_iterator_create(job_ptr->license_list);
+		while ((license_entry = list_next(iter))) {
+			if (!(steps = _timeline_find(timeline,
+						     license_entry))) {
+				next = 0;
+				break;
+			}
+			resv_cnt = job_test_lic_resv(job_ptr,
+						     license_entry->name,
+						     start, true);
+			next = _steps_fit(steps,
+					  license_entry->total + resv_cnt,
+					  start, start + run_time);
+			if (next == start)
+				continue;
+			/* The licenses may fit once the reservations end */
+			if (resv_cnt) {
+				resv_end = job_lic_resv_end(
+					job_ptr, license_entry->name, start,
+					true);
+				if (resv_end && (!next || (resv_end < next)))
+					next = resv_end;
+			}
+			break;
+		}
+		list_iterator_destroy(iter);
+		if (next == start)
+			break;
+		start = next;
+	}
+
+	return start;
+}
+
+/*
+ * license_timeline_add - Remove the licenses of a job from the timeline
+ *	while it is expected to run
+ * IN timeline - licenses available over time
+ * IN job_ptr - job identification
+ * IN start - expected start time of the job
+ * IN end - expected end time of the job
+ */
+extern void license_timeline_add(license_timeline_t *timeline,
+				 job_record_t *job_ptr, time_t start,
+				 time_t end)
+{
+	ListIterator iter;
+	licenses_t *license_entry;
+	license_steps_t *steps;
+
+	if (!job_ptr->license_list)	/* no licenses needed */
+		return;
+
+	iter = list_iterator_create(job_ptr->license_list);
+	while ((license_entry = list_next(iter))) {
+		if ((steps = _timeline_find(timeline, license_entry)))
+			_steps_add(steps, start, end,
+				   -(int32_t) license_entry->total);
+	}
+	list_iterator_destroy(iter);
+}
+
 /* pack_all_licenses()
  *
  * Return license counters to the library.
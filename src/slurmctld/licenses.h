@@ -48,8 +48,13 @@ typedef struct licenses {
 	uint32_t	used;		/* used licenses */
 	uint32_t	reserved;	/* currently reserved licenses */
 	uint8_t         remote;	        /* non-zero if remote (from database) */
+	uint32_t	id;		/* index of the configured license, for a
+					 * job's license a hint, zero if unset */
 } licenses_t;
 
+/* Licenses available over time, used by the backfill scheduler */
+typedef struct license_timeline license_timeline_t;
+
 extern List license_list;
 extern List clus_license_list;
 extern time_t last_license_update;
@@ -111,6 +116,43 @@ extern int license_job_return(job_record_t *job_ptr);
 extern int license_job_test(job_record_t *job_ptr, time_t when,
 			    bool reboot);
 
+/*
+ * license_timeline_create - Build the availability of licenses over time
+ *	from the licenses available now and the end time of the running jobs
+ *	holding them. job_list should be read locked.
+ * IN now - start of the timeline
+ * RET timeline, free with license_timeline_destroy()
+ */
+extern license_timeline_t *license_timeline_create(time_t now);
+
+/* Free a timeline built by license_timeline_create() */
+extern void license_timeline_destroy(license_timeline_t *timeline);
+
+/*
+ * license_timeline_start - Find when the licenses required for a job are
+ *	available for its whole run time
+ * IN timeline - licenses available over time
+ * IN job_ptr - job identification
+ * IN start - earliest start time of the job
+ * IN end - end time of the job if started at start
+ * RET earliest start time at or after start, zero if never
+ */
+extern time_t license_timeline_start(license_timeline_t *timeline,
+				     job_record_t *job_ptr, time_t start,
+				     time_t end);
+
+/*
+ * license_timeline_add - Remove the licenses of a job from the timeline
+ *	while it is expected to run
+ * IN timeline - licenses available over time
+ * IN job_ptr - job identification
+ * IN start - expected start time of the job
+ * IN end - expected end time of the job
+ */
+extern void license_timeline_add(license_timeline_t *timeline,
+				 job_record_t *job_ptr, time_t start,
+				 time_t end);
+
 /*
  * license_validate - Test if the required licenses are valid
  * IN licenses - required licenses
@@ -66,6 +66,7 @@
 #include "src/common/slurm_topology.h"
 #include "src/common/uid.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -115,6 +116,31 @@ enum {
 	NM_TYPES	/* Number of node types */
 };
 
+/*
+ * Node bitmap of a feature expression as evaluated by valid_feature_counts()
+ * or _match_feature(). The result only depends on the expression and on the
+ * node feature lists, so it is cached until node_features_gen changes.
+ */
+typedef struct {
+	char *key;		/* evaluation type followed by the expression */
+	bitstr_t *node_bitmap;	/* nodes satisfying the expression */
+	bool has_xor;		/* XOR/XAND found in the expression */
+	bool have_count;	/* a feature has a node count */
+} feature_expr_t;
+
+#define FEATURE_EXPR_MAX	1024	/* cached expressions before purge */
+#define FEATURE_EXPR_KEY_LEN	256	/* longer keys are not built on stack */
+#define FEATURE_EXPR_ACTIVE	'A'	/* valid_feature_counts(), active */
+#define FEATURE_EXPR_AVAIL	'V'	/* valid_feature_counts(), available */
+#define FEATURE_EXPR_REBOOT	'R'	/* FEATURE_EXPR_AVAIL, can reboot */
+#define FEATURE_EXPR_MATCH	'M'	/* _match_feature() */
+
+static pthread_mutex_t feature_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t feature_cache_gen = 0;
+static xhash_t *feature_expr_hash = NULL;
+static xhash_t *active_feature_hash = NULL;
+static xhash_t *avail_feature_hash = NULL;
+
 static int  _build_node_list(job_record_t *job_ptr,
 			     struct node_set **node_set_pptr,
 			     int *node_set_size, char **err_msg,
@@ -124,7 +150,8 @@ static bool _first_array_task(job_record_t *job_ptr);
 static void _log_node_set(job_record_t *job_ptr,
 			  struct node_set *node_set_ptr,
 			  int node_set_size);
-static int _match_feature(List feature_list, bitstr_t **inactive_bitmap);
+static int _match_feature(struct job_details *details_ptr,
+			  bitstr_t **inactive_bitmap);
 static int _nodes_in_sets(bitstr_t *req_bitmap,
 			  struct node_set * node_set_ptr,
 			  int node_set_size);
@@ -449,6 +476,132 @@ static void _log_feature_nodes(job_feature_t  *job_feat_ptr)
 	xfree(tmp4);
 }
 
+static void _feature_expr_free(void *x)
+{
+	feature_expr_t *expr = (feature_expr_t *) x;
+
+	if (expr) {
+		xfree(expr->key);
+		FREE_NULL_BITMAP(expr->node_bitmap);
+		xfree(expr);
+	}
+}
+
+static void _feature_expr_identity(void *item, const char **key,
+				   uint32_t *key_len)
+{
+	feature_expr_t *expr = (feature_expr_t *) item;
+
+	*key = expr->key;
+	*key_len = strlen(expr->key);
+}
+
+static void _node_feature_identity(void *item, const char **key,
+				   uint32_t *key_len)
+{
+	node_feature_t *feature_ptr = (node_feature_t *) item;
+
+	*key = feature_ptr->name;
+	*key_len = strlen(feature_ptr->name);
+}
+
+/* Discard cached data if node features changed since it was built.
+ * feature_cache_mutex should be locked before calling this. */
+static void _feature_cache_sync(void)
+{
+	if (feature_cache_gen == node_features_gen)
+		return;
+
+	xhash_free(feature_expr_hash);
+	xhash_free(active_feature_hash);
+	xhash_free(avail_feature_hash);
+	feature_cache_gen = node_features_gen;
+}
+
+/* Find a node feature by name in active_feature_list or avail_feature_list,
+ * indexing the list by name first if needed.
+ * feature_cache_mutex should be locked before calling this. */
+static node_feature_t *_find_node_feature(List feature_list,
+					  xhash_t **feature_hash, char *name)
+{
+	ListIterator feat_iter;
+	node_feature_t *node_feat_ptr;
+
+	if (!feature_list || !name)
+		return NULL;
+
+	if (!*feature_hash) {
+		*feature_hash = xhash_init(_node_feature_identity, NULL);
+		feat_iter = list_iterator_create(feature_list);
+		while ((node_feat_ptr = list_next(feat_iter)))
+			xhash_add(*feature_hash, node_feat_ptr);
+		list_iterator_destroy(feat_iter);
+	}
+
+	return xhash_get_str(*feature_hash, name);
+}
+
+/* Return the cached evaluation of a feature expression, NULL if not found.
+ * feature_cache_mutex should be locked before calling this. */
+static feature_expr_t *_feature_expr_find(char type, char *features)
+{
+	feature_expr_t *expr;
+	char key_buf[FEATURE_EXPR_KEY_LEN], *key = key_buf;
+	uint32_t len;
+
+	if (!features || !feature_expr_hash)
+		return NULL;
+
+	/* Type and expression, only a very long one is allocated */
+	len = strlen(features) + 1;
+	if (len >= sizeof(key_buf))
+		key = xmalloc(len + 1);
+	key[0] = type;
+	memcpy(key + 1, features, len);
+	expr = xhash_get(feature_expr_hash, key, len);
+	if (key != key_buf)
+		xfree(key);
+
+	return expr;
+}
+
+/* Cache the evaluation of a feature expression, consumes expr->node_bitmap.
+ * feature_cache_mutex should be locked before calling this. */
+static void _feature_expr_add(char type, char *features, feature_expr_t *expr)
+{
+	feature_expr_t *new_expr;
+
+	if (!features) {
+		FREE_NULL_BITMAP(expr->node_bitmap);
+		return;
+	}
+
+	if (feature_expr_hash &&
+	    (xhash_count(feature_expr_hash) >= FEATURE_EXPR_MAX))
+		xhash_free(feature_expr_hash);
+	if (!feature_expr_hash)
+		feature_expr_hash = xhash_init(_feature_expr_identity,
+					       _feature_expr_free);
+
+	new_expr = xmalloc(sizeof(*new_expr));
+	new_expr->key = xstrdup_printf("%c%s", type, features);
+	new_expr->node_bitmap = expr->node_bitmap;
+	new_expr->has_xor = expr->has_xor;
+	new_expr->have_count = expr->have_count;
+	expr->node_bitmap = NULL;
+	xhash_add(feature_expr_hash, new_expr);
+}
+
+/* Free the cached node bitmaps of job feature expressions */
+extern void feature_cache_fini(void)
+{
+	slurm_mutex_lock(&feature_cache_mutex);
+	xhash_free(feature_expr_hash);
+	xhash_free(active_feature_hash);
+	xhash_free(avail_feature_hash);
+	slurm_mutex_unlock(&feature_cache_mutex);
+}
+
 /*
  * For every element in the feature_list, identify the nodes with that feature
  * either active or available and set the feature_list's node_bitmap_active and
@@ -462,13 +615,15 @@ extern void find_feature_nodes(List feature_list, bool can_reboot)
 
 	if (!feature_list)
 		return;
+	slurm_mutex_lock(&feature_cache_mutex);
+	_feature_cache_sync();
 	feat_iter = list_iterator_create(feature_list);
 	while ((job_feat_ptr = list_next(feat_iter))) {
 		FREE_NULL_BITMAP(job_feat_ptr->node_bitmap_active);
 		FREE_NULL_BITMAP(job_feat_ptr->node_bitmap_avail);
-		node_feat_ptr = list_find_first(active_feature_list,
-						list_find_feature,
-						job_feat_ptr->name);
+		node_feat_ptr = _find_node_feature(active_feature_list,
+						   &active_feature_hash,
+						   job_feat_ptr->name);
 		if (node_feat_ptr && node_feat_ptr->node_bitmap) {
 			job_feat_ptr->node_bitmap_active =
 				bit_copy(node_feat_ptr->node_bitmap);
@@ -477,9 +632,9 @@ extern void find_feature_nodes(List feature_list, bool can_reboot)
 				bit_alloc(node_record_count);
 		}
 		if (can_reboot && job_feat_ptr->changeable) {
-			node_feat_ptr = list_find_first(avail_feature_list,
-							list_find_feature,
-							job_feat_ptr->name);
+			node_feat_ptr = _find_node_feature(avail_feature_list,
+							   &avail_feature_hash,
+							   job_feat_ptr->name);
 			if (node_feat_ptr && node_feat_ptr->node_bitmap) {
 				job_feat_ptr->node_bitmap_avail =
 					bit_copy(node_feat_ptr->node_bitmap);
@@ -495,29 +650,18 @@ extern void find_feature_nodes(List feature_list, bool can_reboot)
 		_log_feature_nodes(job_feat_ptr);
 	}
 	list_iterator_destroy(feat_iter);
+	slurm_mutex_unlock(&feature_cache_mutex);
 }
 
-/*
- * _match_feature - determine which of the job features are now inactive
- * IN feature_list - Job's feature request list
- * OUT inactive_bitmap - Nodes with this as inactive feature
- * RET 1 if some nodes with this inactive feature, 0 no inactive feature
- * NOTE: Currently fully supports only AND/OR of features, not XAND/XOR
- */
-static int _match_feature(List feature_list, bitstr_t **inactive_bitmap)
+/* Return the nodes with all of the job features active */
+static bitstr_t *_eval_match_feature(List feature_list)
 {
 	ListIterator job_feat_iter;
 	job_feature_t *job_feat_ptr;
 	int last_op = FEATURE_OP_AND, last_paren_op = FEATURE_OP_AND;
-	int i, last_paren_cnt = 0;
+	int last_paren_cnt = 0;
 	bitstr_t *feature_bitmap, *paren_bitmap = NULL, *work_bitmap;
 
-	xassert(inactive_bitmap);
-
-	if (!feature_list ||			/* nothing to look for */
-	    (node_features_g_count() == 0))	/* No inactive features */
-		return 0;
-
 	feature_bitmap = bit_alloc(node_record_count);
 	bit_set_all(feature_bitmap);
 	work_bitmap = feature_bitmap;
@@ -574,8 +718,44 @@ static int _match_feature(List feature_list, bitstr_t **inactive_bitmap)
 }
 #endif
 	FREE_NULL_BITMAP(paren_bitmap);
-	i = bit_ffc(feature_bitmap);
-	if (i == -1) {	/* No required node features inactive */
+
+	return feature_bitmap;
+}
+
+/*
+ * _match_feature - determine which of the job features are now inactive
+ * IN details_ptr - Job's details with the feature request list
+ * OUT inactive_bitmap - Nodes with this as inactive feature
+ * RET 1 if some nodes with this inactive feature, 0 no inactive feature
+ * NOTE: Currently fully supports only AND/OR of features, not XAND/XOR
+ */
+static int _match_feature(struct job_details *details_ptr,
+			  bitstr_t **inactive_bitmap)
+{
+	feature_expr_t *expr, new_expr = { 0 };
+	bitstr_t *feature_bitmap;
+
+	xassert(inactive_bitmap);
+
+	if (!details_ptr->feature_list ||	/* nothing to look for */
+	    (node_features_g_count() == 0))	/* No inactive features */
+		return 0;
+
+	slurm_mutex_lock(&feature_cache_mutex);
+	_feature_cache_sync();
+	if ((expr = _feature_expr_find(FEATURE_EXPR_MATCH,
+				       details_ptr->features))) {
+		feature_bitmap = bit_copy(expr->node_bitmap);
+	} else {
+		feature_bitmap = _eval_match_feature(details_ptr->feature_list);
+		new_expr.node_bitmap = bit_copy(feature_bitmap);
+		_feature_expr_add(FEATURE_EXPR_MATCH, details_ptr->features,
+				  &new_expr);
+	}
+	slurm_mutex_unlock(&feature_cache_mutex);
+
+	if (bit_ffc(feature_bitmap) == -1) {
+		/* No required node features inactive */
 		FREE_NULL_BITMAP(feature_bitmap);
 		return 0;
 	}
@@ -609,7 +789,7 @@ extern void build_active_feature_bitmap(job_record_t *job_ptr,
 
 	can_reboot = node_features_g_user_update(job_ptr->user_id);
 	find_feature_nodes(details_ptr->feature_list, can_reboot);
-	if (_match_feature(details_ptr->feature_list, &tmp_bitmap) == 0)
+	if (_match_feature(details_ptr, &tmp_bitmap) == 0)
 		return;		/* No inactive features */
 
 	bit_not(tmp_bitmap);
@@ -2983,17 +3163,12 @@ extern int list_find_feature(void *feature_entry, void *key)
 }
 
 /*
- * valid_feature_counts - validate a job's features can be satisfied
- *	by the selected nodes (NOTE: does not process XOR or XAND operators)
- * IN job_ptr - job to operate on
- * IN use_active - if set, then only consider nodes with the identified features
- *	active, otherwise use available features
- * IN/OUT node_bitmap - nodes available for use, clear if unusable
- * OUT has_xor - set if XOR/XAND found in feature expression
- * RET SLURM_SUCCESS or error
+ * Evaluate a job's feature expression over all nodes for
+ * valid_feature_counts(), the nodes usable by the job are the ones also set
+ * in expr->node_bitmap. find_feature_nodes() must be called first.
  */
-extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
-				bitstr_t *node_bitmap, bool *has_xor)
+static void _eval_feature_counts(job_record_t *job_ptr, bool use_active,
+				 feature_expr_t *expr)
 {
 	struct job_details *detail_ptr = job_ptr->details;
 	ListIterator job_feat_iter;
@@ -3002,20 +3177,9 @@ extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
 	int last_paren_cnt = 0;
 	bitstr_t *feature_bitmap, *paren_bitmap = NULL;
 	bitstr_t *tmp_bitmap, *work_bitmap;
-	bool have_count = false, user_update;
-	int rc = SLURM_SUCCESS;
 
-	xassert(detail_ptr);
-	xassert(node_bitmap);
-	xassert(has_xor);
-
-	*has_xor = false;
-	if (detail_ptr->feature_list == NULL)	/* no constraints */
-		return rc;
-
-	user_update = node_features_g_user_update(job_ptr->user_id);
-	find_feature_nodes(detail_ptr->feature_list, user_update);
-	feature_bitmap = bit_copy(node_bitmap);
+	feature_bitmap = bit_alloc(node_record_count);
+	bit_set_all(feature_bitmap);
 	work_bitmap = feature_bitmap;
 	job_feat_iter = list_iterator_create(detail_ptr->feature_list);
 	while ((job_feat_ptr = list_next(job_feat_iter))) {
@@ -3034,7 +3198,8 @@ extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
 				}
 				bit_free(paren_bitmap);
 			}
-			paren_bitmap = bit_copy(node_bitmap);
+			paren_bitmap = bit_alloc(node_record_count);
+			bit_set_all(paren_bitmap);
 			work_bitmap = paren_bitmap;
 		}
 
@@ -3054,7 +3219,7 @@ extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
 			 */
 			if ((job_feat_ptr->op_code == FEATURE_OP_XOR) ||
 			    (job_feat_ptr->op_code == FEATURE_OP_XAND)) {
-				*has_xor = true;
+				expr->has_xor = true;
 			} else if (last_op == FEATURE_OP_AND) {
 				bit_and(work_bitmap, tmp_bitmap);
 			} else if (last_op == FEATURE_OP_OR) {
@@ -3065,7 +3230,7 @@ extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
 				bit_clear_all(work_bitmap);
 		}
 		if (job_feat_ptr->count)
-			have_count = true;
+			expr->have_count = true;
 
 		if (last_paren_cnt > job_feat_ptr->paren) {
 			/* End of expression in parenthesis */
@@ -3074,7 +3239,7 @@ extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
 			} else if (last_paren_op == FEATURE_OP_OR) {
 				bit_or(feature_bitmap, work_bitmap);
 			} else {	/* FEATURE_OP_XOR or FEATURE_OP_XAND */
-				*has_xor = true;
+				expr->has_xor = true;
 				bit_or(feature_bitmap, work_bitmap);
 			}
 			FREE_NULL_BITMAP(paren_bitmap);
@@ -3098,10 +3263,72 @@ extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
 		}
 	}
 	list_iterator_destroy(job_feat_iter);
-	if (!have_count)
-		bit_and(node_bitmap, work_bitmap);
+	expr->node_bitmap = bit_copy(work_bitmap);
 	FREE_NULL_BITMAP(feature_bitmap);
 	FREE_NULL_BITMAP(paren_bitmap);
+}
+
+/*
+ * valid_feature_counts - validate a job's features can be satisfied
+ *	by the selected nodes (NOTE: does not process XOR or XAND operators)
+ *	The node bitmaps of the job's feature_list are only set by
+ *	find_feature_nodes() if the expression was not cached yet, a caller
+ *	reading them must call it.
+ * IN job_ptr - job to operate on
+ * IN use_active - if set, then only consider nodes with the identified features
+ *	active, otherwise use available features
+ * IN/OUT node_bitmap - nodes available for use, clear if unusable
+ * OUT has_xor - set if XOR/XAND found in feature expression
+ * RET SLURM_SUCCESS or error
+ */
+extern int valid_feature_counts(job_record_t *job_ptr, bool use_active,
+				bitstr_t *node_bitmap, bool *has_xor)
+{
+	struct job_details *detail_ptr = job_ptr->details;
+	feature_expr_t *expr, new_expr = { 0 };
+	bool user_update;
+	char type;
+	int rc = SLURM_SUCCESS;
+
+	xassert(detail_ptr);
+	xassert(node_bitmap);
+	xassert(has_xor);
+
+	*has_xor = false;
+	if (detail_ptr->feature_list == NULL)	/* no constraints */
+		return rc;
+
+	user_update = node_features_g_user_update(job_ptr->user_id);
+	if (use_active)
+		type = FEATURE_EXPR_ACTIVE;
+	else if (user_update)
+		type = FEATURE_EXPR_REBOOT;
+	else
+		type = FEATURE_EXPR_AVAIL;
+
+	slurm_mutex_lock(&feature_cache_mutex);
+	_feature_cache_sync();
+	if ((expr = _feature_expr_find(type, detail_ptr->features))) {
+		/* Per feature details were logged when it was evaluated */
+		log_flag(NODE_FEATURES, "%s: FEATURES:%s from cache",
+			 __func__, detail_ptr->features);
+	} else {
+		/* find_feature_nodes() takes feature_cache_mutex */
+		slurm_mutex_unlock(&feature_cache_mutex);
+		find_feature_nodes(detail_ptr->feature_list, user_update);
+		slurm_mutex_lock(&feature_cache_mutex);
+		_feature_cache_sync();
+		if (!(expr = _feature_expr_find(type, detail_ptr->features))) {
+			_eval_feature_counts(job_ptr, use_active, &new_expr);
+			expr = &new_expr;
+		}
+	}
+	*has_xor = expr->has_xor;
+	if (!expr->have_count)
+		bit_and(node_bitmap, expr->node_bitmap);
+	if (expr == &new_expr)
+		_feature_expr_add(type, detail_ptr->features, &new_expr);
+	slurm_mutex_unlock(&feature_cache_mutex);
 
 	if (slurm_conf.debug_flags & DEBUG_FLAG_NODE_FEATURES) {
 		char *tmp = bitmap2node_name(node_bitmap);
@@ -3329,6 +3556,8 @@ static int _build_node_list(job_record_t *job_ptr,
 		}
 		return rc;
 	}
+	/* _valid_features() and _get_req_features() use the job's bitmaps */
+	find_feature_nodes(detail_ptr->feature_list, can_reboot);
 
 	if (can_reboot)
 		reboot_bitmap = bit_alloc(node_record_count);
@@ -3449,9 +3678,8 @@ static int _build_node_list(job_record_t *job_ptr,
 			if (has_xor) {
 				node_maps[REBOOT] = bit_copy(reboot_bitmap);
 			} else {
-				(void) _match_feature(
-					job_ptr->details->feature_list,
-					&node_maps[REBOOT]);
+				(void) _match_feature(job_ptr->details,
+						      &node_maps[REBOOT]);
 			}
 			/* No nodes in set require reboot */
 			if (node_maps[REBOOT] &&
@@ -107,6 +107,9 @@ extern void filter_by_node_owner(job_record_t *job_ptr,
  */
 extern void find_feature_nodes(List feature_list, bool can_reboot);
 
+/* Free the cached node bitmaps of job feature expressions */
+extern void feature_cache_fini(void);
+
 /*
  * re_kill_job - for a given job, deallocate its nodes for a second time,
  *	basically a cleanup for failed deallocate() calls
@@ -167,6 +170,9 @@ extern void launch_prolog(job_record_t *job_ptr);
 /*
  * valid_feature_counts - validate a job's features can be satisfied
  *	by the selected nodes (NOTE: does not process XOR or XAND operators)
+ *	The node bitmaps of the job's feature_list are only set by
+ *	find_feature_nodes() if the expression was not cached yet, a caller
+ *	reading them must call it.
  * IN job_ptr - job to operate on
  * IN use_active - if set, then only consider nodes with the identified features
  *	active, otherwise use available features
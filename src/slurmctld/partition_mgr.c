@@ -150,6 +150,35 @@ extern void set_partition_tres()
 	list_for_each(part_list, _calc_part_tres, NULL);
 }
 
+/* Add a node to the totals of a partition and link it to the partition */
+static void _link_part_node(part_record_t *part_ptr, node_record_t *node_ptr,
+			    bitstr_t *old_bitmap)
+{
+	int i;
+
+	part_ptr->total_nodes++;
+	part_ptr->total_cpus += node_ptr->config_ptr->cpus;
+	part_ptr->max_cpu_cnt = MAX(part_ptr->max_cpu_cnt,
+				    node_ptr->config_ptr->cpus);
+	part_ptr->max_core_cnt = MAX(part_ptr->max_core_cnt,
+				     node_ptr->config_ptr->cores);
+
+	for (i = 0; i < node_ptr->part_cnt; i++) {
+		if (node_ptr->part_pptr[i] == part_ptr)
+			break;
+	}
+	if (i == node_ptr->part_cnt) { /* Node in new partition */
+		node_ptr->part_cnt++;
+		xrecalloc(node_ptr->part_pptr, node_ptr->part_cnt,
+			  sizeof(part_record_t *));
+		node_ptr->part_pptr[node_ptr->part_cnt-1] = part_ptr;
+	}
+	if (old_bitmap)
+		bit_clear(old_bitmap, (int) (node_ptr - node_record_table_ptr));
+	bit_set(part_ptr->node_bitmap,
+		(int) (node_ptr - node_record_table_ptr));
+}
+
 /*
  * build_part_bitmap - update the total_cpus, total_nodes, and node_bitmap
  *	for the specified partition, also reset the partition pointers in
@@ -166,7 +195,6 @@ extern int build_part_bitmap(part_record_t *part_ptr)
 	bitstr_t *old_bitmap;
 	node_record_t *node_ptr;
 	hostlist_t host_list;
-	int i;
 
 	part_ptr->total_cpus = 0;
 	part_ptr->total_nodes = 0;
@@ -211,29 +239,7 @@ extern int build_part_bitmap(part_record_t *part_ptr)
 			hostlist_destroy(host_list);
 			return ESLURM_INVALID_NODE_NAME;
 		}
-		part_ptr->total_nodes++;
-		part_ptr->total_cpus += node_ptr->config_ptr->cpus;
-		part_ptr->max_cpu_cnt = MAX(part_ptr->max_cpu_cnt,
-					    node_ptr->config_ptr->cpus);
-		part_ptr->max_core_cnt = MAX(part_ptr->max_core_cnt,
-					     node_ptr->config_ptr->cores);
-
-		for (i = 0; i < node_ptr->part_cnt; i++) {
-			if (node_ptr->part_pptr[i] == part_ptr)
-				break;
-		}
-		if (i == node_ptr->part_cnt) { /* Node in new partition */
-			node_ptr->part_cnt++;
-			xrecalloc(node_ptr->part_pptr, node_ptr->part_cnt,
-				  sizeof(part_record_t *));
-			node_ptr->part_pptr[node_ptr->part_cnt-1] = part_ptr;
-		}
-		if (old_bitmap)
-			bit_clear(old_bitmap,
-				  (int) (node_ptr -
-					 node_record_table_ptr));
-		bit_set(part_ptr->node_bitmap,
-			(int) (node_ptr - node_record_table_ptr));
+		_link_part_node(part_ptr, node_ptr, old_bitmap);
 		free(this_node_name);
 	}
 	hostlist_destroy(host_list);
@@ -244,6 +250,40 @@ extern int build_part_bitmap(part_record_t *part_ptr)
 	return 0;
 }
 
+/*
+ * build_part_bitmap_copy - build_part_bitmap() from a bitmap of the nodes in
+ *	the partition rather than from their names, e.g. the bitmap of the
+ *	same partition before a reconfiguration keeping the node order
+ * IN part_ptr - pointer to the partition, with no node_bitmap yet
+ * IN node_bitmap - nodes in the partition
+ */
+extern void build_part_bitmap_copy(part_record_t *part_ptr,
+				   bitstr_t *node_bitmap)
+{
+	int i, i_first, i_last;
+
+	xassert(!part_ptr->node_bitmap);
+	xassert(bit_size(node_bitmap) == node_record_count);
+
+	part_ptr->total_cpus = 0;
+	part_ptr->total_nodes = 0;
+	part_ptr->max_cpu_cnt = 0;
+	part_ptr->max_core_cnt = 0;
+	part_ptr->node_bitmap = bit_alloc(node_record_count);
+
+	i_first = bit_ffs(node_bitmap);
+	if (i_first >= 0)
+		i_last = bit_fls(node_bitmap);
+	else
+		i_last = i_first - 1;
+	for (i = i_first; i <= i_last; i++) {
+		if (bit_test(node_bitmap, i))
+			_link_part_node(part_ptr, &node_record_table_ptr[i],
+					NULL);
+	}
+	last_node_update = time(NULL);
+}
+
 /* unlink nodes removed from a partition */
 static void _unlink_free_nodes(bitstr_t *old_bitmap, part_record_t *part_ptr)
 {
@@ -5179,6 +5179,8 @@ static void _slurm_rpc_accounting_update_msg(slurm_msg_t *msg)
 		}
 
 		rc = assoc_mgr_update(update_ptr->update_list, 0);
+		if (rc == SLURM_SUCCESS)
+			assoc_mgr_update_change_id(update_ptr->change_id);
 	}
 	_throttle_fini(&active_rpc_cnt);
 
@@ -98,6 +98,7 @@
 List active_feature_list;	/* list of currently active features_records */
 List avail_feature_list;	/* list of available features_records */
 bool node_features_updated = true;
+uint32_t node_features_gen = 0;	/* bumped when feature lists change */
 bool slurmctld_init_db = true;
 
 static void _acct_restore_active_jobs(void);
@@ -106,19 +107,24 @@ static void _add_config_feature(List feature_list, char *feature,
 static void _add_config_feature_inx(List feature_list, char *feature,
 				    int node_inx);
 static void _build_bitmaps(void);
-static void _build_bitmaps_pre_select(void);
+static void _build_bitmaps_pre_select(List old_part_list,
+				      bool same_node_order);
 static int  _compare_hostnames(node_record_t *old_node_table,
 			       int old_node_count, node_record_t *node_table,
 			       int node_count);
 static void _gres_reconfig(bool reconfig);
 static int  _init_all_slurm_conf(void);
+static void _feature_lists_sync(List old_active_list, List old_avail_list);
 static void _list_delete_feature(void *feature_entry);
+static void _log_phase_time(const char *phase, struct timeval *tv);
 static int _preserve_select_type_param(slurm_conf_t *ctl_conf_ptr,
                                        uint16_t old_select_type_p);
 static void _purge_old_node_state(node_record_t *old_node_table_ptr,
 				  int old_node_record_count);
 static void _purge_old_part_state(List old_part_list, char *old_def_part_name);
 static int  _reset_node_bitmaps(void *x, void *arg);
+static bool _same_node_order(node_record_t *old_node_table,
+			     int old_node_count);
 static void _restore_job_accounting();
 
 static int  _restore_node_state(int recover, node_record_t *old_node_table_ptr,
@@ -369,24 +375,52 @@ static void _init_bitmaps(void)
 /*
  * _build_bitmaps_pre_select - recover some state for jobs and nodes prior to
  *	calling the select_* functions
+ * IN old_part_list - partitions before a reconfiguration, NULL if none
+ * IN same_node_order - true if the node table kept the order of the one
+ *	old_part_list was built on
  */
-static void _build_bitmaps_pre_select(void)
+static void _build_bitmaps_pre_select(List old_part_list,
+				      bool same_node_order)
 {
-	part_record_t *part_ptr;
+	part_record_t *part_ptr, *old_part_ptr;
 	node_record_t *node_ptr;
 	ListIterator part_iterator;
-	int i;
+	int i, new_cnt = 0, changed_cnt = 0, kept_cnt = 0;
 
-	/* scan partition table and identify nodes in each */
+	/*
+	 * scan partition table and identify nodes in each, a partition with
+	 * the same nodes as before the reconfiguration takes its old bitmap
+	 * rather than looking up each node name again
+	 */
 	part_iterator = list_iterator_create(part_list);
 	while ((part_ptr = list_next(part_iterator))) {
 		_handle_nodesets(&part_ptr->nodes);
+		old_part_ptr = NULL;
+		if (old_part_list)
+			old_part_ptr = list_find_first(old_part_list,
+						       &list_find_part,
+						       part_ptr->name);
+		if (!old_part_ptr) {
+			new_cnt++;
+		} else if (same_node_order && old_part_ptr->node_bitmap &&
+			   !xstrcmp(old_part_ptr->nodes, part_ptr->nodes)) {
+			build_part_bitmap_copy(part_ptr,
+					       old_part_ptr->node_bitmap);
+			kept_cnt++;
+			continue;
+		} else
+			changed_cnt++;
 		if (build_part_bitmap(part_ptr) == ESLURM_INVALID_NODE_NAME)
 			fatal("Invalid node names in partition %s",
 					part_ptr->name);
 	}
 	list_iterator_destroy(part_iterator);
 
+	if (old_part_list)
+		debug("%s: partition nodes: %d unchanged, %d changed, %d new, %d removed",
+		      __func__, kept_cnt, changed_cnt, new_cnt,
+		      list_count(old_part_list) - kept_cnt - changed_cnt);
+
 	/* initialize the configuration bitmaps */
 	list_for_each(config_list, _reset_node_bitmaps, NULL);
 
@@ -1113,9 +1147,12 @@ int read_slurm_conf(int recover, bool reconfig)
 	char *state_save_dir = xstrdup(slurm_conf.state_save_location);
 	uint16_t old_select_type_p = slurm_conf.select_type_param;
 	bool cgroup_mem_confinement = false;
+	bool same_node_order = false;
+	struct timeval phase_tv;
 
 	/* initialization */
 	START_TIMER;
+	gettimeofday(&phase_tv, NULL);
 
 	if (reconfig) {
 		/*
@@ -1155,6 +1192,7 @@ int read_slurm_conf(int recover, bool reconfig)
 		old_def_part_name = NULL;
 		goto end_it;
 	}
+	_log_phase_time("parse configuration", &phase_tv);
 
 	if (reconfig)
 		xcgroup_reconfig_slurm_cgroup_conf();
@@ -1192,6 +1230,7 @@ int read_slurm_conf(int recover, bool reconfig)
 	}
 	_handle_all_downnodes();
 	_build_all_partitionline_info();
+	_log_phase_time("build nodes and partitions", &phase_tv);
 	if (!reconfig) {
 		restore_front_end_state(recover);
 
@@ -1264,6 +1303,16 @@ int read_slurm_conf(int recover, bool reconfig)
 
 	_init_bitmaps();
 
+	/*
+	 * Reconfiguration requires the same node names, so unless the
+	 * topology plugin ranks them differently the node table keeps its
+	 * order and the node bitmaps of jobs are still valid.
+	 */
+	if (reconfig)
+		same_node_order = _same_node_order(old_node_table_ptr,
+						   old_node_record_count);
+	_log_phase_time("order nodes and initialize plugins", &phase_tv);
+
 	/*
 	 * Set standard features and preserve the plugin controlled ones.
 	 * A reconfig always imply load the state from slurm.conf
@@ -1317,9 +1366,10 @@ int read_slurm_conf(int recover, bool reconfig)
 		load_job_ret = load_all_job_state();
 		sync_job_priorities();
 	}
+	_log_phase_time("restore state", &phase_tv);
 
 	_sync_part_prio();
-	_build_bitmaps_pre_select();
+	_build_bitmaps_pre_select(old_part_list, same_node_order);
 	if ((select_g_node_init(node_record_table_ptr, node_record_count)
 	     != SLURM_SUCCESS)						||
 	    (select_g_state_restore(state_save_dir) != SLURM_SUCCESS)	||
@@ -1333,13 +1383,17 @@ int read_slurm_conf(int recover, bool reconfig)
 		}
 	}
 
+	_log_phase_time("initialize select plugin", &phase_tv);
+
 	_gres_reconfig(reconfig);
-	reset_job_bitmaps();		/* must follow select_g_job_init() */
+	/* must follow select_g_job_init() */
+	reset_job_bitmaps(same_node_order);
 
 	(void) _sync_nodes_to_jobs(reconfig);
 	(void) sync_job_files();
 	_purge_old_node_state(old_node_table_ptr, old_node_record_count);
 	_purge_old_part_state(old_part_list, old_def_part_name);
+	_log_phase_time("validate jobs", &phase_tv);
 
 	reserve_port_config(slurm_conf.mpi_params);
 
@@ -1377,6 +1431,7 @@ int read_slurm_conf(int recover, bool reconfig)
 		build_feature_list_eq();
 	else
 		build_feature_list_ne();
+	_log_phase_time("build features", &phase_tv);
 
 	/*
 	 * Must be at after nodes and partitons (e.g.
@@ -1400,6 +1455,7 @@ int read_slurm_conf(int recover, bool reconfig)
 			(void) slurm_sched_g_reconfig();
 		}
 	}
+	_log_phase_time("restore reservations", &phase_tv);
 	 if (test_config)
 		goto end_it;
 
@@ -1505,6 +1561,7 @@ int read_slurm_conf(int recover, bool reconfig)
 		fatal("Failed to reconfigure mcs plugin");
 
 	_set_response_cluster_rec();
+	_log_phase_time("reconfigure plugins", &phase_tv);
 
 	slurm_conf.last_update = time(NULL);
 end_it:
@@ -1522,6 +1579,13 @@ end_it:
 
 }
 
+/* Log the time spent in a phase of read_slurm_conf() and start the next */
+static void _log_phase_time(const char *phase, struct timeval *tv)
+{
+	debug("read_slurm_conf: %s took %d usec", phase, slurm_delta_tv(tv));
+	gettimeofday(tv, NULL);
+}
+
 /* Add feature to list
  * feature_list IN - destination list, either active_feature_list or
  *	avail_feature_list
@@ -1587,6 +1651,56 @@ static void _add_config_feature_inx(List feature_list, char *feature,
 	}
 }
 
+/* Return true if both lists have the same features on the same nodes */
+static bool _feature_list_equal(List old_list, List new_list)
+{
+	ListIterator old_iter, new_iter;
+	node_feature_t *old_feature_ptr, *new_feature_ptr;
+	bool equal = true;
+
+	if (list_count(old_list) != list_count(new_list))
+		return false;
+
+	old_iter = list_iterator_create(old_list);
+	new_iter = list_iterator_create(new_list);
+	while ((old_feature_ptr = list_next(old_iter)) &&
+	       (new_feature_ptr = list_next(new_iter))) {
+		if (xstrcmp(old_feature_ptr->name, new_feature_ptr->name) ||
+		    !bit_equal(old_feature_ptr->node_bitmap,
+			       new_feature_ptr->node_bitmap)) {
+			equal = false;
+			break;
+		}
+	}
+	list_iterator_destroy(old_iter);
+	list_iterator_destroy(new_iter);
+
+	return equal;
+}
+
+/*
+ * Keep the feature lists from before a reconfiguration if the ones just
+ * built are the same, so node_features_gen and the caches built on it stay
+ * valid. Otherwise the new lists replace them.
+ */
+static void _feature_lists_sync(List old_active_list, List old_avail_list)
+{
+	if (old_active_list && old_avail_list &&
+	    _feature_list_equal(old_active_list, active_feature_list) &&
+	    _feature_list_equal(old_avail_list, avail_feature_list)) {
+		FREE_NULL_LIST(active_feature_list);
+		FREE_NULL_LIST(avail_feature_list);
+		active_feature_list = old_active_list;
+		avail_feature_list = old_avail_list;
+		debug("%s: node features unchanged", __func__);
+		return;
+	}
+
+	FREE_NULL_LIST(old_active_list);
+	FREE_NULL_LIST(old_avail_list);
+	node_features_gen++;
+}
+
 /* _list_delete_feature - delete an entry from the feature list,
  *	see list.h for documentation */
 static void _list_delete_feature(void *feature_entry)
@@ -1611,9 +1725,9 @@ extern void build_feature_list_eq(void)
 	node_feature_t *active_feature_ptr, *avail_feature_ptr;
 	ListIterator feature_iter;
 	char *tmp_str, *token, *last = NULL;
+	List old_active_list = active_feature_list;
+	List old_avail_list = avail_feature_list;
 
-	FREE_NULL_LIST(active_feature_list);
-	FREE_NULL_LIST(avail_feature_list);
 	active_feature_list = list_create(_list_delete_feature);
 	avail_feature_list = list_create(_list_delete_feature);
 
@@ -1643,6 +1757,7 @@ extern void build_feature_list_eq(void)
 		list_append(active_feature_list, active_feature_ptr);
 	}
 	list_iterator_destroy(feature_iter);
+	_feature_lists_sync(old_active_list, old_avail_list);
 }
 
 /*
@@ -1680,9 +1795,9 @@ extern void build_feature_list_ne(void)
 	node_record_t *node_ptr;
 	char *tmp_str, *token, *last = NULL;
 	int i;
+	List old_active_list = active_feature_list;
+	List old_avail_list = avail_feature_list;
 
-	FREE_NULL_LIST(active_feature_list);
-	FREE_NULL_LIST(avail_feature_list);
 	active_feature_list = list_create(_list_delete_feature);
 	avail_feature_list = list_create(_list_delete_feature);
 
@@ -1714,6 +1829,7 @@ extern void build_feature_list_ne(void)
 			xfree(tmp_str);
 		}
 	}
+	_feature_lists_sync(old_active_list, old_avail_list);
 }
 
 /*
@@ -1749,6 +1865,7 @@ extern void update_feature_list(List feature_list, char *new_features,
 		xfree(tmp_str);
 	}
 	node_features_updated = true;
+	node_features_gen++;
 }
 
 static void _gres_reconfig(bool reconfig)
@@ -2805,12 +2922,8 @@ static int _compare_hostnames(node_record_t *old_node_table,
 			      int old_node_count, node_record_t *node_table,
 			      int node_count)
 {
+	node_record_t *node_ptr;
 	int cc;
-	int set_size;
-	char *old_ranged;
-	char *ranged;
-	hostset_t old_set;
-	hostset_t set;
 
 	if (old_node_count != node_count) {
 		error("%s: node count has changed before reconfiguration "
@@ -2819,35 +2932,40 @@ static int _compare_hostnames(node_record_t *old_node_table,
 		return -1;
 	}
 
-	old_set = hostset_create("");
-	for (cc = 0; cc < old_node_count; cc++)
-		hostset_insert(old_set, old_node_table[cc].name);
-
-	set = hostset_create("");
-	for (cc = 0; cc < node_count; cc++)
-		hostset_insert(set, node_table[cc].name);
+	/*
+	 * Node names are unique, so with the same count the names are the
+	 * same if every old one is found in the node hash of the new table.
+	 */
+	for (cc = 0; cc < old_node_count; cc++) {
+		node_ptr = find_node_record2(old_node_table[cc].name);
+		if (!node_ptr ||
+		    xstrcmp(node_ptr->name, old_node_table[cc].name)) {
+			error("%s: node names changed before reconfiguration. "
+			      "You have to restart slurmctld.", __func__);
+			return -1;
+		}
+	}
 
-	set_size = HOST_NAME_MAX * node_count + node_count + 1;
+	return 0;
+}
 
-	old_ranged = xmalloc(set_size);
-	ranged = xmalloc(set_size);
+/* Return true if the node table lists the nodes in the same order as
+ * old_node_table, so bitmaps of nodes built before are still valid */
+static bool _same_node_order(node_record_t *old_node_table,
+			     int old_node_count)
+{
+	int i;
 
-	hostset_ranged_string(old_set, set_size, old_ranged);
-	hostset_ranged_string(set, set_size, ranged);
+	if (!old_node_table || (old_node_count != node_record_count))
+		return false;
 
-	cc = 0;
-	if (xstrcmp(old_ranged, ranged) != 0) {
-		error("%s: node names changed before reconfiguration. "
-		      "You have to restart slurmctld.", __func__);
-		cc = -1;
+	for (i = 0; i < node_record_count; i++) {
+		if (xstrcmp(old_node_table[i].name,
+			    node_record_table_ptr[i].name))
+			return false;
 	}
 
-	hostset_destroy(old_set);
-	hostset_destroy(set);
-	xfree(old_ranged);
-	xfree(ranged);
-
-	return cc;
+	return true;
 }
 
 extern int dump_config_state_lite(void)
@@ -123,6 +123,33 @@ List      resv_list = (List) NULL;
 static List magnetic_resv_list = NULL;
 uint32_t  top_suffix = 0;
 
+/*
+ * Interval tree of the reservations by time, used by job_test_resv() to
+ * find the reservations overlapping a job's run time without testing every
+ * reservation. The entries are sorted by start time and form an implicit
+ * balanced tree: the root of range [lo, hi) is (lo + hi) / 2 and max_end is
+ * the latest end time in its range.
+ */
+typedef struct {
+	slurmctld_resv_t *resv_ptr;
+	time_t start;		/* start time when indexed */
+	time_t end;		/* end time when indexed */
+	time_t max_end;		/* latest end time of the subtree */
+	int list_pos;		/* position in resv_list */
+} resv_index_ent_t;
+
+typedef struct {
+	resv_index_ent_t *ent;
+	int cnt;
+	time_t build_time;	/* when built, see _resv_index_valid() */
+	time_t next_end;	/* first end time after build_time */
+	uint32_t max_boot_time;
+	bool valid;
+} resv_index_t;
+
+static resv_index_t resv_index = { 0 };
+static pthread_mutex_t resv_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * the two following structs enable to build a
  * planning of a constraint evolution over time
@@ -169,6 +196,8 @@ static void _free_script_arg(resv_thread_args_t *args);
 static int  _generate_resv_id(void);
 static void _generate_resv_name(resv_desc_msg_t *resv_ptr);
 static int  _get_core_resrcs(slurmctld_resv_t *resv_ptr);
+static void _get_rel_start_end(slurmctld_resv_t *resv_ptr, time_t now,
+			       time_t *start_relative, time_t *end_relative);
 static uint32_t _get_job_duration(job_record_t *job_ptr, bool reboot);
 static bool _is_account_valid(char *account);
 static bool _is_resv_used(slurmctld_resv_t *resv_ptr);
@@ -229,8 +258,17 @@ static void _validate_node_choice(slurmctld_resv_t *resv_ptr);
 static bool _validate_user_access(slurmctld_resv_t *resv_ptr,
 				  List user_assoc_list, uid_t uid);
 
+static void _resv_index_invalidate(void)
+{
+	slurm_mutex_lock(&resv_index_lock);
+	resv_index.valid = false;
+	slurm_mutex_unlock(&resv_index_lock);
+}
+
 static void _set_boot_time(slurmctld_resv_t *resv_ptr)
 {
+	_resv_index_invalidate();
+
 	resv_ptr->boot_time = 0;
 	if (!resv_ptr->node_bitmap)
 		return;
@@ -470,6 +508,8 @@ static void _del_resv_rec(void *x)
 	slurmctld_resv_t *resv_ptr = (slurmctld_resv_t *) x;
 
 	if (resv_ptr) {
+		_resv_index_invalidate();
+
 		/*
 		 * If shutting down magnetic_resv_list is already freed, meaning
 		 * we don't need to remove anything from it.
@@ -527,6 +567,161 @@ static void _add_resv_to_lists(slurmctld_resv_t *resv_ptr)
 	list_append(resv_list, resv_ptr);
 	if (resv_ptr->flags & RESERVE_FLAG_MAGNETIC)
 		list_append(magnetic_resv_list, resv_ptr);
+	_resv_index_invalidate();
+}
+
+static int _resv_index_sort(const void *x, const void *y)
+{
+	const resv_index_ent_t *ent1 = x, *ent2 = y;
+
+	if (ent1->start < ent2->start)
+		return -1;
+	if (ent1->start > ent2->start)
+		return 1;
+	return 0;
+}
+
+static int _resv_pos_sort(const void *x, const void *y)
+{
+	const resv_index_ent_t *ent1 = *(resv_index_ent_t **) x;
+	const resv_index_ent_t *ent2 = *(resv_index_ent_t **) y;
+
+	return ent1->list_pos - ent2->list_pos;
+}
+
+static time_t _resv_index_max_end(int lo, int hi)
+{
+	int mid;
+	time_t max_end, sub_end;
+
+	if (lo >= hi)
+		return 0;
+
+	mid = (lo + hi) / 2;
+	max_end = resv_index.ent[mid].end;
+	sub_end = _resv_index_max_end(lo, mid);
+	max_end = MAX(max_end, sub_end);
+	sub_end = _resv_index_max_end(mid + 1, hi);
+	max_end = MAX(max_end, sub_end);
+	resv_index.ent[mid].max_end = max_end;
+
+	return max_end;
+}
+
+/*
+ * NOTE: Called with resv_index_lock locked. The index is only valid when
+ * built after the last change to the reservations (last_resv_update has a
+ * resolution of seconds, so one built in the second of a change is not
+ * trusted) and before any reservation ended, as recurring reservations are
+ * then moved to their next occurrence.
+ */
+static bool _resv_index_valid(time_t now)
+{
+	return (resv_index.valid &&
+		(last_resv_update < resv_index.build_time) &&
+		(now < resv_index.next_end) &&
+		(resv_index.cnt == list_count(resv_list)));
+}
+
+/* NOTE: Called with resv_index_lock locked */
+static void _resv_index_build(time_t now)
+{
+	slurmctld_resv_t *resv_ptr;
+	resv_index_ent_t *ent;
+	ListIterator iter;
+	time_t start_relative, end_relative;
+	int i = 0;
+
+	resv_index.cnt = list_count(resv_list);
+	xrecalloc(resv_index.ent, MAX(resv_index.cnt, 1),
+		  sizeof(resv_index_ent_t));
+	resv_index.next_end = INFINITE;
+	resv_index.max_boot_time = 0;
+
+	iter = list_iterator_create(resv_list);
+	while ((resv_ptr = list_next(iter))) {
+		ent = &resv_index.ent[i];
+		ent->resv_ptr = resv_ptr;
+		ent->list_pos = i++;
+		if (resv_ptr->flags & RESERVE_FLAG_TIME_FLOAT) {
+			/* Relative to the test time, always a candidate */
+			ent->start = 0;
+			ent->end = INFINITE;
+		} else {
+			_get_rel_start_end(resv_ptr, now, &start_relative,
+					   &end_relative);
+			ent->start = start_relative;
+			ent->end = end_relative;
+			if ((end_relative > now) &&
+			    (end_relative < resv_index.next_end))
+				resv_index.next_end = end_relative;
+		}
+		resv_index.max_boot_time = MAX(resv_index.max_boot_time,
+					       resv_ptr->boot_time);
+	}
+	list_iterator_destroy(iter);
+
+	qsort(resv_index.ent, resv_index.cnt, sizeof(resv_index_ent_t),
+	      _resv_index_sort);
+	(void) _resv_index_max_end(0, resv_index.cnt);
+
+	resv_index.build_time = time(NULL);
+	resv_index.valid = true;
+}
+
+/* NOTE: Called with resv_index_lock locked */
+static void _resv_index_find(int lo, int hi, time_t start, time_t end,
+			     resv_index_ent_t ***found, int *found_cnt)
+{
+	resv_index_ent_t *ent;
+	int mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		ent = &resv_index.ent[mid];
+		if (ent->max_end <= start)
+			return;		/* Everything here ends before */
+		_resv_index_find(lo, mid, start, end, found, found_cnt);
+		if (ent->start >= end)
+			return;		/* Everything after starts later */
+		if (ent->end > start)
+			(*found)[(*found_cnt)++] = ent;
+		lo = mid + 1;
+	}
+}
+
+/*
+ * Get the reservations which may overlap with a job running from start to
+ * end, in their resv_list order.
+ * IN reboot - add the reservations' boot time to the job's end
+ * OUT resv_array - reservations found, caller must xfree
+ * RET count of reservations in resv_array
+ */
+static int _resv_overlap_time(time_t start, time_t end, bool reboot,
+			      slurmctld_resv_t ***resv_array)
+{
+	resv_index_ent_t **found;
+	time_t now = time(NULL);
+	int i, found_cnt = 0;
+
+	slurm_mutex_lock(&resv_index_lock);
+	if (!_resv_index_valid(now))
+		_resv_index_build(now);
+	if (reboot)
+		end += resv_index.max_boot_time;
+
+	found = xcalloc(resv_index.cnt + 1, sizeof(resv_index_ent_t *));
+	_resv_index_find(0, resv_index.cnt, start, end, &found, &found_cnt);
+	qsort(found, found_cnt, sizeof(resv_index_ent_t *), _resv_pos_sort);
+
+	*resv_array = xcalloc(found_cnt + 1, sizeof(slurmctld_resv_t *));
+	for (i = 0; i < found_cnt; i++)
+		(*resv_array)[i] = found[i]->resv_ptr;
+	slurm_mutex_unlock(&resv_index_lock);
+
+	xfree(found);
+
+	return found_cnt;
 }
 
 static int _queue_magnetic_resv(void *x, void *key)
@@ -2866,6 +3061,12 @@ extern void resv_fini(void)
 {
 	FREE_NULL_LIST(magnetic_resv_list);
 	FREE_NULL_LIST(resv_list);
+
+	slurm_mutex_lock(&resv_index_lock);
+	xfree(resv_index.ent);
+	resv_index.cnt = 0;
+	resv_index.valid = false;
+	slurm_mutex_unlock(&resv_index_lock);
 }
 
 /* Update an exiting resource reservation */
@@ -5807,23 +6008,20 @@ extern burst_buffer_info_msg_t *job_test_bb_resv(job_record_t *job_ptr,
 }
 
 /*
- * Determine how many licenses of the give type the specified job is
- *	prevented from using due to reservations
- *
- * IN job_ptr   - job to test
- * IN lic_name  - name of license
- * IN when      - when the job is expected to start
- * IN reboot    - true if node reboot required to start job
- * RET number of licenses of this type the job is prevented from using
+ * Count the licenses of the given type the job is prevented from using due
+ *	to reservations, and the earliest end of the reservations holding any
+ * OUT resv_end - earliest end of those reservations, zero if none
  */
-extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
-			     time_t when, bool reboot)
+static int _job_lic_resv(job_record_t *job_ptr, char *lic_name, time_t when,
+			 bool reboot, time_t *resv_end)
 {
 	slurmctld_resv_t * resv_ptr;
 	time_t job_start_time, job_end_time, now = time(NULL);
 	time_t job_end_time_use;
 	ListIterator iter;
-	int resv_cnt = 0;
+	int resv_cnt = 0, cnt;
+
+	*resv_end = 0;
 
 	job_start_time = when;
 	job_end_time   = when + _get_job_duration(job_ptr, reboot);
@@ -5846,7 +6044,11 @@ extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
 		    (xstrcmp(job_ptr->resv_name, resv_ptr->name) == 0))
 			continue;	/* job can use this reservation */
 
-		resv_cnt += _license_cnt(resv_ptr->license_list, lic_name);
+		if (!(cnt = _license_cnt(resv_ptr->license_list, lic_name)))
+			continue;
+		resv_cnt += cnt;
+		if (!*resv_end || (resv_ptr->end_time < *resv_end))
+			*resv_end = resv_ptr->end_time;
 	}
 	list_iterator_destroy(iter);
 
@@ -5855,6 +6057,45 @@ extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
 	return resv_cnt;
 }
 
+/*
+ * Determine how many licenses of the give type the specified job is
+ *	prevented from using due to reservations
+ *
+ * IN job_ptr   - job to test
+ * IN lic_name  - name of license
+ * IN when      - when the job is expected to start
+ * IN reboot    - true if node reboot required to start job
+ * RET number of licenses of this type the job is prevented from using
+ */
+extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
+			     time_t when, bool reboot)
+{
+	time_t resv_end;
+
+	return _job_lic_resv(job_ptr, lic_name, when, reboot, &resv_end);
+}
+
+/*
+ * Determine when the first of the reservations preventing the specified job
+ *	from using licenses of the given type ends
+ *
+ * IN job_ptr   - job to test
+ * IN lic_name  - name of license
+ * IN when      - when the job is expected to start
+ * IN reboot    - true if node reboot required to start job
+ * RET end time of that reservation, zero if the job is not prevented from
+ *	using any license of this type
+ */
+extern time_t job_lic_resv_end(job_record_t *job_ptr, char *lic_name,
+			       time_t when, bool reboot)
+{
+	time_t resv_end;
+
+	(void) _job_lic_resv(job_ptr, lic_name, when, reboot, &resv_end);
+
+	return resv_end;
+}
+
 static void _init_constraint_planning(constraint_planning_t* sched)
 {
 	sched->slot_list = list_create(xfree_ptr);
@@ -6136,12 +6377,11 @@ extern int job_test_resv(job_record_t *job_ptr, time_t *when,
 			 bitstr_t **exc_core_bitmap, bool *resv_overlap,
 			 bool reboot)
 {
-	slurmctld_resv_t *resv_ptr = NULL, *res2_ptr;
+	slurmctld_resv_t *resv_ptr = NULL, *res2_ptr, **resv_array = NULL;
 	time_t job_start_time, job_end_time, job_end_time_use, lic_resv_time;
 	time_t start_relative, end_relative;
 	time_t now = time(NULL);
-	ListIterator iter;
-	int i, rc = SLURM_SUCCESS, rc2;
+	int i, j, resv_cnt, rc = SLURM_SUCCESS, rc2;
 
 	*resv_overlap = false;	/* initialize to false */
 	job_start_time = *when;
@@ -6226,8 +6466,10 @@ extern int job_test_resv(job_record_t *job_ptr, time_t *when,
 		 * if there are any overlapping reservations, we need to
 		 * prevent the job from using those nodes (e.g. MAINT nodes)
 		 */
-		iter = list_iterator_create(resv_list);
-		while ((res2_ptr = list_next(iter))) {
+		resv_cnt = _resv_overlap_time(job_start_time, job_end_time,
+					      reboot, &resv_array);
+		for (j = 0; j < resv_cnt; j++) {
+			res2_ptr = resv_array[j];
 			if (reboot)
 				job_end_time_use =
 					job_end_time + res2_ptr->boot_time;
@@ -6257,7 +6499,7 @@ extern int job_test_resv(job_record_t *job_ptr, time_t *when,
 				bit_and_not(*node_bitmap,res2_ptr->node_bitmap);
 			}
 		}
-		list_iterator_destroy(iter);
+		xfree(resv_array);
 
 		if (slurm_conf.debug_flags & DEBUG_FLAG_RESERVATION) {
 			char *nodes = bitmap2node_name(*node_bitmap);
@@ -6292,8 +6534,10 @@ extern int job_test_resv(job_record_t *job_ptr, time_t *when,
 	for (i = 0; ; i++) {
 		lic_resv_time = (time_t) 0;
 
-		iter = list_iterator_create(resv_list);
-		while ((resv_ptr = list_next(iter))) {
+		resv_cnt = _resv_overlap_time(job_start_time, job_end_time,
+					      reboot, &resv_array);
+		for (j = 0; j < resv_cnt; j++) {
+			resv_ptr = resv_array[j];
 			_get_rel_start_end(
 				resv_ptr, now, &start_relative, &end_relative);
 
@@ -6382,7 +6626,7 @@ extern int job_test_resv(job_record_t *job_ptr, time_t *when,
 				continue;
 			}
 		}
-		list_iterator_destroy(iter);
+		xfree(resv_array);
 
 		if ((rc == SLURM_SUCCESS) && move_time) {
 			if (license_job_test(job_ptr, job_start_time, reboot)
@@ -148,6 +148,20 @@ extern burst_buffer_info_msg_t *job_test_bb_resv(job_record_t *job_ptr,
 extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
 			     time_t when, bool reboot);
 
+/*
+ * Determine when the first of the reservations preventing the specified job
+ *	from using licenses of the given type ends
+ *
+ * IN job_ptr   - job to test
+ * IN lic_name  - name of license
+ * IN when      - when the job is expected to start
+ * IN reboot    - true if node reboot required to start job
+ * RET end time of that reservation, zero if the job is not prevented from
+ *	using any license of this type
+ */
+extern time_t job_lic_resv_end(job_record_t *job_ptr, char *lic_name,
+			       time_t when, bool reboot);
+
 /*
  * Determine how many watts the specified job is prevented from using
  * due to reservations
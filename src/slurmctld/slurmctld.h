@@ -231,6 +231,7 @@ extern uint32_t   cluster_cpus;
 extern bool disable_remote_singleton;
 extern int max_depend_depth;
 extern bool node_features_updated;
+extern uint32_t node_features_gen;
 extern pthread_cond_t purge_thread_cond;
 extern pthread_mutex_t purge_thread_lock;
 extern pthread_mutex_t check_bf_running_lock;
@@ -1137,6 +1138,16 @@ extern part_record_t *create_part_record(const char *name);
  */
 extern int build_part_bitmap(part_record_t *part_ptr);
 
+/*
+ * build_part_bitmap_copy - build_part_bitmap() from a bitmap of the nodes in
+ *	the partition rather than from their names, e.g. the bitmap of the
+ *	same partition before a reconfiguration keeping the node order
+ * IN part_ptr - pointer to the partition, with no node_bitmap yet
+ * IN node_bitmap - nodes in the partition
+ */
+extern void build_part_bitmap_copy(part_record_t *part_ptr,
+				   bitstr_t *node_bitmap);
+
 /*
  * job_limits_check - check the limits specified for the job.
  * IN job_ptr - pointer to job table entry.
@@ -2206,10 +2217,12 @@ extern void reset_first_job_id(void);
  * reset_job_bitmaps - reestablish bitmaps for existing jobs.
  *	this should be called after rebuilding node information,
  *	but before using any job entries.
+ * IN same_node_order - true if the node table was rebuilt with the nodes in
+ *	the same order, keep the node bitmaps of jobs and steps
  * global: last_job_update - time of last job table update
  *	job_list - pointer to global job list
  */
-extern void reset_job_bitmaps (void);
+extern void reset_job_bitmaps(bool same_node_order);
 
 /* Reset a node's CPU load value */
 extern void reset_node_load(char *node_name, uint32_t cpu_load);
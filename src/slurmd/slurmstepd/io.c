@@ -55,12 +55,15 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "src/common/cbuf.h"
 #include "src/common/eio.h"
+#include "src/common/env.h"
 #include "src/common/fd.h"
 #include "src/common/io_hdr.h"
 #include "src/common/list.h"
@@ -118,6 +121,12 @@ struct client_io_info {
 
 	/* true if writing to a file, false if writing to a socket */
 	bool is_local_file;
+
+	/* aggregated output, used when job->io_agg_window is set */
+	char *agg_buf;			/* frames coalesced for one write */
+	uint32_t agg_len;		/* bytes of frames in agg_buf */
+	uint32_t agg_sent;		/* bytes of agg_buf already written */
+	struct timeval agg_start;	/* when output started to be held */
 };
 
 
@@ -208,6 +217,19 @@ static bool _outgoing_buf_free(stepd_step_rec_t *job);
 static int  _send_connection_okay_response(stepd_step_rec_t *job);
 static struct io_buf *_build_connection_okay_message(stepd_step_rec_t *job);
 
+/**********************************************************************
+ * Output aggregation declarations
+ **********************************************************************/
+static bool _client_agg_ready(eio_obj_t *obj, struct client_io_info *client);
+static int  _client_agg_write(eio_obj_t *obj, struct client_io_info *client);
+static void _agg_timer_arm(void);
+
+static pthread_t agg_timer_id = 0;
+static pthread_mutex_t agg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t agg_cond = PTHREAD_COND_INITIALIZER;
+static bool agg_pending = false;
+static bool agg_shutdown = false;
+
 /**********************************************************************
  * IO client socket functions
  **********************************************************************/
@@ -255,6 +277,7 @@ _client_writable(eio_obj_t *obj)
 
 	if (client->out_eof == true) {
 		debug5("  false, out_eof");
+		xfree(client->agg_buf);
 		return false;
 	}
 
@@ -282,6 +305,9 @@ _client_writable(eio_obj_t *obj)
 		debug5("  client->out.msg_queue queue length = %d",
 		       list_count(client->msg_queue));
 
+	if (client->job->io_agg_window)
+		return _client_agg_ready(obj, client);
+
 	if (client->out_msg != NULL
 	    || !list_is_empty(client->msg_queue))
 		return true;
@@ -435,6 +461,9 @@ _client_write(eio_obj_t *obj, List objs)
 
 	debug4("Entering _client_write");
 
+	if (client->job->io_agg_window)
+		return _client_agg_write(obj, client);
+
 	/*
 	 * If we aren't already in the middle of sending a message, get the
 	 * next message from the queue.
@@ -485,6 +514,199 @@ again:
 	return SLURM_SUCCESS;
 }
 
+/**********************************************************************
+ * Output aggregation functions
+ **********************************************************************/
+/*
+ * Decide if a client's held output should be written now. Output is held
+ * until the oldest pending frame is io_agg_window msec old, or enough frames
+ * are queued that tasks could soon run out of outgoing buffers.
+ */
+static bool
+_client_agg_ready(eio_obj_t *obj, struct client_io_info *client)
+{
+	struct timeval now;
+	long elapsed;
+
+	if (client->agg_sent < client->agg_len)
+		return true;
+	if (list_is_empty(client->msg_queue)) {
+		timerclear(&client->agg_start);
+		return false;
+	}
+	if (obj->shutdown ||
+	    (list_count(client->msg_queue) >= STDIO_MAX_AGG_MSGS))
+		return true;
+
+	gettimeofday(&now, NULL);
+	if (!timerisset(&client->agg_start))
+		client->agg_start = now;
+	elapsed = (now.tv_sec - client->agg_start.tv_sec) * 1000 +
+		  (now.tv_usec - client->agg_start.tv_usec) / 1000;
+	if (elapsed >= client->job->io_agg_window)
+		return true;
+
+	debug5("  false, holding %d messages for %ld msec",
+	       list_count(client->msg_queue), elapsed);
+	_agg_timer_arm();
+	return false;
+}
+
+/*
+ * Copy as many queued frames as fit into the client's aggregation buffer and
+ * write them with a single write(). Every frame keeps its io_hdr_t, so the
+ * client parses (and labels) the stream exactly as it would without
+ * aggregation.
+ */
+static int
+_client_agg_write(eio_obj_t *obj, struct client_io_info *client)
+{
+	struct io_buf *msg;
+	int n;
+
+	if (client->agg_sent == client->agg_len) {
+		client->agg_len = 0;
+		client->agg_sent = 0;
+		if (!client->agg_buf)
+			client->agg_buf = xmalloc(IO_AGGREGATE_MAX_LEN);
+		while ((msg = list_peek(client->msg_queue)) &&
+		       ((client->agg_len + msg->length) <=
+			IO_AGGREGATE_MAX_LEN)) {
+			(void) list_dequeue(client->msg_queue);
+			memcpy(client->agg_buf + client->agg_len, msg->data,
+			       msg->length);
+			client->agg_len += msg->length;
+			_free_outgoing_msg(msg, client->job);
+		}
+		/* Anything left over is sent without waiting again */
+		if (list_is_empty(client->msg_queue))
+			timerclear(&client->agg_start);
+		if (!client->agg_len) {
+			debug5("_client_write: nothing in the queue");
+			return SLURM_SUCCESS;
+		}
+	}
+
+again:
+	if ((n = write(obj->fd, client->agg_buf + client->agg_sent,
+		       client->agg_len - client->agg_sent)) < 0) {
+		if (errno == EINTR) {
+			goto again;
+		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			debug5("_client_write returned EAGAIN");
+			return SLURM_SUCCESS;
+		} else {
+			client->out_eof = true;
+			client->agg_len = 0;
+			client->agg_sent = 0;
+			_free_all_outgoing_msgs(client->msg_queue, client->job);
+			return SLURM_SUCCESS;
+		}
+	}
+	debug5("Wrote %d of %u aggregated bytes to socket",
+	       n, client->agg_len - client->agg_sent);
+	client->agg_sent += n;
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * The eio engine only wakes up on file descriptor activity, so a helper
+ * thread kicks it once the aggregation window of held output has passed.
+ */
+static void *
+_agg_timer(void *arg)
+{
+	stepd_step_rec_t *job = (stepd_step_rec_t *) arg;
+	struct timespec ts;
+
+	slurm_mutex_lock(&agg_mutex);
+	while (!agg_shutdown) {
+		if (!agg_pending) {
+			slurm_cond_wait(&agg_cond, &agg_mutex);
+			continue;
+		}
+		/*
+		 * Wait out the window. agg_pending stays set meanwhile, so
+		 * only _agg_fini() signals agg_cond and interrupts the wait.
+		 */
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += job->io_agg_window / 1000;
+		ts.tv_nsec += (job->io_agg_window % 1000) * NSEC_IN_MSEC;
+		if (ts.tv_nsec >= NSEC_IN_SEC) {
+			ts.tv_sec++;
+			ts.tv_nsec -= NSEC_IN_SEC;
+		}
+		slurm_cond_timedwait(&agg_cond, &agg_mutex, &ts);
+		agg_pending = false;
+		if (agg_shutdown)
+			break;
+
+		slurm_mutex_unlock(&agg_mutex);
+		eio_signal_wakeup(job->eio);
+		slurm_mutex_lock(&agg_mutex);
+	}
+	slurm_mutex_unlock(&agg_mutex);
+
+	return NULL;
+}
+
+static void
+_agg_timer_arm(void)
+{
+	slurm_mutex_lock(&agg_mutex);
+	if (!agg_pending) {
+		agg_pending = true;
+		slurm_cond_signal(&agg_cond);
+	}
+	slurm_mutex_unlock(&agg_mutex);
+}
+
+/* Enable output aggregation if requested with srun/sbatch --io-aggregate */
+static void
+_agg_init(stepd_step_rec_t *job)
+{
+	char *val;
+
+	if (job->batch || !(val = getenvp(job->env, "SLURM_IO_AGGREGATE")))
+		return;
+
+	job->io_agg_window = strtoul(val, NULL, 10);
+	if (!job->io_agg_window)
+		return;
+	if (job->io_agg_window > IO_AGGREGATE_MAX_WINDOW)
+		job->io_agg_window = IO_AGGREGATE_MAX_WINDOW;
+
+	debug("Coalescing task output for up to %u msec",
+	      job->io_agg_window);
+	slurm_thread_create(&agg_timer_id, _agg_timer, job);
+}
+
+static void
+_agg_fini(stepd_step_rec_t *job)
+{
+	ListIterator clients;
+	eio_obj_t *obj;
+	struct client_io_info *client;
+
+	if (!agg_timer_id)
+		return;
+
+	slurm_mutex_lock(&agg_mutex);
+	agg_shutdown = true;
+	slurm_cond_signal(&agg_cond);
+	slurm_mutex_unlock(&agg_mutex);
+
+	pthread_join(agg_timer_id, NULL);
+	agg_timer_id = 0;
+
+	clients = list_iterator_create(job->clients);
+	while ((obj = list_next(clients))) {
+		client = (struct client_io_info *) obj->arg;
+		xfree(client->agg_buf);
+	}
+	list_iterator_destroy(clients);
+}
 
 static bool
 _local_file_writable(eio_obj_t *obj)
@@ -1179,6 +1401,7 @@ io_init_tasks_stdio(stepd_step_rec_t *job)
 
 extern void io_thread_start(stepd_step_rec_t *job)
 {
+	_agg_init(job);
 	slurm_thread_create(&job->ioid, _io_thr, job);
 }
 
@@ -1473,6 +1696,7 @@ _io_thr(void *arg)
 	debug("IO handler started pid=%lu", (unsigned long) getpid());
 	rc = eio_handle_mainloop(job->eio);
 	debug("IO handler exited, rc=%d", rc);
+	_agg_fini(job);
 	return (void *)1;
 }
 
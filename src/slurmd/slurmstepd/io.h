@@ -50,6 +50,12 @@
 #define STDIO_MAX_FREE_BUF 1024
 #define STDIO_MAX_MSG_CACHE 128
 
+/*
+ * With --io-aggregate, held output is flushed early once this many messages
+ * are queued for a client so that tasks do not run out of free buffers.
+ */
+#define STDIO_MAX_AGG_MSGS (STDIO_MAX_FREE_BUF / 4)
+
 struct io_buf {
 	int ref_count;
 	uint32_t length;
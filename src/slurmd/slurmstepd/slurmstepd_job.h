@@ -205,6 +205,9 @@ typedef struct {
 	List outgoing_cache;  /* cache of outgoing stdio messages
 			       * used when a new client attaches
 			       */
+	uint32_t io_agg_window; /* msec to coalesce output sent to clients,
+				 * zero if --io-aggregate was not requested
+				 */
 
 	pthread_t      ioid;  /* pthread id of IO thread                    */
 	pthread_t      msgid; /* pthread id of message thread               */
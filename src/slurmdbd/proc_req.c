@@ -68,6 +68,7 @@ static bool  _validate_slurm_user(uint32_t uid);
 static bool  _validate_super_user(uint32_t uid, slurmdbd_conn_t *slurmdbd_conn);
 static bool  _validate_operator(uint32_t uid, slurmdbd_conn_t *slurmdbd_conn);
 static int   _find_rpc_obj_in_list(void *x, void *key);
+static bool  _read_only_req(uint16_t msg_type);
 static void _process_job_start(slurmdbd_conn_t *slurmdbd_conn,
 			       dbd_job_start_msg_t *job_start_msg,
 			       dbd_id_rc_msg_t *id_rc_msg);
@@ -718,15 +719,165 @@ static int _get_accounts(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	return rc;
 }
 
+/* Return true if str matches one of the entries of list, or list is empty */
+static bool _cached_str_match(List list, char *str)
+{
+	ListIterator itr;
+	char *object;
+	bool found = false;
+
+	if (!list || !list_count(list))
+		return true;
+
+	/* The database does case insensitive compares */
+	itr = list_iterator_create(list);
+	while ((object = list_next(itr))) {
+		if (!xstrcasecmp(object, str)) {
+			found = true;
+			break;
+		}
+	}
+	list_iterator_destroy(itr);
+
+	return found;
+}
+
+static bool _cached_id_match(List list, uint32_t id)
+{
+	ListIterator itr;
+	char *object;
+	bool found = false;
+
+	if (!list || !list_count(list))
+		return true;
+
+	itr = list_iterator_create(list);
+	while ((object = list_next(itr))) {
+		if (slurm_atoul(object) == id) {
+			found = true;
+			break;
+		}
+	}
+	list_iterator_destroy(itr);
+
+	return found;
+}
+
+static int _cached_tres_match(void *x, void *key)
+{
+	slurmdb_tres_rec_t *tres = x;
+	slurmdb_tres_cond_t *tres_cond = key;
+	ListIterator itr;
+	char *object, *slash;
+	bool found = false;
+
+	if (!tres_cond)
+		return 1;
+
+	if (!_cached_id_match(tres_cond->id_list, tres->id) ||
+	    !_cached_str_match(tres_cond->name_list, tres->name))
+		return 0;
+
+	if (!tres_cond->type_list || !list_count(tres_cond->type_list))
+		return 1;
+
+	/* A type may come with a name as "type/name" */
+	itr = list_iterator_create(tres_cond->type_list);
+	while ((object = list_next(itr))) {
+		if (!(slash = strchr(object, '/'))) {
+			found = !xstrcasecmp(object, tres->type);
+		} else {
+			found = tres->type &&
+				(strlen(tres->type) == (slash - object)) &&
+				!xstrncasecmp(object, tres->type,
+					      slash - object) &&
+				!xstrcasecmp(slash + 1, tres->name);
+		}
+		if (found)
+			break;
+	}
+	list_iterator_destroy(itr);
+
+	return found;
+}
+
+static int _cached_qos_match(void *x, void *key)
+{
+	slurmdb_qos_rec_t *qos = x;
+	slurmdb_qos_cond_t *qos_cond = key;
+
+	if (!qos_cond)
+		return 1;
+
+	return _cached_str_match(qos_cond->description_list,
+				 qos->description) &&
+		_cached_id_match(qos_cond->id_list, qos->id) &&
+		_cached_str_match(qos_cond->name_list, qos->name);
+}
+
+/*
+ * Answer a DBD_GET_* request out of the assoc_mgr cache of the slurmdbd.
+ * It holds every record not deleted and is updated on each commit, so it can
+ * only be used when the connection has nothing uncommitted.
+ * RET true if *out_buffer was filled in, false to go to the database
+ */
+static bool _pack_cached_list(slurmdbd_conn_t *slurmdbd_conn,
+			      slurmdbd_msg_type_t got_type,
+			      assoc_mgr_lock_t *locks, List *cache_list,
+			      ListFindF match, void *cond,
+			      buf_t **out_buffer)
+{
+	dbd_list_msg_t list_msg = { NULL };
+	ListIterator itr;
+	void *object;
+
+	if (slurmdbd_conn->uncommitted)
+		return false;
+
+	assoc_mgr_lock(locks);
+	if (!*cache_list) {
+		assoc_mgr_unlock(locks);
+		return false;
+	}
+
+	list_msg.my_list = list_create(NULL);
+	itr = list_iterator_create(*cache_list);
+	while ((object = list_next(itr))) {
+		if ((*match)(object, cond))
+			list_append(list_msg.my_list, object);
+	}
+	list_iterator_destroy(itr);
+
+	*out_buffer = init_buf(1024);
+	pack16((uint16_t) got_type, *out_buffer);
+	slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+			       got_type, *out_buffer);
+	assoc_mgr_unlock(locks);
+
+	FREE_NULL_LIST(list_msg.my_list);
+
+	return true;
+}
+
 static int _get_tres(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 		     buf_t **out_buffer, uint32_t *uid)
 {
 	dbd_cond_msg_t *get_msg = msg->data;
+	slurmdb_tres_cond_t *tres_cond = get_msg->cond;
 	dbd_list_msg_t list_msg = { NULL };
 	int rc = SLURM_SUCCESS;
 
 	debug2("DBD_GET_TRES: called");
 
+	if (!tres_cond || !tres_cond->with_deleted) {
+		assoc_mgr_lock_t locks = { .tres = READ_LOCK };
+
+		if (_pack_cached_list(slurmdbd_conn, DBD_GOT_TRES, &locks,
+				      &assoc_mgr_tres_list, _cached_tres_match,
+				      tres_cond, out_buffer))
+			return rc;
+	}
+
 	list_msg.my_list = acct_storage_g_get_tres(
 		slurmdbd_conn->db_conn, *uid, get_msg->cond);
 
@@ -750,6 +901,187 @@ static int _get_tres(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	return rc;
 }
 
+/*
+ * The assoc_mgr of the slurmdbd can't hold the associations, their ids are
+ * only unique within a cluster.  They are kept here instead, those of every
+ * cluster in one list per combination of the flags changing what the
+ * database returns for them.
+ */
+#define ASSOC_CACHE_RAW_QOS		0x0001
+#define ASSOC_CACHE_NO_PARENT_INFO	0x0002
+#define ASSOC_CACHE_NO_PARENT_LIMITS	0x0004
+#define ASSOC_CACHE_CNT			0x0008
+
+typedef struct {
+	uint64_t change_id; /* journal change the list was loaded at */
+	uint64_t gen; /* assoc_cache_gen the list was loaded at, 0 if it must
+		       * be loaded again */
+	List assoc_list; /* slurmdb_assoc_rec_t *'s */
+} assoc_cache_t;
+
+static pthread_rwlock_t assoc_cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+static assoc_cache_t assoc_cache[ASSOC_CACHE_CNT];
+static void *assoc_cache_db_conn = NULL; /* only used to load the cache */
+static uint64_t assoc_cache_gen = 1; /* bumped by committed archive loads */
+
+/*
+ * A connection committed changes the journal doesn't know about.  Bumped
+ * atomically, a load in progress holds the write lock.
+ */
+static void _assoc_cache_changed(void)
+{
+	if (!__atomic_add_fetch(&assoc_cache_gen, 1, __ATOMIC_SEQ_CST))
+		__atomic_add_fetch(&assoc_cache_gen, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Every commit with updates for the clusters is added to the journal */
+static uint64_t _assoc_cache_change_id(void)
+{
+	uint64_t change_id = 0;
+	List update_list = assoc_mgr_journal_get(&change_id);
+
+	FREE_NULL_LIST(update_list);
+
+	return change_id;
+}
+
+static int _cached_assoc_match(void *x, void *key)
+{
+	slurmdb_assoc_rec_t *assoc = x;
+	slurmdb_assoc_cond_t *assoc_cond = key;
+
+	if (!assoc_cond)
+		return 1;
+
+	if (assoc_cond->only_defs && !assoc->is_def)
+		return 0;
+
+	/* An empty user_list asks for the user associations only */
+	if (assoc_cond->user_list && !list_count(assoc_cond->user_list) &&
+	    !assoc->user)
+		return 0;
+
+	/* The database has "" where the records have NULL */
+	return _cached_str_match(assoc_cond->cluster_list, assoc->cluster) &&
+		_cached_str_match(assoc_cond->acct_list, assoc->acct) &&
+		_cached_id_match(assoc_cond->def_qos_id_list,
+				 assoc->def_qos_id) &&
+		_cached_str_match(assoc_cond->user_list,
+				  assoc->user ? assoc->user : "") &&
+		_cached_str_match(assoc_cond->partition_list,
+				  assoc->partition ? assoc->partition : "") &&
+		_cached_id_match(assoc_cond->id_list, assoc->id) &&
+		_cached_str_match(assoc_cond->parent_acct_list,
+				  assoc->parent_acct ? assoc->parent_acct : "");
+}
+
+/*
+ * Answer a DBD_GET_ASSOCS request out of the association cache, loading the
+ * associations of all clusters first if the cache isn't current.  Requests
+ * the cache can't answer in memory go to the database.
+ * RET true if *out_buffer was filled in, false to go to the database
+ */
+static bool _pack_cached_assocs(slurmdbd_conn_t *slurmdbd_conn,
+				slurmdb_assoc_cond_t *assoc_cond,
+				buf_t **out_buffer)
+{
+	slurmdb_assoc_cond_t load_cond;
+	dbd_list_msg_t list_msg = { NULL };
+	assoc_cache_t *cache;
+	uint64_t change_id, gen;
+	ListIterator itr;
+	void *object;
+	int flags = 0;
+
+	if (slurmdbd_conn->uncommitted ||
+	    (slurm_conf.private_data & PRIVATE_DATA_USERS))
+		return false;
+
+	memset(&load_cond, 0, sizeof(load_cond));
+	if (assoc_cond) {
+		/*
+		 * Sub accounts and QOS are matched against the tree in the
+		 * database, usage and deleted associations aren't cached.
+		 */
+		if (assoc_cond->with_deleted || assoc_cond->with_usage ||
+		    assoc_cond->with_sub_accts ||
+		    (assoc_cond->qos_list && list_count(assoc_cond->qos_list)))
+			return false;
+		/* Without parent info the records don't have the parent */
+		if (assoc_cond->without_parent_info &&
+		    assoc_cond->parent_acct_list &&
+		    list_count(assoc_cond->parent_acct_list))
+			return false;
+
+		if (assoc_cond->with_raw_qos)
+			flags |= ASSOC_CACHE_RAW_QOS;
+		if (assoc_cond->without_parent_info)
+			flags |= ASSOC_CACHE_NO_PARENT_INFO;
+		if (assoc_cond->without_parent_limits)
+			flags |= ASSOC_CACHE_NO_PARENT_LIMITS;
+		load_cond.with_raw_qos = assoc_cond->with_raw_qos;
+		load_cond.without_parent_info =
+			assoc_cond->without_parent_info;
+		load_cond.without_parent_limits =
+			assoc_cond->without_parent_limits;
+	}
+	cache = &assoc_cache[flags];
+
+	change_id = _assoc_cache_change_id();
+	gen = __atomic_load_n(&assoc_cache_gen, __ATOMIC_SEQ_CST);
+	slurm_rwlock_rdlock(&assoc_cache_lock);
+	if ((cache->change_id != change_id) || (cache->gen != gen)) {
+		slurm_rwlock_unlock(&assoc_cache_lock);
+		slurm_rwlock_wrlock(&assoc_cache_lock);
+	}
+	if ((cache->change_id != change_id) || (cache->gen != gen)) {
+		/*
+		 * The change id and generation are read before loading, so
+		 * a commit made while loading only makes the next request
+		 * load again.
+		 */
+		FREE_NULL_LIST(cache->assoc_list);
+		cache->gen = 0;
+		if (!assoc_cache_db_conn)
+			assoc_cache_db_conn = acct_storage_g_get_connection(
+				0, NULL, true, NULL);
+		errno = 0;
+		cache->assoc_list = acct_storage_g_get_assocs(
+			assoc_cache_db_conn, slurm_conf.slurm_user_id,
+			&load_cond);
+		/* End the snapshot so the next load sees every commit */
+		acct_storage_g_commit(assoc_cache_db_conn, 0);
+		if (errno || !cache->assoc_list) {
+			FREE_NULL_LIST(cache->assoc_list);
+			slurm_rwlock_unlock(&assoc_cache_lock);
+			errno = 0;
+			return false;
+		}
+		cache->change_id = change_id;
+		cache->gen = gen;
+		debug2("%s: loaded %d associations", __func__,
+		       list_count(cache->assoc_list));
+	}
+
+	list_msg.my_list = list_create(NULL);
+	itr = list_iterator_create(cache->assoc_list);
+	while ((object = list_next(itr))) {
+		if (_cached_assoc_match(object, assoc_cond))
+			list_append(list_msg.my_list, object);
+	}
+	list_iterator_destroy(itr);
+
+	*out_buffer = init_buf(1024);
+	pack16((uint16_t) DBD_GOT_ASSOCS, *out_buffer);
+	slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+			       DBD_GOT_ASSOCS, *out_buffer);
+	slurm_rwlock_unlock(&assoc_cache_lock);
+
+	FREE_NULL_LIST(list_msg.my_list);
+
+	return true;
+}
+
 static int _get_assocs(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 		       buf_t **out_buffer, uint32_t *uid)
 {
@@ -759,6 +1091,9 @@ static int _get_assocs(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 
 	debug2("DBD_GET_ASSOCS: called");
 
+	if (_pack_cached_assocs(slurmdbd_conn, get_msg->cond, out_buffer))
+		return rc;
+
 	list_msg.my_list = acct_storage_g_get_assocs(
 		slurmdbd_conn->db_conn, *uid, get_msg->cond);
 
@@ -1015,11 +1350,21 @@ static int _get_qos(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 		    buf_t **out_buffer, uint32_t *uid)
 {
 	dbd_cond_msg_t *cond_msg = msg->data;
+	slurmdb_qos_cond_t *qos_cond = cond_msg->cond;
 	dbd_list_msg_t list_msg = { NULL };
 	int rc = SLURM_SUCCESS;
 
 	debug2("DBD_GET_QOS: called");
 
+	if (!qos_cond || !qos_cond->with_deleted) {
+		assoc_mgr_lock_t locks = { .qos = READ_LOCK };
+
+		if (_pack_cached_list(slurmdbd_conn, DBD_GOT_QOS, &locks,
+				      &assoc_mgr_qos_list, _cached_qos_match,
+				      qos_cond, out_buffer))
+			return rc;
+	}
+
 	list_msg.my_list = acct_storage_g_get_qos(slurmdbd_conn->db_conn, *uid,
 						  cond_msg->cond);
 
@@ -1110,6 +1455,45 @@ static int _get_txn(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	return rc;
 }
 
+static int _get_updates(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
+			buf_t **out_buffer, uint32_t *uid)
+{
+	dbd_updates_msg_t *get_msg = msg->data;
+	dbd_updates_msg_t got_msg = { 0 };
+	int rc = SLURM_SUCCESS;
+	char *comment = NULL;
+
+	if (!_validate_slurm_user(*uid)) {
+		comment = "DBD_GET_UPDATES message from invalid uid";
+		error("DBD_GET_UPDATES message from invalid uid %u", *uid);
+		rc = ESLURM_ACCESS_DENIED;
+		goto end_it;
+	}
+
+	debug2("DBD_GET_UPDATES: called");
+
+	got_msg.change_id = get_msg->change_id;
+	if (!(got_msg.update_list = acct_storage_g_get_updates(
+		      slurmdbd_conn->db_conn, &got_msg.change_id))) {
+		comment = "Changes are no longer known";
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+
+	*out_buffer = init_buf(1024);
+	pack16((uint16_t) DBD_GOT_UPDATES, *out_buffer);
+	slurmdbd_pack_updates_msg(&got_msg, slurmdbd_conn->conn->version,
+				  *out_buffer);
+	FREE_NULL_LIST(got_msg.update_list);
+
+	return rc;
+
+end_it:
+	*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+						rc, comment, DBD_GET_UPDATES);
+	return rc;
+}
+
 static int _get_usage(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 		      buf_t **out_buffer, uint32_t *uid)
 {
@@ -1302,6 +1686,42 @@ static int _find_rpc_obj_in_list(void *x, void *key)
 	return 0;
 }
 
+/* Return true for requests only reading the database */
+static bool _read_only_req(uint16_t msg_type)
+{
+	switch (msg_type) {
+	case DBD_GET_ACCOUNTS:
+	case DBD_GET_TRES:
+	case DBD_GET_ASSOCS:
+	case DBD_GET_ASSOC_USAGE:
+	case DBD_GET_WCKEY_USAGE:
+	case DBD_GET_CLUSTER_USAGE:
+	case DBD_GET_CLUSTERS:
+	case DBD_GET_FEDERATIONS:
+	case DBD_GET_EVENTS:
+	case DBD_GET_JOBS_COND:
+	case DBD_GET_PROBS:
+	case DBD_GET_QOS:
+	case DBD_GET_RES:
+	case DBD_GET_TXN:
+	case DBD_GET_WCKEYS:
+	case DBD_GET_RESVS:
+	case DBD_GET_USERS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Return true for requests that can change the cached associations without
+ * going through the assoc_mgr journal.  An archive can hold any SQL.
+ */
+static bool _assoc_change_req(uint16_t msg_type)
+{
+	return (msg_type == DBD_ARCHIVE_LOAD);
+}
+
 static int _flush_jobs(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 		       buf_t **out_buffer, uint32_t *uid)
 {
@@ -1347,9 +1767,14 @@ static int _fini_conn(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 
 	if (fini_msg->close_conn == 1)
 		rc = acct_storage_g_close_connection(&slurmdbd_conn->db_conn);
-	else
+	else {
 		rc = acct_storage_g_commit(slurmdbd_conn->db_conn,
 					   fini_msg->commit);
+		if (fini_msg->commit && slurmdbd_conn->assoc_changed)
+			_assoc_cache_changed();
+	}
+	slurmdbd_conn->uncommitted = false;
+	slurmdbd_conn->assoc_changed = false;
 	if (locked)
 		slurm_mutex_unlock(&registered_lock);
 
@@ -2864,6 +3289,27 @@ static int _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 	}
 
 	list_msg.my_list = list_create(slurmdbd_free_buffer);
+	list_msg.seq = get_msg->seq;
+
+	/*
+	 * The slurmctld sends several batches without waiting for the reply.
+	 * Once one fails the ones sent after it are refused, the slurmctld
+	 * sends them again after the failed one.
+	 */
+	if (get_msg->seq && slurmdbd_conn->mult_msg_seq &&
+	    (get_msg->seq != slurmdbd_conn->mult_msg_seq)) {
+		debug("CONN:%u DBD_SEND_MULT_MSG sequence %u refused, waiting for %u",
+		      slurmdbd_conn->conn->fd, get_msg->seq,
+		      slurmdbd_conn->mult_msg_seq);
+		list_msg.return_code = SLURM_ERROR;
+		goto end_it;
+	}
+
+	/*
+	 * Process all the messages in one transaction, proc_req() commits
+	 * once this returns instead of after every message.
+	 */
+	slurmdbd_conn->in_mult_msg = true;
 	/* START_TIMER; */
 	itr = list_iterator_create(get_msg->my_list);
 	while ((req_buf = list_next(itr))) {
@@ -2887,9 +3333,19 @@ static int _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn, persist_msg_t *msg,
 			break;
 	}
 	list_iterator_destroy(itr);
+	slurmdbd_conn->in_mult_msg = false;
 	/* END_TIMER; */
 	/* info("%d multi took %s", list_count(get_msg->my_list), TIME_STR); */
 
+	/* On failure the same sequence is expected again */
+	if (get_msg->seq) {
+		slurmdbd_conn->mult_msg_seq = (rc == SLURM_SUCCESS) ?
+			(get_msg->seq + 1) : get_msg->seq;
+		if (!slurmdbd_conn->mult_msg_seq)	/* wrapped */
+			slurmdbd_conn->mult_msg_seq = 1;
+	}
+
+end_it:
 	*out_buffer = init_buf(1024);
 	pack16((uint16_t) DBD_GOT_MULT_MSG, *out_buffer);
 	slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
@@ -3141,6 +3597,21 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 	slurmdb_rpc_obj_t *rpc_obj;
 
 	DEF_TIMERS;
+
+	if (!slurmdbd_conn->in_pool) {
+		/*
+		 * Reads can run on a worker while this thread gets the next
+		 * request, as long as they see everything written on this
+		 * connection.  Anything else waits for the replies already
+		 * owed so they go out in order.
+		 */
+		if (_read_only_req(msg->msg_type) &&
+		    !slurmdbd_conn->uncommitted &&
+		    rpc_mgr_queue_req(slurmdbd_conn, msg, *uid))
+			return SLURM_SUCCESS;
+		rpc_mgr_wait_conn(slurmdbd_conn);
+	}
+
 	START_TIMER;
 
 	switch (msg->msg_type) {
@@ -3239,6 +3710,9 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 	case DBD_GET_USERS:
 		rc = _get_users(slurmdbd_conn, msg, out_buffer, uid);
 		break;
+	case DBD_GET_UPDATES:
+		rc = _get_updates(slurmdbd_conn, msg, out_buffer, uid);
+		break;
 	case DBD_FLUSH_JOBS:
 		rc = _flush_jobs(slurmdbd_conn, msg, out_buffer, uid);
 		break;
@@ -3361,19 +3835,47 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 		break;
 	}
 
+	if (_assoc_change_req(msg->msg_type))
+		slurmdbd_conn->assoc_changed = true;
+
 	if (rc == ESLURM_ACCESS_DENIED)
 		error("CONN:%u Security violation, %s",
 		      slurmdbd_conn->conn->fd,
 		      slurmdbd_msg_type_2_str(msg->msg_type, 1));
 	else if (slurmdbd_conn->conn->rem_port
-		 && !slurmdbd_conf->commit_delay) {
+		 && !slurmdbd_conf->commit_delay
+		 && !slurmdbd_conn->in_mult_msg) {
 		/* If we are dealing with the slurmctld do the
 		   commit (SUCCESS or NOT) afterwards since we
 		   do transactions for performance reasons.
 		   (don't ever use autocommit with innodb)
 		*/
-		acct_storage_g_commit(slurmdbd_conn->db_conn, 1);
-	}
+		if ((acct_storage_g_commit(slurmdbd_conn->db_conn, 1) !=
+		     SLURM_SUCCESS) && (rc == SLURM_SUCCESS)) {
+			/*
+			 * The reply claims what was rolled back got stored,
+			 * replace it so the slurmctld sends it all again.
+			 */
+			comment = "Commit failed";
+			error("CONN:%u %s for %s", slurmdbd_conn->conn->fd,
+			      comment, slurmdbd_msg_type_2_str(msg->msg_type, 1));
+			rc = SLURM_ERROR;
+			if (msg->msg_type == DBD_SEND_MULT_MSG) {
+				/* Expect the failed batch again */
+				dbd_list_msg_t *mult_msg = msg->data;
+				slurmdbd_conn->mult_msg_seq = mult_msg->seq;
+			}
+			FREE_NULL_BUFFER(*out_buffer);
+			*out_buffer = slurm_persist_make_rc_msg(
+				slurmdbd_conn->conn, rc, comment,
+				msg->msg_type);
+		} else if (slurmdbd_conn->assoc_changed)
+			_assoc_cache_changed();
+		slurmdbd_conn->uncommitted = false;
+		slurmdbd_conn->assoc_changed = false;
+	} else if (!_read_only_req(msg->msg_type) &&
+		   (msg->msg_type != DBD_FINI))
+		slurmdbd_conn->uncommitted = true;
 
 	END_TIMER;
 
@@ -3399,7 +3901,33 @@ extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 	rpc_obj->cnt++;
 	rpc_obj->time += DELTA_TIMER;
 
+	if (msg->msg_type == DBD_SEND_MULT_MSG) {
+		dbd_list_msg_t *list_msg = msg->data;
+
+		rpc_stats.mult_msg_cnt++;
+		if (list_msg && list_msg->my_list)
+			rpc_stats.mult_msg_recs +=
+				list_count(list_msg->my_list);
+		rpc_stats.mult_msg_time_max =
+			MAX(rpc_stats.mult_msg_time_max, DELTA_TIMER);
+		rpc_stats.mult_msg_time_total += DELTA_TIMER;
+	}
+
 	slurm_mutex_unlock(&rpc_mutex);
 
 	return rc;
 }
+
+extern void proc_req_fini(void)
+{
+	int i;
+
+	slurm_rwlock_wrlock(&assoc_cache_lock);
+	for (i = 0; i < ASSOC_CACHE_CNT; i++) {
+		FREE_NULL_LIST(assoc_cache[i].assoc_list);
+		assoc_cache[i].gen = 0;
+	}
+	if (assoc_cache_db_conn)
+		acct_storage_g_close_connection(&assoc_cache_db_conn);
+	slurm_rwlock_unlock(&assoc_cache_lock);
+}
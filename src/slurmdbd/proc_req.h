@@ -39,6 +39,8 @@
 #ifndef _PROC_REQ_H
 #define _PROC_REQ_H
 
+#include <pthread.h>
+
 #include "src/common/macros.h"
 #include "src/common/pack.h"
 #include "src/common/slurm_protocol_defs.h"
@@ -46,6 +48,16 @@
 typedef struct {
 	slurm_persist_conn_t *conn;
 	void *db_conn; /* database connection */
+	bool in_mult_msg; /* commit once at the end of DBD_SEND_MULT_MSG */
+	uint32_t mult_msg_seq; /* DBD_SEND_MULT_MSG sequence number expected
+				* next, 0 for any */
+	bool uncommitted; /* db_conn may hold writes others can't see yet */
+	bool assoc_changed; /* those writes bypass the assoc_mgr journal */
+	bool in_pool; /* used by an rpc_mgr worker for one request */
+	pthread_mutex_t pool_lock;
+	pthread_cond_t pool_cond;
+	uint32_t pool_queued; /* requests handed to the rpc_mgr workers */
+	uint32_t pool_sent; /* replies to those sent, in order */
 	char *tres_str;
 } slurmdbd_conn_t;
 
@@ -61,4 +73,7 @@ typedef struct {
 extern int proc_req(void *conn, persist_msg_t *msg, buf_t **out_buffer,
 		    uint32_t *uid);
 
+/* Free the association cache and close its database connection */
+extern void proc_req_fini(void);
+
 #endif /* !_PROC_REQ */
@@ -87,6 +87,7 @@ static void _clear_slurmdbd_conf(void)
 	free_slurm_conf(&slurm_conf, 0);
 
 	if (slurmdbd_conf) {
+		slurmdbd_conf->archive_columnar = false;
 		xfree(slurmdbd_conf->archive_dir);
 		xfree(slurmdbd_conf->archive_script);
 		slurmdbd_conf->commit_delay = 0;
@@ -107,6 +108,8 @@ static void _clear_slurmdbd_conf(void)
 		slurmdbd_conf->purge_suspend = 0;
 		slurmdbd_conf->purge_txn = 0;
 		slurmdbd_conf->purge_usage = 0;
+		slurmdbd_conf->rollup_threads = 0;
+		slurmdbd_conf->rpc_workers = 0;
 		xfree(slurmdbd_conf->storage_loc);
 		slurmdbd_conf->track_wckey = 0;
 		slurmdbd_conf->track_ctld = 0;
@@ -332,10 +335,31 @@ extern int read_slurmdbd_conf(void)
 
 		s_p_get_string(&slurmdbd_conf->parameters, "Parameters", tbl);
 		if (slurmdbd_conf->parameters) {
+			char *tmp_ptr;
+
+			if (xstrcasestr(slurmdbd_conf->parameters,
+					"ArchiveColumnar"))
+				slurmdbd_conf->archive_columnar = true;
 			if (xstrcasestr(slurmdbd_conf->parameters,
 					"PreserveCaseUser"))
 				slurmdbd_conf->persist_conn_rc_flags |=
 					PERSIST_FLAG_P_USER_CASE;
+			if ((tmp_ptr = xstrcasestr(slurmdbd_conf->parameters,
+						   "RollupThreads="))) {
+				int threads = atoi(tmp_ptr + 14);
+				if ((threads < 1) || (threads > 64))
+					fatal("Invalid RollupThreads value: %s",
+					      tmp_ptr + 14);
+				slurmdbd_conf->rollup_threads = threads;
+			}
+			if ((tmp_ptr = xstrcasestr(slurmdbd_conf->parameters,
+						   "RpcWorkers="))) {
+				int workers = atoi(tmp_ptr + 11);
+				if ((workers < 1) || (workers > 64))
+					fatal("Invalid RpcWorkers value: %s",
+					      tmp_ptr + 11);
+				slurmdbd_conf->rpc_workers = workers;
+			}
 		}
 
 		s_p_get_string(&slurmdbd_conf->pid_file, "PidFile", tbl);
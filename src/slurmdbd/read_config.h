@@ -54,6 +54,7 @@
 
 /* SlurmDBD configuration parameters */
 typedef struct {
+	bool		archive_columnar; /* write columnar archive files */
 	char *		archive_dir;    /* location to locally store
 					 * data if not using a script   */
 	char *		archive_script;	/* script to archive old data	*/
@@ -88,6 +89,8 @@ typedef struct {
 					 * than this in months or days	*/
 	uint32_t        purge_usage;    /* purge usage data older
 					 * than this in months or days	*/
+	uint16_t	rollup_threads;	/* threads doing hourly rollup	*/
+	uint16_t	rpc_workers;	/* threads running read requests */
 	char *		storage_loc;	/* database name		*/
 	uint16_t	syslog_debug;	/* output to both logfile and syslog*/
 	uint16_t        track_wckey;    /* Whether or not to track wckey*/
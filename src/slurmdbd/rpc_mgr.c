@@ -46,6 +46,7 @@
 #include <sys/types.h>
 
 #include "src/common/fd.h"
+#include "src/common/list.h"
 #include "src/common/log.h"
 #include "src/common/macros.h"
 #include "src/common/slurm_protocol_api.h"
@@ -53,17 +54,40 @@
 #include "src/common/slurmdbd_defs.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xsignal.h"
+#include "src/common/xstring.h"
 #include "src/slurmdbd/proc_req.h"
 #include "src/slurmdbd/read_config.h"
 #include "src/slurmdbd/rpc_mgr.h"
 #include "src/slurmdbd/slurmdbd.h"
 
+typedef struct {
+	persist_msg_t msg;
+	uint32_t seq;			/* order of the reply on the connection */
+	slurmdbd_conn_t *slurmdbd_conn;
+	uint32_t uid;
+} rpc_job_t;
+
+/* Database connection of an RPC worker, one per cluster */
+typedef struct {
+	char *cluster_name;
+	void *db_conn;
+} pool_db_conn_t;
+
 /* Local functions */
 static void _connection_fini_callback(void *arg);
+static void _pool_fini(void);
+static void _pool_init(void);
 
 /* Local variables */
 static pthread_t       master_thread_id = 0;
 
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_cond = PTHREAD_COND_INITIALIZER;
+static List            pool_jobs = NULL;
+static pthread_t      *pool_threads = NULL;
+static int             pool_thread_cnt = 0;
+static bool            pool_shutdown = false;
+
 /* Process incoming RPCs. Meant to execute as a pthread */
 extern void *rpc_mgr(void *no_data)
 {
@@ -80,6 +104,7 @@ extern void *rpc_mgr(void *no_data)
 		fatal("slurm_init_msg_engine_port error %m");
 
 	slurm_persist_conn_recv_server_init();
+	_pool_init();
 
 	/*
 	 * Process incoming RPCs until told to shutdown
@@ -101,6 +126,8 @@ extern void *rpc_mgr(void *no_data)
 		fd_set_nonblocking(newsockfd);
 
 		conn_arg = xmalloc(sizeof(slurmdbd_conn_t));
+		slurm_mutex_init(&conn_arg->pool_lock);
+		slurm_cond_init(&conn_arg->pool_cond, NULL);
 		conn_arg->conn = xmalloc(sizeof(slurm_persist_conn_t));
 		conn_arg->conn->fd = newsockfd;
 		conn_arg->conn->flags = PERSIST_FLAG_DBD;
@@ -130,6 +157,184 @@ extern void rpc_mgr_wake(void)
 	if (master_thread_id)
 		pthread_kill(master_thread_id, SIGUSR1);
 	slurm_persist_conn_recv_server_fini();
+	_pool_fini();
+}
+
+extern bool rpc_mgr_queue_req(slurmdbd_conn_t *slurmdbd_conn,
+			      persist_msg_t *msg, uint32_t uid)
+{
+	rpc_job_t *job;
+
+	if (!pool_thread_cnt || !slurmdbd_conn->db_conn)
+		return false;
+
+	job = xmalloc(sizeof(*job));
+	job->msg = *msg;
+	job->slurmdbd_conn = slurmdbd_conn;
+	job->uid = uid;
+	msg->data = NULL;
+
+	slurm_mutex_lock(&slurmdbd_conn->pool_lock);
+	job->seq = slurmdbd_conn->pool_queued++;
+	slurm_mutex_unlock(&slurmdbd_conn->pool_lock);
+
+	slurm_mutex_lock(&pool_mutex);
+	list_append(pool_jobs, job);
+	slurm_cond_signal(&pool_cond);
+	slurm_mutex_unlock(&pool_mutex);
+
+	return true;
+}
+
+extern void rpc_mgr_wait_conn(slurmdbd_conn_t *slurmdbd_conn)
+{
+	slurm_mutex_lock(&slurmdbd_conn->pool_lock);
+	while (slurmdbd_conn->pool_sent != slurmdbd_conn->pool_queued)
+		slurm_cond_wait(&slurmdbd_conn->pool_cond,
+				&slurmdbd_conn->pool_lock);
+	slurm_mutex_unlock(&slurmdbd_conn->pool_lock);
+}
+
+static void _pool_send(rpc_job_t *job, buf_t *buffer)
+{
+	slurmdbd_conn_t *slurmdbd_conn = job->slurmdbd_conn;
+
+	slurm_mutex_lock(&slurmdbd_conn->pool_lock);
+	while (slurmdbd_conn->pool_sent != job->seq)
+		slurm_cond_wait(&slurmdbd_conn->pool_cond,
+				&slurmdbd_conn->pool_lock);
+	slurm_mutex_unlock(&slurmdbd_conn->pool_lock);
+
+	/* Only the owner of the next sequence number writes to the socket */
+	if (buffer &&
+	    (slurm_persist_send_msg(slurmdbd_conn->conn, buffer) !=
+	     SLURM_SUCCESS))
+		error("%s: Problem sending response to connection %d(%s)",
+		      __func__, slurmdbd_conn->conn->fd,
+		      slurmdbd_conn->conn->rem_host);
+
+	slurm_mutex_lock(&slurmdbd_conn->pool_lock);
+	slurmdbd_conn->pool_sent++;
+	slurm_cond_broadcast(&slurmdbd_conn->pool_cond);
+	slurm_mutex_unlock(&slurmdbd_conn->pool_lock);
+}
+
+static void _pool_db_conn_free(void *x)
+{
+	pool_db_conn_t *pool_db_conn = x;
+
+	acct_storage_g_close_connection(&pool_db_conn->db_conn);
+	xfree(pool_db_conn->cluster_name);
+	xfree(pool_db_conn);
+}
+
+static int _find_pool_db_conn(void *x, void *key)
+{
+	pool_db_conn_t *pool_db_conn = x;
+
+	return !xstrcmp(pool_db_conn->cluster_name, key);
+}
+
+static void *_pool_worker(void *arg)
+{
+	slurmdbd_conn_t worker_conn;
+	List db_conns = list_create(_pool_db_conn_free);
+	pool_db_conn_t *pool_db_conn;
+	char *cluster_name;
+	rpc_job_t *job;
+	buf_t *buffer;
+	int rc;
+
+	while (true) {
+		slurm_mutex_lock(&pool_mutex);
+		while (!pool_shutdown && !list_count(pool_jobs))
+			slurm_cond_wait(&pool_cond, &pool_mutex);
+		/* Drain the queue first, each connection waits for these */
+		job = list_dequeue(pool_jobs);
+		slurm_mutex_unlock(&pool_mutex);
+		if (!job)
+			break;
+
+		/*
+		 * The plugin keeps the cluster of a connection, so keep one
+		 * per cluster.  Each worker has its own so reads run in
+		 * parallel.
+		 */
+		cluster_name = job->slurmdbd_conn->conn->cluster_name;
+		if (!(pool_db_conn = list_find_first(db_conns,
+						     _find_pool_db_conn,
+						     cluster_name))) {
+			pool_db_conn = xmalloc(sizeof(*pool_db_conn));
+			pool_db_conn->cluster_name = xstrdup(cluster_name);
+			pool_db_conn->db_conn = acct_storage_g_get_connection(
+				job->slurmdbd_conn->conn->fd, NULL, true,
+				cluster_name);
+			list_append(db_conns, pool_db_conn);
+		}
+
+		memset(&worker_conn, 0, sizeof(worker_conn));
+		worker_conn.conn = job->slurmdbd_conn->conn;
+		worker_conn.db_conn = pool_db_conn->db_conn;
+		worker_conn.in_pool = true;
+
+		buffer = NULL;
+		proc_req(&worker_conn, &job->msg, &buffer, &job->uid);
+
+		/*
+		 * proc_req() only ends the transaction for the slurmctld
+		 * without CommitDelay.  End the snapshot of the reads here so
+		 * the next request served by this worker sees current data.
+		 */
+		if ((rc = acct_storage_g_commit(pool_db_conn->db_conn, 0)))
+			error("%s: ending the transaction of %s failed: %s",
+			      __func__,
+			      slurmdbd_msg_type_2_str(job->msg.msg_type, 1),
+			      slurm_strerror(rc));
+		slurmdbd_free_msg(&job->msg);
+
+		_pool_send(job, buffer);
+		FREE_NULL_BUFFER(buffer);
+		xfree(job);
+	}
+
+	FREE_NULL_LIST(db_conns);
+	return NULL;
+}
+
+static void _pool_init(void)
+{
+	int i;
+
+	if (!slurmdbd_conf->rpc_workers)
+		return;
+
+	pool_jobs = list_create(NULL);
+	pool_shutdown = false;
+	pool_thread_cnt = slurmdbd_conf->rpc_workers;
+	pool_threads = xcalloc(pool_thread_cnt, sizeof(pthread_t));
+	for (i = 0; i < pool_thread_cnt; i++)
+		slurm_thread_create(&pool_threads[i], _pool_worker, NULL);
+	debug("%s: started %d RPC workers", __func__, pool_thread_cnt);
+}
+
+/* Connection threads are gone, let the workers finish what is queued */
+static void _pool_fini(void)
+{
+	int i;
+
+	if (!pool_thread_cnt)
+		return;
+
+	slurm_mutex_lock(&pool_mutex);
+	pool_shutdown = true;
+	slurm_cond_broadcast(&pool_cond);
+	slurm_mutex_unlock(&pool_mutex);
+
+	for (i = 0; i < pool_thread_cnt; i++)
+		pthread_join(pool_threads[i], NULL);
+	xfree(pool_threads);
+	pool_thread_cnt = 0;
+	FREE_NULL_LIST(pool_jobs);
 }
 
 static void _connection_fini_callback(void *arg)
@@ -137,6 +342,9 @@ static void _connection_fini_callback(void *arg)
 	slurmdbd_conn_t *conn = (slurmdbd_conn_t *) arg;
 	bool locked = false;
 
+	/* The RPC workers still reference this connection until replied */
+	rpc_mgr_wait_conn(conn);
+
 	if (conn->conn->rem_port) {
 		if (!shutdown_time) {
 			slurmdb_cluster_rec_t cluster_rec;
@@ -181,5 +389,7 @@ static void _connection_fini_callback(void *arg)
 	/* handled directly in the internal persist_conn code */
 	//slurm_persist_conn_members_destroy(&conn->conn);
 	xfree(conn->tres_str);
+	slurm_mutex_destroy(&conn->pool_lock);
+	slurm_cond_destroy(&conn->pool_cond);
 	xfree(conn);
 }
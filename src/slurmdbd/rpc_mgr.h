@@ -41,6 +41,7 @@
 
 #include "src/common/pack.h"
 #include "src/common/assoc_mgr.h"
+#include "src/slurmdbd/proc_req.h"
 
 /* Process incoming RPCs. Meant to execute as a pthread */
 extern void *rpc_mgr(void *no_data);
@@ -48,4 +49,19 @@ extern void *rpc_mgr(void *no_data);
 /* Wake up the RPC manager so that it can exit */
 extern void rpc_mgr_wake(void);
 
+/*
+ * Hand a request to the RPC workers (Parameters=RpcWorkers).  The worker
+ * sends the reply itself, after the replies to any request queued before it
+ * on the same connection.
+ * IN slurmdbd_conn - connection the request came from
+ * IN/OUT msg - request, msg->data is taken over if queued
+ * IN uid - user ID who initiated the RPC
+ * RET true if queued, false if the caller has to process it
+ */
+extern bool rpc_mgr_queue_req(slurmdbd_conn_t *slurmdbd_conn,
+			      persist_msg_t *msg, uint32_t uid);
+
+/* Wait until all replies owed on slurmdbd_conn by the RPC workers are sent */
+extern void rpc_mgr_wait_conn(slurmdbd_conn_t *slurmdbd_conn);
+
 #endif /* !_RPC_MGR_H */
@@ -298,6 +298,7 @@ end_it:
 	if (commit_handler_thread)
 		pthread_join(commit_handler_thread, NULL);
 
+	proc_req_fini();
 	acct_storage_g_commit(db_conn, 1);
 	acct_storage_g_close_connection(&db_conn);
 
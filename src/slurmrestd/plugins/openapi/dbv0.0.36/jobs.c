@@ -87,6 +87,15 @@ static int _foreach_job(void *x, void *arg)
 		return 1;
 }
 
+/* Dump each chunk of jobs as it comes instead of holding all of them */
+static int _foreach_job_chunk(List jobs, void *arg)
+{
+	if (list_for_each(jobs, _foreach_job, arg) < 0)
+		return ESLURM_DATA_CONV_FAILED;
+
+	return SLURM_SUCCESS;
+}
+
 typedef struct {
 	data_t *errors;
 	slurmdb_job_cond_t *job_cond;
@@ -354,21 +363,38 @@ static int _dump_jobs(const char *context_id, http_request_method_t method,
 		.magic = MAGIC_FOREACH_JOB,
 		.jobs = data_set_list(data_key_set(resp, "jobs")),
 	};
-	List jobs = NULL;
+	/* same as what slurmdbd gets for a NULL job_cond */
+	slurmdb_job_cond_t def_job_cond = {
+		.db_flags = SLURMDB_JOB_FLAG_NOTSET,
+	};
+	int query_rc;
 
-	if (!db_query_list(errors, auth, &jobs, slurmdb_jobs_get, job_cond) &&
-	    !db_query_list(errors, auth, &args.assoc_list,
+	if (!job_cond)
+		job_cond = &def_job_cond;
+
+	if (!db_query_list(errors, auth, &args.assoc_list,
 			   slurmdb_associations_get, &assoc_cond) &&
 	    !db_query_list(errors, auth, &args.qos_list, slurmdb_qos_get,
 			   &qos_cond) &&
 	    !db_query_list(errors, auth, &args.tres_list, slurmdb_tres_get,
-			   &tres_cond) &&
-	    (list_for_each(jobs, _foreach_job, &args) < 0))
-		rc = ESLURM_DATA_CONV_FAILED;
+			   &tres_cond)) {
+		errno = 0;
+		query_rc = slurmdb_jobs_get_chunked(
+			rest_auth_g_get_db_conn(auth), job_cond,
+			_foreach_job_chunk, &args);
+
+		if (query_rc == ESLURM_DATA_CONV_FAILED)
+			rc = query_rc;
+		else if (query_rc)
+			resp_error(errors, (errno ? errno : query_rc), NULL,
+				   "slurmdb_jobs_get_chunked");
+		else if (!data_get_list_length(args.jobs))
+			resp_error(errors, ESLURM_REST_EMPTY_RESULT,
+				   "Nothing found", "slurmdb_jobs_get_chunked");
+	}
 
 	FREE_NULL_LIST(args.tres_list);
 	FREE_NULL_LIST(args.qos_list);
-	FREE_NULL_LIST(jobs);
 
 	return rc;
 }
@@ -559,6 +559,7 @@ env_vars_t env_vars[] = {
   { "SLURM_GRES", LONG_OPT_GRES },
   { "SLURM_GRES_FLAGS", LONG_OPT_GRES_FLAGS },
   { "SLURM_HINT", LONG_OPT_HINT },
+  { "SLURM_IO_AGGREGATE", LONG_OPT_IO_AGGREGATE },
   { "SLURM_JOB_ID", LONG_OPT_JOBID },
   { "SLURM_JOB_NAME", 'J' },
   { "SLURM_JOB_NODELIST", LONG_OPT_ALLOC_NODELIST },
@@ -1483,6 +1484,8 @@ static void _help(void)
 "  -H, --hold                  submit job in held state\n"
 "  -i, --input=in              location of stdin redirection\n"
 "  -I, --immediate[=secs]      exit if resources not available in \"secs\"\n"
+"      --io-aggregate[=msec]   coalesce task output on each node for up to\n"
+"                              msec before sending it to srun\n"
 "      --jobid=id              run under already allocated job\n"
 "  -J, --job-name=jobname      name of job\n"
 "  -k, --no-kill               do not kill job on node failure\n"
@@ -139,6 +139,7 @@ static void _set_env_vars(resource_allocation_response_msg_t *resp,
 			  int het_job_offset);
 static void _set_env_vars2(resource_allocation_response_msg_t *resp,
 			   int het_job_offset);
+static void _set_io_aggregate_env(void);
 static void _set_ntasks(allocation_info_t *ai, slurm_opt_t *opt_local);
 static void _set_prio_process_env(void);
 static int  _set_rlimit_env(void);
@@ -746,6 +747,7 @@ extern void init_srun(int argc, char **argv,
 	(void) _set_rlimit_env();
 	_set_prio_process_env();
 	(void) _set_umask_env();
+	_set_io_aggregate_env();
 	_set_submit_dir_env();
 
 	/*
@@ -2203,6 +2205,19 @@ static void _set_submit_dir_env(void)
 		error("unable to set SLURM_SUBMIT_HOST in environment");
 }
 
+/*
+ * Set SLURM_IO_AGGREGATE so the slurmstepd of each node coalesces task
+ * output for the requested window before sending it back to srun
+ */
+static void _set_io_aggregate_env(void)
+{
+	if (sropt.io_aggregate <= 0)
+		return;
+
+	if (setenvf(NULL, "SLURM_IO_AGGREGATE", "%d", sropt.io_aggregate) < 0)
+		error("unable to set SLURM_IO_AGGREGATE in environment");
+}
+
 /* Set some environment variables with current state */
 static int _set_umask_env(void)
 {
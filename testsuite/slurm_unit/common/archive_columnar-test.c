@@ -0,0 +1,305 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+/*
+ * Round trip of the columnar archive format of accounting_storage/common.
+ *
+ * Every value packed must come back as the same string (NULL staying NULL),
+ * whichever encoding its column ends up with, and damaged files must be
+ * refused instead of loaded, whatever their record count claims.
+ */
+
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <check.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/plugins/accounting_storage/common/common_as.h"
+
+/* Normally provided by the accounting_storage plugin and the slurmdbd */
+const char plugin_type[] = "accounting_storage/test";
+char *assoc_day_table = "assoc_usage_day_table";
+char *assoc_hour_table = "assoc_usage_hour_table";
+char *assoc_month_table = "assoc_usage_month_table";
+char *cluster_day_table = "usage_day_table";
+char *cluster_hour_table = "usage_hour_table";
+char *cluster_month_table = "usage_month_table";
+char *wckey_day_table = "wckey_usage_day_table";
+char *wckey_hour_table = "wckey_usage_hour_table";
+char *wckey_month_table = "wckey_usage_month_table";
+#ifndef NDEBUG
+__thread bool drop_priv = false;
+#endif
+
+#define REC_CNT 1000
+
+enum {
+	COL_ID,		/* increasing integers, delta encoded */
+	COL_SIGNED,	/* negative and 64 bit integers */
+	COL_NAME,	/* strings */
+	COL_NULL,	/* strings, NULL and "" mixed */
+	COL_PADDED,	/* looks like integers but must stay strings */
+	COL_CNT
+};
+
+static char *col_names[] = {
+	"id_job", "signed", "job_name", "comment", "padded"
+};
+
+static char ***_create_rows(void)
+{
+	char ***rows = xcalloc(REC_CNT, sizeof(char **));
+	int i;
+
+	for (i = 0; i < REC_CNT; i++) {
+		rows[i] = xcalloc(COL_CNT, sizeof(char *));
+		rows[i][COL_ID] = xstrdup_printf("%d", 1000000 + (i * 3));
+		rows[i][COL_SIGNED] = xstrdup_printf(
+			"%"PRId64, (i % 2) ? (int64_t) -i :
+			(int64_t) INT64_MAX - i);
+		rows[i][COL_NAME] = xstrdup_printf("job_%d", i % 17);
+		if (i % 3 == 1)
+			rows[i][COL_NULL] = xstrdup("");
+		else if (i % 3 == 2)
+			rows[i][COL_NULL] = xstrdup_printf("comment %d", i);
+		rows[i][COL_PADDED] = xstrdup_printf("%03d", i % 100);
+	}
+
+	return rows;
+}
+
+static void _free_rows(char ***rows)
+{
+	int i, col;
+
+	for (i = 0; i < REC_CNT; i++) {
+		for (col = 0; col < COL_CNT; col++)
+			xfree(rows[i][col]);
+		xfree(rows[i]);
+	}
+	xfree(rows);
+}
+
+/* Return the number of values that did not come back unchanged */
+static int _cmp_rows(char ***rows, char ***out_rows)
+{
+	int i, col, diff = 0;
+
+	for (i = 0; i < REC_CNT; i++) {
+		for (col = 0; col < COL_CNT; col++) {
+			if (!rows[i][col] != !out_rows[i][col])
+				diff++;
+			else if (xstrcmp(rows[i][col], out_rows[i][col]))
+				diff++;
+		}
+	}
+
+	return diff;
+}
+
+/* Unpack size bytes of data, returns the rc of archive_unpack_columnar() */
+static int _unpack(char *data, uint32_t size, archive_footer_t *footer,
+		   char ****rows)
+{
+	char *copy = xmalloc(size);
+	buf_t *buffer;
+	int rc;
+
+	memcpy(copy, data, size);
+	buffer = create_buf(copy, size);
+	rc = archive_unpack_columnar(buffer, footer, rows);
+	free_buf(buffer);
+
+	return rc;
+}
+
+static archive_footer_t footer;
+static char ***rows;
+static buf_t *buffer;
+static char *data;
+static uint32_t size;
+
+static void _setup(void)
+{
+	rows = _create_rows();
+	memset(&footer, 0, sizeof(footer));
+	footer.cluster_name = "test_cluster";
+	footer.col_cnt = COL_CNT;
+	footer.col_names = col_names;
+	footer.rec_cnt = REC_CNT;
+	footer.type = 3;
+	footer.usage_info = 0x1234;
+
+	buffer = archive_pack_columnar(rows, &footer);
+	data = get_buf_data(buffer);
+	size = get_buf_offset(buffer);
+}
+
+static void _teardown(void)
+{
+	free_buf(buffer);
+	_free_rows(rows);
+}
+
+/* Assert that size bytes of data are refused */
+static void _refused(uint32_t size)
+{
+	archive_footer_t out_footer;
+	char ***out_rows = NULL;
+
+	ck_assert_int_ne(_unpack(data, size, &out_footer, &out_rows),
+			 SLURM_SUCCESS);
+	ck_assert(out_rows == NULL);
+	archive_free_footer(&out_footer);
+}
+
+/* Overwrite the record count in the footer */
+static void _set_rec_cnt(uint32_t rec_cnt)
+{
+	uint32_t footer_offset, off;
+
+	memcpy(&footer_offset, data + size - (2 * sizeof(uint32_t)),
+	       sizeof(uint32_t));
+	/* type, usage_info, then the packed cluster name */
+	off = ntohl(footer_offset) + sizeof(uint16_t) + sizeof(uint32_t) +
+	      sizeof(uint32_t) + strlen(footer.cluster_name) + 1;
+	rec_cnt = htonl(rec_cnt);
+	memcpy(data + off, &rec_cnt, sizeof(uint32_t));
+}
+
+START_TEST(test_detect)
+{
+	buf_t *old_buffer = init_buf(1024);
+
+	ck_assert(archive_is_columnar(data, size));
+
+	pack16(SLURM_PROTOCOL_VERSION, old_buffer);
+	pack_time(1600000000, old_buffer);
+	ck_assert(!archive_is_columnar(get_buf_data(old_buffer),
+				       get_buf_offset(old_buffer)));
+	free_buf(old_buffer);
+}
+END_TEST
+
+START_TEST(test_round_trip)
+{
+	archive_footer_t out_footer;
+	char ***out_rows = NULL;
+	uint32_t col;
+
+	ck_assert_int_eq(_unpack(data, size, &out_footer, &out_rows),
+			 SLURM_SUCCESS);
+	ck_assert_str_eq(out_footer.cluster_name, footer.cluster_name);
+	ck_assert_int_eq(out_footer.type, footer.type);
+	ck_assert_int_eq(out_footer.usage_info, footer.usage_info);
+	ck_assert_int_eq(out_footer.rec_cnt, REC_CNT);
+	ck_assert_int_eq(out_footer.col_cnt, COL_CNT);
+	for (col = 0; col < COL_CNT; col++)
+		ck_assert_str_eq(out_footer.col_names[col], col_names[col]);
+	ck_assert_int_eq(_cmp_rows(rows, out_rows), 0);
+
+	archive_free_columnar_rows(out_rows, &out_footer);
+	archive_free_footer(&out_footer);
+}
+END_TEST
+
+START_TEST(test_truncated)
+{
+	/* Cutting the end off loses the footer */
+	_refused(size - 3);
+}
+END_TEST
+
+START_TEST(test_bad_footer_offset)
+{
+	/* A footer offset past the end of the file */
+	data[size - (2 * sizeof(uint32_t))] ^= 0x40;
+	_refused(size);
+}
+END_TEST
+
+START_TEST(test_damaged_column)
+{
+	/*
+	 * The first column starts after the magic and version, the length of
+	 * its data follows the encoding and raw size.
+	 */
+	data[sizeof(uint32_t) + sizeof(uint16_t) + 1 + sizeof(uint32_t)] = 0x7f;
+	_refused(size);
+}
+END_TEST
+
+START_TEST(test_bad_rec_cnt)
+{
+	/* More records than the columns hold, up to wrapping rec_cnt + 1 */
+	_set_rec_cnt(UINT32_MAX);
+	_refused(size);
+	_set_rec_cnt(UINT32_MAX / 2);
+	_refused(size);
+	_set_rec_cnt(REC_CNT * 100);
+	_refused(size);
+}
+END_TEST
+
+Suite *archive_columnar_suite(void)
+{
+	Suite *s = suite_create("archive_columnar");
+	TCase *tc_core = tcase_create("archive_columnar");
+	tcase_add_checked_fixture(tc_core, _setup, _teardown);
+	tcase_add_test(tc_core, test_detect);
+	tcase_add_test(tc_core, test_round_trip);
+	tcase_add_test(tc_core, test_truncated);
+	tcase_add_test(tc_core, test_bad_footer_offset);
+	tcase_add_test(tc_core, test_damaged_column);
+	tcase_add_test(tc_core, test_bad_rec_cnt);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+	SRunner *sr = srunner_create(archive_columnar_suite());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
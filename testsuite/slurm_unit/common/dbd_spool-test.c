@@ -0,0 +1,407 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+/*
+ * Recovery of the slurmctld's spool of messages for the SlurmDBD.
+ *
+ * Messages must come back in order and unchanged after the spool is closed
+ * and opened again, from the oldest one not acknowledged.  A record with a
+ * bad checksum or cut short, as left by a crash, must be dropped along with
+ * everything after it, and messages spooled by an older slurmctld must be
+ * repacked with the current protocol version.  Segments are synced through
+ * descriptors taken from the spool, appending goes on meanwhile.
+ */
+
+#include "config.h"
+
+#include <check.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/common/list.h"
+#include "src/common/slurmdbd_pack.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/plugins/accounting_storage/slurmdbd/slurmdbd_spool.h"
+
+/* Normally provided by the accounting_storage plugin */
+const char plugin_type[] = "accounting_storage/test";
+
+/* On disk format of the spool, see slurmdbd_spool.c */
+#define SPOOL_MAGIC		0xDB5B0001
+#define SPOOL_REC_MAGIC		0xDEAD3219
+#define SPOOL_HDR_SIZE		(2 * sizeof(uint32_t))
+#define SPOOL_REC_SIZE(_len)	((_len) + (3 * sizeof(uint32_t)))
+
+#define MSG_CNT 5
+#define BIG_MSG 2	/* larger than MAX_DBD_MSG_LEN */
+
+static char *dir = NULL;
+
+static uint32_t _crc32(const char *data, uint32_t len)
+{
+	uint32_t c = 0xFFFFFFFF;
+	int i;
+
+	while (len--) {
+		c ^= (uint8_t) *data++;
+		for (i = 0; i < 8; i++)
+			c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+	}
+
+	return c ^ 0xFFFFFFFF;
+}
+
+static buf_t *_pack_msg(int i, uint16_t version)
+{
+	dbd_cluster_tres_msg_t tres_msg = { 0 };
+	persist_msg_t msg = { 0 };
+	buf_t *buffer;
+
+	tres_msg.cluster_nodes = xstrdup_printf("node[0-%d]", i);
+	tres_msg.event_time = 1600000000 + i;
+	if (i == BIG_MSG) {
+		tres_msg.tres_str = xmalloc(MAX_DBD_MSG_LEN * 2);
+		memset(tres_msg.tres_str, '1', (MAX_DBD_MSG_LEN * 2) - 1);
+	} else
+		tres_msg.tres_str = xstrdup_printf("1=%d,2=%d", i, i * 1024);
+	msg.msg_type = DBD_CLUSTER_TRES;
+	msg.data = &tres_msg;
+	buffer = pack_slurmdbd_msg(&msg, version);
+	xfree(tres_msg.cluster_nodes);
+	xfree(tres_msg.tres_str);
+
+	return buffer;
+}
+
+/* Return true if buffer does not hold message i packed with version */
+static bool _diff_msg(buf_t *buffer, int i, uint16_t version)
+{
+	buf_t *expect = _pack_msg(i, version);
+	bool diff = (!buffer ||
+		     (get_buf_offset(buffer) != get_buf_offset(expect)) ||
+		     memcmp(get_buf_data(buffer), get_buf_data(expect),
+			    get_buf_offset(expect)));
+
+	free_buf(expect);
+	return diff;
+}
+
+/* Append messages first to first + cnt - 1 */
+static void _append(int first, int cnt)
+{
+	buf_t *buffer;
+	int i;
+
+	for (i = first; i < (first + cnt); i++) {
+		buffer = _pack_msg(i, SLURM_PROTOCOL_VERSION);
+		ck_assert_int_eq(dbd_spool_append(buffer, false),
+				 SLURM_SUCCESS);
+		free_buf(buffer);
+	}
+}
+
+/* Load everything pending and compare it with the messages in order */
+static void _load_cmp(int *msgs, int cnt)
+{
+	List list = list_create(slurmdbd_free_buffer);
+	buf_t *buffer;
+	int i = 0;
+
+	ck_assert_int_eq(dbd_spool_load(list, 100), cnt);
+	while ((buffer = list_dequeue(list))) {
+		ck_assert_int_lt(i, cnt);
+		ck_assert_msg(!_diff_msg(buffer, msgs[i],
+					 SLURM_PROTOCOL_VERSION),
+			      "message %d loaded unchanged", msgs[i]);
+		free_buf(buffer);
+		i++;
+	}
+	FREE_NULL_LIST(list);
+}
+
+static char *_seg_path(uint32_t seg)
+{
+	return xstrdup_printf("%s/%010u", dir, seg);
+}
+
+static off_t _seg_size(uint32_t seg)
+{
+	struct stat st;
+	char *path = _seg_path(seg);
+	off_t size = -1;
+
+	if (!stat(path, &st))
+		size = st.st_size;
+	xfree(path);
+
+	return size;
+}
+
+/* Offset of record rec of segment 0 written by _append(0, ...) */
+static uint32_t _rec_off(int rec)
+{
+	uint32_t off = SPOOL_HDR_SIZE;
+	buf_t *buffer;
+	int i;
+
+	for (i = 0; i < rec; i++) {
+		buffer = _pack_msg(i, SLURM_PROTOCOL_VERSION);
+		off += SPOOL_REC_SIZE(get_buf_offset(buffer));
+		free_buf(buffer);
+	}
+
+	return off;
+}
+
+static void _write(int fd, void *data, uint32_t len)
+{
+	ck_assert_int_eq(write(fd, data, len), len);
+}
+
+static void _write_rec(int fd, char *data, uint32_t len)
+{
+	uint32_t hdr[2] = { len, _crc32(data, len) };
+	uint32_t magic = SPOOL_REC_MAGIC;
+
+	_write(fd, hdr, sizeof(hdr));
+	_write(fd, data, len);
+	_write(fd, &magic, sizeof(magic));
+}
+
+static void _setup(void)
+{
+	dir = xstrdup("/tmp/dbd_spool-test.XXXXXX");
+	ck_assert_msg(mkdtemp(dir), "mkdtemp %s", dir);
+}
+
+static void _teardown(void)
+{
+	char *cmd = xstrdup_printf("rm -rf %s", dir);
+
+	if (system(cmd))
+		printf("%s failed\n", cmd);
+	xfree(cmd);
+	xfree(dir);
+}
+
+START_TEST(test_reopen)
+{
+	int all[] = { 0, 1, 2, 3, 4 }, rest[] = { 2, 3, 4 };
+	List list;
+
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	_append(0, MSG_CNT);
+	ck_assert_int_eq(dbd_spool_pending(), MSG_CNT);
+	dbd_spool_close();
+
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	ck_assert_int_eq(dbd_spool_pending(), MSG_CNT);
+	_load_cmp(all, MSG_CNT);
+	dbd_spool_ack();
+	dbd_spool_ack();
+	dbd_spool_close();
+
+	/* Acknowledged messages are gone */
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	ck_assert_int_eq(dbd_spool_pending(), 3);
+	_load_cmp(rest, 3);
+	dbd_spool_close();
+
+	/* Loading stops at max and picks up from there */
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	list = list_create(slurmdbd_free_buffer);
+	ck_assert_int_eq(dbd_spool_load(list, 1), 1);
+	ck_assert(!_diff_msg(list_peek(list), 2, SLURM_PROTOCOL_VERSION));
+	FREE_NULL_LIST(list);
+	_load_cmp(rest + 1, 2);
+	dbd_spool_close();
+}
+END_TEST
+
+START_TEST(test_sync)
+{
+	dbd_spool_sync_t sync;
+
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	ck_assert(!dbd_spool_sync_prep(&sync, true));
+	_append(0, 1);
+	ck_assert(dbd_spool_sync_prep(&sync, true));
+	ck_assert_int_ge(sync.tail_fd, 0);
+	/* Appending goes on while the segment is synced */
+	_append(1, 1);
+	dbd_spool_sync_fds(&sync);
+	ck_assert_int_eq(sync.tail_fd, -1);
+	ck_assert(dbd_spool_sync_prep(&sync, true));
+	dbd_spool_sync_fds(&sync);
+	ck_assert(!dbd_spool_sync_prep(&sync, true));
+	dbd_spool_close();
+
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	ck_assert_int_eq(dbd_spool_pending(), 2);
+	dbd_spool_close();
+}
+END_TEST
+
+START_TEST(test_crc)
+{
+	int msgs[] = { 0, 1, MSG_CNT };
+	uint32_t off = _rec_off(2);
+	char byte, *path;
+	int fd;
+
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	_append(0, MSG_CNT);
+	dbd_spool_close();
+
+	/* Damage the message of the third record */
+	path = _seg_path(0);
+	fd = open(path, O_RDWR);
+	ck_assert_int_ge(fd, 0);
+	ck_assert_int_eq(pread(fd, &byte, 1,
+			       off + (2 * sizeof(uint32_t)) + 10), 1);
+	byte ^= 0x01;
+	ck_assert_int_eq(pwrite(fd, &byte, 1,
+				off + (2 * sizeof(uint32_t)) + 10), 1);
+	close(fd);
+	xfree(path);
+
+	/* Records from the bad checksum on are dropped */
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	ck_assert_int_eq(dbd_spool_pending(), 2);
+	ck_assert_int_eq(_seg_size(0), off);
+	/* Messages appended after recovery follow the good ones */
+	_append(MSG_CNT, 1);
+	_load_cmp(msgs, 3);
+	dbd_spool_close();
+}
+END_TEST
+
+START_TEST(test_truncated)
+{
+	int msgs[] = { 0, 1, 2, 3, MSG_CNT };
+	uint32_t off = _rec_off(MSG_CNT);
+	char *path;
+
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	_append(0, MSG_CNT);
+	dbd_spool_close();
+
+	/* A crash while the last record was written */
+	path = _seg_path(0);
+	ck_assert_int_eq(truncate(path, off - 5), 0);
+	xfree(path);
+
+	/* The incomplete last record is dropped */
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	ck_assert_int_eq(dbd_spool_pending(), MSG_CNT - 1);
+	ck_assert_int_eq(_seg_size(0), _rec_off(MSG_CNT - 1));
+	_append(MSG_CNT, 1);
+	_load_cmp(msgs, MSG_CNT);
+	dbd_spool_close();
+}
+END_TEST
+
+START_TEST(test_version)
+{
+	uint32_t hdr[2] = { SPOOL_MAGIC, SLURM_ONE_BACK_PROTOCOL_VERSION };
+	List list = list_create(slurmdbd_free_buffer);
+	char *path, garbage[] = "not a message";
+	buf_t *buffer;
+	int fd;
+
+	/* A segment written by the slurmctld of the previous release */
+	path = _seg_path(0);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	ck_assert_int_ge(fd, 0);
+	_write(fd, hdr, sizeof(hdr));
+	buffer = _pack_msg(0, SLURM_ONE_BACK_PROTOCOL_VERSION);
+	_write_rec(fd, get_buf_data(buffer), get_buf_offset(buffer));
+	free_buf(buffer);
+	_write_rec(fd, garbage, sizeof(garbage));
+	buffer = _pack_msg(1, SLURM_ONE_BACK_PROTOCOL_VERSION);
+	_write_rec(fd, get_buf_data(buffer), get_buf_offset(buffer));
+	free_buf(buffer);
+	close(fd);
+	xfree(path);
+
+	ck_assert_int_eq(dbd_spool_open(dir), SLURM_SUCCESS);
+	ck_assert_int_eq(dbd_spool_pending(), 3);
+	/* New messages go to a segment of the current version */
+	ck_assert_int_eq(_seg_size(1), SPOOL_HDR_SIZE);
+	/* The message that can't be unpacked is skipped */
+	ck_assert_int_eq(dbd_spool_load(list, 100), 2);
+	/* The others are repacked with the current version */
+	buffer = list_dequeue(list);
+	ck_assert(!_diff_msg(buffer, 0, SLURM_PROTOCOL_VERSION));
+	FREE_NULL_BUFFER(buffer);
+	buffer = list_dequeue(list);
+	ck_assert(!_diff_msg(buffer, 1, SLURM_PROTOCOL_VERSION));
+	FREE_NULL_BUFFER(buffer);
+	dbd_spool_ack();
+	dbd_spool_ack();
+	/* The old segment is removed once its messages are acknowledged */
+	ck_assert_int_eq(_seg_size(0), -1);
+	dbd_spool_close();
+	FREE_NULL_LIST(list);
+}
+END_TEST
+
+Suite *dbd_spool_suite(void)
+{
+	Suite *s = suite_create("dbd_spool");
+	TCase *tc_core = tcase_create("dbd_spool");
+	tcase_add_checked_fixture(tc_core, _setup, _teardown);
+	tcase_add_test(tc_core, test_reopen);
+	tcase_add_test(tc_core, test_sync);
+	tcase_add_test(tc_core, test_crc);
+	tcase_add_test(tc_core, test_truncated);
+	tcase_add_test(tc_core, test_version);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+	SRunner *sr = srunner_create(dbd_spool_suite());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,243 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+/*
+ * Check the poll() and epoll eio backends.
+ *
+ * A single token is passed along a chain of pipes: reading the token from
+ * one pipe writes it to the next one, so every loop iteration has exactly
+ * one ready fd among many idle ones. The reuse tests close an object's fd
+ * and get the same fd number back, either for a new object or for the same
+ * one, which must still be polled afterwards.
+ */
+
+#include <check.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "src/common/eio.h"
+#include "src/common/read_config.h"
+#include "src/common/xmalloc.h"
+
+#define PIPE_CNT	100
+#define HOPS		1000
+#define REUSE_CNT	100
+
+static int pipes[PIPE_CNT][2];
+static int hops_done;
+static eio_handle_t *eio;
+
+static bool _chain_readable(eio_obj_t *obj)
+{
+	return !obj->shutdown;
+}
+
+static int _chain_read(eio_obj_t *obj, List objs)
+{
+	int i = (int) (intptr_t) obj->arg;
+	char c;
+
+	if (read(obj->fd, &c, 1) != 1)
+		return SLURM_ERROR;
+
+	if (++hops_done >= HOPS) {
+		eio_signal_shutdown(eio);
+		return SLURM_SUCCESS;
+	}
+
+	if (write(pipes[(i + 1) % PIPE_CNT][1], &c, 1) != 1)
+		return SLURM_ERROR;
+
+	return SLURM_SUCCESS;
+}
+
+static struct io_operations chain_ops = {
+	.readable = &_chain_readable,
+	.handle_read = &_chain_read,
+};
+
+static int reuse_done;
+static int reuse_fds[2];
+static bool reuse_same_obj;
+
+static bool _reuse_readable(eio_obj_t *obj)
+{
+	return !obj->shutdown && (obj->fd >= 0);
+}
+
+/*
+ * Read the token, close the pipe and pass the token through a new pipe whose
+ * read end gets the same fd number, owned by a new object or by this one.
+ */
+static int _reuse_read(eio_obj_t *obj, List objs);
+
+static struct io_operations reuse_ops = {
+	.readable = &_reuse_readable,
+	.handle_read = &_reuse_read,
+};
+
+static int _reuse_read(eio_obj_t *obj, List objs)
+{
+	int old_fd = obj->fd;
+	char c;
+
+	if (read(obj->fd, &c, 1) != 1)
+		return SLURM_ERROR;
+
+	close(reuse_fds[0]);
+	close(reuse_fds[1]);
+	obj->fd = -1;
+
+	if (++reuse_done >= REUSE_CNT) {
+		eio_signal_shutdown(eio);
+		return SLURM_SUCCESS;
+	}
+
+	if (pipe(reuse_fds) < 0)
+		return SLURM_ERROR;
+	ck_assert_int_eq(reuse_fds[0], old_fd);
+	if (reuse_same_obj)
+		obj->fd = reuse_fds[0];
+	else
+		list_append(objs, eio_obj_create(reuse_fds[0], &reuse_ops,
+						 NULL));
+	if (write(reuse_fds[1], &c, 1) != 1)
+		return SLURM_ERROR;
+
+	return SLURM_SUCCESS;
+}
+
+static void _run_chain(char *comm_params)
+{
+	eio_obj_t *obj;
+	int i;
+
+	for (i = 0; i < PIPE_CNT; i++)
+		ck_assert_int_eq(pipe(pipes[i]), 0);
+
+	slurm_conf.comm_params = comm_params;
+	eio = eio_handle_create(0);
+	for (i = 0; i < PIPE_CNT; i++) {
+		obj = eio_obj_create(pipes[i][0], &chain_ops,
+				     (void *) (intptr_t) i);
+		eio_new_initial_obj(eio, obj);
+	}
+
+	hops_done = 0;
+	ck_assert_int_eq(write(pipes[0][1], "x", 1), 1);
+	ck_assert_int_eq(eio_handle_mainloop(eio), 0);
+	ck_assert_int_eq(hops_done, HOPS);
+
+	eio_handle_destroy(eio);
+	slurm_conf.comm_params = NULL;
+
+	for (i = 0; i < PIPE_CNT; i++) {
+		close(pipes[i][0]);
+		close(pipes[i][1]);
+	}
+}
+
+static void _run_reuse(char *comm_params, bool same_obj)
+{
+	eio_obj_t *obj;
+
+	/* A lost fd registration hangs the loop, fail instead */
+	alarm(10);
+
+	slurm_conf.comm_params = comm_params;
+	reuse_same_obj = same_obj;
+	eio = eio_handle_create(0);
+	ck_assert_int_eq(pipe(reuse_fds), 0);
+	obj = eio_obj_create(reuse_fds[0], &reuse_ops, NULL);
+	eio_new_initial_obj(eio, obj);
+
+	reuse_done = 0;
+	ck_assert_int_eq(write(reuse_fds[1], "x", 1), 1);
+	ck_assert_int_eq(eio_handle_mainloop(eio), 0);
+	ck_assert_int_eq(reuse_done, REUSE_CNT);
+
+	eio_handle_destroy(eio);
+	slurm_conf.comm_params = NULL;
+	alarm(0);
+}
+
+START_TEST(test_poll_chain)
+{
+	_run_chain(NULL);
+}
+END_TEST
+
+START_TEST(test_epoll_chain)
+{
+	_run_chain("EioEpoll");
+}
+END_TEST
+
+START_TEST(test_poll_reuse)
+{
+	_run_reuse(NULL, false);
+	_run_reuse(NULL, true);
+}
+END_TEST
+
+START_TEST(test_epoll_reuse)
+{
+	_run_reuse("EioEpoll", false);
+	_run_reuse("EioEpoll", true);
+}
+END_TEST
+
+Suite *eio_suite(void)
+{
+	Suite *s = suite_create("eio");
+	TCase *tc_core = tcase_create("eio");
+	tcase_add_test(tc_core, test_poll_chain);
+	tcase_add_test(tc_core, test_epoll_chain);
+	tcase_add_test(tc_core, test_poll_reuse);
+	tcase_add_test(tc_core, test_epoll_reuse);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+	SRunner *sr = srunner_create(eio_suite());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
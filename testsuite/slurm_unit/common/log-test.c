@@ -1,14 +1,102 @@
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <slurm/slurm_errno.h>
 #include "src/common/log.h"
 
+#define ASYNC_THREADS 4
+#define ASYNC_LINES 5000
+
 int bad_func()
 {
 	slurm_seterrno_ret(EINVAL);
 }
+
+static void *_async_logger(void *arg)
+{
+	for (int i = 0; i < ASYNC_LINES; i++) {
+		if (!(i % 100))
+			error("async line %d from thread %d",
+			      i, (int) (intptr_t) arg);
+		else
+			info("async line %d from thread %d",
+			     i, (int) (intptr_t) arg);
+	}
+	return NULL;
+}
+
+/*
+ * Log from several threads through the asynchronous writer. Every line
+ * queued must end up in the file or be counted as dropped, errors are never
+ * dropped and the lines of each thread stay in order.
+ * RET 0 on success
+ */
+static int _test_async(void)
+{
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	char logfile[] = "/tmp/log-test.XXXXXX";
+	char line[256];
+	pthread_t threads[ASYNC_THREADS];
+	uint64_t dropped = 0, waits = 0;
+	int last[ASYNC_THREADS], errors = 0, thread, num;
+	int fd, written = 0, rc = 0;
+	FILE *fp;
+
+	if ((fd = mkstemp(logfile)) < 0)
+		return 1;
+	close(fd);
+
+	log_opts.stderr_level = LOG_LEVEL_QUIET;
+	log_opts.syslog_level = LOG_LEVEL_QUIET;
+	log_opts.async = true;
+	log_alter(log_opts, 0, logfile);
+
+	for (int i = 0; i < ASYNC_THREADS; i++)
+		pthread_create(&threads[i], NULL, _async_logger,
+			       (void *) (intptr_t) i);
+	for (int i = 0; i < ASYNC_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	log_fini();
+
+	if (!(fp = fopen(logfile, "r")))
+		return 1;
+	for (int i = 0; i < ASYNC_THREADS; i++)
+		last[i] = -1;
+	while (fgets(line, sizeof(line), fp)) {
+		if (strstr(line, "async line")) {
+			written++;
+			if ((sscanf(strstr(line, "async line"),
+				    "async line %d from thread %d",
+				    &num, &thread) != 2) ||
+			    (thread < 0) || (thread >= ASYNC_THREADS) ||
+			    (num <= last[thread]))
+				rc = 1;
+			else
+				last[thread] = num;
+			if (strstr(line, "error: "))
+				errors++;
+		} else if (strstr(line, "log writer dropped"))
+			sscanf(strstr(line, "dropped"),
+			       "dropped %"SCNu64" messages, %"SCNu64,
+			       &dropped, &waits);
+	}
+	fclose(fp);
+	unlink(logfile);
+
+	printf("async: %d lines written, %"PRIu64" dropped, %"PRIu64" waits\n",
+	       written, dropped, waits);
+	if ((written + dropped) != (ASYNC_THREADS * ASYNC_LINES))
+		rc = 1;
+	if (errors != (ASYNC_THREADS * ASYNC_LINES / 100))
+		rc = 1;
+
+	return rc;
+}
+
 int main(int ac, char **av)
 {
 	/* test elements */
@@ -62,6 +150,7 @@ int main(int ac, char **av)
 
 	if (bad_func() < 0)
 		error("bad_func: %m");
-	return 0;
+
+	return _test_async();
 }
 	
@@ -0,0 +1,218 @@
+/*****************************************************************************\
+ *  Copyright (C) 2021 SchedMD LLC.
+ *
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+/*
+ * Check the polls of the jobacct_gather common code on this process.
+ *
+ * The /proc scan must account the CPU time and memory of the task and its
+ * children, records built by a get_precs() callback from per task counters
+ * (as with JobAcctGatherParams=UseCgroupStats) must reach the task, and the
+ * cost of every poll must be counted.
+ */
+
+/*
+ * The plugin's copies of these would clash with the ones of libslurm.o when
+ * linked statically, and the acct_gather plugins are not loaded here.
+ */
+#define g_tres_count test_g_tres_count
+#define assoc_mgr_tres_name_array test_assoc_mgr_tres_name_array
+#define acct_gather_energy_g_get_sum test_energy_g_get_sum
+#define acct_gather_filesystem_g_get_data test_filesystem_g_get_data
+#define acct_gather_interconnect_g_get_data test_interconnect_g_get_data
+#define acct_gather_profile_g_get test_profile_g_get
+#include "src/plugins/jobacct_gather/common/common_jag.c"
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "src/slurmd/slurmd/slurmd.h"
+
+/* Normally provided by the slurmstepd and the jobacct_gather plugin */
+slurmd_conf_t *conf = NULL;
+const char plugin_type[] = "jobacct_gather/test";
+
+extern int acct_gather_energy_g_get_sum(enum acct_energy_type data_type,
+					acct_gather_energy_t *energy)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_filesystem_g_get_data(acct_gather_data_t *data)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_interconnect_g_get_data(acct_gather_data_t *data)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_profile_g_get(enum acct_gather_profile_info info_type,
+				     void *data)
+{
+	*(uint32_t *) data = ACCT_GATHER_PROFILE_NOT_SET;
+	return SLURM_SUCCESS;
+}
+
+#define TASK_USER_SEC 42
+
+static struct jobacctinfo *_create_jobacct(pid_t pid, uint32_t taskid)
+{
+	struct jobacctinfo *jobacct = xmalloc(sizeof(*jobacct));
+	int cnt = TRES_ARRAY_TOTAL_CNT, i;
+
+	jobacct->pid = pid;
+	jobacct->id.taskid = taskid;
+	jobacct->tres_count = cnt;
+	jobacct->tres_ids = xcalloc(cnt, sizeof(uint32_t));
+	jobacct->tres_usage_in_max = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_in_max_nodeid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_in_max_taskid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_in_min = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_in_min_nodeid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_in_min_taskid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_in_tot = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_out_max = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_out_max_nodeid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_out_max_taskid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_out_min = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_out_min_nodeid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_out_min_taskid = xcalloc(cnt, sizeof(uint64_t));
+	jobacct->tres_usage_out_tot = xcalloc(cnt, sizeof(uint64_t));
+	for (i = 0; i < cnt; i++) {
+		jobacct->tres_ids[i] = i;
+		jobacct->tres_usage_in_min[i] = INFINITE64;
+		jobacct->tres_usage_in_max[i] = INFINITE64;
+		jobacct->tres_usage_in_tot[i] = INFINITE64;
+		jobacct->tres_usage_out_max[i] = INFINITE64;
+		jobacct->tres_usage_out_min[i] = INFINITE64;
+		jobacct->tres_usage_out_tot[i] = INFINITE64;
+	}
+
+	return jobacct;
+}
+
+/* Stand in for the task cgroup counters */
+static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
+{
+	prec->usec = TASK_USER_SEC * sysconf(_SC_CLK_TCK);
+	prec->ssec = 0;
+	prec->tres_data[TRES_ARRAY_MEM].size_read = 1024 * 1024;
+}
+
+static List task_list;
+static struct jobacctinfo *jobacct;
+
+static void _setup(void)
+{
+	jag_common_init(0);
+	task_list = list_create(jobacctinfo_destroy);
+	jobacct = _create_jobacct(getpid(), 0);
+	list_append(task_list, jobacct);
+}
+
+static void _teardown(void)
+{
+	jag_common_fini();
+	FREE_NULL_LIST(task_list);
+}
+
+START_TEST(test_proc_poll)
+{
+	jag_callbacks_t callbacks;
+	struct timeval start, now;
+	volatile uint64_t spin = 0;
+
+	/* Use some CPU time so that it shows up in /proc */
+	gettimeofday(&start, NULL);
+	do {
+		spin++;
+		gettimeofday(&now, NULL);
+	} while (((now.tv_sec - start.tv_sec) * 1000000 +
+		  (now.tv_usec - start.tv_usec)) < 1100000);
+
+	memset(&callbacks, 0, sizeof(callbacks));
+	jag_common_poll_data(task_list, true, NO_VAL64, &callbacks, false);
+	ck_assert(jobacct->tres_usage_in_tot[TRES_ARRAY_MEM] != INFINITE64);
+	ck_assert(jobacct->tres_usage_in_tot[TRES_ARRAY_MEM] != 0);
+	ck_assert(jobacct->user_cpu_sec || jobacct->sys_cpu_sec);
+}
+END_TEST
+
+START_TEST(test_task_poll)
+{
+	jag_callbacks_t callbacks;
+	uint32_t poll_cnt, old_cnt;
+	uint64_t usec_tot, usec_max, old_tot;
+
+	jag_common_poll_stats(&old_cnt, &old_tot, &usec_max);
+	memset(&callbacks, 0, sizeof(callbacks));
+	callbacks.prec_extra = _prec_extra;
+	callbacks.get_precs = jag_common_get_task_precs;
+	jag_common_poll_data(task_list, true, NO_VAL64, &callbacks, false);
+	ck_assert_int_eq(jobacct->user_cpu_sec, TASK_USER_SEC);
+	ck_assert(jobacct->tres_usage_in_tot[TRES_ARRAY_MEM] == 1024 * 1024);
+
+	jag_common_poll_data(task_list, true, NO_VAL64, &callbacks, false);
+	jag_common_poll_stats(&poll_cnt, &usec_tot, &usec_max);
+	ck_assert_int_eq(poll_cnt - old_cnt, 2);
+	ck_assert(usec_tot > old_tot);
+	ck_assert(usec_max && (usec_max <= usec_tot));
+}
+END_TEST
+
+Suite *common_jag_suite(void)
+{
+	Suite *s = suite_create("common_jag");
+	TCase *tc_core = tcase_create("common_jag");
+	tcase_add_unchecked_fixture(tc_core, _setup, _teardown);
+	tcase_add_test(tc_core, test_proc_poll);
+	tcase_add_test(tc_core, test_task_poll);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void)
+{
+	int number_failed;
+	SRunner *sr = srunner_create(common_jag_suite());
+
+	srunner_run_all(sr, CK_ENV);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}